@@ -0,0 +1,386 @@
+#include "AssetRegistry.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include "WICTextureLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdio.h>
+
+using namespace DirectX;
+
+// SimpleShader wants wide paths, but everything else about
+// the registry (and MappedFile) is narrow
+static std::wstring Widen(const std::string& path)
+{
+	int length = MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, 0, 0);
+	if (length <= 0)
+		return std::wstring();
+
+	std::wstring wide(length, L'\0');
+	MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, &wide[0], length);
+	wide.resize(length - 1); // Drop the terminator
+	return wide;
+}
+
+// Bits per texel for the formats the WIC loader creates
+static size_t BitsPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+		return 64;
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+		return 16;
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_A8_UNORM:
+		return 8;
+	case DXGI_FORMAT_R1_UNORM:
+		return 1;
+	default:
+		return 32; // All of the 8-bit RGBA/BGRA and 10:10:10:2 formats
+	}
+}
+
+
+AssetRegistry::AssetRegistry(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<MeshPool> meshPool)
+	: device(device),
+	context(context),
+	meshPool(meshPool),
+	requests(0),
+	loads(0),
+	pathHits(0),
+	contentHits(0),
+	duplicateBytes(0)
+{
+}
+
+
+std::shared_ptr<Mesh> AssetRegistry::LoadMesh(const std::string& path, const MeshOptions& options)
+{
+	// Every option changes what gets cooked
+	char variant[64];
+	sprintf_s(variant, sizeof(variant), "weld %g, layout %d, lods %u, meshlets %d",
+		options.WeldEpsilon, (int)options.Layout, options.LodCount, (int)options.BuildMeshlets);
+
+	std::shared_ptr<Asset> asset = Find(AssetType::Mesh, path, variant, [&](Asset& a, MappedFile& file)
+	{
+		// The mesh maps the file itself, since it may need to cook it
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(path.c_str(), device, options, meshPool);
+		if (mesh->GetLodCount() == 0)
+			return false;
+
+		a.MeshData = mesh;
+		a.Info.Bytes = mesh->GetStats().Bytes;
+		return true;
+	});
+	return asset ? asset->MeshData : nullptr;
+}
+
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> AssetRegistry::LoadTexture(const std::string& path)
+{
+	std::shared_ptr<Asset> asset = Find(AssetType::Texture, path, "", [&](Asset& a, MappedFile& file)
+	{
+		// Decode straight from the mapped file we just hashed
+		// rather than having WIC read it all over again
+		HRESULT hr = CreateWICTextureFromMemory(
+			device.Get(),
+			context.Get(),
+			(const uint8_t*)file.GetData(),
+			file.GetSize(),
+			0,
+			a.Texture.GetAddressOf());
+		if (FAILED(hr))
+			return false;
+
+		a.Info.Bytes = GetTextureBytes(a.Texture);
+		return true;
+	});
+	return asset ? asset->Texture : nullptr;
+}
+
+
+std::shared_ptr<SimpleVertexShader> AssetRegistry::LoadVertexShader(const std::string& path, VertexLayout layout)
+{
+	const char* variant = layout == VertexLayout::Packed ? "packed" : "full";
+	std::shared_ptr<Asset> asset = Find(AssetType::Shader, path, variant, [&](Asset& a, MappedFile& file)
+	{
+		std::shared_ptr<SimpleVertexShader> vs;
+		if (layout == VertexLayout::Packed)
+		{
+			// Shader reflection would assume every input is a float,
+			// so the packed layout's input layout is made by hand
+			Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+			if (FAILED(D3DCreateBlob(file.GetSize(), shaderBlob.GetAddressOf())))
+				return false;
+			memcpy(shaderBlob->GetBufferPointer(), file.GetData(), file.GetSize());
+
+			Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout = Mesh::CreateInputLayout(layout, device, shaderBlob);
+			vs = std::make_shared<SimpleVertexShader>(device, context, Widen(path).c_str(), inputLayout, false);
+		}
+		else
+		{
+			vs = std::make_shared<SimpleVertexShader>(device, context, Widen(path).c_str());
+		}
+		if (!vs->IsShaderValid())
+			return false;
+
+		a.Shader = vs;
+		a.Info.Bytes = file.GetSize();
+		return true;
+	});
+	return asset ? std::static_pointer_cast<SimpleVertexShader>(asset->Shader) : nullptr;
+}
+
+
+std::shared_ptr<SimplePixelShader> AssetRegistry::LoadPixelShader(const std::string& path)
+{
+	std::shared_ptr<Asset> asset = Find(AssetType::Shader, path, "pixel", [&](Asset& a, MappedFile& file)
+	{
+		std::shared_ptr<SimplePixelShader> ps = std::make_shared<SimplePixelShader>(device, context, Widen(path).c_str());
+		if (!ps->IsShaderValid())
+			return false;
+
+		a.Shader = ps;
+		a.Info.Bytes = file.GetSize();
+		return true;
+	});
+	return asset ? std::static_pointer_cast<SimplePixelShader>(asset->Shader) : nullptr;
+}
+
+
+void AssetRegistry::Unload(const std::string& path)
+{
+	// Keys end with the normalized path
+	std::string suffix = "|" + NormalizePath(path);
+
+	std::vector<std::shared_ptr<Asset>> matches;
+	for (auto& pair : byPath)
+	{
+		const std::string& key = pair.first;
+		if (key.size() >= suffix.size() && key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0)
+			matches.push_back(pair.second);
+	}
+
+	for (auto& asset : matches)
+		Remove(asset);
+}
+
+
+unsigned int AssetRegistry::UnloadUnused()
+{
+	std::vector<std::shared_ptr<Asset>> unused;
+	for (auto& pair : byContent)
+	{
+		if (CountReferences(*pair.second) == 0)
+			unused.push_back(pair.second);
+	}
+
+	for (auto& asset : unused)
+		Remove(asset);
+	return (unsigned int)unused.size();
+}
+
+
+AssetRegistryStats AssetRegistry::GetStats()
+{
+	AssetRegistryStats stats = {};
+	stats.Requests = requests;
+	stats.Loads = loads;
+	stats.PathHits = pathHits;
+	stats.ContentHits = contentHits;
+	stats.DuplicateBytes = duplicateBytes;
+
+	// Each asset is in byContent exactly once
+	for (auto& pair : byContent)
+	{
+		const AssetInfo& info = pair.second->Info;
+		switch (info.Type)
+		{
+		case AssetType::Mesh: stats.Meshes++; break;
+		case AssetType::Texture: stats.Textures++; break;
+		case AssetType::Shader: stats.Shaders++; break;
+		}
+		stats.ResidentBytes += info.Bytes;
+	}
+	return stats;
+}
+
+
+std::vector<AssetInfo> AssetRegistry::GetAssets()
+{
+	std::vector<AssetInfo> assets;
+	for (auto& pair : byContent)
+	{
+		AssetInfo info = pair.second->Info;
+		info.References = CountReferences(*pair.second);
+		assets.push_back(info);
+	}
+
+	// Biggest first, since that's usually what you're looking for
+	std::sort(assets.begin(), assets.end(), [](const AssetInfo& a, const AssetInfo& b) { return a.Bytes > b.Bytes; });
+	return assets;
+}
+
+
+std::string AssetRegistry::NormalizePath(const std::string& path)
+{
+	// Windows paths aren't case sensitive
+	std::string lower = path;
+	for (char& c : lower)
+		c = c == '\\' ? '/' : (char)tolower((unsigned char)c);
+
+	// Rebuild it one part at a time, resolving "." and ".."
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= lower.size())
+	{
+		size_t end = lower.find('/', start);
+		if (end == std::string::npos)
+			end = lower.size();
+		std::string part = lower.substr(start, end - start);
+		start = end + 1;
+
+		if (part.empty() || part == ".")
+			continue;
+		if (part == ".." && !parts.empty() && parts.back() != ".." && parts.back().back() != ':')
+			parts.pop_back();
+		else
+			parts.push_back(part);
+	}
+
+	std::string normalized = !lower.empty() && lower[0] == '/' ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i > 0)
+			normalized += '/';
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+
+template<typename LoadFunc>
+std::shared_ptr<AssetRegistry::Asset> AssetRegistry::Find(
+	AssetType type,
+	const std::string& path,
+	const std::string& variant,
+	const LoadFunc& load)
+{
+	requests++;
+
+	// Already loaded from this path?
+	std::string normalized = NormalizePath(path);
+	std::string prefix = std::to_string((int)type) + "|" + variant + "|";
+	std::string key = prefix + normalized;
+	auto existing = byPath.find(key);
+	if (existing != byPath.end())
+	{
+		std::shared_ptr<Asset> asset = existing->second;
+		asset->Info.Requests++;
+		pathHits++;
+		duplicateBytes += asset->Info.Bytes;
+		return asset;
+	}
+
+	// Or the same file under another name?
+	MappedFile file(path.c_str());
+	if (!file.IsOpen())
+		return nullptr;
+	unsigned long long contentHash = HashBytes(file.GetData(), file.GetSize());
+	unsigned long long contentKey = HashBytes(&contentHash, sizeof(contentHash), HashBytes(prefix.data(), prefix.size()));
+
+	auto sameContent = byContent.find(contentKey);
+	if (sameContent != byContent.end())
+	{
+		std::shared_ptr<Asset> asset = sameContent->second;
+		asset->Info.Requests++;
+		asset->Keys.push_back(key);
+		byPath[key] = asset;
+		contentHits++;
+		duplicateBytes += asset->Info.Bytes;
+		return asset;
+	}
+
+	// Nope, load it for real
+	std::shared_ptr<Asset> asset = std::make_shared<Asset>();
+	asset->Info.Type = type;
+	asset->Info.Path = normalized;
+	asset->Info.ContentHash = contentHash;
+	asset->Info.Bytes = 0;
+	asset->Info.Requests = 1;
+	asset->Info.References = 0;
+	asset->ContentKey = contentKey;
+	if (!load(*asset, file))
+		return nullptr;
+
+	asset->Keys.push_back(key);
+	byPath[key] = asset;
+	byContent[contentKey] = asset;
+	loads++;
+	return asset;
+}
+
+
+void AssetRegistry::Remove(const std::shared_ptr<Asset>& asset)
+{
+	for (const std::string& key : asset->Keys)
+		byPath.erase(key);
+	byContent.erase(asset->ContentKey);
+}
+
+
+// How many handles to the asset exist outside of the registry
+unsigned int AssetRegistry::CountReferences(const Asset& asset)
+{
+	if (asset.MeshData)
+		return (unsigned int)asset.MeshData.use_count() - 1;
+	if (asset.Shader)
+		return (unsigned int)asset.Shader.use_count() - 1;
+	if (asset.Texture)
+	{
+		// COM doesn't have a way to just read the count, but
+		// AddRef() and Release() both return the new one.  That
+		// includes materials holding the view and any binding
+		// left on the pipeline, which is what we want anyway.
+		asset.Texture->AddRef();
+		return asset.Texture->Release() - 1;
+	}
+	return 0;
+}
+
+
+// Adds up every mip of every array slice
+size_t AssetRegistry::GetTextureBytes(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	srv->GetResource(resource.GetAddressOf());
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(resource.As(&texture)))
+		return 0;
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+
+	size_t bytes = 0;
+	for (UINT mip = 0; mip < desc.MipLevels; mip++)
+	{
+		size_t width = std::max(1u, desc.Width >> mip);
+		size_t height = std::max(1u, desc.Height >> mip);
+		bytes += (width * height * BitsPerPixel(desc.Format) + 7) / 8;
+	}
+	return bytes * desc.ArraySize;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshPool.h"
+#include "SimpleShader.h"
+
+enum class AssetType
+{
+	Mesh,
+	Texture,
+	Shader
+};
+
+// What the registry knows about one resident asset
+struct AssetInfo
+{
+	AssetType Type;
+	std::string Path;				// Normalized path it was first loaded from
+	unsigned long long ContentHash;	// HashBytes() of the file
+	size_t Bytes;					// GPU memory (or bytecode, for shaders)
+	unsigned int Requests;			// Times it was asked for, under any path
+	unsigned int References;		// Handles held outside the registry
+};
+
+struct AssetRegistryStats
+{
+	unsigned int Meshes;
+	unsigned int Textures;
+	unsigned int Shaders;
+	unsigned int Requests;		// Every Load call
+	unsigned int Loads;			// Ones that actually read and created something
+	unsigned int PathHits;		// Same path as something already resident
+	unsigned int ContentHits;	// Different path, but the same file contents
+	size_t ResidentBytes;
+	size_t DuplicateBytes;		// What the hits would have cost as separate copies
+};
+
+// --------------------------------------------------------
+// The one place meshes, textures and shaders get loaded.
+//
+// Each asset is keyed by its normalized path (so "a/../b.png"
+// and "B.png" are the same file) and by a hash of the file's
+// contents (so a copy of a file under another name is still
+// only loaded once).  Asking for something already resident
+// is just a lookup, and everyone who asks shares the same
+// mesh, view or shader.
+//
+// The registry holds a reference to everything it loads, so
+// assets stay resident until they're unloaded - either by
+// path, or all of the ones nothing else is using any more.
+// --------------------------------------------------------
+class AssetRegistry
+{
+public:
+	AssetRegistry(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<MeshPool> meshPool = nullptr);
+
+	// Each of these returns null if the file can't be read.  The
+	// same file with different options is a different asset.
+	std::shared_ptr<Mesh> LoadMesh(const std::string& path, const MeshOptions& options = MeshOptions());
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadTexture(const std::string& path);
+	std::shared_ptr<SimpleVertexShader> LoadVertexShader(const std::string& path, VertexLayout layout = VertexLayout::Full);
+	std::shared_ptr<SimplePixelShader> LoadPixelShader(const std::string& path);
+
+	// Drops the registry's reference to everything loaded from
+	// this path.  Anything still in use stays alive until its
+	// last handle goes away, but won't be handed out again.
+	void Unload(const std::string& path);
+
+	// Drops every asset nobody outside the registry is holding,
+	// returning how many went
+	unsigned int UnloadUnused();
+
+	AssetRegistryStats GetStats();
+	std::vector<AssetInfo> GetAssets();
+
+	// Lowercase, forward slashes, no "." or ".." parts and no
+	// doubled slashes
+	static std::string NormalizePath(const std::string& path);
+
+private:
+	struct Asset
+	{
+		AssetInfo Info;
+		std::vector<std::string> Keys;	// Every path key that leads here
+		unsigned long long ContentKey;
+
+		// Only one of these is set, depending on the type
+		std::shared_ptr<Mesh> MeshData;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Texture;
+		std::shared_ptr<ISimpleShader> Shader;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::shared_ptr<MeshPool> meshPool;
+
+	// Path keys and content keys both include the asset type and
+	// any load options, since those change what gets created
+	std::unordered_map<std::string, std::shared_ptr<Asset>> byPath;
+	std::unordered_map<unsigned long long, std::shared_ptr<Asset>> byContent;
+
+	unsigned int requests;
+	unsigned int loads;
+	unsigned int pathHits;
+	unsigned int contentHits;
+	size_t duplicateBytes;
+
+	// Returns the asset already loaded for this key or content,
+	// or loads it with the given function (which fills in the
+	// asset and returns false on failure)
+	template<typename LoadFunc>
+	std::shared_ptr<Asset> Find(
+		AssetType type,
+		const std::string& path,
+		const std::string& variant,
+		const LoadFunc& load);
+
+	void Remove(const std::shared_ptr<Asset>& asset);
+	static unsigned int CountReferences(const Asset& asset);
+	static size_t GetTextureBytes(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+};
@@ -0,0 +1,2645 @@
+#include "Benchmarks.h"
+#include "CookedMesh.h"
+#include "Hash.h"
+#include "InstanceBatcher.h"
+#include "Frustum.h"
+#include "LightGrid.h"
+#include "FrustumCuller.h"
+#include "MappedFile.h"
+#include "Meshlet.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjectLights.h"
+#include "OcclusionCuller.h"
+#include "Parallel.h"
+#include "PackedVertex.h"
+#include "RangeAllocator.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "ShadowCache.h"
+#include "ShadowCascades.h"
+#include "ShadowCasterCuller.h"
+#include "Tangents.h"
+#include "Transform.h"
+#include "TransformSystem.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+// The models we ship, used as the benchmark data set
+static const char* modelFiles[] = { "cone.obj", "cube.obj", "cylinder.obj", "helix.obj", "sphere.obj", "torus.obj" };
+
+// The entities from Game::Init(), for benchmarks that need a scene
+struct SceneEntity
+{
+	const char* Model;
+	XMFLOAT3 Position;
+	XMFLOAT3 Scale;
+};
+static const SceneEntity sceneEntities[] =
+{
+	{ "helix.obj", XMFLOAT3(0, 0, -3), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(-6, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(-4, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(-2, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(2, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(4, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "sphere.obj", XMFLOAT3(6, 0, 0), XMFLOAT3(1, 1, 1) },
+	{ "cube.obj", XMFLOAT3(0, 0, 3), XMFLOAT3(20, 10, 1) },
+};
+
+// --------------------------------------------------------
+// Runs the given function several times and returns the
+// fastest time in seconds, which filters out most noise
+// --------------------------------------------------------
+template<typename Func>
+static double TimeBest(int iterations, const Func& func)
+{
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		func();
+		auto end = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double>(end - start).count());
+	}
+	return best;
+}
+
+// --------------------------------------------------------
+// The original Mesh OBJ loader (getline into a 100-char
+// buffer, then sscanf_s per line), kept as the baseline.
+// Produces the same raw data as ParseObj().
+// --------------------------------------------------------
+static bool LoadObjReference(const char* objFile, ObjData& out)
+{
+	std::ifstream obj(objFile);
+	if (!obj.is_open())
+		return false;
+
+	out = ObjData();
+	char chars[100];
+	while (obj.good())
+	{
+		obj.getline(chars, 100);
+
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			out.Normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			out.UVs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			out.Positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			int i[12];
+			int facesRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			ObjCorner c[4];
+			for (int k = 0; k < 4; k++)
+				c[k] = { i[k * 3] - 1, i[k * 3 + 1] - 1, i[k * 3 + 2] - 1 };
+
+			out.Corners.push_back(c[0]); out.Corners.push_back(c[1]); out.Corners.push_back(c[2]);
+			if (facesRead == 12)
+			{
+				out.Corners.push_back(c[0]); out.Corners.push_back(c[2]); out.Corners.push_back(c[3]);
+			}
+		}
+	}
+
+	return !out.Corners.empty();
+}
+
+
+void RunBenchmarks(const std::string& modelFolder)
+{
+	printf("\n===== Benchmarks =====\n");
+	BenchmarkObjLoading(modelFolder);
+	BenchmarkMeshOptimization(modelFolder);
+	BenchmarkLodGeneration(modelFolder);
+	BenchmarkMeshletCulling(modelFolder);
+	CheckTangents(modelFolder);
+	BenchmarkCookedLoading(modelFolder);
+	CheckVertexPacking(modelFolder);
+	CheckRangeAllocator();
+	BenchmarkSceneGraph();
+	BenchmarkTransformSystem();
+	CheckNormalMatrix();
+	CheckTransformRotation();
+	CheckInterpolation();
+	BenchmarkFrustumCulling();
+	CheckOcclusionCulling();
+	CheckRenderQueue();
+	CheckInstancing();
+	CheckLightGrid();
+	CheckObjectLights();
+	CheckShadowCasters();
+	CheckShadowCache();
+	CheckShadowCascades();
+	printf("======================\n\n");
+}
+
+
+void BenchmarkObjLoading(const std::string& modelFolder)
+{
+	printf("\n-- OBJ loading (best of 5) --\n");
+	printf("%-14s %10s %12s %12s %9s\n", "File", "KB", "sscanf MB/s", "mapped MB/s", "Speedup");
+
+	for (const char* name : modelFiles)
+	{
+		std::string path = modelFolder + name;
+
+		// Grab the file size for the throughput numbers
+		std::ifstream sizeCheck(path, std::ios::binary | std::ios::ate);
+		if (!sizeCheck.is_open())
+			continue;
+		double megabytes = (double)sizeCheck.tellg() / (1024.0 * 1024.0);
+
+		ObjData reference, mapped;
+		double refTime = TimeBest(5, [&]() { LoadObjReference(path.c_str(), reference); });
+		double newTime = TimeBest(5, [&]() { LoadObj(path.c_str(), mapped); });
+
+		printf("%-14s %10.1f %12.1f %12.1f %8.1fx\n",
+			name,
+			megabytes * 1024.0,
+			megabytes / refTime,
+			megabytes / newTime,
+			refTime / newTime);
+
+		// Both loaders should agree on what's in the file
+		if (reference.Positions.size() != mapped.Positions.size() ||
+			reference.Corners.size() != mapped.Corners.size())
+		{
+			printf("  WARNING: loaders disagree (%zu vs %zu positions, %zu vs %zu corners)\n",
+				reference.Positions.size(), mapped.Positions.size(),
+				reference.Corners.size(), mapped.Corners.size());
+		}
+	}
+}
+
+
+void BenchmarkMeshOptimization(const std::string& modelFolder)
+{
+	printf("\n-- Mesh optimization (16 entry FIFO cache, 6 view overdraw) --\n");
+	printf("%-14s %-10s %7s %7s %9s %9s\n", "File", "Pass", "ACMR", "ATVR", "Overdraw", "ms");
+
+	for (const char* name : modelFiles)
+	{
+		ObjData obj;
+		if (!LoadObj((modelFolder + name).c_str(), obj))
+			continue;
+
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		BuildObjVertices(obj, verts, indices);
+		WeldVertices(verts, indices);
+
+		auto report = [&](const char* pass, double seconds)
+		{
+			VertexCacheStats cache = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)verts.size());
+			OverdrawStats overdraw = AnalyzeOverdraw(verts, indices);
+			printf("%-14s %-10s %7.3f %7.3f %9.3f %9.3f\n",
+				name, pass, cache.ACMR, cache.ATVR, overdraw.Overdraw, seconds * 1000.0);
+		};
+		report("welded", 0.0);
+
+		// Each pass is timed on a fresh copy of its input
+		std::vector<unsigned int> clusters;
+		std::vector<unsigned int> input = indices;
+		double time = TimeBest(5, [&]() { indices = input; OptimizeVertexCache(indices, (unsigned int)verts.size(), &clusters); });
+		report("cache", time);
+
+		input = indices;
+		time = TimeBest(5, [&]() { indices = input; OptimizeOverdraw(verts, indices, clusters); });
+		report("overdraw", time);
+
+		std::vector<Vertex> inputVerts = verts;
+		input = indices;
+		time = TimeBest(5, [&]() { verts = inputVerts; indices = input; OptimizeVertexFetch(verts, indices); });
+		report("fetch", time);
+	}
+}
+
+
+void BenchmarkLodGeneration(const std::string& modelFolder)
+{
+	printf("\n-- LOD generation (half the triangles per level, error capped at 10%% of radius) --\n");
+	printf("%-14s %4s %9s %10s %9s %7s\n", "File", "LOD", "Triangles", "Error", "% Radius", "ACMR");
+
+	for (const char* name : modelFiles)
+	{
+		ObjData obj;
+		if (!LoadObj((modelFolder + name).c_str(), obj))
+			continue;
+
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		BuildObjVertices(obj, verts, indices);
+		WeldVertices(verts, indices);
+		OptimizeMesh(verts, indices);
+		MeshBounds bounds = CalculateBounds(verts.data(), verts.size());
+
+		std::vector<unsigned int> lodIndices;
+		std::vector<MeshLod> lods;
+		double time = TimeBest(3, [&]()
+		{
+			lodIndices = indices;
+			GenerateLods(verts, lodIndices, MAX_MESH_LODS, bounds.Radius * 0.1f, lods);
+		});
+
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			const MeshLod& lod = lods[i];
+			VertexCacheStats cache = AnalyzeVertexCache(&lodIndices[lod.IndexOffset], lod.IndexCount, (unsigned int)verts.size());
+			printf("%-14s %4zu %9u %10.5f %9.2f %7.3f\n",
+				name, i, lod.IndexCount / 3, lod.Error, lod.Error / bounds.Radius * 100.0f, cache.ACMR);
+		}
+
+		// The simplifier has to be deterministic, or re-cooking
+		// the same file would give different LODs
+		std::vector<unsigned int> again = indices;
+		std::vector<MeshLod> againLods;
+		GenerateLods(verts, again, MAX_MESH_LODS, bounds.Radius * 0.1f, againLods);
+		bool same = again == lodIndices && againLods.size() == lods.size();
+		printf("%-14s %.3f ms, %s\n", name, time * 1000.0, same ? "deterministic" : "NOT DETERMINISTIC");
+	}
+}
+
+
+// --------------------------------------------------------
+// A UV sphere with the given number of segments around and
+// rings from pole to pole, wound to match our OBJ meshes
+// --------------------------------------------------------
+static void BuildSphere(unsigned int segments, unsigned int rings, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	verts.clear();
+	indices.clear();
+	for (unsigned int r = 0; r <= rings; r++)
+	{
+		float theta = XM_PI * r / rings;
+		for (unsigned int s = 0; s <= segments; s++)
+		{
+			float phi = XM_2PI * s / segments;
+			Vertex v = {};
+			v.Normal = XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			v.Position = v.Normal;
+			v.UV = XMFLOAT2((float)s / segments, (float)r / rings);
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned int r = 0; r < rings; r++)
+	{
+		for (unsigned int s = 0; s < segments; s++)
+		{
+			unsigned int i0 = r * (segments + 1) + s;
+			unsigned int i1 = i0 + 1;
+			unsigned int i2 = i0 + segments + 1;
+			unsigned int i3 = i2 + 1;
+			unsigned int quad[6] = { i0, i1, i2, i2, i1, i3 };
+			for (int t = 0; t < 6; t += 3)
+			{
+				// Skip the slivers at the poles
+				XMVECTOR p0 = XMLoadFloat3(&verts[quad[t]].Position);
+				XMVECTOR p1 = XMLoadFloat3(&verts[quad[t + 1]].Position);
+				XMVECTOR p2 = XMLoadFloat3(&verts[quad[t + 2]].Position);
+				XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+				if (XMVectorGetX(XMVector3LengthSq(n)) <= 0.0f)
+					continue;
+
+				// Front faces are clockwise, so their cross product points out
+				bool outward = XMVectorGetX(XMVector3Dot(n, p0 + p1 + p2)) > 0.0f;
+				indices.push_back(quad[t]);
+				indices.push_back(outward ? quad[t + 1] : quad[t + 2]);
+				indices.push_back(outward ? quad[t + 2] : quad[t + 1]);
+			}
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Culls every object's meshlets from a camera orbiting the
+// origin, printing the average triangles rejected per frame
+// --------------------------------------------------------
+struct CullObject
+{
+	const std::vector<Meshlet>* Meshlets;
+	XMFLOAT4X4 World;
+};
+
+static void MeasureMeshletCulling(const char* label, const std::vector<CullObject>& objects, float orbitRadius, double buildTime)
+{
+	const int frames = 72;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.01f, 100.0f));
+
+	MeshletCullStats total = {};
+	std::vector<IndexRange> visible;
+	size_t drawCalls = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		// Start in front (where the game's camera starts) and go round
+		float angle = XM_2PI * f / frames;
+		XMFLOAT3 cameraPos(sinf(angle) * orbitRadius, 0.0f, -cosf(angle) * orbitRadius);
+		XMVECTOR eye = XMLoadFloat3(&cameraPos);
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(eye, -eye, XMVectorSet(0, 1, 0, 0)));
+		Frustum frustum = CreateFrustum(view, projection);
+
+		for (const CullObject& o : objects)
+		{
+			CullMeshlets(*o.Meshlets, o.World, frustum, cameraPos, visible, &total);
+			drawCalls += visible.size();
+		}
+	}
+	double cullTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	unsigned int rejected = total.TrianglesOutsideFrustum + total.TrianglesBackfacing;
+	printf("%-18s %8u %9.2f %9u %9u %9u %8.1f%% %6zu %8.1f\n",
+		label,
+		total.Meshlets / frames,
+		buildTime * 1000.0,
+		total.Triangles / frames,
+		total.TrianglesOutsideFrustum / frames,
+		total.TrianglesBackfacing / frames,
+		total.Triangles ? 100.0f * rejected / total.Triangles : 0.0f,
+		drawCalls / frames,
+		cullTime / frames * 1000000.0);
+}
+
+
+void BenchmarkMeshletCulling(const std::string& modelFolder)
+{
+	printf("\n-- Meshlet culling (%d verts / %d tris, orbiting camera, per frame) --\n", MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+	printf("%-18s %8s %9s %9s %9s %9s %9s %6s %8s\n",
+		"Scene", "Meshlets", "Build ms", "Triangles", "Frustum", "Backface", "Rejected", "Draws", "Cull us");
+
+	// The game's scene, with meshlets for every model it uses
+	std::vector<std::string> names;
+	std::vector<std::vector<Meshlet>> meshlets;
+	double buildTime = 0.0;
+	std::vector<CullObject> objects;
+	for (const SceneEntity& e : sceneEntities)
+	{
+		size_t m = std::find(names.begin(), names.end(), e.Model) - names.begin();
+		if (m == names.size())
+		{
+			ObjData obj;
+			if (!LoadObj((modelFolder + e.Model).c_str(), obj))
+				return;
+
+			std::vector<Vertex> verts;
+			std::vector<unsigned int> indices;
+			BuildObjVertices(obj, verts, indices);
+			WeldVertices(verts, indices);
+			OptimizeMesh(verts, indices);
+
+			names.push_back(e.Model);
+			meshlets.emplace_back();
+			buildTime += TimeBest(3, [&]() { std::vector<unsigned int> copy = indices; BuildMeshlets(verts, copy, meshlets.back()); });
+		}
+
+		CullObject o;
+		XMStoreFloat4x4(&o.World, XMMatrixScaling(e.Scale.x, e.Scale.y, e.Scale.z) * XMMatrixTranslation(e.Position.x, e.Position.y, e.Position.z));
+		objects.push_back(o);
+	}
+
+	// Pointers only once the vector is done growing
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		size_t m = std::find(names.begin(), names.end(), sceneEntities[i].Model) - names.begin();
+		objects[i].Meshlets = &meshlets[m];
+	}
+	MeasureMeshletCulling("game scene", objects, 10.0f, buildTime);
+
+	// One big sphere, close up
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	BuildSphere(512, 256, verts, indices);
+	OptimizeVertexCache(indices, (unsigned int)verts.size());
+
+	std::vector<Meshlet> sphereMeshlets;
+	buildTime = TimeBest(1, [&]() { std::vector<unsigned int> copy = indices; BuildMeshlets(verts, copy, sphereMeshlets); });
+
+	CullObject sphere;
+	sphere.Meshlets = &sphereMeshlets;
+	XMStoreFloat4x4(&sphere.World, XMMatrixIdentity());
+	MeasureMeshletCulling("sphere 512x256", std::vector<CullObject>(1, sphere), 3.0f, buildTime);
+}
+
+
+// Uses atan2 rather than acos, which is too imprecise near 0 degrees
+static float AngleBetween(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	XMVECTOR va = XMLoadFloat3(&a);
+	XMVECTOR vb = XMLoadFloat3(&b);
+	float sinPart = XMVectorGetX(XMVector3Length(XMVector3Cross(va, vb)));
+	float cosPart = XMVectorGetX(XMVector3Dot(va, vb));
+	return XMConvertToDegrees(atan2f(sinPart, cosPart));
+}
+
+// --------------------------------------------------------
+// Times CalculateTangents() against the reference version on
+// copies of the same vertices, then prints the largest angle
+// between their tangents and how many handedness signs differ
+// --------------------------------------------------------
+static bool CompareTangents(const char* label, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, int iterations)
+{
+	std::vector<Vertex> reference = verts;
+	std::vector<Vertex> fast = verts;
+	double referenceTime = TimeBest(iterations, [&]() {
+		CalculateTangentsReference(reference.data(), (int)reference.size(), indices.data(), (int)indices.size()); });
+	double fastTime = TimeBest(iterations, [&]() {
+		CalculateTangents(fast.data(), (int)fast.size(), indices.data(), (int)indices.size()); });
+
+	float maxAngle = 0.0f;
+	unsigned int signDiffs = 0;
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		const XMFLOAT4& a = reference[i].Tangent;
+		const XMFLOAT4& b = fast[i].Tangent;
+		float angle = AngleBetween(XMFLOAT3(a.x, a.y, a.z), XMFLOAT3(b.x, b.y, b.z));
+		maxAngle = std::isfinite(angle) ? std::max(maxAngle, angle) : 180.0f;
+		signDiffs += a.w != b.w;
+	}
+
+	bool pass = maxAngle <= 0.01f && signDiffs == 0;
+	printf("%-18s %9zu %9.3f %9.3f %8.1fx %9.5f %6u   %s\n",
+		label, indices.size() / 3, referenceTime * 1000.0, fastTime * 1000.0,
+		referenceTime / fastTime, maxAngle, signDiffs, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+
+void CheckTangents(const std::string& modelFolder)
+{
+	printf("\n-- Tangent generation (%u threads, best of 5) --\n", GetWorkerCount());
+	printf("%-18s %9s %9s %9s %9s %9s %6s\n",
+		"Mesh", "Triangles", "Ref ms", "Fast ms", "Speedup", "Max deg", "Signs");
+
+	for (const char* name : modelFiles)
+	{
+		ObjData obj;
+		if (!LoadObj((modelFolder + name).c_str(), obj))
+			continue;
+
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		BuildObjVertices(obj, verts, indices);
+		WeldVertices(verts, indices);
+		CompareTangents(name, verts, indices, 5);
+	}
+
+	// Big enough for the threads to matter
+	const unsigned int segments = 2048;
+	const unsigned int rings = 1024;
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	BuildSphere(segments, rings, verts, indices);
+	CompareTangents("sphere 2048x1024", verts, indices, 5);
+
+	// Mirror the second half of the sphere's UVs, the way symmetric
+	// models usually share texture space, and check that each
+	// vertex's handedness is the opposite of its mirror image's
+	for (Vertex& v : verts)
+		v.UV.x = v.UV.x > 0.5f ? 1.0f - v.UV.x : v.UV.x;
+	CompareTangents("  mirrored UVs", verts, indices, 1);
+
+	CalculateTangents(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+	unsigned int checked = 0;
+	unsigned int wrong = 0;
+	for (unsigned int r = 1; r < rings; r++)
+	{
+		for (unsigned int s = 1; s < segments / 2; s++)
+		{
+			const Vertex& a = verts[r * (segments + 1) + s];
+			const Vertex& b = verts[r * (segments + 1) + segments - s];
+			wrong += a.Tangent.w == b.Tangent.w;
+			checked++;
+		}
+	}
+	printf("  mirrored signs:  %u of %u pairs wrong   %s\n", wrong, checked, wrong == 0 ? "PASS" : "FAIL");
+
+	// No UV area anywhere, so every vertex needs the fallback
+	for (Vertex& v : verts)
+		v.UV = XMFLOAT2(0.5f, 0.5f);
+	CompareTangents("  degenerate UVs", verts, indices, 1);
+
+	CalculateTangents(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+	unsigned int bad = 0;
+	for (const Vertex& v : verts)
+	{
+		XMVECTOR t = XMVectorSetW(XMLoadFloat4(&v.Tangent), 0.0f);
+		float length = XMVectorGetX(XMVector3Length(t));
+		float dot = XMVectorGetX(XMVector3Dot(t, XMLoadFloat3(&v.Normal)));
+		bad += !(fabsf(length - 1.0f) <= 1e-4f && fabsf(dot) <= 1e-4f);
+	}
+	printf("  fallback:        %u of %zu not unit & perpendicular   %s\n", bad, verts.size(), bad == 0 ? "PASS" : "FAIL");
+}
+
+
+void BenchmarkCookedLoading(const std::string& modelFolder)
+{
+	printf("\n-- Cooked mesh loading (best of 5, ms) --\n");
+	printf("%-14s %9s %9s %9s %10s %10s\n", "File", "Parse", "Cook", "Cooked", "vs Parse", "vs Cook");
+
+	for (const char* name : modelFiles)
+	{
+		std::string path = modelFolder + name;
+		// Our own cooked file, so we don't clobber the one Mesh uses
+		std::string cookedPath = GetCookedMeshPath(path.c_str()) + ".benchmark";
+
+		// Cook it, just like Mesh does
+		MeshOptions options;
+		unsigned long long sourceHash = 0;
+		{
+			MappedFile source(path.c_str());
+			if (!source.IsOpen())
+				continue;
+			sourceHash = HashBytes(source.GetData(), source.GetSize());
+
+			CookedMeshData mesh;
+			if (!CookObj(source.GetData(), source.GetSize(), sourceHash, options, mesh) ||
+				!WriteCookedMesh(cookedPath.c_str(), mesh))
+				continue;
+		}
+
+		ObjData obj;
+		double parseTime = TimeBest(5, [&]() { LoadObj(path.c_str(), obj); });
+
+		double cookTime = TimeBest(5, [&]()
+		{
+			MappedFile source(path.c_str());
+			CookedMeshData mesh;
+			CookObj(source.GetData(), source.GetSize(), HashBytes(source.GetData(), source.GetSize()), options, mesh);
+		});
+
+		// Everything Mesh does before CreateBuffers, plus touching each
+		// page of the cooked data as the upload would
+		bool valid = false;
+		volatile unsigned char sink = 0;
+		double cookedTime = TimeBest(5, [&]()
+		{
+			MappedFile source(path.c_str());
+			unsigned long long hash = HashBytes(source.GetData(), source.GetSize());
+
+			CookedMesh cooked(cookedPath.c_str());
+			valid = cooked.IsValid(hash, options);
+			if (!valid)
+				return;
+
+			const CookedMeshHeader* header = cooked.GetHeader();
+			const unsigned char* bytes = (const unsigned char*)cooked.GetVertexData();
+			size_t size = (size_t)header->VertexCount * header->VertexStride + (size_t)header->IndexCount * header->IndexStride;
+			unsigned char sum = 0;
+			for (size_t i = 0; i < size; i += 4096)
+				sum += bytes[i];
+			sink = sum;
+		});
+
+		printf("%-14s %9.3f %9.3f %9.3f %9.1fx %9.1fx%s\n",
+			name,
+			parseTime * 1000.0,
+			cookTime * 1000.0,
+			cookedTime * 1000.0,
+			parseTime / cookedTime,
+			cookTime / cookedTime,
+			valid ? "" : "  (cooked file rejected!)");
+
+		remove(cookedPath.c_str());
+	}
+}
+
+
+// --------------------------------------------------------
+// Largest errors seen when round-tripping through PackVertex()
+// and UnpackVertex()
+// --------------------------------------------------------
+struct PackingErrors
+{
+	float Position;		// Worst axis, as a fraction of that axis' extent
+	float Normal;		// Degrees
+	float Tangent;		// Degrees, or 180 if the handedness flips
+	float UV;			// Relative to the UV's magnitude (or absolute below 1)
+};
+
+static void MeasurePacking(const Vertex& v, const MeshBounds& bounds, PackingErrors& errors)
+{
+	Vertex unpacked = UnpackVertex(PackVertex(v, bounds), bounds);
+
+	const float* p = &v.Position.x;
+	const float* q = &unpacked.Position.x;
+	const float* minP = &bounds.Min.x;
+	const float* maxP = &bounds.Max.x;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = maxP[axis] - minP[axis];
+		if (extent > 0.0f)
+			errors.Position = std::max(errors.Position, fabsf(p[axis] - q[axis]) / extent);
+	}
+
+	errors.Normal = std::max(errors.Normal, AngleBetween(v.Normal, unpacked.Normal));
+	errors.Tangent = std::max(errors.Tangent, (v.Tangent.w < 0.0f) != (unpacked.Tangent.w < 0.0f) ? 180.0f :
+		AngleBetween(XMFLOAT3(v.Tangent.x, v.Tangent.y, v.Tangent.z), XMFLOAT3(unpacked.Tangent.x, unpacked.Tangent.y, unpacked.Tangent.z)));
+	errors.UV = std::max(errors.UV, fabsf(v.UV.x - unpacked.UV.x) / std::max(1.0f, fabsf(v.UV.x)));
+	errors.UV = std::max(errors.UV, fabsf(v.UV.y - unpacked.UV.y) / std::max(1.0f, fabsf(v.UV.y)));
+}
+
+// Prints the errors and whether they're within the format's limits
+static bool ReportPacking(const char* label, const PackingErrors& errors)
+{
+	// - Positions: half a unorm16 step
+	// - Directions: 16-bit octahedral is good to about a hundredth of a degree
+	// - UVs: half floats have 11 bits of precision, so half an ulp is 2^-11
+	// Each gets 5% extra for float rounding in the checks themselves
+	const float positionLimit = 0.5f / 65535.0f * 1.05f;
+	const float directionLimit = 0.01f;
+	const float uvLimit = 1.0f / 2048.0f * 1.05f;
+
+	bool pass =
+		errors.Position <= positionLimit &&
+		errors.Normal <= directionLimit &&
+		errors.Tangent <= directionLimit &&
+		errors.UV <= uvLimit;
+
+	printf("%-14s %12.2e %12.5f %12.5f %12.2e   %s\n",
+		label, errors.Position, errors.Normal, errors.Tangent, errors.UV, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+
+void CheckVertexPacking(const std::string& modelFolder)
+{
+	printf("\n-- Packed vertex round trip (max errors) --\n");
+	printf("%-14s %12s %12s %12s %12s\n", "Source", "Pos/extent", "Normal deg", "Tangent deg", "UV");
+
+	// Random data, seeded so every run checks the same vertices
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> uvRange(-4.0f, 4.0f);
+
+		MeshBounds bounds = {};
+		bounds.Min = XMFLOAT3(-3.0f, -0.5f, -10.0f);
+		bounds.Max = XMFLOAT3(5.0f, 0.5f, 10.0f);
+
+		PackingErrors errors = {};
+		for (int i = 0; i < 1000000; i++)
+		{
+			Vertex v = {};
+			v.Position = XMFLOAT3(
+				bounds.Min.x + (unit(rng) * 0.5f + 0.5f) * (bounds.Max.x - bounds.Min.x),
+				bounds.Min.y + (unit(rng) * 0.5f + 0.5f) * (bounds.Max.y - bounds.Min.y),
+				bounds.Min.z + (unit(rng) * 0.5f + 0.5f) * (bounds.Max.z - bounds.Min.z));
+			XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0)));
+			XMStoreFloat4(&v.Tangent, XMVectorSetW(XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0)), unit(rng) < 0.0f ? -1.0f : 1.0f));
+			v.UV = XMFLOAT2(uvRange(rng), uvRange(rng));
+			MeasurePacking(v, bounds, errors);
+		}
+
+		// The octahedron's folds and corners are the usual trouble spots
+		const XMFLOAT3 edgeCases[] = {
+			XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0),
+			XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(0.7071f, 0, -0.7071f), XMFLOAT3(0, -0.7071f, -0.7071f) };
+		for (const XMFLOAT3& n : edgeCases)
+		{
+			Vertex v = {};
+			v.Position = bounds.Max;
+			v.Normal = n;
+			v.Tangent = XMFLOAT4(n.x, n.y, n.z, -1.0f);
+			MeasurePacking(v, bounds, errors);
+		}
+
+		ReportPacking("random", errors);
+	}
+
+	// And the real thing
+	for (const char* name : modelFiles)
+	{
+		ObjData obj;
+		if (!LoadObj((modelFolder + name).c_str(), obj))
+			continue;
+
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		BuildObjVertices(obj, verts, indices);
+		WeldVertices(verts, indices);
+		CalculateTangents(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+		MeshBounds bounds = CalculateBounds(verts.data(), verts.size());
+
+		PackingErrors errors = {};
+		for (const Vertex& v : verts)
+			MeasurePacking(v, bounds, errors);
+		ReportPacking(name, errors);
+	}
+}
+
+
+// Copies the allocations that moved during Compact() around a
+// CPU copy of the buffer, the way MeshPool does on the GPU
+static void ApplyMoves(std::vector<unsigned int>& buffer, const std::vector<RangeMove>& moves)
+{
+	for (const RangeMove& move : moves)
+		memmove(&buffer[move.To], &buffer[move.From], move.Size * sizeof(unsigned int));
+}
+
+// Whether every live allocation still holds its own id
+static bool CheckContents(const RangeAllocator& allocator, const std::vector<unsigned int>& buffer, const std::vector<unsigned int>& live)
+{
+	for (unsigned int id : live)
+	{
+		unsigned int offset = allocator.GetOffset(id);
+		for (unsigned int i = 0; i < allocator.GetSize(id); i++)
+		{
+			if (buffer[offset + i] != id)
+				return false;
+		}
+	}
+	return true;
+}
+
+
+void CheckRangeAllocator()
+{
+	printf("\n-- Range allocator (mesh pool bookkeeping) --\n");
+
+	// Freed neighbors should merge back into one block
+	{
+		RangeAllocator allocator(100);
+		unsigned int a = allocator.Allocate(10);
+		unsigned int b = allocator.Allocate(20);
+		unsigned int c = allocator.Allocate(30);
+		allocator.Free(b);
+		bool split = allocator.GetStats().FreeBlocks == 2;
+		allocator.Free(a);
+		allocator.Free(c);
+		RangeAllocatorStats s = allocator.GetStats();
+		bool pass = split && s.FreeBlocks == 1 && s.LargestFreeBlock == 100 && s.Fragmentation == 0.0f && allocator.Validate();
+		printf("%-24s %s\n", "Coalescing", pass ? "PASS" : "FAIL");
+	}
+
+	// Best fit should pick the exact hole over the big one at the end,
+	// and nothing should fit once the space is gone
+	{
+		RangeAllocator allocator(100);
+		unsigned int a = allocator.Allocate(10);
+		allocator.Allocate(10);
+		allocator.Free(a);
+		unsigned int fit = allocator.Allocate(10);
+		bool pass = allocator.GetOffset(fit) == 0 &&
+			allocator.Allocate(81) == RangeAllocator::Invalid &&
+			allocator.Allocate(0) == RangeAllocator::Invalid &&
+			allocator.Allocate(80) != RangeAllocator::Invalid &&
+			allocator.Allocate(1) == RangeAllocator::Invalid &&
+			allocator.Validate();
+		printf("%-24s %s\n", "Best fit / full", pass ? "PASS" : "FAIL");
+	}
+
+	// Random loads and unloads, mesh sized, with the same policy
+	// as MeshPool: compact when the free space is there but split
+	// up, grow when it isn't.  A CPU copy of the buffer follows
+	// the moves, to check no allocation's data gets lost.
+	{
+		std::mt19937 rng(5678);
+		std::uniform_int_distribution<unsigned int> sizes(1, 5000);
+
+		RangeAllocator allocator(65536);
+		std::vector<unsigned int> buffer(allocator.GetCapacity());
+		std::vector<unsigned int> live;
+		unsigned int compactions = 0, grows = 0;
+		float worstFragmentation = 0.0f;
+		bool valid = true, contents = true;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		const int operations = 20000;
+		for (int op = 0; op < operations; op++)
+		{
+			// Lean towards allocating until there's a decent amount live
+			if (!live.empty() && rng() % 100 < (live.size() > 64 ? 55u : 30u))
+			{
+				size_t pick = rng() % live.size();
+				allocator.Free(live[pick]);
+				live[pick] = live.back();
+				live.pop_back();
+			}
+			else
+			{
+				unsigned int size = sizes(rng);
+				unsigned int id = allocator.Allocate(size);
+				if (id == RangeAllocator::Invalid)
+				{
+					RangeAllocatorStats s = allocator.GetStats();
+					if (s.Capacity - s.Used >= size)
+						compactions++;
+					else
+					{
+						allocator.Grow(std::max(s.Capacity * 2, s.Used + size));
+						buffer.resize(allocator.GetCapacity());
+						grows++;
+					}
+					ApplyMoves(buffer, allocator.Compact());
+					id = allocator.Allocate(size);
+				}
+				std::fill(buffer.begin() + allocator.GetOffset(id), buffer.begin() + allocator.GetOffset(id) + size, id);
+				live.push_back(id);
+			}
+
+			worstFragmentation = std::max(worstFragmentation, allocator.GetStats().Fragmentation);
+			if (op % 64 == 0)
+			{
+				valid = valid && allocator.Validate();
+				contents = contents && CheckContents(allocator, buffer, live);
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// And one last defragment, like after a level unload
+		ApplyMoves(buffer, allocator.Compact());
+		RangeAllocatorStats s = allocator.GetStats();
+		bool packed = s.FreeBlocks <= 1 && s.Fragmentation == 0.0f;
+		valid = valid && allocator.Validate();
+		contents = contents && CheckContents(allocator, buffer, live);
+
+		printf("%-24s %d ops, %u live, %u / %u used, %u compactions, %u grows\n",
+			"Random churn", operations, s.Allocations, s.Used, s.Capacity, compactions, grows);
+		printf("%-24s worst fragmentation %.0f%%, %.2f us per op (with checks)\n",
+			"", worstFragmentation * 100.0f, seconds * 1e6 / operations);
+		printf("%-24s %s\n", "Free list consistent", valid ? "PASS" : "FAIL");
+		printf("%-24s %s\n", "Data survives moves", contents ? "PASS" : "FAIL");
+		printf("%-24s %s\n", "Defragment", packed ? "PASS" : "FAIL");
+	}
+}
+
+
+// How a hierarchy has to be done with plain Transforms: each
+// object is its own allocation with a pointer to its parent,
+// and its world matrix means walking up the chain
+struct TransformObject
+{
+	Transform transform;
+	TransformObject* parent;
+};
+
+static XMMATRIX GetChainedWorldMatrix(TransformObject* object)
+{
+	XMFLOAT4X4 local = object->transform.GetWorldMatrix();
+	XMMATRIX world = XMLoadFloat4x4(&local);
+	for (TransformObject* p = object->parent; p; p = p->parent)
+	{
+		XMFLOAT4X4 parentLocal = p->transform.GetWorldMatrix();
+		world = world * XMLoadFloat4x4(&parentLocal);
+	}
+	return world;
+}
+
+
+void BenchmarkSceneGraph()
+{
+	printf("\n-- Scene graph, 100k nodes (best of 10 frames) --\n");
+
+	// A forest of random trees: the first nodes are roots, and the
+	// rest hang off a random earlier node (about 12 levels deep)
+	const unsigned int nodeCount = 100000;
+	const unsigned int rootCount = 1000;
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<unsigned int> parentOf(nodeCount);
+	for (unsigned int i = 0; i < nodeCount; i++)
+		parentOf[i] = i < rootCount ? InvalidSceneNode : rng() % i;
+
+	SceneGraph scene;
+	std::vector<SceneNode> nodes(nodeCount);
+	std::vector<std::shared_ptr<TransformObject>> objects(nodeCount);
+	unsigned int maxDepth = 0;
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		XMFLOAT3 p(unit(rng) * 2.0f, unit(rng) * 2.0f, unit(rng) * 2.0f);
+		XMFLOAT3 r(unit(rng), unit(rng), unit(rng));
+		float s = 0.9f + unit(rng) * 0.1f;
+
+		nodes[i] = scene.CreateNode(parentOf[i] == InvalidSceneNode ? InvalidSceneNode : nodes[parentOf[i]]);
+		scene.SetPosition(nodes[i], p.x, p.y, p.z);
+		scene.SetRotation(nodes[i], r.x, r.y, r.z);
+		scene.SetScale(nodes[i], s, s, s);
+
+		objects[i] = std::make_shared<TransformObject>();
+		objects[i]->parent = parentOf[i] == InvalidSceneNode ? nullptr : objects[parentOf[i]].get();
+		objects[i]->transform.SetPosition(p.x, p.y, p.z);
+		objects[i]->transform.SetRotation(r.x, r.y, r.z);
+		objects[i]->transform.SetScale(s, s, s);
+
+		unsigned int depth = 0;
+		for (unsigned int a = parentOf[i]; a != InvalidSceneNode; a = parentOf[a])
+			depth++;
+		maxDepth = std::max(maxDepth, depth);
+	}
+	printf("%u roots, %u levels\n", rootCount, maxDepth + 1);
+	printf("%-22s %14s %14s %9s\n", "Moving", "Per-object ms", "Batched ms", "Speedup");
+
+	// Where the renderer would read the results from.  Both sides
+	// produce the inverse transpose too, since a chained world
+	// matrix needs its own for lighting.
+	std::vector<XMFLOAT4X4> perObjectWorlds(nodeCount), batchedWorlds(nodeCount);
+	std::vector<XMFLOAT4X4> perObjectInverses(nodeCount), batchedInverses(nodeCount);
+
+	const unsigned int movingCounts[] = { rootCount, rootCount / 100 };
+	const char* labels[] = { "every root (all)", "1% of roots" };
+	for (int test = 0; test < 2; test++)
+	{
+		unsigned int moving = movingCounts[test];
+
+		double perObjectTime = TimeBest(10, [&]()
+		{
+			for (unsigned int i = 0; i < moving; i++)
+				objects[i]->transform.MoveAbsolute(0.01f, 0, 0);
+			for (unsigned int i = 0; i < nodeCount; i++)
+			{
+				XMMATRIX world = GetChainedWorldMatrix(objects[i].get());
+				XMStoreFloat4x4(&perObjectWorlds[i], world);
+				XMStoreFloat4x4(&perObjectInverses[i], XMMatrixInverse(0, XMMatrixTranspose(world)));
+			}
+		});
+
+		double batchedTime = TimeBest(10, [&]()
+		{
+			for (unsigned int i = 0; i < moving; i++)
+				scene.MoveAbsolute(nodes[i], 0.01f, 0, 0);
+			scene.UpdateWorldMatrices();
+			for (unsigned int i = 0; i < nodeCount; i++)
+			{
+				batchedWorlds[i] = scene.GetWorldMatrix(nodes[i]);
+				batchedInverses[i] = scene.GetWorldInverseTransposeMatrix(nodes[i]);
+			}
+		});
+
+		printf("%-22s %14.2f %14.2f %8.1fx   (%u recomputed)\n",
+			labels[test], perObjectTime * 1000.0, batchedTime * 1000.0, perObjectTime / batchedTime, scene.GetLastUpdateCount());
+	}
+
+	// Both should have ended up in the same place
+	float maxError = 0.0f;
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		const float* a = &perObjectWorlds[i]._11;
+		const float* b = &batchedWorlds[i]._11;
+		for (int e = 0; e < 16; e++)
+			maxError = std::max(maxError, fabsf(a[e] - b[e]) / std::max(1.0f, fabsf(a[e])));
+	}
+
+	// And reparenting or destroying a subtree keeps the rest intact
+	bool structure = true;
+	{
+		SceneGraph small;
+		SceneNode a = small.CreateNode();
+		SceneNode b = small.CreateNode(a);
+		SceneNode c = small.CreateNode(b);
+		SceneNode d = small.CreateNode();
+		small.SetPosition(a, 1, 0, 0);
+		small.SetPosition(b, 0, 1, 0);
+		small.SetPosition(c, 0, 0, 1);
+		small.SetPosition(d, 5, 0, 0);
+		structure = structure && !small.SetParent(a, c); // Would be a cycle
+		structure = structure && small.SetParent(b, d);
+		small.UpdateWorldMatrices();
+		const XMFLOAT4X4& cw = small.GetWorldMatrix(c);
+		structure = structure && cw._41 == 5.0f && cw._42 == 1.0f && cw._43 == 1.0f;
+
+		small.DestroyNode(b);
+		structure = structure && !small.IsValid(b) && !small.IsValid(c) && small.IsValid(a) && small.IsValid(d);
+		structure = structure && small.GetNodeCount() == 2 && small.GetWorldMatrix(d)._41 == 5.0f;
+	}
+
+	printf("%-22s %.2e   %s\n", "Max difference", maxError, maxError < 1e-4f ? "PASS" : "FAIL");
+	printf("%-22s %s\n", "Reparent / destroy", structure ? "PASS" : "FAIL");
+}
+
+
+void BenchmarkTransformSystem()
+{
+	printf("\n-- Transform system (best of 10 frames, %u threads) --\n", GetWorkerCount());
+	printf("%-10s %-10s %13s %9s %9s %13s\n", "Objects", "Moving", "Transform ms", "SoA ms", "Speedup", "SoA + inv ms");
+
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	float maxError = 0.0f;
+
+	const unsigned int objectCounts[] = { 1000, 10000, 100000, 1000000 };
+	for (unsigned int count : objectCounts)
+	{
+		// Each Transform is its own allocation, like the ones
+		// entities used to hold
+		TransformSystem system;
+		std::vector<TransformHandle> handles(count);
+		std::vector<std::shared_ptr<Transform>> objects(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			// Angles well outside [-pi, pi], to exercise the wrapping
+			XMFLOAT3 p(unit(rng) * 50.0f, unit(rng) * 50.0f, unit(rng) * 50.0f);
+			XMFLOAT3 r(unit(rng) * 10.0f, unit(rng) * 10.0f, unit(rng) * 10.0f);
+			XMFLOAT3 s(1.0f + unit(rng) * 0.5f, 1.0f + unit(rng) * 0.5f, 1.0f + unit(rng) * 0.5f);
+
+			handles[i] = system.Create();
+			system.SetPosition(handles[i], p.x, p.y, p.z);
+			system.SetRotation(handles[i], r.x, r.y, r.z);
+			system.SetScale(handles[i], s.x, s.y, s.z);
+
+			objects[i] = std::make_shared<Transform>();
+			objects[i]->SetPosition(p.x, p.y, p.z);
+			objects[i]->SetRotation(r.x, r.y, r.z);
+			objects[i]->SetScale(s.x, s.y, s.z);
+		}
+
+		// Where the renderer would read the results from
+		std::vector<XMFLOAT4X4> perObjectWorlds(count), soaWorlds(count), soaInverses(count);
+
+		for (unsigned int moving : { count, count / 100 })
+		{
+			double perObjectTime = TimeBest(10, [&]()
+			{
+				for (unsigned int i = 0; i < moving; i++)
+					objects[i]->Rotate(0.01f, 0, 0);
+				for (unsigned int i = 0; i < count; i++)
+					perObjectWorlds[i] = objects[i]->GetWorldMatrix();
+			});
+
+			double soaTime = TimeBest(10, [&]()
+			{
+				for (unsigned int i = 0; i < moving; i++)
+					system.Rotate(handles[i], 0.01f, 0, 0);
+				system.UpdateWorldMatrices();
+				for (unsigned int i = 0; i < count; i++)
+					soaWorlds[i] = system.GetWorldMatrix(handles[i]);
+			});
+
+			// Transform always makes the inverse transpose as well,
+			// where the system only does it when asked
+			double soaInverseTime = TimeBest(10, [&]()
+			{
+				for (unsigned int i = 0; i < moving; i++)
+					system.Rotate(handles[i], 0.01f, 0, 0);
+				system.UpdateWorldMatrices();
+				for (unsigned int i = 0; i < count; i++)
+				{
+					soaWorlds[i] = system.GetWorldMatrix(handles[i]);
+					soaInverses[i] = system.GetWorldInverseTransposeMatrix(handles[i]);
+				}
+			});
+
+			// The system's been rotated more times, so catch the
+			// Transforms up before comparing
+			for (unsigned int i = 0; i < moving; i++)
+			{
+				XMFLOAT3 r = system.GetPitchYawRoll(handles[i]);
+				objects[i]->SetRotation(r.x, r.y, r.z);
+			}
+			for (unsigned int i = 0; i < count; i++)
+				perObjectWorlds[i] = objects[i]->GetWorldMatrix();
+
+			printf("%-10u %-10u %13.3f %9.3f %8.1fx %13.3f\n",
+				count, moving, perObjectTime * 1000.0, soaTime * 1000.0, perObjectTime / soaTime, soaInverseTime * 1000.0);
+		}
+
+		// Both should have ended up in the same place
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const float* a = &perObjectWorlds[i]._11;
+			const float* b = &soaWorlds[i]._11;
+			for (int e = 0; e < 16; e++)
+				maxError = std::max(maxError, fabsf(a[e] - b[e]) / std::max(1.0f, fabsf(a[e])));
+		}
+	}
+
+	// Destroying moves other transforms around, but their handles
+	// (and matrices) have to stay put
+	bool handlesOk = true;
+	{
+		TransformSystem system;
+		std::vector<TransformHandle> handles;
+		for (int i = 0; i < 20; i++)
+		{
+			handles.push_back(system.Create());
+			system.SetPosition(handles.back(), (float)i, 0, 0);
+		}
+		system.UpdateWorldMatrices();
+		for (int i = 0; i < 20; i += 3)
+			system.Destroy(handles[i]);
+
+		TransformHandle reused = system.Create();
+		system.SetPosition(reused, 100, 0, 0);
+		system.UpdateWorldMatrices();
+		handlesOk = system.GetCount() == 14 && system.GetLastUpdateCount() == 1 && system.GetWorldMatrix(reused)._41 == 100.0f;
+		for (int i = 0; i < 20; i++)
+		{
+			if (i % 3 != 0)
+				handlesOk = handlesOk && system.IsValid(handles[i]) && system.GetWorldMatrix(handles[i])._41 == (float)i;
+		}
+	}
+
+	printf("%-22s %.2e   %s\n", "Max difference", maxError, maxError < 1e-4f ? "PASS" : "FAIL");
+	printf("%-22s %s\n", "Destroy / reuse", handlesOk ? "PASS" : "FAIL");
+}
+
+
+// Largest difference between two matrices, relative to the
+// size of each element of the first
+static float MatrixError(const XMFLOAT4X4& expected, const XMFLOAT4X4& actual)
+{
+	float maxError = 0.0f;
+	const float* a = &expected._11;
+	const float* b = &actual._11;
+	for (int e = 0; e < 16; e++)
+		maxError = std::max(maxError, fabsf(a[e] - b[e]) / std::max(1.0f, fabsf(a[e])));
+	return maxError;
+}
+
+void CheckNormalMatrix()
+{
+	printf("\n-- Normal matrix (analytic inverse transpose) --\n");
+
+	std::mt19937 rng(1357);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// Uniform, non-uniform and mirrored scales, each against the
+	// general inverse of the same world matrix
+	const int count = 100000;
+	std::vector<XMFLOAT4X4> worlds(count);
+	std::vector<XMFLOAT3> scales(count);
+	float maxError[3] = {};
+	for (int i = 0; i < count; i++)
+	{
+		int kind = i % 3;
+		float s = 0.25f + (unit(rng) + 1.0f) * 2.0f;
+		XMFLOAT3 scale =
+			kind == 0 ? XMFLOAT3(s, s, s) :
+			kind == 1 ? XMFLOAT3(s, 0.25f + (unit(rng) + 1.0f) * 2.0f, 0.25f + (unit(rng) + 1.0f) * 2.0f) :
+			XMFLOAT3(-s, s, 0.5f * s);
+
+		Transform t;
+		t.SetPosition(unit(rng) * 50.0f, unit(rng) * 50.0f, unit(rng) * 50.0f);
+		t.SetRotation(unit(rng) * 4.0f, unit(rng) * 4.0f, unit(rng) * 4.0f);
+		t.SetScale(scale.x, scale.y, scale.z);
+
+		XMFLOAT4X4 general;
+		worlds[i] = t.GetWorldMatrix();
+		scales[i] = scale;
+		XMStoreFloat4x4(&general, XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(&worlds[i]))));
+		maxError[kind] = std::max(maxError[kind], MatrixError(general, t.GetWorldInverseTransposeMatrix()));
+	}
+
+	const char* labels[] = { "Uniform scale", "Non-uniform scale", "Mirrored scale" };
+	for (int kind = 0; kind < 3; kind++)
+		printf("%-22s %.2e   %s\n", labels[kind], maxError[kind], maxError[kind] < 1e-4f ? "PASS" : "FAIL");
+
+	// A scale of 1 is the world matrix itself, rotation and all
+	bool identityScale = true;
+	{
+		Transform t;
+		t.SetPosition(1, 2, 3);
+		t.SetRotation(0.3f, 0.7f, 1.1f);
+		XMFLOAT4X4 w = t.GetWorldMatrix();
+		XMFLOAT4X4 n = t.GetWorldInverseTransposeMatrix();
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+				identityScale = identityScale && w.m[r][c] == n.m[r][c];
+		}
+	}
+	printf("%-22s %s\n", "Unit scale", identityScale ? "PASS" : "FAIL");
+
+	// Through a hierarchy, where the scene graph multiplies the
+	// per-node results together
+	float sceneError = 0.0f;
+	{
+		SceneGraph scene;
+		SceneNode parent = InvalidSceneNode;
+		for (int i = 0; i < 8; i++)
+		{
+			SceneNode node = scene.CreateNode(parent);
+			scene.SetPosition(node, unit(rng) * 3.0f, unit(rng) * 3.0f, unit(rng) * 3.0f);
+			scene.SetRotation(node, unit(rng), unit(rng), unit(rng));
+			scene.SetScale(node, 1.0f + unit(rng) * 0.5f, 1.0f + unit(rng) * 0.5f, 1.0f + unit(rng) * 0.5f);
+			parent = node;
+		}
+		scene.UpdateWorldMatrices();
+
+		XMFLOAT4X4 general;
+		XMStoreFloat4x4(&general, XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(&scene.GetWorldMatrix(parent)))));
+		sceneError = MatrixError(general, scene.GetWorldInverseTransposeMatrix(parent));
+	}
+	printf("%-22s %.2e   %s\n", "Scene graph (8 deep)", sceneError, sceneError < 1e-4f ? "PASS" : "FAIL");
+
+	// And how long each takes
+	std::vector<XMFLOAT4X4> results(count);
+	double generalTime = TimeBest(10, [&]()
+	{
+		for (int i = 0; i < count; i++)
+			XMStoreFloat4x4(&results[i], XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(&worlds[i]))));
+	});
+	double analyticTime = TimeBest(10, [&]()
+	{
+		for (int i = 0; i < count; i++)
+			XMStoreFloat4x4(&results[i], InverseTransposeFromTRS(XMLoadFloat4x4(&worlds[i]), scales[i]));
+	});
+	printf("%-22s %.2f ns general, %.2f ns analytic, %.1fx\n", "Per matrix",
+		generalTime * 1e9 / count, analyticTime * 1e9 / count, generalTime / analyticTime);
+}
+
+
+void CheckTransformRotation()
+{
+	printf("\n-- Transform rotation (quaternion + cached axes) --\n");
+
+	std::mt19937 rng(8642);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// Pitch/yaw/roll still mean what they did: same axes, same
+	// matrices and the same relative movement as rotating by a
+	// freshly built quaternion each time
+	float eulerError = 0.0f;
+	float roundTripError = 0.0f;
+	float composeError = 0.0f;
+	for (int i = 0; i < 10000; i++)
+	{
+		XMFLOAT3 angles(unit(rng) * 3.0f, unit(rng) * 3.0f, unit(rng) * 3.0f);
+		XMVECTOR quat = XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z);
+
+		Transform t;
+		t.SetPosition(unit(rng), unit(rng), unit(rng));
+		t.SetRotation(angles.x * 0.5f, angles.y * 0.5f, angles.z * 0.5f);
+		t.Rotate(angles.x * 0.5f, angles.y * 0.5f, angles.z * 0.5f);
+
+		XMFLOAT3 start = t.GetPosition();
+		XMFLOAT3 expected, actual;
+		XMStoreFloat3(&expected, XMLoadFloat3(&start) + XMVector3Rotate(XMVectorSet(1, 2, 3, 0), quat));
+		t.MoveRelative(1, 2, 3);
+		actual = t.GetPosition();
+		eulerError = std::max(eulerError, XMVectorGetX(XMVector3Length(XMLoadFloat3(&expected) - XMLoadFloat3(&actual))));
+
+		XMFLOAT3 axes[3] = { t.GetRight(), t.GetUp(), t.GetForward() };
+		XMVECTOR unitAxes[3] = { XMVectorSet(1, 0, 0, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 0, 1, 0) };
+		for (int a = 0; a < 3; a++)
+		{
+			XMVECTOR rotated = XMVector3Rotate(unitAxes[a], quat);
+			eulerError = std::max(eulerError, XMVectorGetX(XMVector3Length(rotated - XMLoadFloat3(&axes[a]))));
+		}
+
+		XMFLOAT4X4 expectedWorld;
+		XMStoreFloat4x4(&expectedWorld, XMMatrixRotationRollPitchYaw(angles.x, angles.y, angles.z) * XMMatrixTranslation(actual.x, actual.y, actual.z));
+		eulerError = std::max(eulerError, MatrixError(expectedWorld, t.GetWorldMatrix()));
+
+		// Setting a quaternion and reading the angles back gives
+		// angles for the same rotation
+		XMFLOAT4 q;
+		XMStoreFloat4(&q, quat);
+		Transform fromQuat;
+		fromQuat.SetRotation(q);
+		XMFLOAT3 back = fromQuat.GetPitchYawRoll();
+		Transform fromAngles;
+		fromAngles.SetRotation(back.x, back.y, back.z);
+		roundTripError = std::max(roundTripError, MatrixError(fromQuat.GetWorldMatrix(), fromAngles.GetWorldMatrix()));
+
+		// And rotating by a quaternion comes after the current rotation
+		XMFLOAT4 extra;
+		XMStoreFloat4(&extra, XMQuaternionRotationRollPitchYaw(unit(rng), unit(rng), unit(rng)));
+		fromQuat.Rotate(extra);
+		XMFLOAT4X4 composed;
+		XMStoreFloat4x4(&composed, XMMatrixRotationQuaternion(quat) * XMMatrixRotationQuaternion(XMLoadFloat4(&extra)));
+		composeError = std::max(composeError, MatrixError(composed, fromQuat.GetWorldMatrix()));
+	}
+
+	printf("%-22s %.2e   %s\n", "Euler compatibility", eulerError, eulerError < 1e-4f ? "PASS" : "FAIL");
+	printf("%-22s %.2e   %s\n", "Quaternion round trip", roundTripError, roundTripError < 1e-4f ? "PASS" : "FAIL");
+	printf("%-22s %.2e   %s\n", "Quaternion rotate", composeError, composeError < 1e-4f ? "PASS" : "FAIL");
+
+	// A camera's frame: maybe look around a little, strafe and
+	// walk, then find the look direction for the view matrix.
+	// Each frame's position is kept so the work can't be skipped.
+	const int frames = 100000;
+	std::vector<XMFLOAT3> path(frames);
+	for (bool turning : { true, false })
+	{
+		float turn = turning ? 0.0001f : 0.0f;
+		double rebuildTime = TimeBest(5, [&]()
+		{
+			XMFLOAT3 pyr(0.1f, 0.2f, 0), pos(0, 0, 0);
+			for (int f = 0; f < frames; f++)
+			{
+				pyr.x += turn;
+				pyr.y += turn * 2.0f;
+				XMVECTOR q = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pyr));
+				XMVECTOR p = XMLoadFloat3(&pos) + XMVector3Rotate(XMVectorSet(0, 0, 0.01f, 0), q);
+				q = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pyr));
+				p = p + XMVector3Rotate(XMVectorSet(0.01f, 0, 0, 0), q);
+				XMStoreFloat3(&pos, p);
+				q = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pyr));
+				XMFLOAT3 dir;
+				XMStoreFloat3(&dir, XMVector3Rotate(XMVectorSet(0, 0, 1, 0), q));
+				pos.y += dir.y * 1e-6f;
+				path[f] = pos;
+			}
+		});
+
+		double cachedTime = TimeBest(5, [&]()
+		{
+			Transform camera;
+			camera.SetRotation(0.1f, 0.2f, 0);
+			for (int f = 0; f < frames; f++)
+			{
+				if (turning)
+					camera.Rotate(turn, turn * 2.0f, 0);
+				camera.MoveRelative(0, 0, 0.01f);
+				camera.MoveRelative(0.01f, 0, 0);
+				XMFLOAT3 dir = camera.GetForward();
+				camera.MoveAbsolute(0, dir.y * 1e-6f, 0);
+				path[f] = camera.GetPosition();
+			}
+		});
+		printf("%-22s %.1f ns rebuilding, %.1f ns cached (per frame)\n", turning ? "Camera, turning" : "Camera, walking",
+			rebuildTime * 1e9 / frames, cachedTime * 1e9 / frames);
+	}
+}
+
+
+// Where the interpolated matrix puts the object
+static XMFLOAT3 InterpolatedPosition(const XMFLOAT4X4& m)
+{
+	return XMFLOAT3(m._41, m._42, m._43);
+}
+
+static float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMVectorGetX(XMVector3Length(XMLoadFloat3(&a) - XMLoadFloat3(&b)));
+}
+
+// How far a blended normal matrix turns normals from where the
+// general inverse transpose of the blended world matrix does
+static float NormalError(const XMFLOAT4X4& world, const XMFLOAT4X4& normalMatrix)
+{
+	XMMATRIX expected = XMMatrixTranspose(XMMatrixInverse(0, XMLoadFloat4x4(&world)));
+	XMMATRIX actual = XMLoadFloat4x4(&normalMatrix);
+	float maxError = 0.0f;
+	XMVECTOR normals[] = { XMVectorSet(1, 0, 0, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(1, 1, 1, 0) };
+	for (XMVECTOR n : normals)
+	{
+		// Same multiply as the vertex shader's
+		XMVECTOR a = XMVector3Normalize(XMVector3TransformNormal(n, XMMatrixTranspose(expected)));
+		XMVECTOR b = XMVector3Normalize(XMVector3TransformNormal(n, XMMatrixTranspose(actual)));
+		maxError = std::max(maxError, XMVectorGetX(XMVector3Length(a - b)));
+	}
+	return maxError;
+}
+
+void CheckInterpolation()
+{
+	printf("\n-- Render interpolation --\n");
+
+	// Both kinds of storage go through the same steps: a new
+	// object, a step where it moves, and a step where it stops
+	TransformSystem system;
+	SceneGraph graph;
+	float slideError = 0.0f;
+	float blendError = 0.0f;
+	float restError = 0.0f;
+	for (int i = 0; i < 100; i++)
+	{
+		TransformHandle handle = system.Create();
+		SceneNode node = graph.CreateNode();
+		float x = (float)i;
+		system.SetPosition(handle, x, 1, 0);
+		graph.SetPosition(node, x, 1, 0);
+		system.UpdateWorldMatrices();
+		graph.UpdateWorldMatrices();
+
+		// Just made, so every alpha is where it was put
+		XMFLOAT3 start(x, 1, 0);
+		slideError = std::max(slideError, Distance(start, InterpolatedPosition(system.GetInterpolatedWorldMatrix(handle, 0.0f))));
+		slideError = std::max(slideError, Distance(start, InterpolatedPosition(graph.GetInterpolatedWorldMatrix(node, 0.0f))));
+
+		// Moved by 2 along z, so a quarter of the way is 0.5
+		system.MoveAbsolute(handle, 0, 0, 2);
+		graph.MoveAbsolute(node, 0, 0, 2);
+		system.UpdateWorldMatrices();
+		graph.UpdateWorldMatrices();
+		XMFLOAT3 quarter(x, 1, 0.5f);
+		blendError = std::max(blendError, Distance(quarter, InterpolatedPosition(system.GetInterpolatedWorldMatrix(handle, 0.25f))));
+		blendError = std::max(blendError, Distance(quarter, InterpolatedPosition(graph.GetInterpolatedWorldMatrix(node, 0.25f))));
+
+		// Left alone for a step, so it's at the end, whatever the alpha
+		system.UpdateWorldMatrices();
+		graph.UpdateWorldMatrices();
+		XMFLOAT3 end(x, 1, 2);
+		restError = std::max(restError, Distance(end, InterpolatedPosition(system.GetInterpolatedWorldMatrix(handle, 0.0f))));
+		restError = std::max(restError, Distance(end, InterpolatedPosition(graph.GetInterpolatedWorldMatrix(node, 0.0f))));
+	}
+
+	printf("%-22s %.2e   %s\n", "New objects", slideError, slideError < 1e-5f ? "PASS" : "FAIL");
+	printf("%-22s %.2e   %s\n", "Moving objects", blendError, blendError < 1e-5f ? "PASS" : "FAIL");
+	printf("%-22s %.2e   %s\n", "Stopped objects", restError, restError < 1e-5f ? "PASS" : "FAIL");
+
+	// Squashed objects turning and growing over a step, whose
+	// normals have to follow the blended world matrix rather
+	// than jump to the last step's.  A blended rotation isn't
+	// quite a rotation, so neither way of blending the normal
+	// matrix is exact, but both should be far closer than the
+	// last step's matrix.
+	float normalError = 0.0f;
+	float staleError = 0.0f;
+	for (int i = 0; i < 100; i++)
+	{
+		TransformHandle handle = system.Create();
+		SceneNode node = graph.CreateNode();
+		float turn = i * 0.06f;
+		system.SetScale(handle, 1, 3, 0.5f);
+		graph.SetScale(node, 1, 3, 0.5f);
+		system.SetRotation(handle, turn, turn * 2.0f, 0);
+		graph.SetRotation(node, turn, turn * 2.0f, 0);
+		system.UpdateWorldMatrices();
+		graph.UpdateWorldMatrices();
+
+		system.Rotate(handle, 0.02f, 0.05f, 0);
+		graph.Rotate(node, 0.02f, 0.05f, 0);
+		system.SetScale(handle, 1.2f, 3, 0.4f);
+		graph.SetScale(node, 1.2f, 3, 0.4f);
+		system.UpdateWorldMatrices();
+		graph.UpdateWorldMatrices();
+		for (float alpha : { 0.25f, 0.5f, 0.75f })
+		{
+			normalError = std::max(normalError, NormalError(
+				system.GetInterpolatedWorldMatrix(handle, alpha),
+				system.GetInterpolatedWorldInverseTransposeMatrix(handle, alpha)));
+			normalError = std::max(normalError, NormalError(
+				graph.GetInterpolatedWorldMatrix(node, alpha),
+				graph.GetInterpolatedWorldInverseTransposeMatrix(node, alpha)));
+			staleError = std::max(staleError, NormalError(
+				system.GetInterpolatedWorldMatrix(handle, alpha),
+				system.GetWorldInverseTransposeMatrix(handle)));
+		}
+	}
+	printf("%-22s %.2e   (%.2e unblended)   %s\n", "Moving normals", normalError, staleError,
+		normalError < 0.02f && normalError < staleError * 0.1f ? "PASS" : "FAIL");
+}
+
+
+// True if the point is inside all six planes
+static bool PointInFrustum(const Frustum& frustum, const XMFLOAT3& point)
+{
+	return SphereInFrustum(frustum, point, 0.0f);
+}
+
+void BenchmarkFrustumCulling()
+{
+	printf("\n-- Frustum culling (best of 10 frames) --\n");
+
+	// A 60 degree camera at the origin looking down +Z, with
+	// objects scattered all around it
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 16.0f / 9.0f, 0.1f, 100.0f));
+	Frustum frustum = CreateFrustum(view, projection);
+
+	printf("%-10s %-9s %12s %12s %9s %14s\n", "Objects", "Visible", "Sphere ms", "SIMD ms", "Speedup", "Bounds / ms");
+	bool conservative = true;
+	unsigned int sizes[] = { 1000, 10000, 100000, 1000000 };
+	for (unsigned int count : sizes)
+	{
+		std::mt19937 rng(1234 + count);
+		std::uniform_real_distribution<float> place(-120.0f, 120.0f);
+		std::uniform_real_distribution<float> size(0.1f, 3.0f);
+		std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+
+		std::vector<MeshBounds> bounds(count);
+		std::vector<XMFLOAT4X4> worlds(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			MeshBounds& b = bounds[i];
+			b.Min = XMFLOAT3(-size(rng), -size(rng), -size(rng));
+			b.Max = XMFLOAT3(size(rng), size(rng), size(rng));
+			b.Center = XMFLOAT3((b.Min.x + b.Max.x) * 0.5f, (b.Min.y + b.Max.y) * 0.5f, (b.Min.z + b.Max.z) * 0.5f);
+			XMFLOAT3 extent = GetBoundsExtent(b);
+			b.Radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&extent))) * 0.5f;
+
+			float s = size(rng);
+			XMStoreFloat4x4(&worlds[i],
+				XMMatrixScaling(s, s * 0.5f, s) *
+				XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+				XMMatrixTranslation(place(rng), place(rng), place(rng)));
+		}
+
+		// What the renderer could do before: each object's sphere,
+		// one at a time
+		std::vector<unsigned int> sphereVisible;
+		double sphereTime = TimeBest(10, [&]()
+		{
+			sphereVisible.clear();
+			for (unsigned int i = 0; i < count; i++)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+				XMFLOAT3 center;
+				XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&bounds[i].Center), world));
+				float scale = std::max(XMVectorGetX(XMVector3Length(world.r[0])),
+					std::max(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+				if (SphereInFrustum(frustum, center, bounds[i].Radius * scale))
+					sphereVisible.push_back(i);
+			}
+		});
+
+		// The culler, filled the same way the renderer fills it
+		FrustumCuller culler;
+		std::vector<unsigned int> visible;
+		double simdTime = TimeBest(10, [&]()
+		{
+			culler.Clear();
+			for (unsigned int i = 0; i < count; i++)
+				culler.AddBounds(bounds[i], worlds[i]);
+			culler.Cull(frustum, visible);
+		});
+		double cullTime = TimeBest(10, [&]() { culler.Cull(frustum, visible); });
+
+		// Anything with a corner on screen must survive
+		std::vector<unsigned char> kept(count, 0);
+		for (unsigned int i : visible)
+			kept[i] = 1;
+		for (unsigned int i = 0; i < count && conservative; i++)
+		{
+			if (kept[i])
+				continue;
+
+			XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+			for (int c = 0; c < 8; c++)
+			{
+				XMFLOAT3 corner(
+					(c & 1) ? bounds[i].Max.x : bounds[i].Min.x,
+					(c & 2) ? bounds[i].Max.y : bounds[i].Min.y,
+					(c & 4) ? bounds[i].Max.z : bounds[i].Min.z);
+				XMStoreFloat3(&corner, XMVector3TransformCoord(XMLoadFloat3(&corner), world));
+				if (PointInFrustum(frustum, corner))
+					conservative = false;
+			}
+		}
+
+		// And the box only ever takes away from what the sphere keeps
+		conservative = conservative && visible.size() <= sphereVisible.size();
+
+		char visibleText[32];
+		snprintf(visibleText, sizeof(visibleText), "%u", (unsigned int)visible.size());
+		printf("%-10u %-9s %12.3f %12.3f %8.1fx %14.0f\n", count, visibleText,
+			sphereTime * 1000.0, simdTime * 1000.0, sphereTime / simdTime, count / (cullTime * 1000.0));
+	}
+
+	printf("(SIMD ms includes filling the culler; bounds / ms is culling alone)\n");
+	printf("Nothing visible culled %s\n", conservative ? "PASS" : "FAIL");
+}
+
+
+// Bounds of a box with the given center and half size
+static MeshBounds BoxBounds(const XMFLOAT3& center, const XMFLOAT3& halfExtent)
+{
+	MeshBounds b;
+	b.Min = XMFLOAT3(center.x - halfExtent.x, center.y - halfExtent.y, center.z - halfExtent.z);
+	b.Max = XMFLOAT3(center.x + halfExtent.x, center.y + halfExtent.y, center.z + halfExtent.z);
+	b.Center = center;
+	b.Radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&halfExtent)));
+	return b;
+}
+
+void CheckOcclusionCulling()
+{
+	printf("\n-- Occlusion culling --\n");
+
+	// Camera at the origin looking down +Z, as in the frustum test
+	XMFLOAT4X4 view, projection, identity;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 16.0f / 9.0f, 0.1f, 100.0f));
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	// Two walls side by side at z = 10, together covering
+	// -4 <= x <= 4 and -4 <= y <= 4, so anything behind the
+	// seam needs both of them
+	OcclusionCuller culler(320, 180);
+	culler.BeginFrame(view, projection);
+	culler.AddOccluder(CreateBoxOccluder(BoxBounds(XMFLOAT3(-2, 0, 10), XMFLOAT3(2, 4, 0.5f))), identity);
+	culler.AddOccluder(CreateBoxOccluder(BoxBounds(XMFLOAT3(2, 0, 10), XMFLOAT3(2, 4, 0.5f))), identity);
+	culler.RasterizeOccluders();
+
+	struct Layout
+	{
+		const char* Name;
+		XMFLOAT3 Center;
+		XMFLOAT3 HalfExtent;
+		bool Visible;
+	};
+	const Layout layouts[] =
+	{
+		{ "Behind the walls", XMFLOAT3(-3, 2, 20), XMFLOAT3(1, 1, 1), false },
+		{ "Behind the seam", XMFLOAT3(0, 0, 30), XMFLOAT3(1, 1, 1), false },
+		{ "In front", XMFLOAT3(0, 0, 5), XMFLOAT3(1, 1, 1), true },
+		{ "Peeking out", XMFLOAT3(8, 0, 20), XMFLOAT3(1, 1, 1), true },
+		{ "Off to the side", XMFLOAT3(14, 0, 20), XMFLOAT3(1, 1, 1), true },
+		{ "Through the wall", XMFLOAT3(0, 0, 10), XMFLOAT3(1, 1, 1), true },
+		{ "The wall itself", XMFLOAT3(-2, 0, 10), XMFLOAT3(2, 4, 0.5f), true },
+		{ "Around the camera", XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), true },
+	};
+	bool layoutsPass = true;
+	for (const Layout& l : layouts)
+	{
+		bool visible = culler.IsVisible(l.Center, l.HalfExtent);
+		bool pass = visible == l.Visible;
+		layoutsPass = layoutsPass && pass;
+		printf("%-22s %-9s %s\n", l.Name, visible ? "visible" : "hidden", pass ? "PASS" : "FAIL");
+	}
+
+	// A city block: a grid of buildings (box occluders) with lots
+	// of smaller objects scattered between and behind them,
+	// frustum culled first like the renderer does
+	std::mt19937 rng(777);
+	std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> depthRange(5.0f, 95.0f);
+	std::uniform_real_distribution<float> size(0.2f, 1.5f);
+	std::vector<MeshBounds> buildings;
+	for (int gx = -4; gx <= 4; gx++)
+	{
+		for (int gz = 1; gz <= 9; gz++)
+			buildings.push_back(BoxBounds(XMFLOAT3(gx * 10.0f, 0, gz * 10.0f), XMFLOAT3(4, 8, 4)));
+	}
+
+	const unsigned int objectCount = 20000;
+	MeshBounds unitBox = BoxBounds(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+	std::vector<XMFLOAT4X4> worlds(objectCount);
+	for (auto& w : worlds)
+	{
+		float s = size(rng);
+		XMStoreFloat4x4(&w, XMMatrixScaling(s, s, s) * XMMatrixTranslation(spread(rng), spread(rng) * 0.1f, depthRange(rng)));
+	}
+
+	Frustum frustum = CreateFrustum(view, projection);
+	FrustumCuller bounds;
+	for (auto& w : worlds)
+		bounds.AddBounds(unitBox, w);
+	std::vector<unsigned int> inFrustum;
+	bounds.Cull(frustum, inFrustum);
+
+	std::vector<unsigned int> visible;
+	OcclusionStats best = {};
+	best.RasterMs = best.TestMs = 1e9;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		culler.BeginFrame(view, projection);
+		for (const MeshBounds& b : buildings)
+			culler.AddOccluder(CreateBoxOccluder(b), identity);
+		culler.RasterizeOccluders();
+
+		visible = inFrustum;
+		culler.Cull(bounds, visible);
+
+		const OcclusionStats& stats = culler.GetStats();
+		best.Occluders = stats.Occluders;
+		best.Triangles = stats.Triangles;
+		best.Tested = stats.Tested;
+		best.Occluded = stats.Occluded;
+		best.RasterMs = std::min(best.RasterMs, stats.RasterMs);
+		best.TestMs = std::min(best.TestMs, stats.TestMs);
+	}
+
+	// Spot check the hidden ones against the depth buffer: each
+	// should have its box center behind the occluder there
+	std::vector<unsigned char> kept(objectCount, 0);
+	for (unsigned int i : visible)
+		kept[i] = 1;
+	bool hiddenPass = true;
+	XMMATRIX viewProjection = XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection);
+	for (unsigned int i : inFrustum)
+	{
+		if (kept[i])
+			continue;
+
+		XMFLOAT3 center, halfExtent;
+		bounds.GetBox(i, center, halfExtent);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&center), viewProjection));
+		int x = (int)((clip.x / clip.w * 0.5f + 0.5f) * culler.GetWidth());
+		int y = (int)((0.5f - clip.y / clip.w * 0.5f) * culler.GetHeight());
+		if (x >= 0 && y >= 0 && x < (int)culler.GetWidth() && y < (int)culler.GetHeight())
+			hiddenPass = hiddenPass && culler.GetDepth(x, y) < clip.z / clip.w;
+	}
+
+	printf("City: %u occluders (%u triangles), %u of %u objects in the frustum hidden\n",
+		best.Occluders, best.Triangles, best.Occluded, best.Tested);
+	printf("Per frame (best of 10, %u threads): %.3f ms rasterizing, %.3f ms testing\n",
+		GetWorkerCount(), best.RasterMs, best.TestMs);
+	printf("Hidden behind occluders  %s\n", hiddenPass ? "PASS" : "FAIL");
+	printf("Layouts                  %s\n", layoutsPass ? "PASS" : "FAIL");
+}
+
+
+void CheckRenderQueue()
+{
+	printf("\n-- Render queue --\n");
+
+	// A scene made in no particular order: a few shaders, more
+	// materials and meshes, and some refractive things
+	std::mt19937 rng(2024);
+	std::uniform_int_distribution<unsigned int> pixelShader(0, 3);
+	std::uniform_int_distribution<unsigned int> vertexShader(0, 1);
+	std::uniform_int_distribution<unsigned int> material(0, 39);
+	std::uniform_int_distribution<unsigned int> buffers(0, 2);
+	std::uniform_int_distribution<unsigned int> mesh(0, 29);
+	std::uniform_real_distribution<float> depth(0.5f, 200.0f);
+	std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+	const unsigned int drawCount = 5000;
+	std::vector<RenderKey> keys(drawCount);
+	RenderQueue queue;
+	for (unsigned int i = 0; i < drawCount; i++)
+	{
+		RenderKey& k = keys[i];
+		k.Pass = chance(rng) < 0.1f ? RenderPass::Refractive : RenderPass::Opaque;
+		k.PixelShader = pixelShader(rng);
+		k.VertexShader = vertexShader(rng);
+		k.Material = material(rng);
+		k.Buffers = buffers(rng);
+		k.Mesh = mesh(rng);
+		k.Depth = depth(rng);
+		queue.Add(EncodeRenderKey(k), i);
+	}
+	std::vector<RenderPacket> unsorted = queue.GetPackets();
+
+	double radixTime = TimeBest(10, [&]()
+	{
+		queue.Clear();
+		for (const RenderPacket& p : unsorted)
+			queue.Add(p.Key, p.Item);
+		queue.Sort();
+	});
+
+	std::vector<RenderPacket> expected;
+	double stdTime = TimeBest(10, [&]()
+	{
+		expected = unsorted;
+		std::stable_sort(expected.begin(), expected.end(),
+			[](const RenderPacket& a, const RenderPacket& b) { return a.Key < b.Key; });
+	});
+
+	const std::vector<RenderPacket>& sorted = queue.GetPackets();
+	bool sameOrder = sorted.size() == expected.size();
+	for (size_t i = 0; sameOrder && i < sorted.size(); i++)
+		sameOrder = sorted[i].Item == expected[i].Item;
+
+	// Opaque draws come first, nearest first within the same state;
+	// refractive ones are farthest first, whatever their state
+	bool passOrder = true;
+	for (size_t i = 1; i < sorted.size(); i++)
+	{
+		const RenderKey& a = keys[sorted[i - 1].Item];
+		const RenderKey& b = keys[sorted[i].Item];
+		if (a.Pass != b.Pass)
+		{
+			passOrder = passOrder && a.Pass == RenderPass::Opaque;
+			continue;
+		}
+
+		bool sameState = a.PixelShader == b.PixelShader && a.VertexShader == b.VertexShader &&
+			a.Material == b.Material && a.Buffers == b.Buffers && a.Mesh == b.Mesh;
+		if (a.Pass == RenderPass::Opaque && sameState)
+			passOrder = passOrder && a.Depth <= b.Depth * 1.01f;
+		if (a.Pass == RenderPass::Refractive)
+			passOrder = passOrder && a.Depth * 1.01f >= b.Depth;
+	}
+
+	const RenderStateChanges& before = queue.GetUnsortedChanges();
+	const RenderStateChanges& after = queue.GetSortedChanges();
+	printf("%u draws          Unsorted     Sorted\n", drawCount);
+	printf("Shader changes     %8u   %8u\n", before.Shaders, after.Shaders);
+	printf("Material changes   %8u   %8u\n", before.Materials, after.Materials);
+	printf("Buffer changes     %8u   %8u\n", before.Buffers, after.Buffers);
+	printf("Sort: %.3f ms radix (with filling), %.3f ms std::stable_sort\n", radixTime * 1000.0, stdTime * 1000.0);
+	printf("Same order as std::stable_sort   %s\n", sameOrder ? "PASS" : "FAIL");
+	printf("Pass and depth order             %s\n", passOrder ? "PASS" : "FAIL");
+
+	// Sort ids over many frames: the same 40 materials every
+	// frame, and a buffer that's made again every frame (like a
+	// mesh pool that keeps growing), which must not use up ids.
+	// An old buffer's id comes back the frame after it's last
+	// used, so the new one alternates between two.
+	SortIdTable materialIds, bufferIds;
+	std::vector<unsigned int> firstIds(40);
+	bool idsKept = true;
+	unsigned int highestBuffer = 0;
+	for (unsigned int f = 0; f < 5000; f++)
+	{
+		for (unsigned int m = 0; m < 40; m++)
+		{
+			unsigned int id = materialIds.Get(&firstIds[m]);
+			if (f == 0)
+				firstIds[m] = id;
+			idsKept = idsKept && id == firstIds[m] && id < 40;
+		}
+		highestBuffer = std::max(highestBuffer, bufferIds.Get((const void*)(uintptr_t)(0x1000 + f * 64)));
+		materialIds.EndFrame();
+		bufferIds.EndFrame();
+	}
+	printf("Sort ids kept and dense          %s\n", idsKept && highestBuffer <= 1 ? "PASS" : "FAIL");
+}
+
+
+void CheckInstancing()
+{
+	printf("\n-- Instancing --\n");
+
+	// A sorted-looking scene: runs of a few groups, with some draws
+	// that can't be instanced mixed in.  Each draw's matrices are
+	// made from its item, so they can be checked after packing.
+	std::mt19937 rng(77);
+	std::uniform_int_distribution<unsigned int> group(0, 49);
+	std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+	auto matrices = [](unsigned int item, DirectX::XMFLOAT4X4& world, DirectX::XMFLOAT4X4& worldIT)
+	{
+		DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixTranslation((float)item, 1, 2));
+		DirectX::XMStoreFloat4x4(&worldIT, DirectX::XMMatrixScaling(1, (float)item, 1));
+	};
+
+	const unsigned int drawCount = 10000;
+	std::vector<uint64_t> groups(drawCount);
+	std::vector<bool> single(drawCount);
+	for (unsigned int i = 0; i < drawCount; i++)
+	{
+		groups[i] = group(rng);
+		single[i] = chance(rng) < 0.05f;
+	}
+
+	InstanceBatcher batcher;
+	auto fill = [&]()
+	{
+		batcher.Clear();
+		for (unsigned int i = 0; i < drawCount; i++)
+		{
+			if (single[i])
+			{
+				batcher.AddSingle(i);
+				continue;
+			}
+			DirectX::XMFLOAT4X4 world, worldIT;
+			matrices(i, world, worldIT);
+			batcher.Add(groups[i], i, world, worldIT);
+		}
+		batcher.Build();
+	};
+	double time = TimeBest(10, fill);
+
+	// Every draw is in exactly one batch, in the order they were
+	// added within it, and batches sit where their first draw was
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	const std::vector<unsigned int>& items = batcher.GetItems();
+	const std::vector<InstanceData>& instances = batcher.GetInstances();
+	std::vector<unsigned int> seen(drawCount, 0);
+	bool grouped = true;
+	bool packed = true;
+	unsigned int lastFirst = 0;
+	unsigned int instanceTotal = 0;
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		const InstanceBatch& batch = batches[b];
+		unsigned int first = items[batch.FirstItem];
+		grouped = grouped && (b == 0 || first > lastFirst);
+		lastFirst = first;
+		if (batch.Count > 1)
+			instanceTotal += batch.Count;
+
+		for (unsigned int k = 0; k < batch.Count; k++)
+		{
+			unsigned int item = items[batch.FirstItem + k];
+			seen[item]++;
+			if (single[item])
+				grouped = grouped && batch.Count == 1;
+			else
+				grouped = grouped && groups[item] == groups[first] && !single[first];
+			if (k > 0)
+				grouped = grouped && item > items[batch.FirstItem + k - 1];
+
+			if (batch.Count > 1)
+			{
+				DirectX::XMFLOAT4X4 world, worldIT;
+				matrices(item, world, worldIT);
+				const InstanceData& data = instances[batch.FirstInstance + k];
+				packed = packed &&
+					memcmp(&data.World, &world, sizeof(world)) == 0 &&
+					memcmp(&data.WorldInverseTranspose, &worldIT, sizeof(worldIT)) == 0;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < drawCount; i++)
+		grouped = grouped && seen[i] == 1;
+	packed = packed && instanceTotal == instances.size();
+
+	const InstancingStats& stats = batcher.GetStats();
+	printf("%u draws -> %u (%u instanced, %u saved), %u KB of instance data\n",
+		stats.Items, stats.Draws, stats.InstancedDraws, stats.Items - stats.Draws, stats.InstanceBytes / 1024);
+	printf("Batching: %.3f ms (with filling)\n", time * 1000.0);
+	printf("Every draw in its group, in order   %s\n", grouped ? "PASS" : "FAIL");
+	printf("Instance data packed per batch      %s\n", packed ? "PASS" : "FAIL");
+}
+
+
+void CheckLightGrid()
+{
+	printf("\n-- Light grid (16x9 tiles, 24 slices) --\n");
+
+	// The game's camera, looking at the middle of the scene
+	const float nearZ = 0.01f;
+	const float farZ = 100.0f;
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 0, -10, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, nearZ, farZ));
+
+	// A directional light and random point lights spread around
+	// the scene like Game::GenerateLights(), with smaller ranges
+	std::mt19937 rng(21);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto makeLights = [&](unsigned int count, float minRange, float maxRange)
+	{
+		std::vector<Light> lights(count);
+		lights[0].Type = LIGHT_TYPE_DIRECTIONAL;
+		lights[0].Direction = XMFLOAT3(0, 0, 1);
+		for (unsigned int i = 1; i < count; i++)
+		{
+			lights[i].Type = LIGHT_TYPE_POINT;
+			lights[i].Position = XMFLOAT3(unit(rng) * 40 - 20, unit(rng) * 10 - 5, unit(rng) * 60 - 20);
+			lights[i].Range = minRange + unit(rng) * (maxRange - minRange);
+		}
+		return lights;
+	};
+
+	LightGrid grid;
+	grid.SetProjection(projection);
+
+	// Random points in view, a fifth of them snapped onto tile and
+	// slice edges, must find every light that reaches them in
+	// their own cluster's list
+	std::vector<Light> lights = makeLights(1000, 0.5f, 4.0f);
+	grid.Build(view, lights);
+	const std::vector<LightCluster>& clusters = grid.GetClusters();
+	const std::vector<unsigned int>& indices = grid.GetLightIndices();
+
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	std::vector<XMFLOAT3> centers(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+		XMStoreFloat3(&centers[i], XMVector3TransformCoord(XMLoadFloat3(&lights[i].Position), viewMatrix));
+
+	bool complete = true;
+	unsigned int pointLights = 0;
+	for (int p = 0; p < 20000; p++)
+	{
+		float sx = unit(rng);
+		float sy = unit(rng);
+		float depth = nearZ * powf(farZ / nearZ, unit(rng));
+		if (p % 5 == 0)
+		{
+			sx = floorf(sx * grid.GetTilesX()) / grid.GetTilesX();
+			sy = floorf(sy * grid.GetTilesY()) / grid.GetTilesY();
+			depth = nearZ * powf(farZ / nearZ, floorf(unit(rng) * grid.GetSlices()) / grid.GetSlices());
+		}
+		XMFLOAT3 point((sx * 2 - 1) * depth / projection._11, (1 - sy * 2) * depth / projection._22, depth);
+
+		const LightCluster& cluster = clusters[grid.GetClusterIndex(sx, sy, depth)];
+		const unsigned int* begin = indices.data() + cluster.Offset;
+		const unsigned int* end = begin + cluster.Count;
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			float dx = point.x - centers[i].x, dy = point.y - centers[i].y, dz = point.z - centers[i].z;
+			bool reaches = lights[i].Type == LIGHT_TYPE_DIRECTIONAL ||
+				dx * dx + dy * dy + dz * dz <= lights[i].Range * lights[i].Range;
+			if (!reaches)
+				continue;
+			pointLights++;
+			complete = complete && std::binary_search(begin, end, i);
+		}
+	}
+
+	// Each cluster's list follows the last one's, sorted by light
+	unsigned int offset = 0;
+	bool ordered = true;
+	for (const LightCluster& cluster : clusters)
+	{
+		ordered = ordered && cluster.Offset == offset && std::is_sorted(indices.data() + offset, indices.data() + offset + cluster.Count);
+		offset += cluster.Count;
+	}
+	ordered = ordered && offset == indices.size();
+
+	// How long binning takes, and how many lights a pixel loops
+	// over on average compared to all of them
+	printf("%6s %10s %9s %12s %12s\n", "Lights", "Build ms", "Indices", "Avg/cluster", "Max/cluster");
+	for (unsigned int count : { 100u, 1000u, 4000u })
+	{
+		std::vector<Light> timed = makeLights(count, 0.5f, 4.0f);
+		double time = TimeBest(10, [&]() { grid.Build(view, timed); });
+		const LightGridStats& stats = grid.GetStats();
+		printf("%6u %10.3f %9u %12.1f %12u\n", count, time * 1000.0, stats.Indices,
+			(double)stats.Indices / grid.GetClusters().size(), stats.MaxPerCluster);
+	}
+
+	printf("Every light reaching a point found  %s (%u checked)\n", complete ? "PASS" : "FAIL", pointLights);
+	printf("Cluster lists packed in order       %s\n", ordered ? "PASS" : "FAIL");
+}
+
+
+void CheckObjectLights()
+{
+	printf("\n-- Object light lists (%d per object) --\n", MAX_OBJECT_LIGHTS);
+
+	// Spheres (center and radius) and point lights scattered
+	// through a box, with a directional light first
+	std::mt19937 rng(22);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<XMFLOAT4> spheres;
+	std::vector<Light> lights;
+	ObjectLightSelector selector;
+	auto makeScene = [&](unsigned int objectCount, unsigned int lightCount, float size)
+	{
+		selector.Clear();
+		spheres.resize(objectCount);
+		for (XMFLOAT4& sphere : spheres)
+		{
+			sphere = XMFLOAT4(unit(rng) * size, unit(rng) * 10, unit(rng) * size, 0.5f + unit(rng) * 1.5f);
+			selector.AddObject(XMFLOAT3(sphere.x, sphere.y, sphere.z), sphere.w);
+		}
+
+		lights.assign(lightCount, Light());
+		lights[0].Type = LIGHT_TYPE_DIRECTIONAL;
+		lights[0].Color = XMFLOAT3(1, 1, 1);
+		lights[0].Intensity = 1.0f;
+		for (unsigned int i = 1; i < lightCount; i++)
+		{
+			lights[i].Type = LIGHT_TYPE_POINT;
+			lights[i].Position = XMFLOAT3(unit(rng) * size, unit(rng) * 10, unit(rng) * size);
+			lights[i].Color = XMFLOAT3(unit(rng), unit(rng), unit(rng));
+			lights[i].Range = 5.0f + unit(rng) * 10.0f;
+			lights[i].Intensity = 0.1f + unit(rng) * 3.0f;
+		}
+	};
+
+	// One object's lights picked the slow way: weigh every light,
+	// keep the strongest (first on ties) and add up the rest
+	std::vector<std::pair<float, unsigned int>> ranked;
+	auto reference = [&](const XMFLOAT4& sphere, std::vector<unsigned int>& kept, XMFLOAT3& dropped)
+	{
+		XMFLOAT3 center(sphere.x, sphere.y, sphere.z);
+		ranked.clear();
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			float weight = ObjectLightSelector::GetLightWeight(lights[i], center, sphere.w);
+			if (weight > 0.0f)
+				ranked.push_back({ weight, i });
+		}
+		std::stable_sort(ranked.begin(), ranked.end(),
+			[](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+
+		kept.clear();
+		dropped = XMFLOAT3(0, 0, 0);
+		for (size_t k = 0; k < ranked.size(); k++)
+		{
+			if (k < MAX_OBJECT_LIGHTS)
+			{
+				kept.push_back(ranked[k].second);
+				continue;
+			}
+
+			const Light& light = lights[ranked[k].second];
+			float att = 1.0f;
+			if (light.Type != LIGHT_TYPE_DIRECTIONAL)
+			{
+				float dx = center.x - light.Position.x, dy = center.y - light.Position.y, dz = center.z - light.Position.z;
+				att = std::max(1.0f - (dx * dx + dy * dy + dz * dz) / (light.Range * light.Range), 0.0f);
+				att *= att;
+			}
+			dropped.x += att * light.Intensity * light.Color.x * 0.25f;
+			dropped.y += att * light.Intensity * light.Color.y * 0.25f;
+			dropped.z += att * light.Intensity * light.Color.z * 0.25f;
+		}
+	};
+
+	// A crowded scene (and a count that isn't a whole number of
+	// SIMD groups), so most objects have lights to drop.  Lists
+	// have to hold the same lights in the same order, other than
+	// lights whose weights are too close to call.
+	makeScene(2003, 300, 40.0f);
+	selector.Select(lights);
+
+	bool sameLights = true;
+	bool sameDropped = true;
+	unsigned int withDropped = 0;
+	std::vector<unsigned int> kept;
+	for (unsigned int i = 0; i < spheres.size(); i++)
+	{
+		XMFLOAT3 dropped;
+		reference(spheres[i], kept, dropped);
+
+		const ObjectLightList& list = selector.GetList(i);
+		XMFLOAT3 center(spheres[i].x, spheres[i].y, spheres[i].z);
+		sameLights = sameLights && list.Count == kept.size();
+		for (unsigned int k = 0; k < list.Count && k < kept.size(); k++)
+		{
+			float a = ObjectLightSelector::GetLightWeight(lights[list.Indices[k]], center, spheres[i].w);
+			float b = ObjectLightSelector::GetLightWeight(lights[kept[k]], center, spheres[i].w);
+			sameLights = sameLights && (list.Indices[k] == kept[k] || fabsf(a - b) <= 1e-5f * b);
+		}
+
+		float tolerance = 1e-3f + 1e-4f * (dropped.x + dropped.y + dropped.z);
+		sameDropped = sameDropped &&
+			fabsf(list.DroppedColor.x - dropped.x) <= tolerance &&
+			fabsf(list.DroppedColor.y - dropped.y) <= tolerance &&
+			fabsf(list.DroppedColor.z - dropped.z) <= tolerance;
+		if (dropped.x + dropped.y + dropped.z > 0.0f)
+			withDropped++;
+	}
+
+	// No lights at all leaves every list empty
+	ObjectLightSelector empty;
+	empty.AddObject(XMFLOAT3(0, 0, 0), 1.0f);
+	empty.Select(std::vector<Light>());
+	bool emptyOk = empty.GetList(0).Count == 0 && empty.GetList(0).DroppedColor.x == 0.0f;
+
+	// The big scene: 10k objects and 1k lights, against picking
+	// each object's lights the slow way
+	makeScene(10000, 1000, 100.0f);
+	double time = TimeBest(5, [&]() { selector.Select(lights); });
+	const ObjectLightStats& stats = selector.GetStats();
+	double referenceTime = TimeBest(1, [&]()
+	{
+		XMFLOAT3 dropped;
+		for (const XMFLOAT4& sphere : spheres)
+			reference(sphere, kept, dropped);
+	});
+
+	printf("%u objects x %u lights: %u in range, %u kept (%.1f per object)\n",
+		stats.Objects, stats.Lights, stats.Reaching, stats.Kept, (double)stats.Kept / stats.Objects);
+	printf("Select: %.3f ms   one at a time: %.3f ms   (%.1fx)\n", time * 1000.0, referenceTime * 1000.0, referenceTime / time);
+	printf("Strongest lights kept, in order     %s\n", sameLights ? "PASS" : "FAIL");
+	printf("Dropped lights summed (%u objects) %s\n", withDropped, sameDropped ? "PASS" : "FAIL");
+	printf("No lights, empty lists              %s\n", emptyOk ? "PASS" : "FAIL");
+}
+
+
+void CheckShadowCasters()
+{
+	printf("\n-- Shadow caster culling (32x32 receiver grid) --\n");
+
+	// The renderer's light: looking down at 45 degrees from 20
+	// units back, with a 40 unit wide orthographic volume
+	XMFLOAT3 direction(0, -0.7071f, 0.7071f);
+	XMVECTOR lightPos = XMVectorScale(XMLoadFloat3(&direction), -20.0f);
+	XMFLOAT4X4 shadowView, shadowProjection;
+	XMStoreFloat4x4(&shadowView, XMMatrixLookToLH(lightPos, XMLoadFloat3(&direction), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&shadowProjection, XMMatrixOrthographicLH(40.0f, 40.0f, 0.1f, 100.0f));
+
+	// A floor with a box above it, a box under it (the light can't
+	// reach past the floor) and a box well off to the side
+	ShadowCasterCuller culler;
+	culler.BeginFrame(shadowView, shadowProjection);
+	culler.AddReceiver(XMFLOAT3(0, 0, 0), XMFLOAT3(10, 0.1f, 10));
+	bool layout =
+		culler.CouldShadow(XMFLOAT3(0, 3, 0), XMFLOAT3(1, 1, 1)) &&
+		!culler.CouldShadow(XMFLOAT3(0, -30, 30), XMFLOAT3(1, 1, 1)) &&
+		!culler.CouldShadow(XMFLOAT3(200, 3, 0), XMFLOAT3(1, 1, 1));
+
+	// With nothing visible, nothing casts
+	culler.BeginFrame(shadowView, shadowProjection);
+	layout = layout && !culler.CouldShadow(XMFLOAT3(0, 3, 0), XMFLOAT3(1, 1, 1));
+
+	// A big scene of boxes, with a patch of it visible
+	std::mt19937 rng(23);
+	std::uniform_real_distribution<float> place(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> height(0.0f, 10.0f);
+	std::uniform_real_distribution<float> size(0.2f, 2.0f);
+	const unsigned int count = 100000;
+	FrustumCuller bounds;
+	std::vector<unsigned int> visible;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		MeshBounds b;
+		b.Min = XMFLOAT3(-size(rng), -size(rng), -size(rng));
+		b.Max = XMFLOAT3(size(rng), size(rng), size(rng));
+		b.Center = XMFLOAT3((b.Min.x + b.Max.x) * 0.5f, (b.Min.y + b.Max.y) * 0.5f, (b.Min.z + b.Max.z) * 0.5f);
+		XMFLOAT3 extent = GetBoundsExtent(b);
+		b.Radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&extent))) * 0.5f;
+
+		XMFLOAT4X4 world;
+		float x = place(rng), z = place(rng);
+		XMStoreFloat4x4(&world, XMMatrixTranslation(x, height(rng), z));
+		bounds.AddBounds(b, world);
+		if (fabsf(x) < 15.0f && z > -5.0f && z < 25.0f)
+			visible.push_back(i);
+	}
+
+	std::vector<unsigned int> casters;
+	auto cull = [&]()
+	{
+		culler.BeginFrame(shadowView, shadowProjection);
+		for (unsigned int i : visible)
+		{
+			XMFLOAT3 center, halfExtent;
+			bounds.GetBox(i, center, halfExtent);
+			culler.AddReceiver(center, halfExtent);
+		}
+		culler.Cull(bounds, casters);
+	};
+	double time = TimeBest(10, cull);
+	const ShadowCasterStats stats = culler.GetStats();
+
+	// Every caster some receiver is exactly behind (checking each
+	// pair of light-space boxes) has to have been kept
+	auto toLight = [&](unsigned int i, XMFLOAT3& minimum, XMFLOAT3& maximum)
+	{
+		XMFLOAT3 center, halfExtent, c;
+		bounds.GetBox(i, center, halfExtent);
+		XMStoreFloat3(&c, XMVector3TransformCoord(XMLoadFloat3(&center), XMLoadFloat4x4(&shadowView)));
+		const XMFLOAT4X4& v = shadowView;
+		XMFLOAT3 half(
+			fabsf(v._11) * halfExtent.x + fabsf(v._21) * halfExtent.y + fabsf(v._31) * halfExtent.z,
+			fabsf(v._12) * halfExtent.x + fabsf(v._22) * halfExtent.y + fabsf(v._32) * halfExtent.z,
+			fabsf(v._13) * halfExtent.x + fabsf(v._23) * halfExtent.y + fabsf(v._33) * halfExtent.z);
+		minimum = XMFLOAT3(c.x - half.x, c.y - half.y, c.z - half.z);
+		maximum = XMFLOAT3(c.x + half.x, c.y + half.y, c.z + half.z);
+	};
+	auto inVolume = [](const XMFLOAT3& minimum, const XMFLOAT3& maximum)
+	{
+		return minimum.x <= 20.0f && maximum.x >= -20.0f && minimum.y <= 20.0f && maximum.y >= -20.0f &&
+			minimum.z <= 100.0f && maximum.z >= 0.1f;
+	};
+
+	std::vector<XMFLOAT3> receiverMin, receiverMax;
+	for (unsigned int i : visible)
+	{
+		XMFLOAT3 minimum, maximum;
+		toLight(i, minimum, maximum);
+		if (!inVolume(minimum, maximum))
+			continue;
+		receiverMin.push_back(minimum);
+		receiverMax.push_back(maximum);
+	}
+
+	std::vector<bool> kept(count, false);
+	for (unsigned int i : casters)
+		kept[i] = true;
+	bool conservative = true;
+	unsigned int exact = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 minimum, maximum;
+		toLight(i, minimum, maximum);
+		if (!inVolume(minimum, maximum))
+			continue;
+
+		for (size_t r = 0; r < receiverMin.size(); r++)
+		{
+			if (minimum.x <= receiverMax[r].x && maximum.x >= receiverMin[r].x &&
+				minimum.y <= receiverMax[r].y && maximum.y >= receiverMin[r].y &&
+				minimum.z <= receiverMax[r].z)
+			{
+				exact++;
+				conservative = conservative && kept[i];
+				break;
+			}
+		}
+	}
+	double exactTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("%u objects, %u receivers: %u casters (%u outside the light, %u with nothing behind)\n",
+		stats.Tested, stats.Receivers, stats.Casters, stats.Outside, stats.Unseen);
+	printf("Pair by pair: %u casters   Grid: %.3f ms   pair by pair: %.3f ms\n", exact, time * 1000.0, exactTime * 1000.0);
+	printf("Floor, above, below and aside       %s\n", layout ? "PASS" : "FAIL");
+	printf("No caster with a receiver dropped   %s\n", conservative ? "PASS" : "FAIL");
+}
+
+
+
+void CheckShadowCache()
+{
+	printf("\n-- Static shadow cache --\n");
+
+	// Versions: set by the first update, then only changed by
+	// moving, and once more by the update after stopping (which
+	// is when it stops counting as moving)
+	TransformSystem transforms;
+	TransformHandle t = transforms.Create();
+	transforms.UpdateWorldMatrices();
+	unsigned int created = transforms.GetVersion(t);
+	transforms.UpdateWorldMatrices();
+	unsigned int still = transforms.GetVersion(t);
+	transforms.SetPosition(t, 1, 2, 3);
+	transforms.UpdateWorldMatrices();
+	unsigned int moved = transforms.GetVersion(t);
+	bool wasMoving = transforms.IsMoving(t);
+	transforms.UpdateWorldMatrices();
+	unsigned int stopped = transforms.GetVersion(t);
+	transforms.UpdateWorldMatrices();
+	bool transformVersions = created != 0 && still == created && moved != still && wasMoving &&
+		stopped != moved && transforms.GetVersion(t) == stopped && !transforms.IsMoving(t);
+
+	SceneGraph scene;
+	SceneNode parent = scene.CreateNode();
+	SceneNode child = scene.CreateNode(parent);
+	scene.UpdateWorldMatrices();
+	unsigned int childCreated = scene.GetVersion(child);
+	scene.UpdateWorldMatrices();
+	bool sceneVersions = childCreated != 0 && scene.GetVersion(child) == childCreated;
+	scene.SetPosition(parent, 0, 1, 0);
+	scene.UpdateWorldMatrices();
+	unsigned int childMoved = scene.GetVersion(child);
+	sceneVersions = sceneVersions && childMoved != childCreated;
+	scene.UpdateWorldMatrices();
+	sceneVersions = sceneVersions && scene.GetVersion(child) != childMoved;
+
+	// The renderer's light, and the same one turned a little
+	XMFLOAT4X4 shadowView, turnedView, shadowProjection;
+	XMStoreFloat4x4(&shadowView, XMMatrixLookToLH(XMVectorSet(0, 14, -14, 1), XMVectorSet(0, -1, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&turnedView, XMMatrixLookToLH(XMVectorSet(1, 14, -14, 1), XMVectorSet(-0.05f, -1, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&shadowProjection, XMMatrixOrthographicLH(10.0f, 10.0f, 0.1f, 100.0f));
+
+	// A hundred casters, with one that moves every other frame
+	// (a simulation step for every two frames drawn) and so has
+	// to be dynamic
+	const unsigned int casterCount = 100;
+	const unsigned int mover = 7;
+	const unsigned int settle = 30;
+	ShadowCache cache(settle);
+	std::vector<unsigned int> versions(casterCount, 1);
+	std::vector<bool> moving(casterCount, false);
+	unsigned int visibleCasters = casterCount;
+	auto frame = [&](const XMFLOAT4X4& view)
+	{
+		cache.BeginFrame(view, shadowProjection);
+		for (unsigned int i = 0; i < visibleCasters; i++)
+			cache.AddCaster(i, versions[i], moving[i]);
+		return cache.EndFrame();
+	};
+
+	// Everything starts out static
+	bool redraws = frame(shadowView) && !frame(shadowView) && cache.IsStatic(mover);
+
+	// The mover costs one redraw when it starts, then none, and
+	// stays dynamic on the frames between its steps too
+	unsigned int redrawsWhileMoving = 0;
+	moving[mover] = true;
+	for (unsigned int f = 0; f < 200; f++)
+	{
+		if (f % 2 == 0)
+			versions[mover]++;
+		redrawsWhileMoving += frame(shadowView);
+	}
+	redraws = redraws && redrawsWhileMoving == 1 && !cache.IsStatic(mover) && cache.IsStatic(mover + 1);
+	redraws = redraws && cache.GetStats().StaticCasters == casterCount - 1 && cache.GetStats().DynamicCasters == 1;
+
+	// Once it's settled, it goes back in the cache (one redraw).
+	// The step after it stops changes its version once more.
+	versions[mover]++;
+	moving[mover] = false;
+	unsigned int redrawsSettling = 0;
+	for (unsigned int f = 0; f < settle + 5; f++)
+		redrawsSettling += frame(shadowView);
+	redraws = redraws && redrawsSettling == 1 && cache.IsStatic(mover);
+
+	// A static caster moving, the light turning, a caster leaving
+	// the volume and the map being made again each redraw once
+	versions[3]++;
+	redraws = redraws && frame(shadowView) && !frame(shadowView);
+	redraws = redraws && frame(turnedView) && !frame(turnedView);
+	visibleCasters--;
+	redraws = redraws && frame(turnedView) && !frame(turnedView);
+	cache.Invalidate();
+	redraws = redraws && frame(turnedView) && !frame(turnedView);
+
+	// A caster that comes into the volume already moving isn't
+	// cached, even on a frame its version doesn't change
+	moving[casterCount - 1] = true;
+	visibleCasters++;
+	bool movingEnters = !frame(turnedView) && !cache.IsStatic(casterCount - 1) &&
+		!frame(turnedView) && !cache.IsStatic(casterCount - 1);
+
+	// Timing for a big scene that isn't changing
+	const unsigned int bigCount = 100000;
+	ShadowCache bigCache;
+	auto start = std::chrono::high_resolution_clock::now();
+	const int frames = 100;
+	for (int f = 0; f < frames; f++)
+	{
+		bigCache.BeginFrame(shadowView, shadowProjection);
+		for (unsigned int i = 0; i < bigCount; i++)
+			bigCache.AddCaster(i, 1, false);
+		bigCache.EndFrame();
+	}
+	double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+
+	const ShadowCacheStats& stats = cache.GetStats();
+	printf("%u frames: %u static re-renders (%u light, %u casters)\n",
+		stats.Frames, stats.StaticRenders, stats.LightChanges, stats.CasterChanges);
+	printf("%u unchanging casters: %.3f ms per frame, %u re-render in %u frames\n",
+		bigCount, time * 1000.0, bigCache.GetStats().StaticRenders, bigCache.GetStats().Frames);
+	printf("Transform versions                  %s\n", transformVersions ? "PASS" : "FAIL");
+	printf("Scene graph versions                %s\n", sceneVersions ? "PASS" : "FAIL");
+	printf("Redraws only when something changed %s\n", redraws ? "PASS" : "FAIL");
+	printf("Moving casters come in dynamic      %s\n", movingEnters ? "PASS" : "FAIL");
+}
+
+
+void CheckShadowCascades()
+{
+	printf("\n-- Cascaded shadow maps (4 cascades, 1024x1024) --\n");
+
+	// Splits: the ends exactly, evenly spaced at 0, each the same
+	// ratio past the last at 1, and in order in between
+	float uniform[5], logarithmic[5], practical[5];
+	ShadowCascades::ComputeSplits(0.1f, 100.0f, 4, 0.0f, uniform);
+	ShadowCascades::ComputeSplits(0.1f, 100.0f, 4, 1.0f, logarithmic);
+	ShadowCascades::ComputeSplits(0.1f, 100.0f, 4, 0.75f, practical);
+	bool splits = true;
+	for (int i = 0; i <= 4; i++)
+	{
+		splits = splits && fabsf(uniform[i] - (0.1f + 99.9f * i / 4)) < 1e-3f;
+		splits = splits && fabsf(logarithmic[i] - 0.1f * powf(1000.0f, i / 4.0f)) < 1e-3f * logarithmic[i];
+		if (i > 0)
+			splits = splits && practical[i] > practical[i - 1] && practical[i] <= uniform[i] && practical[i] >= logarithmic[i];
+	}
+	splits = splits && practical[0] == 0.1f && practical[4] == 100.0f;
+
+	// The game's camera, wandering about and looking around
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.1f, 100.0f));
+	XMFLOAT3 lightDirection(0.3f, -0.8f, 0.5f);
+	const unsigned int resolution = 1024;
+	auto cameraView = [](float x, float z, float yaw, float pitch)
+	{
+		XMFLOAT4X4 view;
+		XMMATRIX rotation = XMMatrixRotationRollPitchYaw(pitch, yaw, 0);
+		XMVECTOR forward = XMVector3Transform(XMVectorSet(0, 0, 1, 0), rotation);
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(x, 2, z, 1), forward, XMVectorSet(0, 1, 0, 0)));
+		return view;
+	};
+
+	// Every corner of each cascade's slice lands in its map, and
+	// each map's edges are on whole texels of the light's view
+	ShadowCascades cascades;
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		cascades.SetUpdateInterval(i, 1);
+	bool fitted = true;
+	bool snapped = true;
+	std::mt19937 rng(25);
+	std::uniform_real_distribution<float> place(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> angle(-1.2f, 1.2f);
+	float firstTexels[MAX_SHADOW_CASCADES] = {};
+	bool sameSize = true;
+	for (int step = 0; step < 100; step++)
+	{
+		XMFLOAT4X4 view = cameraView(place(rng), place(rng), angle(rng) * 2.5f, angle(rng));
+		cascades.Update(view, projection, lightDirection, resolution);
+		XMMATRIX cameraWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+
+		for (unsigned int i = 0; i < cascades.GetCascadeCount(); i++)
+		{
+			const ShadowCascade& c = cascades.GetCascade(i);
+			XMMATRIX toShadow = XMLoadFloat4x4(&c.ViewProjection);
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float z = corner & 4 ? c.FarDepth : c.NearDepth;
+				float x = (corner & 1 ? z : -z) / projection._11;
+				float y = (corner & 2 ? z : -z) / projection._22;
+				XMVECTOR world = XMVector3TransformCoord(XMVectorSet(x, y, z, 1), cameraWorld);
+				XMFLOAT3 p;
+				XMStoreFloat3(&p, XMVector3TransformCoord(world, toShadow));
+				fitted = fitted && fabsf(p.x) <= 1.0001f && fabsf(p.y) <= 1.0001f && p.z >= 0.0f && p.z <= 1.0f;
+			}
+
+			float left = (-1.0f - c.Projection._41) / c.Projection._11;
+			float bottom = (-1.0f - c.Projection._42) / c.Projection._22;
+			snapped = snapped &&
+				fabsf(left / c.TexelSize - roundf(left / c.TexelSize)) < 0.01f &&
+				fabsf(bottom / c.TexelSize - roundf(bottom / c.TexelSize)) < 0.01f;
+
+			if (step == 0)
+				firstTexels[i] = c.TexelSize;
+			sameSize = sameSize && c.TexelSize == firstTexels[i];
+		}
+	}
+
+	// Moving less than a texel doesn't move the maps at all
+	XMFLOAT4X4 still = cameraView(3, 4, 0.5f, 0.2f);
+	cascades.Update(still, projection, lightDirection, resolution);
+	XMFLOAT4X4 before = cascades.GetCascade(3).Projection;
+	float nudge = cascades.GetCascade(3).TexelSize * 0.01f;
+	cascades.Update(cameraView(3 + nudge, 4, 0.5f, 0.2f), projection, lightDirection, resolution);
+	float moved = fabsf(cascades.GetCascade(3).Projection._41 - before._41) + fabsf(cascades.GetCascade(3).Projection._42 - before._42);
+	float texelInClip = cascades.GetCascade(3).TexelSize * before._11;
+	snapped = snapped && (moved == 0.0f || fabsf(moved - texelInClip) < 1e-3f);
+
+	// Walking slowly, the maps move often but the cached regions
+	// rarely, and every map is its region minus the border: the
+	// same point lands on the same texel and depth in both
+	unsigned int cacheResolution = ShadowCascades::GetCacheResolution(resolution);
+	unsigned int movesBefore[MAX_SHADOW_CASCADES], mapMoves = 0;
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		movesBefore[i] = cascades.GetCascade(i).CacheMoves;
+	bool cached = true;
+	const int walkSteps = 1000;
+	for (int step = 0; step < walkSteps; step++)
+	{
+		XMFLOAT4X4 before = cascades.GetCascade(0).Projection;
+		XMFLOAT4X4 view = cameraView(3 + step * 0.01f, 4 + step * 0.005f, 0.5f, 0.2f);
+		cascades.Update(view, projection, lightDirection, resolution);
+		mapMoves += memcmp(&before, &cascades.GetCascade(0).Projection, sizeof(XMFLOAT4X4)) != 0;
+
+		XMMATRIX cameraWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+		XMMATRIX lightView = XMLoadFloat4x4(&cascades.GetView());
+		for (unsigned int i = 0; i < cascades.GetCascadeCount(); i++)
+		{
+			const ShadowCascade& c = cascades.GetCascade(i);
+			cached = cached && c.CacheX <= cacheResolution - resolution && c.CacheY <= cacheResolution - resolution;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float z = corner & 4 ? c.FarDepth : c.NearDepth;
+				float x = (corner & 1 ? z : -z) / projection._11;
+				float y = (corner & 2 ? z : -z) / projection._22;
+				XMVECTOR world = XMVector3TransformCoord(XMVectorSet(x, y, z, 1), cameraWorld);
+				XMFLOAT3 map, cache;
+				XMStoreFloat3(&map, XMVector3TransformCoord(world, XMLoadFloat4x4(&c.ViewProjection)));
+				XMStoreFloat3(&cache, XMVector3TransformCoord(world, lightView * XMLoadFloat4x4(&c.CacheProjection)));
+				float mapU = (map.x * 0.5f + 0.5f) * resolution + c.CacheX;
+				float mapV = (0.5f - map.y * 0.5f) * resolution + c.CacheY;
+				float cacheU = (cache.x * 0.5f + 0.5f) * cacheResolution;
+				float cacheV = (0.5f - cache.y * 0.5f) * cacheResolution;
+				cached = cached && fabsf(mapU - cacheU) < 0.01f && fabsf(mapV - cacheV) < 0.01f && fabsf(map.z - cache.z) < 1e-5f;
+			}
+		}
+	}
+	unsigned int regionMoves[MAX_SHADOW_CASCADES];
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		regionMoves[i] = cascades.GetCascade(i).CacheMoves - movesBefore[i];
+	cached = cached && mapMoves > 100 && regionMoves[0] * 20 < mapMoves;
+
+	// Update rates: every frame, every frame, every other frame
+	// and every fourth frame by default, and everything at once
+	// when the light turns
+	ShadowCascades rates;
+	unsigned int updates[MAX_SHADOW_CASCADES] = {};
+	bool first = rates.Update(still, projection, lightDirection, resolution) == 0xF;
+	for (int f = 0; f < 16; f++)
+	{
+		unsigned int mask = rates.Update(still, projection, lightDirection, resolution);
+		for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+			updates[i] += (mask >> i) & 1;
+	}
+	XMFLOAT3 turned(0.35f, -0.8f, 0.5f);
+	bool rated = first && updates[0] == 16 && updates[1] == 16 && updates[2] == 8 && updates[3] == 4 &&
+		rates.Update(still, projection, turned, resolution) == 0xF;
+
+	// Cost of fitting every cascade
+	auto start = std::chrono::high_resolution_clock::now();
+	const int fits = 100000;
+	for (int f = 0; f < fits; f++)
+	{
+		cascades.Invalidate();
+		cascades.Update(still, projection, lightDirection, resolution);
+	}
+	double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / fits;
+
+	printf("Splits at 0.75: %.2f %.2f %.2f %.2f %.2f\n", practical[0], practical[1], practical[2], practical[3], practical[4]);
+	printf("Texels: %.4f %.4f %.4f %.4f   Fitting all: %.3f us\n",
+		firstTexels[0], firstTexels[1], firstTexels[2], firstTexels[3], time * 1000000.0);
+	printf("Practical splits                    %s\n", splits ? "PASS" : "FAIL");
+	printf("Slices inside their cascades        %s\n", fitted ? "PASS" : "FAIL");
+	printf("Snapped to texels, steady size      %s\n", snapped && sameSize ? "PASS" : "FAIL");
+	printf("Walking %d steps: near map moved %u times, cached regions %u %u %u %u\n",
+		walkSteps, mapMoves, regionMoves[0], regionMoves[1], regionMoves[2], regionMoves[3]);
+	printf("Per-cascade update rates            %s\n", rated ? "PASS" : "FAIL");
+	printf("Maps inside steady cached regions   %s\n", cached ? "PASS" : "FAIL");
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+
+// --------------------------------------------------------
+// CPU-side benchmarks for the asset and rendering helpers.
+// These print their results to the console, so they're only
+// run when RUN_BENCHMARKS is defined (see Game.cpp).
+//
+// modelFolder - Full path to the folder holding our .obj files,
+//               including the trailing slash
+// --------------------------------------------------------
+void RunBenchmarks(const std::string& modelFolder);
+
+// Compares the memory-mapped, multi-threaded OBJ parser
+// against the original getline/sscanf_s loader (MB/s)
+void BenchmarkObjLoading(const std::string& modelFolder);
+
+// Vertex cache (ACMR/ATVR) and overdraw statistics for each
+// of the mesh optimization passes, plus how long they take
+void BenchmarkMeshOptimization(const std::string& modelFolder);
+
+// Triangle counts and geometric error for each generated LOD,
+// how long the chain takes to build, and whether building it
+// again gives exactly the same result
+void BenchmarkLodGeneration(const std::string& modelFolder);
+
+// Triangles rejected per frame by meshlet frustum and backface
+// culling, for a copy of the game's scene and for a large
+// synthetic sphere, with a camera orbiting each one
+void BenchmarkMeshletCulling(const std::string& modelFolder);
+
+// Times the SIMD, multi-threaded tangent generator against the
+// scalar reference and checks that they agree, along with the
+// handedness of mirrored UVs and the degenerate UV fallback
+void CheckTangents(const std::string& modelFolder);
+
+// Round-trips random vertices and our models through the packed
+// vertex format, checking the decode errors against their bounds
+void CheckVertexPacking(const std::string& modelFolder);
+
+// Compares loading a cooked .mesh file (hash the source,
+// map and validate the cooked file) against parsing the .obj,
+// both on its own and with the full cook pipeline
+void BenchmarkCookedLoading(const std::string& modelFolder);
+
+// Random allocations and frees through the mesh pool's range
+// allocator, checking the free list, that compaction keeps
+// every mesh's data intact, and how fragmented it gets
+void CheckRangeAllocator();
+
+// Moving 100k transforms arranged in a hierarchy: the scene
+// graph's single batched pass against Transforms that each
+// multiply their way up a chain of parent pointers
+void BenchmarkSceneGraph();
+
+// World matrices for up to 1M objects: the structure of arrays
+// transform system's SIMD, multi-threaded update against each
+// object's own Transform, checking that they agree
+void BenchmarkTransformSystem();
+
+// The analytic inverse transpose of scale * rotation * translation
+// against XMMatrixInverse() for uniform, non-uniform and mirrored
+// scales, on its own and through the scene graph, and how much
+// faster it is
+void CheckNormalMatrix();
+
+// Transform's quaternion rotation against the pitch/yaw/roll
+// behavior it replaced, converting back and forth, and the cost
+// of a camera's per-frame moves with and without cached axes
+void CheckTransformRotation();
+
+// Blending between the last two simulation steps in the transform
+// system and the scene graph: moving objects land halfway, new
+// ones don't slide in from the origin and stopped ones stay put,
+// and their normal matrices follow along
+void CheckInterpolation();
+
+// Frustum culling up to 1M objects' bounds with the SIMD culler
+// against testing each one's sphere on its own, checking that
+// nothing with a corner on screen gets culled
+void BenchmarkFrustumCulling();
+
+// Software occlusion culling against known layouts of walls and
+// boxes, then the per-frame cost of a city-like scene of box
+// occluders and objects
+void CheckOcclusionCulling();
+
+// The render queue's radix sort against std::stable_sort, the
+// order it puts each pass in, the state changes sorting saves
+// over drawing a scene in the order it was made, and sort ids
+// staying small as things come and go
+void CheckRenderQueue();
+
+// Grouping draws for instancing: every draw lands in the batch
+// for its group, in order, with the right matrices packed for
+// it, and how long batching a big scene takes
+void CheckInstancing();
+
+// Binning up to 4000 lights into the clustered light grid:
+// every point in view finds each light reaching it in its
+// cluster's list, the lists are packed in order, and how long
+// building the grid takes
+void CheckLightGrid();
+
+// Per-object light lists against picking each object's lights
+// one at a time: the same strongest lights kept in order, the
+// rest summed into the dropped light, and the time to select
+// for 10k objects and 1k lights
+void CheckObjectLights();
+
+// Shadow caster culling against a known layout (a caster over
+// a floor, one under it, one off to the side), that it never
+// drops a caster testing each receiver one at a time would
+// keep, and the cost for a big scene
+void CheckShadowCasters();
+
+// Transform versions changing when (and only when) a transform
+// moves or stops, and the static shadow cache redrawing for a
+// scripted run of frames: only when the light, a static caster
+// or the volume's contents change, and not for something that
+// keeps moving or comes into the volume moving
+void CheckShadowCache();
+
+// Cascade splits against the evenly spaced and logarithmic
+// schemes, every corner of each cascade's slice of the camera
+// frustum landing inside its shadow map, cascades snapping to
+// whole texels (and keeping their size as the camera turns),
+// each cascade updating at its own rate, and cached regions
+// staying put while their cascades move around inside them
+void CheckShadowCascades();
@@ -0,0 +1,52 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+MeshBounds CalculateBounds(const Vertex* verts, size_t numVerts)
+{
+	MeshBounds bounds = {};
+	if (numVerts == 0)
+		return bounds;
+
+	// Box first
+	bounds.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	bounds.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < numVerts; i++)
+	{
+		const XMFLOAT3& p = verts[i].Position;
+		bounds.Min = XMFLOAT3(std::min(bounds.Min.x, p.x), std::min(bounds.Min.y, p.y), std::min(bounds.Min.z, p.z));
+		bounds.Max = XMFLOAT3(std::max(bounds.Max.x, p.x), std::max(bounds.Max.y, p.y), std::max(bounds.Max.z, p.z));
+	}
+
+	// Then a sphere from the box's center, just big enough for
+	// the farthest vertex (tighter than the box's half diagonal)
+	bounds.Center = XMFLOAT3(
+		(bounds.Min.x + bounds.Max.x) * 0.5f,
+		(bounds.Min.y + bounds.Max.y) * 0.5f,
+		(bounds.Min.z + bounds.Max.z) * 0.5f);
+
+	float radiusSq = 0.0f;
+	for (size_t i = 0; i < numVerts; i++)
+	{
+		float dx = verts[i].Position.x - bounds.Center.x;
+		float dy = verts[i].Position.y - bounds.Center.y;
+		float dz = verts[i].Position.z - bounds.Center.z;
+		radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.Radius = sqrtf(radiusSq);
+
+	return bounds;
+}
+
+
+XMFLOAT3 GetBoundsExtent(const MeshBounds& bounds)
+{
+	return XMFLOAT3(
+		bounds.Max.x - bounds.Min.x,
+		bounds.Max.y - bounds.Min.y,
+		bounds.Max.z - bounds.Min.z);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Object-space bounds of a mesh: an axis-aligned box, and
+// a sphere around the box's center that contains every vertex
+// --------------------------------------------------------
+struct MeshBounds
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+};
+
+MeshBounds CalculateBounds(const Vertex* verts, size_t numVerts);
+
+// Size of the box along each axis
+DirectX::XMFLOAT3 GetBoundsExtent(const MeshBounds& bounds);
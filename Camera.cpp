@@ -10,6 +10,10 @@ Camera::Camera(float x, float y, float z, float moveSpeed, float mouseLookSpeed,
 	this->mouseLookSpeed = mouseLookSpeed;
 	transform.SetPosition(x, y, z);
 
+	// The view update rebuilds the frustum, so the projection
+	// needs a value before it's made for real
+	XMStoreFloat4x4(&projMatrix, XMMatrixIdentity());
+
 	UpdateViewMatrix();
 	UpdateProjectionMatrix(aspectRatio);
 }
@@ -57,18 +61,18 @@ void Camera::Update(float dt)
 // Creates a new view matrix based on current position and orientation
 void Camera::UpdateViewMatrix()
 {
-	// Rotate the standard "forward" matrix by our rotation
-	// This gives us our "look direction"
-	XMFLOAT3 rot = transform.GetPitchYawRoll();
-	XMVECTOR dir = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rot)));
-
+	// The transform keeps its rotated axes around, so
+	// forward is our "look direction" as it is
 	XMFLOAT3 pos = transform.GetPosition();
+	XMFLOAT3 dir = transform.GetForward();
+	XMFLOAT3 up = transform.GetUp();
 	XMMATRIX view = XMMatrixLookToLH(
 		XMLoadFloat3(&pos),
-		dir,
-		XMVectorSet(0, 1, 0, 0));
+		XMLoadFloat3(&dir),
+		XMLoadFloat3(&up));
 
 	XMStoreFloat4x4(&viewMatrix, view);
+	frustum = CreateFrustum(viewMatrix, projMatrix);
 }
 
 // Updates the projection matrix
@@ -80,6 +84,7 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 		0.01f,				// Near clip plane distance
 		100.0f);			// Far clip plane distance
 	XMStoreFloat4x4(&projMatrix, P);
+	frustum = CreateFrustum(viewMatrix, projMatrix);
 }
 
 Transform* Camera::GetTransform()
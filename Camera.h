@@ -2,6 +2,7 @@
 #include <DirectXMath.h>
 #include <Windows.h>
 
+#include "Frustum.h"
 #include "Transform.h"
 
 class Camera
@@ -18,6 +19,7 @@ public:
 	// Getters
 	DirectX::XMFLOAT4X4 GetView() { return viewMatrix; }
 	DirectX::XMFLOAT4X4 GetProjection() { return projMatrix; }
+	const Frustum& GetFrustum() { return frustum; }
 
 	Transform* GetTransform();
 
@@ -25,6 +27,7 @@ private:
 	// Camera matrices
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projMatrix;
+	Frustum frustum; // World space, kept in sync with both matrices
 
 	Transform transform;
 
@@ -0,0 +1,185 @@
+#include "CookedMesh.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "Tangents.h"
+
+#include <fstream>
+#include <string>
+
+// LODs stop once their error would pass this fraction of the
+// mesh's bounding radius - past that they're unrecognizable
+static const float MaxLodError = 0.1f;
+
+CookedMesh::CookedMesh(const char* cookedFile)
+	: file(cookedFile), header(0)
+{
+	if (file.IsOpen() && file.GetSize() >= sizeof(CookedMeshHeader))
+		header = (const CookedMeshHeader*)file.GetData();
+}
+
+
+bool CookedMesh::IsValid(unsigned long long sourceHash, const MeshOptions& options)
+{
+	if (!header ||
+		header->Magic != COOKED_MESH_MAGIC ||
+		header->Version != COOKED_MESH_VERSION ||
+		header->SourceHash != sourceHash ||
+		header->WeldEpsilon != options.WeldEpsilon ||
+		header->Layout != options.Layout ||
+		header->MaxLodCount != options.LodCount ||
+		header->BuildMeshlets != options.BuildMeshlets)
+		return false;
+
+	// The strides need to match what this build expects
+	unsigned int vertexStride = header->Layout == VertexLayout::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+	unsigned int indexStride = header->VertexCount < 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	if (header->VertexStride != vertexStride || header->IndexStride != indexStride)
+		return false;
+
+	// Every LOD has to fit in the index buffer
+	if (header->LodCount == 0 || header->LodCount > MAX_MESH_LODS)
+		return false;
+	for (unsigned int i = 0; i < header->LodCount; i++)
+	{
+		const MeshLod& lod = header->Lods[i];
+		if ((size_t)lod.IndexOffset + lod.IndexCount > header->IndexCount)
+			return false;
+	}
+
+	// Make sure the file wasn't cut short while being written
+	size_t expected =
+		sizeof(CookedMeshHeader) +
+		(size_t)header->VertexCount * header->VertexStride +
+		(size_t)header->IndexCount * header->IndexStride +
+		(size_t)header->MeshletCount * sizeof(Meshlet);
+	return header->VertexCount > 0 && header->IndexCount > 0 && file.GetSize() >= expected;
+}
+
+
+// --------------------------------------------------------
+// Fills in the packed vertices and 16-bit indices (as the
+// header asks for) from the full precision data
+// --------------------------------------------------------
+static void CompressCookedMesh(CookedMeshData& mesh)
+{
+	const CookedMeshHeader& header = mesh.Header;
+
+	mesh.PackedVertices.clear();
+	if (header.Layout == VertexLayout::Packed)
+	{
+		mesh.PackedVertices.resize(mesh.Vertices.size());
+		for (size_t i = 0; i < mesh.Vertices.size(); i++)
+			mesh.PackedVertices[i] = PackVertex(mesh.Vertices[i], header.Bounds);
+	}
+
+	mesh.ShortIndices.clear();
+	if (header.IndexStride == sizeof(unsigned short))
+	{
+		mesh.ShortIndices.resize(mesh.Indices.size());
+		for (size_t i = 0; i < mesh.Indices.size(); i++)
+			mesh.ShortIndices[i] = (unsigned short)mesh.Indices[i];
+	}
+}
+
+
+const void* CookedMeshData::GetVertexData() const
+{
+	if (Header.Layout == VertexLayout::Packed)
+		return PackedVertices.data();
+	return Vertices.data();
+}
+
+
+const void* CookedMeshData::GetIndexData() const
+{
+	if (Header.IndexStride == sizeof(unsigned short))
+		return ShortIndices.data();
+	return Indices.data();
+}
+
+
+bool CookObj(const char* data, size_t size, unsigned long long sourceHash, const MeshOptions& options, CookedMeshData& out)
+{
+	ObjData obj;
+	if (!ParseObj(data, size, obj))
+		return false;
+
+	std::vector<Vertex>& verts = out.Vertices;
+	std::vector<unsigned int>& indices = out.Indices;
+	BuildObjVertices(obj, verts, indices);
+	if (verts.empty())
+		return false;
+	unsigned int cornerCount = (unsigned int)verts.size();
+
+	// Share identical corners, then reorder for the GPU
+	WeldVertices(verts, indices, options.WeldEpsilon);
+	VertexCacheStats sourceCache = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)verts.size());
+	OptimizeMesh(verts, indices);
+
+	// Meshlets regroup the triangles, so the cache stats have to
+	// be measured after them
+	out.Meshlets.clear();
+	if (options.BuildMeshlets)
+		BuildMeshlets(verts, indices, out.Meshlets);
+	VertexCacheStats cache = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)verts.size());
+
+	CalculateTangents(verts.data(), (int)verts.size(), indices.data(), (int)indices.size());
+	MeshBounds bounds = CalculateBounds(verts.data(), verts.size());
+
+	// Simplified index lists go on the end of the original
+	std::vector<MeshLod> lods;
+	GenerateLods(verts, indices, options.LodCount, bounds.Radius * MaxLodError, lods);
+
+	CookedMeshHeader& header = out.Header;
+	header = {};
+	header.Magic = COOKED_MESH_MAGIC;
+	header.Version = COOKED_MESH_VERSION;
+	header.SourceHash = sourceHash;
+	header.WeldEpsilon = options.WeldEpsilon;
+	header.Layout = options.Layout;
+	header.MaxLodCount = options.LodCount;
+	header.BuildMeshlets = options.BuildMeshlets;
+	header.VertexStride = options.Layout == VertexLayout::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+	header.IndexStride = verts.size() < 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+	header.VertexCount = (unsigned int)verts.size();
+	header.IndexCount = (unsigned int)indices.size();
+	header.LodCount = (unsigned int)lods.size();
+	for (size_t i = 0; i < lods.size(); i++)
+		header.Lods[i] = lods[i];
+	header.MeshletCount = (unsigned int)out.Meshlets.size();
+	header.SourceVertexCount = cornerCount;
+	header.SourceACMR = sourceCache.ACMR;
+	header.SourceATVR = sourceCache.ATVR;
+	header.ACMR = cache.ACMR;
+	header.ATVR = cache.ATVR;
+	header.Bounds = bounds;
+
+	CompressCookedMesh(out);
+	return true;
+}
+
+
+bool WriteCookedMesh(const char* cookedFile, const CookedMeshData& mesh)
+{
+	std::ofstream out(cookedFile, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	out.write((const char*)&mesh.Header, sizeof(CookedMeshHeader));
+	out.write((const char*)mesh.GetVertexData(), (size_t)mesh.Header.VertexStride * mesh.Header.VertexCount);
+	out.write((const char*)mesh.GetIndexData(), (size_t)mesh.Header.IndexStride * mesh.Header.IndexCount);
+	out.write((const char*)mesh.Meshlets.data(), sizeof(Meshlet) * mesh.Meshlets.size());
+	return out.good();
+}
+
+
+std::string GetCookedMeshPath(const char* objFile)
+{
+	// Swap the extension, if there is one, for .mesh
+	std::string path = objFile;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path.erase(dot);
+	return path + ".mesh";
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Bounds.h"
+#include "MappedFile.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "PackedVertex.h"
+#include "Vertex.h"
+
+// "MESH" when viewed in a hex editor
+#define COOKED_MESH_MAGIC 0x4853454D
+
+// Bump this whenever the layout or the cook steps change, so
+// old files get re-cooked instead of loaded
+#define COOKED_MESH_VERSION 5
+
+// --------------------------------------------------------
+// Settings for turning a source file into a mesh.  These are
+// saved in the cooked file, and changing them forces a re-cook.
+// --------------------------------------------------------
+struct MeshOptions
+{
+	float WeldEpsilon = 0.0f;					// See WeldVertices()
+	VertexLayout Layout = VertexLayout::Full;	// What gets uploaded to the GPU
+	unsigned int LodCount = 1;					// Most detail levels to generate, including the original (up to MAX_MESH_LODS)
+	bool BuildMeshlets = false;					// Split the full detail level into meshlets for culling
+};
+
+// --------------------------------------------------------
+// The start of a cooked mesh file.  The vertices (already
+// welded, reordered and with tangents, in the requested
+// layout) follow immediately, then the indices of every LOD
+// back to back, then the meshlets of the full detail level.
+// Indices are 16-bit whenever there are fewer than 65536
+// vertices.
+// --------------------------------------------------------
+struct CookedMeshHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned long long SourceHash;		// HashBytes() of the source .obj
+	float WeldEpsilon;					// Cook settings the file was made with
+	VertexLayout Layout;
+	unsigned int MaxLodCount;
+	bool BuildMeshlets;
+	unsigned int VertexStride;			// sizeof(Vertex) or sizeof(PackedVertex) when cooked
+	unsigned int IndexStride;			// 2 or 4
+	unsigned int VertexCount;
+	unsigned int IndexCount;			// All LODs together
+
+	// Simplified versions of the mesh, lods[0] being the original
+	unsigned int LodCount;
+	MeshLod Lods[MAX_MESH_LODS];
+
+	unsigned int MeshletCount;
+
+	// Stats from cooking, so they don't need recalculating
+	unsigned int SourceVertexCount;
+	float SourceACMR;
+	float SourceATVR;
+	float ACMR;
+	float ATVR;
+
+	MeshBounds Bounds;
+};
+
+// --------------------------------------------------------
+// A cooked mesh that's still in memory.  The full precision
+// vertices and 32-bit indices are always filled in; the
+// packed/16-bit versions only when the header says so.
+// --------------------------------------------------------
+struct CookedMeshData
+{
+	CookedMeshHeader Header;
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	std::vector<PackedVertex> PackedVertices;
+	std::vector<unsigned short> ShortIndices;
+	std::vector<Meshlet> Meshlets;
+
+	// What actually goes in the file and the GPU buffers
+	const void* GetVertexData() const;
+	const void* GetIndexData() const;
+};
+
+// --------------------------------------------------------
+// A memory-mapped cooked mesh file.  The vertex and index
+// pointers point straight into the mapped view, so they're
+// only valid while this object is alive.
+// --------------------------------------------------------
+class CookedMesh
+{
+public:
+	CookedMesh(const char* cookedFile);
+
+	// True if the file exists, is complete and was cooked by
+	// this version of the code from the given source and settings
+	bool IsValid(unsigned long long sourceHash, const MeshOptions& options);
+
+	const CookedMeshHeader* GetHeader() { return header; }
+	const void* GetVertexData() { return header + 1; }
+	const void* GetIndexData() { return (const char*)GetVertexData() + (size_t)header->VertexCount * header->VertexStride; }
+
+	// Not necessarily aligned, so copy these out with memcpy
+	const void* GetMeshletData() { return (const char*)GetIndexData() + (size_t)header->IndexCount * header->IndexStride; }
+
+private:
+	MappedFile file;
+	const CookedMeshHeader* header;
+};
+
+// Runs the whole OBJ pipeline (parse, weld, reorder, meshlets,
+// tangents, bounds, LODs) on an already loaded file
+bool CookObj(const char* data, size_t size, unsigned long long sourceHash, const MeshOptions& options, CookedMeshData& out);
+
+// Saves a cooked mesh so it can be loaded with CookedMesh
+bool WriteCookedMesh(const char* cookedFile, const CookedMeshData& mesh);
+
+// The cooked file that goes with a given .obj file
+std::string GetCookedMeshPath(const char* objFile);
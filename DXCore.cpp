@@ -62,6 +62,16 @@ DXCore::DXCore(
 	this->startTime = 0;
 	this->totalTime = 0;
 
+	this->stepTime = 0;
+	this->maxStepsPerFrame = 1;
+	this->stepAccumulator = 0;
+	this->stepCount = 0;
+	this->stepBaseTime = 0;
+	this->simulationTime = 0;
+	this->interpolationAlpha = 1.0f;
+	this->stepsLastFrame = 0;
+	this->droppedSteps = 0;
+
 	// Query performance counter for accurate timing information
 	__int64 perfFreq = 0;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
@@ -411,6 +421,7 @@ HRESULT DXCore::Run()
 			Input::GetInstance().Update();
 
 			// The game loop
+			UpdateSimulation();
 			Update(deltaTime, totalTime);
 			Draw(deltaTime, totalTime);
 
@@ -459,6 +470,62 @@ void DXCore::UpdateTimer()
 }
 
 
+// --------------------------------------------------------
+// Switches between fixed and per-frame simulation steps
+// --------------------------------------------------------
+void DXCore::SetFixedTimestep(float ticksPerSecond, unsigned int maxStepsPerFrame)
+{
+	this->stepTime = ticksPerSecond > 0 ? 1.0f / ticksPerSecond : 0.0f;
+	this->maxStepsPerFrame = max(maxStepsPerFrame, 1u);
+
+	// Carry on from wherever the simulation is now
+	stepAccumulator = 0;
+	stepCount = 0;
+	stepBaseTime = simulationTime;
+}
+
+
+// --------------------------------------------------------
+// Adds this frame's time to the accumulator and runs a
+// FixedUpdate() for every whole step in it, up to the cap
+// --------------------------------------------------------
+void DXCore::UpdateSimulation()
+{
+	// One step per frame, however long it was
+	if (stepTime <= 0)
+	{
+		simulationTime = totalTime;
+		FixedUpdate(deltaTime, simulationTime);
+		stepsLastFrame = 1;
+		interpolationAlpha = 1.0f;
+		return;
+	}
+
+	stepAccumulator += deltaTime;
+	stepsLastFrame = 0;
+	while (stepAccumulator >= stepTime && stepsLastFrame < maxStepsPerFrame)
+	{
+		// Counting steps rather than adding up times keeps the
+		// clock the same run to run, whatever the frame rate
+		stepCount++;
+		simulationTime = stepBaseTime + (float)(stepCount * (double)stepTime);
+		FixedUpdate(stepTime, simulationTime);
+		stepAccumulator -= stepTime;
+		stepsLastFrame++;
+	}
+
+	// Still behind after as many steps as we'll do in one frame,
+	// so let the simulation fall behind the clock instead
+	if (stepAccumulator >= stepTime)
+	{
+		unsigned int dropped = (unsigned int)(stepAccumulator / stepTime);
+		droppedSteps += dropped;
+		stepAccumulator -= dropped * (double)stepTime;
+	}
+	interpolationAlpha = (float)(stepAccumulator / stepTime);
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
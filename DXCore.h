@@ -44,6 +44,12 @@ public:
 	virtual void Update(float deltaTime, float totalTime) = 0;
 	virtual void Draw(float deltaTime, float totalTime) = 0;
 
+	// Moves the simulation along by one step, before each frame's
+	// Update().  With a fixed timestep (see SetFixedTimestep())
+	// that's as many steps of the same length as the time passed
+	// calls for, otherwise one step as long as the frame.
+	virtual void FixedUpdate(float stepTime, float simulationTime) { }
+
 protected:
 	HINSTANCE	hInstance;		// The handle to the application
 	HWND		hWnd;			// The handle to the window itself
@@ -77,6 +83,22 @@ protected:
 	std::string GetFullPathTo(std::string relativeFilePath);
 	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
 
+	// Runs FixedUpdate() this many times per simulated second, doing
+	// at most maxStepsPerFrame steps to catch up after a slow frame
+	// (anything past that is dropped, so a heavy frame can't make
+	// the next one heavier still).  0 goes back to one step per
+	// frame.
+	void SetFixedTimestep(float ticksPerSecond, unsigned int maxStepsPerFrame = 5);
+
+	// Simulation timing.  The alpha is how far this frame is from
+	// the second-to-last step (0) to the last one (1), for blending
+	// what gets drawn between them.
+	float GetStepTime() { return stepTime; }
+	float GetSimulationTime() { return simulationTime; }
+	float GetInterpolationAlpha() { return interpolationAlpha; }
+	unsigned int GetStepsLastFrame() { return stepsLastFrame; }
+	unsigned int GetDroppedSteps() { return droppedSteps; }
+
 
 private:
 	// Timing related data
@@ -91,7 +113,19 @@ private:
 	int fpsFrameCount;
 	float fpsTimeElapsed;
 
+	// Fixed timestep simulation (stepTime of 0 when it's off)
+	float stepTime;
+	unsigned int maxStepsPerFrame;
+	double stepAccumulator;
+	unsigned long long stepCount;	// Since fixed steps were turned on
+	float stepBaseTime;				// Simulation time when they were
+	float simulationTime;
+	float interpolationAlpha;
+	unsigned int stepsLastFrame;
+	unsigned int droppedSteps;
+
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+	void UpdateSimulation();	// Runs this frame's simulation steps
 };
 
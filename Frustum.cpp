@@ -0,0 +1,61 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+Frustum CreateFrustum(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	// With row vectors, each clip space coordinate is a point
+	// dotted with one column of the matrix.  D3D clips to
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	XMVECTOR x = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR y = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR z = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR w = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMVECTOR planes[6] =
+	{
+		w + x,	// Left
+		w - x,	// Right
+		w + y,	// Bottom
+		w - y,	// Top
+		z,		// Near
+		w - z	// Far
+	};
+
+	// Normalized, so plane tests give real distances
+	Frustum frustum;
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+	return frustum;
+}
+
+
+bool SphereInFrustum(const Frustum& frustum, const XMFLOAT3& center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& p = frustum.Planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+
+bool BoxInFrustum(const Frustum& frustum, const XMFLOAT3& center, const XMFLOAT3& halfExtent)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// How far the box reaches towards the plane's normal
+		const XMFLOAT4& p = frustum.Planes[i];
+		float reach = fabsf(p.x) * halfExtent.x + fabsf(p.y) * halfExtent.y + fabsf(p.z) * halfExtent.z;
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -reach)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// A view frustum as six planes (left, right, bottom, top,
+// near, far) with their normals pointing inward, so a point
+// is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];
+};
+
+// Pulls the planes out of a view and projection matrix
+// (Gribb & Hartmann), giving them in world space
+Frustum CreateFrustum(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+// True if any part of the sphere could be inside the frustum
+bool SphereInFrustum(const Frustum& frustum, const DirectX::XMFLOAT3& center, float radius);
+
+// True if any part of the axis-aligned box (given by its center
+// and half its size along each axis) could be inside the frustum
+bool BoxInFrustum(const Frustum& frustum, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfExtent);
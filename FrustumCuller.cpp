@@ -0,0 +1,137 @@
+#include "FrustumCuller.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+using namespace DirectX;
+
+FrustumCuller::FrustumCuller()
+	: count(0)
+{
+}
+
+
+void FrustumCuller::Clear()
+{
+	count = 0;
+}
+
+
+unsigned int FrustumCuller::AddBounds(const MeshBounds& bounds, const XMFLOAT4X4& world)
+{
+	// Grow a whole group at a time, so the padding is always there
+	if (count == centerX.size())
+	{
+		size_t size = centerX.size() + LaneCount;
+		centerX.resize(size, 0.0f);
+		centerY.resize(size, 0.0f);
+		centerZ.resize(size, 0.0f);
+		radius.resize(size, 0.0f);
+		halfExtentX.resize(size, 0.0f);
+		halfExtentY.resize(size, 0.0f);
+		halfExtentZ.resize(size, 0.0f);
+	}
+
+	// Both shapes share the box's center
+	XMFLOAT3 center;
+	XMMATRIX m = XMLoadFloat4x4(&world);
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&bounds.Center), m));
+
+	// The world-space box around the transformed box: each axis
+	// reaches as far as all three of the old axes do along it
+	XMFLOAT3 half(
+		(bounds.Max.x - bounds.Min.x) * 0.5f,
+		(bounds.Max.y - bounds.Min.y) * 0.5f,
+		(bounds.Max.z - bounds.Min.z) * 0.5f);
+	XMFLOAT3 worldHalf(
+		fabsf(world._11) * half.x + fabsf(world._21) * half.y + fabsf(world._31) * half.z,
+		fabsf(world._12) * half.x + fabsf(world._22) * half.y + fabsf(world._32) * half.z,
+		fabsf(world._13) * half.x + fabsf(world._23) * half.y + fabsf(world._33) * half.z);
+
+	// The sphere grows with the largest scale
+	float scaleSq = std::max(
+		XMVectorGetX(XMVector3LengthSq(m.r[0])),
+		std::max(XMVectorGetX(XMVector3LengthSq(m.r[1])), XMVectorGetX(XMVector3LengthSq(m.r[2]))));
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	radius[count] = bounds.Radius * sqrtf(scaleSq);
+	halfExtentX[count] = worldHalf.x;
+	halfExtentY[count] = worldHalf.y;
+	halfExtentZ[count] = worldHalf.z;
+	return count++;
+}
+
+
+void FrustumCuller::GetBox(unsigned int index, XMFLOAT3& center, XMFLOAT3& halfExtent) const
+{
+	center = XMFLOAT3(centerX[index], centerY[index], centerZ[index]);
+	halfExtent = XMFLOAT3(halfExtentX[index], halfExtentY[index], halfExtentZ[index]);
+}
+
+
+void FrustumCuller::GetSphere(unsigned int index, XMFLOAT3& center, float& radius) const
+{
+	center = XMFLOAT3(centerX[index], centerY[index], centerZ[index]);
+	radius = this->radius[index];
+}
+
+
+unsigned int FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	visible.reserve(count);
+	if (count == 0)
+		return 0;
+
+	// Each plane, and the absolute value of its normal for the
+	// box test, one component per register
+	Lanes planeX[6], planeY[6], planeZ[6], planeW[6];
+	Lanes absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = frustum.Planes[p];
+		planeX[p] = Splat(plane.x);
+		planeY[p] = Splat(plane.y);
+		planeZ[p] = Splat(plane.z);
+		planeW[p] = Splat(plane.w);
+		absX[p] = Splat(fabsf(plane.x));
+		absY[p] = Splat(fabsf(plane.y));
+		absZ[p] = Splat(fabsf(plane.z));
+	}
+
+	for (size_t g = 0; g < count; g += LaneCount)
+	{
+		Lanes cx = Load(&centerX[g]);
+		Lanes cy = Load(&centerY[g]);
+		Lanes cz = Load(&centerZ[g]);
+		Lanes r = Load(&radius[g]);
+		Lanes hx = Load(&halfExtentX[g]);
+		Lanes hy = Load(&halfExtentY[g]);
+		Lanes hz = Load(&halfExtentZ[g]);
+
+		// Outside if the center is further behind any plane than
+		// the nearer of the sphere and box reaches towards it
+		Lanes outside = Zero();
+		for (int p = 0; p < 6; p++)
+		{
+			Lanes distance = Add(Add(Add(Mul(planeX[p], cx), Mul(planeY[p], cy)), Mul(planeZ[p], cz)), planeW[p]);
+			Lanes reach = Add(Add(Mul(absX[p], hx), Mul(absY[p], hy)), Mul(absZ[p], hz));
+			reach = Min(reach, r);
+			outside = Or(outside, Less(distance, Sub(Zero(), reach)));
+		}
+
+		unsigned int inside = ~Mask(outside);
+		size_t lanes = std::min(LaneCount, count - g);
+		for (size_t lane = 0; lane < lanes; lane++)
+		{
+			if (inside & (1u << lane))
+				visible.push_back((unsigned int)(g + lane));
+		}
+	}
+
+	return (unsigned int)visible.size();
+}
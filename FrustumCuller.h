@@ -0,0 +1,54 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// World-space bounds of lots of objects, tested against a
+// frustum all at once.
+//
+// Each object gets a sphere and a box (both centered on the
+// middle of its mesh's box), stored one array per component
+// so Cull() can test a whole SIMD register's worth of objects
+// against each plane at a time (8 with AVX2, 4 otherwise).
+// An object is culled if either shape is fully outside any
+// plane, so long thin things get the box and rotated ones
+// still have the sphere to fall back on.
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Forgets every object, keeping the memory for next time
+	void Clear();
+
+	// Adds an object with the given mesh bounds and world matrix,
+	// returning its index (objects are numbered from 0 in the
+	// order they were added)
+	unsigned int AddBounds(const MeshBounds& bounds, const DirectX::XMFLOAT4X4& world);
+
+	// Fills visible with the index of every object that could be
+	// inside the frustum, in order, returning how many there were
+	unsigned int Cull(const Frustum& frustum, std::vector<unsigned int>& visible);
+
+	// World-space box of an object, as tested by Cull()
+	void GetBox(unsigned int index, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& halfExtent) const;
+
+	// World-space bounding sphere of an object
+	void GetSphere(unsigned int index, DirectX::XMFLOAT3& center, float& radius) const;
+
+	unsigned int GetCount() const { return count; }
+
+private:
+	// Bounds by index.  Each array is padded out to a whole number
+	// of SIMD groups, and anything past count is ignored.
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> radius;
+	std::vector<float> halfExtentX, halfExtentY, halfExtentZ;
+
+	unsigned int count;
+};
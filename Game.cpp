@@ -5,27 +5,27 @@
 #include "Game.h"
 #include "Vertex.h"
 #include "Input.h"
-
-#include "WICTextureLoader.h"
+#include "Benchmarks.h"
 
 #include "ImGUI/imgui.h"
 #include "ImGUI/imgui_impl_dx11.h"
 #include "ImGUI/imgui_impl_win32.h"
 
-
-// Needed for a helper function to read compiled shader files from the hard drive
-#pragma comment(lib, "d3dcompiler.lib")
-#include <d3dcompiler.h>
-
 // For the DirectX Math library
 using namespace DirectX;
 
+// Uncomment to run the CPU benchmarks during Init() - results are
+// printed to the console, so use an optimized (Release) build
+//#define RUN_BENCHMARKS
+
 // Helper macro for getting a float between min and max
 #define RandomRange(min, max) (float)rand() / RAND_MAX * (max - min) + min
 
-// Helper macros for making texture and shader loading code more succinct
-#define LoadTexture(file, srv) CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(file).c_str(), 0, srv.GetAddressOf())
-#define LoadShader(type, file) std::make_shared<type>(device.Get(), context.Get(), GetFullPathTo_Wide(file).c_str())
+// Helper macros for making texture and shader loading code more succinct.
+// Everything goes through the asset registry, so nothing is loaded twice.
+#define LoadTexture(file, srv) srv = assets->LoadTexture(GetFullPathTo(file))
+#define LoadVS(file) assets->LoadVertexShader(GetFullPathTo(file))
+#define LoadPS(file) assets->LoadPixelShader(GetFullPathTo(file))
 
 
 // --------------------------------------------------------
@@ -48,13 +48,20 @@ Game::Game(HINSTANCE hInstance)
 	sky(0),
 	spriteBatch(0),
 	lightCount(0),
+	movingNode(InvalidSceneNode),
+	orbitNode(InvalidSceneNode),
 	arial(0)
 {
 	// Seed random
 	srand((unsigned int)time(0));
 
-#if defined(DEBUG) || defined(_DEBUG)
+	// Everything that moves on its own does so 60 times a second,
+	// however fast we're drawing
+	SetFixedTimestep(60.0f, 5);
+
+#if defined(DEBUG) || defined(_DEBUG) || defined(RUN_BENCHMARKS)
 	// Do we want a console window?  Probably only in debug mode
+	// (or when benchmarking, since that's where results go)
 	CreateConsoleWindow(500, 120, 32, 120);
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
@@ -87,6 +94,10 @@ void Game::Init()
 {
 	// Asset loading and entity creation
 	LoadAssetsAndCreateEntities();
+
+#if defined(RUN_BENCHMARKS)
+	RunBenchmarks(GetFullPathTo("../../Assets/Models/"));
+#endif
 	
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
@@ -95,6 +106,7 @@ void Game::Init()
 
 	// Set up lights initially
 	lightCount = 0;
+	shadowPreviewCascade = 0;
 	GenerateLights();
 
 	// Make our camera
@@ -124,37 +136,64 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadAssetsAndCreateEntities()
 {
-	// Load shaders using our succinct LoadShader() macro
-	std::shared_ptr<SimpleVertexShader> vertexShader	= LoadShader(SimpleVertexShader, L"VertexShader.cso");
-	std::shared_ptr<SimplePixelShader> pixelShader		= LoadShader(SimplePixelShader, L"PixelShader.cso");
-	std::shared_ptr<SimplePixelShader> pixelShaderPBR	= LoadShader(SimplePixelShader, L"PixelShaderPBR.cso");
-	std::shared_ptr<SimplePixelShader> solidColorPS		= LoadShader(SimplePixelShader, L"SolidColorPS.cso");
+	// Everything is loaded through the registry, and the meshes all
+	// share one set of buffers
+	meshPool = std::make_shared<MeshPool>(device, context);
+	assets = std::make_shared<AssetRegistry>(device, context, meshPool);
+
+	// Load shaders using our succinct LoadVS() and LoadPS() macros
+	std::shared_ptr<SimpleVertexShader> vertexShader	= LoadVS("VertexShader.cso");
+	std::shared_ptr<SimplePixelShader> pixelShader		= LoadPS("PixelShader.cso");
+	std::shared_ptr<SimplePixelShader> pixelShaderPBR	= LoadPS("PixelShaderPBR.cso");
+	std::shared_ptr<SimplePixelShader> solidColorPS		= LoadPS("SolidColorPS.cso");
 	
-	std::shared_ptr<SimpleVertexShader> skyVS = LoadShader(SimpleVertexShader, L"SkyVS.cso");
-	std::shared_ptr<SimplePixelShader> skyPS  = LoadShader(SimplePixelShader, L"SkyPS.cso");
+	std::shared_ptr<SimpleVertexShader> skyVS = LoadVS("SkyVS.cso");
+	std::shared_ptr<SimplePixelShader> skyPS  = LoadPS("SkyPS.cso");
 	
-	std::shared_ptr<SimpleVertexShader> fullscreenVS = LoadShader(SimpleVertexShader, L"FullscreenVS.cso");
-	std::shared_ptr<SimplePixelShader> simpleTexturePS = LoadShader(SimplePixelShader, L"SimpleTexturePS.cso");
-	std::shared_ptr<SimplePixelShader> IBLIrradianceMapPS = LoadShader(SimplePixelShader, L"IBLIrradianceMapPS.cso");
-	std::shared_ptr<SimplePixelShader> IBLSpecularConvolutionPS = LoadShader(SimplePixelShader, L"IBLSpecularConvolutionPS.cso");
-	std::shared_ptr<SimplePixelShader> IBLBrdfLookUpTablePS = LoadShader(SimplePixelShader, L"IBLBrdfLookUpTablePS.cso");
+	std::shared_ptr<SimpleVertexShader> fullscreenVS = LoadVS("FullscreenVS.cso");
+	std::shared_ptr<SimplePixelShader> simpleTexturePS = LoadPS("SimpleTexturePS.cso");
+	std::shared_ptr<SimplePixelShader> IBLIrradianceMapPS = LoadPS("IBLIrradianceMapPS.cso");
+	std::shared_ptr<SimplePixelShader> IBLSpecularConvolutionPS = LoadPS("IBLSpecularConvolutionPS.cso");
+	std::shared_ptr<SimplePixelShader> IBLBrdfLookUpTablePS = LoadPS("IBLBrdfLookUpTablePS.cso");
+
+	std::shared_ptr<SimplePixelShader> RefractionPS = LoadPS("RefractionPS.cso");
 
-	std::shared_ptr<SimplePixelShader> RefractionPS = LoadShader(SimplePixelShader, L"RefractionPS.cso");
+	std::shared_ptr<SimpleVertexShader> particleVS = LoadVS("ParticleVS.cso");
+	std::shared_ptr<SimplePixelShader> particlePS = LoadPS("ParticlePS.cso");
 
-	std::shared_ptr<SimpleVertexShader> particleVS = LoadShader(SimpleVertexShader, L"ParticleVS.cso");
-	std::shared_ptr<SimplePixelShader> particlePS = LoadShader(SimplePixelShader, L"ParticlePS.cso");
+	std::shared_ptr<SimpleVertexShader> shadowVS = LoadVS("ShadowVS.cso");
+	std::shared_ptr<SimplePixelShader> shadowCacheCopyPS = LoadPS("ShadowCacheCopyPS.cso");
 
-	std::shared_ptr<SimpleVertexShader> shadowVS = LoadShader(SimpleVertexShader, L"ShadowVS.cso");
+	// Instanced versions read world matrices from a second vertex
+	// buffer (their *_PER_INSTANCE inputs get slot 1 on reflection)
+	std::shared_ptr<SimpleVertexShader> vertexShaderInstanced = LoadVS("VertexShaderInstanced.cso");
+	std::shared_ptr<SimpleVertexShader> shadowVSInstanced = LoadVS("ShadowVSInstanced.cso");
+
+	// Shaders that read PackedVertex data need a hand-made input layout
+	std::shared_ptr<SimpleVertexShader> vertexShaderPacked = assets->LoadVertexShader(GetFullPathTo("VertexShaderPacked.cso"), VertexLayout::Packed);
+	std::shared_ptr<SimpleVertexShader> shadowVSPacked = assets->LoadVertexShader(GetFullPathTo("ShadowVSPacked.cso"), VertexLayout::Packed);
 
 	// Set up the sprite batch and load the sprite font
 	spriteBatch = std::make_shared<SpriteBatch>(context.Get());
 	arial = std::make_shared<SpriteFont>(device.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/arial.spritefont").c_str());
 
 	// Make the meshes
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/sphere.obj").c_str(), device);
-	std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/helix.obj").c_str(), device);
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cube.obj").c_str(), device);
-	std::shared_ptr<Mesh> coneMesh = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cone.obj").c_str(), device);
+	// The curved meshes get simplified LODs for when they're far away
+	// and meshlets so the parts facing away can be skipped up close
+	MeshOptions lodOptions;
+	lodOptions.LodCount = 4;
+	lodOptions.BuildMeshlets = true;
+	std::shared_ptr<Mesh> sphereMesh = assets->LoadMesh(GetFullPathTo("../../Assets/Models/sphere.obj"), lodOptions);
+	// The helix is our densest mesh, so it uses the compact vertex format
+	MeshOptions packedOptions = lodOptions;
+	packedOptions.Layout = VertexLayout::Packed;
+	std::shared_ptr<Mesh> helixMesh = assets->LoadMesh(GetFullPathTo("../../Assets/Models/helix.obj"), packedOptions);
+	std::shared_ptr<Mesh> cubeMesh = assets->LoadMesh(GetFullPathTo("../../Assets/Models/cube.obj"));
+	std::shared_ptr<Mesh> coneMesh = assets->LoadMesh(GetFullPathTo("../../Assets/Models/cone.obj"));
+	meshes.push_back(sphereMesh);
+	meshes.push_back(helixMesh);
+	meshes.push_back(cubeMesh);
+	meshes.push_back(coneMesh);
 	
 	// Declare the textures we'll need
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleA,  cobbleN,  cobbleR,  cobbleM;
@@ -169,44 +208,44 @@ void Game::LoadAssetsAndCreateEntities()
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> testParticle1, testParticle2, testParticle3;
 
 	// Load the textures using our succinct LoadTexture() macro
-	LoadTexture(L"../../Assets/Textures/cobblestone_albedo.png", cobbleA);
-	LoadTexture(L"../../Assets/Textures/cobblestone_normals.png", cobbleN);
-	LoadTexture(L"../../Assets/Textures/cobblestone_roughness.png", cobbleR);
-	LoadTexture(L"../../Assets/Textures/cobblestone_metal.png", cobbleM);
-
-	LoadTexture(L"../../Assets/Textures/floor_albedo.png", floorA);
-	LoadTexture(L"../../Assets/Textures/floor_normals.png", floorN);
-	LoadTexture(L"../../Assets/Textures/floor_roughness.png", floorR);
-	LoadTexture(L"../../Assets/Textures/floor_metal.png", floorM);
+	LoadTexture("../../Assets/Textures/cobblestone_albedo.png", cobbleA);
+	LoadTexture("../../Assets/Textures/cobblestone_normals.png", cobbleN);
+	LoadTexture("../../Assets/Textures/cobblestone_roughness.png", cobbleR);
+	LoadTexture("../../Assets/Textures/cobblestone_metal.png", cobbleM);
+
+	LoadTexture("../../Assets/Textures/floor_albedo.png", floorA);
+	LoadTexture("../../Assets/Textures/floor_normals.png", floorN);
+	LoadTexture("../../Assets/Textures/floor_roughness.png", floorR);
+	LoadTexture("../../Assets/Textures/floor_metal.png", floorM);
 	
-	LoadTexture(L"../../Assets/Textures/paint_albedo.png", paintA);
-	LoadTexture(L"../../Assets/Textures/paint_normals.png", paintN);
-	LoadTexture(L"../../Assets/Textures/paint_roughness.png", paintR);
-	LoadTexture(L"../../Assets/Textures/paint_metal.png", paintM);
+	LoadTexture("../../Assets/Textures/paint_albedo.png", paintA);
+	LoadTexture("../../Assets/Textures/paint_normals.png", paintN);
+	LoadTexture("../../Assets/Textures/paint_roughness.png", paintR);
+	LoadTexture("../../Assets/Textures/paint_metal.png", paintM);
 	
-	LoadTexture(L"../../Assets/Textures/scratched_albedo.png", scratchedA);
-	LoadTexture(L"../../Assets/Textures/scratched_normals.png", scratchedN);
-	LoadTexture(L"../../Assets/Textures/scratched_roughness.png", scratchedR);
-	LoadTexture(L"../../Assets/Textures/scratched_metal.png", scratchedM);
+	LoadTexture("../../Assets/Textures/scratched_albedo.png", scratchedA);
+	LoadTexture("../../Assets/Textures/scratched_normals.png", scratchedN);
+	LoadTexture("../../Assets/Textures/scratched_roughness.png", scratchedR);
+	LoadTexture("../../Assets/Textures/scratched_metal.png", scratchedM);
 	
-	LoadTexture(L"../../Assets/Textures/bronze_albedo.png", bronzeA);
-	LoadTexture(L"../../Assets/Textures/bronze_normals.png", bronzeN);
-	LoadTexture(L"../../Assets/Textures/bronze_roughness.png", bronzeR);
-	LoadTexture(L"../../Assets/Textures/bronze_metal.png", bronzeM);
+	LoadTexture("../../Assets/Textures/bronze_albedo.png", bronzeA);
+	LoadTexture("../../Assets/Textures/bronze_normals.png", bronzeN);
+	LoadTexture("../../Assets/Textures/bronze_roughness.png", bronzeR);
+	LoadTexture("../../Assets/Textures/bronze_metal.png", bronzeM);
 	
-	LoadTexture(L"../../Assets/Textures/rough_albedo.png", roughA);
-	LoadTexture(L"../../Assets/Textures/rough_normals.png", roughN);
-	LoadTexture(L"../../Assets/Textures/rough_roughness.png", roughR);
-	LoadTexture(L"../../Assets/Textures/rough_metal.png", roughM);
+	LoadTexture("../../Assets/Textures/rough_albedo.png", roughA);
+	LoadTexture("../../Assets/Textures/rough_normals.png", roughN);
+	LoadTexture("../../Assets/Textures/rough_roughness.png", roughR);
+	LoadTexture("../../Assets/Textures/rough_metal.png", roughM);
 	
-	LoadTexture(L"../../Assets/Textures/wood_albedo.png", woodA);
-	LoadTexture(L"../../Assets/Textures/wood_normals.png", woodN);
-	LoadTexture(L"../../Assets/Textures/wood_roughness.png", woodR);
-	LoadTexture(L"../../Assets/Textures/wood_metal.png", woodM);
+	LoadTexture("../../Assets/Textures/wood_albedo.png", woodA);
+	LoadTexture("../../Assets/Textures/wood_normals.png", woodN);
+	LoadTexture("../../Assets/Textures/wood_roughness.png", woodR);
+	LoadTexture("../../Assets/Textures/wood_metal.png", woodM);
 
-	LoadTexture(L"../../Assets/Particles/transparent/symbol_01.png", testParticle1);
-	LoadTexture(L"../../Assets/Particles/transparent/fire_01.png", testParticle2);
-	LoadTexture(L"../../Assets/Particles/transparent/star_08.png", testParticle3);
+	LoadTexture("../../Assets/Particles/transparent/symbol_01.png", testParticle1);
+	LoadTexture("../../Assets/Particles/transparent/fire_01.png", testParticle2);
+	LoadTexture("../../Assets/Particles/transparent/star_08.png", testParticle3);
 
 	// Describe and create our sampler state
 	D3D11_SAMPLER_DESC sampDesc = {};
@@ -382,33 +421,58 @@ void Game::LoadAssetsAndCreateEntities()
 	cobbleMat2xRefract->AddTextureSRV("MetalMap", cobbleM);
 
 	// === Create the PBR entities =====================================
-	std::shared_ptr<GameEntity> cobSpherePBR = std::make_shared<GameEntity>(sphereMesh, cobbleMat2xPBR);
-	cobSpherePBR->GetTransform()->SetPosition(-6, 0, 0);
+	transforms = std::make_shared<TransformSystem>();
+
+	std::shared_ptr<GameEntity> cobSpherePBR = std::make_shared<GameEntity>(sphereMesh, cobbleMat2xPBR, transforms);
+	cobSpherePBR->GetTransform().SetPosition(-6, 0, 0);
+
+	std::shared_ptr<GameEntity> floorSpherePBR = std::make_shared<GameEntity>(sphereMesh, floorMatPBR, transforms);
+	floorSpherePBR->GetTransform().SetPosition(-4, 0, 0);
+
+	std::shared_ptr<GameEntity> paintSpherePBR = std::make_shared<GameEntity>(sphereMesh, paintMatPBR, transforms);
+	paintSpherePBR->GetTransform().SetPosition(-2, 0, 0);
 
-	std::shared_ptr<GameEntity> floorSpherePBR = std::make_shared<GameEntity>(sphereMesh, floorMatPBR);
-	floorSpherePBR->GetTransform()->SetPosition(-4, 0, 0);
+	std::shared_ptr<GameEntity> scratchSpherePBR = std::make_shared<GameEntity>(sphereMesh, scratchedMatPBR, transforms);
+	scratchSpherePBR->GetTransform().SetPosition(0, 0, 0);
 
-	std::shared_ptr<GameEntity> paintSpherePBR = std::make_shared<GameEntity>(sphereMesh, paintMatPBR);
-	paintSpherePBR->GetTransform()->SetPosition(-2, 0, 0);
+	std::shared_ptr<GameEntity> bronzeSpherePBR = std::make_shared<GameEntity>(sphereMesh, bronzeMatPBR, transforms);
+	bronzeSpherePBR->GetTransform().SetPosition(2, 0, 0);
 
-	std::shared_ptr<GameEntity> scratchSpherePBR = std::make_shared<GameEntity>(sphereMesh, scratchedMatPBR);
-	scratchSpherePBR->GetTransform()->SetPosition(0, 0, 0);
+	std::shared_ptr<GameEntity> roughSpherePBR = std::make_shared<GameEntity>(sphereMesh, roughMatPBR, transforms);
+	roughSpherePBR->GetTransform().SetPosition(4, 0, 0);
 
-	std::shared_ptr<GameEntity> bronzeSpherePBR = std::make_shared<GameEntity>(sphereMesh, bronzeMatPBR);
-	bronzeSpherePBR->GetTransform()->SetPosition(2, 0, 0);
+	std::shared_ptr<GameEntity> woodSpherePBR = std::make_shared<GameEntity>(sphereMesh, woodMatPBR, transforms);
+	woodSpherePBR->GetTransform().SetPosition(6, 0, 0);
 
-	std::shared_ptr<GameEntity> roughSpherePBR = std::make_shared<GameEntity>(sphereMesh, roughMatPBR);
-	roughSpherePBR->GetTransform()->SetPosition(4, 0, 0);
+	std::shared_ptr<GameEntity> woodBackground = std::make_shared<GameEntity>(cubeMesh, woodMatPBR, transforms);
+	woodBackground->GetTransform().SetPosition(0, 0, 3);
+	woodBackground->GetTransform().SetScale(20, 10, 1);
 
-	std::shared_ptr<GameEntity> woodSpherePBR = std::make_shared<GameEntity>(sphereMesh, woodMatPBR);
-	woodSpherePBR->GetTransform()->SetPosition(6, 0, 0);
+	// It's a solid box, so its bounds can hide things for it
+	woodBackground->SetOccluder(std::make_shared<OccluderMesh>(CreateBoxOccluder(cubeMesh->GetBounds())));
 
-	std::shared_ptr<GameEntity> woodBackground = std::make_shared<GameEntity>(cubeMesh, woodMatPBR);
-	woodBackground->GetTransform()->SetPosition(0, 0, 3);
-	woodBackground->GetTransform()->SetScale(20, 10, 1);
+	// The moving helix lives in the scene graph, with a pair of
+	// cones orbiting it that follow it around without any help
+	scene = std::make_shared<SceneGraph>();
+	movingNode = scene->CreateNode();
+	scene->SetPosition(movingNode, 0, 0, -3);
+	orbitNode = scene->CreateNode(movingNode);
 
-	std::shared_ptr<GameEntity> movingEntity = std::make_shared<GameEntity>(helixMesh, cobbleMat2xPBR);
-	movingEntity->GetTransform()->SetPosition(0, 0, -3);
+	std::shared_ptr<GameEntity> movingEntity = std::make_shared<GameEntity>(helixMesh, cobbleMat2xPBR, transforms);
+	movingEntity->SetSceneNode(scene, movingNode);
+
+	std::vector<std::shared_ptr<GameEntity>> orbitingEntities;
+	for (float side : { -1.5f, 1.5f })
+	{
+		SceneNode coneNode = scene->CreateNode(orbitNode);
+		scene->SetPosition(coneNode, side, 0, 0);
+		scene->SetScale(coneNode, 0.4f, 0.4f, 0.4f);
+
+		std::shared_ptr<GameEntity> cone = std::make_shared<GameEntity>(coneMesh, bronzeMatPBR, transforms);
+		cone->SetSceneNode(scene, coneNode);
+		orbitingEntities.push_back(cone);
+	}
+	scene->UpdateWorldMatrices();
 
 	entities.push_back(movingEntity);
 	entities.push_back(cobSpherePBR);
@@ -419,6 +483,16 @@ void Game::LoadAssetsAndCreateEntities()
 	entities.push_back(roughSpherePBR);
 	entities.push_back(woodSpherePBR);
 	entities.push_back(woodBackground);
+	entities.insert(entities.end(), orbitingEntities.begin(), orbitingEntities.end());
+
+	// Every material uses the same vertex shader, so they all
+	// get its packed twin for drawing packed meshes, and its
+	// instanced twin for drawing several entities at once
+	for (auto& e : entities)
+	{
+		e->GetMaterial()->SetPackedVertexShader(vertexShaderPacked);
+		e->GetMaterial()->SetInstancedVertexShader(vertexShaderInstanced);
+	}
 
 	// Save assets needed for drawing point lights
 	lightMesh = sphereMesh;
@@ -499,6 +573,9 @@ void Game::LoadAssetsAndCreateEntities()
 		fullscreenVS,
 		simpleTexturePS,
 		shadowVS,
+		shadowVSPacked,
+		shadowVSInstanced,
+		shadowCacheCopyPS,
 		samplerOptions);
 }
 
@@ -564,7 +641,8 @@ void Game::OnResize()
 }
 
 // --------------------------------------------------------
-// Update your game here - user input, move objects, AI, etc.
+// Once per frame - the UI, the camera and user input.  Things
+// that move on their own go in FixedUpdate().
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
@@ -613,6 +691,152 @@ void Game::Update(float deltaTime, float totalTime)
 			ImGui::Text("Aspect Ratio: %f", (float)width / (float)height);
 			ImGui::Text("Entity Count: %d", entities.size());
 			ImGui::SameLine(); ImGui::Text("Light Count: %d", lights.size());
+			if (ImGui::SliderInt("Lights", &lightCount, 0, MAX_LIGHTS))
+				GenerateLights();
+			ImGui::Text("Simulation: %.0f Hz, %u steps this frame, %u dropped", 1.0f / GetStepTime(), GetStepsLastFrame(), GetDroppedSteps());
+			ImGui::Text("Scene nodes: %u (%u updated last step)", scene->GetNodeCount(), scene->GetLastUpdateCount());
+			ImGui::Text("Transforms: %u (%u updated last step)", transforms->GetCount(), transforms->GetLastUpdateCount());
+
+			// Entities left after frustum and occlusion culling
+			const OcclusionStats& occlusion = renderer->GetOcclusionStats();
+			ImGui::Text("Visible entities: %u / %u (%u occluded)",
+				renderer->GetVisibleEntityCount(), (unsigned int)entities.size(), occlusion.Occluded);
+			ImGui::Text("Occlusion: %u occluders, %.3f ms raster, %.3f ms test",
+				occlusion.Occluders, occlusion.RasterMs, occlusion.TestMs);
+
+			// What sorting the draws saved
+			const RenderStateChanges& unsorted = renderer->GetUnsortedStateChanges();
+			const RenderStateChanges& sorted = renderer->GetSortedStateChanges();
+			ImGui::Text("State changes (unsorted -> sorted), %u draws:", sorted.Draws);
+			ImGui::Text("    Shaders %u -> %u, materials %u -> %u, buffers %u -> %u",
+				unsorted.Shaders, sorted.Shaders, unsorted.Materials, sorted.Materials, unsorted.Buffers, sorted.Buffers);
+
+			// How the shadow is split into cascades, and how often
+			// each one is redrawn
+			ShadowCascades& cascades = renderer->GetShadowCascades();
+			int cascadeCount = (int)cascades.GetCascadeCount();
+			if (ImGui::SliderInt("Shadow cascades", &cascadeCount, 1, MAX_SHADOW_CASCADES))
+				cascades.SetCascadeCount(cascadeCount);
+			float splitBlend = cascades.GetSplitBlend();
+			if (ImGui::SliderFloat("Cascade splits (even to log)", &splitBlend, 0.0f, 1.0f))
+				cascades.SetSplitBlend(splitBlend);
+			bool shadowCaching = renderer->GetShadowCaching();
+			if (ImGui::Checkbox("Cache static shadows", &shadowCaching))
+				renderer->SetShadowCaching(shadowCaching);
+			if (ImGui::TreeNode("Cascades")) {
+				for (unsigned int i = 0; i < cascades.GetCascadeCount(); i++) {
+					const ShadowCascade& cascade = cascades.GetCascade(i);
+					ImGui::Text("Cascade %u: %.2f to %.2f, %.1f mm texels, %u updates",
+						i, cascade.NearDepth, cascade.FarDepth, cascade.TexelSize * 1000.0f, cascade.Updates);
+
+					ImGui::PushID(i);
+					int interval = (int)cascades.GetUpdateInterval(i);
+					if (ImGui::SliderInt("Update every N frames", &interval, 1, 16))
+						cascades.SetUpdateInterval(i, interval);
+					ImGui::PopID();
+
+					// How often the static casters' cached depth was redrawn
+					if (shadowCaching) {
+						const ShadowCacheStats& cache = renderer->GetShadowCacheStats(i);
+						ImGui::Text("    %u static / %u dynamic casters, %u re-renders in %u frames",
+							cache.StaticCasters, cache.DynamicCasters, cache.StaticRenders, cache.Frames);
+						ImGui::Text("    %u for the light or cached region moving (%u moves), %u for static casters changing",
+							cache.LightChanges, cascade.CacheMoves, cache.CasterChanges);
+					}
+				}
+				ImGui::TreePop();
+			}
+
+			// Entities drawn into the shadow map, and why the rest weren't
+			const ShadowCasterStats& casters = renderer->GetShadowCasterStats();
+			ImGui::Text("Shadow casters: %u / %u drawn for %u receivers, %.3f ms",
+				casters.Casters, casters.Tested, casters.Receivers, casters.CullMs);
+			ImGui::Text("    %u outside the light, %u with nothing visible behind",
+				casters.Outside, casters.Unseen);
+
+			// Draws instancing saved, in the main pass and the shadow map
+			const InstancingStats& instancing = renderer->GetInstancingStats();
+			const InstancingStats& shadowInstancing = renderer->GetShadowInstancingStats();
+			ImGui::Text("Instancing: %u draws for %u entities (%u saved, %u instanced)",
+				instancing.Draws, instancing.Items, instancing.Items - instancing.Draws, instancing.InstancedDraws);
+			ImGui::Text("    Shadow map: %u draws for %u entities (%u saved, %u instanced)",
+				shadowInstancing.Draws, shadowInstancing.Items, shadowInstancing.Items - shadowInstancing.Draws, shadowInstancing.InstancedDraws);
+
+			// Constant buffer traffic, split into the shared per-frame
+			// buffer and everything the shaders copy themselves
+			const ConstantBufferUploads& uploads = renderer->GetConstantBufferUploads();
+			ImGui::Text("Constant buffer uploads: %u bytes per frame, %u bytes per object/material",
+				uploads.PerFrameBytes, uploads.ShaderBytes);
+
+			// How the lights were binned for clustered shading, or
+			// picked for each entity
+			bool objectLighting = renderer->GetObjectLighting();
+			if (ImGui::Checkbox("Per-object light lists", &objectLighting))
+				renderer->SetObjectLighting(objectLighting);
+			if (objectLighting) {
+				const ObjectLightStats& objectLights = renderer->GetObjectLightStats();
+				ImGui::Text("Object lights: %u objects, %u of %u lights in range kept, %.3f ms",
+					objectLights.Objects, objectLights.Kept, objectLights.Reaching, objectLights.SelectMs);
+			} else {
+				const LightGridStats& lightGrid = renderer->GetLightGridStats();
+				ImGui::Text("Light grid: %u lights, %u indices (%u KB uploaded), %.3f ms",
+					lightGrid.Lights, lightGrid.Indices, uploads.LightGridBytes / 1024, lightGrid.BuildMs);
+				ImGui::Text("    Up to %u lights per cluster, %u empty clusters", lightGrid.MaxPerCluster, lightGrid.EmptyClusters);
+			}
+
+			// Triangles the meshlet culling skipped last frame
+			const MeshletCullStats& cull = renderer->GetMeshletCullStats();
+			ImGui::Text("Meshlets: %u / %u drawn", cull.MeshletsDrawn, cull.Meshlets);
+			ImGui::Text("Triangles culled: %u frustum, %u backfacing (of %u)",
+				cull.TrianglesOutsideFrustum, cull.TrianglesBackfacing, cull.Triangles);
+
+			// How full the shared mesh buffers are, and how
+			// scattered their free space is
+			const MeshPoolStats pool = meshPool->GetStats();
+			ImGui::Text("Mesh pool: %u meshes, %.1f / %.1f KB",
+				pool.Meshes, pool.UsedBytes / 1024.0f, pool.CapacityBytes / 1024.0f);
+			ImGui::Text("    Fragmentation: %.0f%% full verts, %.0f%% packed verts, %.0f%% indices",
+				meshPool->GetVertexStats(VertexLayout::Full).Fragmentation * 100.0f,
+				meshPool->GetVertexStats(VertexLayout::Packed).Fragmentation * 100.0f,
+				meshPool->GetIndexStats().Fragmentation * 100.0f);
+			ImGui::Text("    %u compactions, %u grows", pool.Compactions, pool.Grows);
+
+			// What's resident, and how many loads were avoided
+			const AssetRegistryStats assetStats = assets->GetStats();
+			ImGui::Text("Assets: %u meshes, %u textures, %u shaders, %.1f MB",
+				assetStats.Meshes, assetStats.Textures, assetStats.Shaders,
+				assetStats.ResidentBytes / (1024.0f * 1024.0f));
+			ImGui::Text("    %u requests, %u loads, %u path hits, %u content hits (%.1f MB saved)",
+				assetStats.Requests, assetStats.Loads, assetStats.PathHits, assetStats.ContentHits,
+				assetStats.DuplicateBytes / (1024.0f * 1024.0f));
+			if (ImGui::TreeNode("Resident assets")) {
+				for (const AssetInfo& a : assets->GetAssets()) {
+					ImGui::Text("%8.1f KB  %u refs  %s", a.Bytes / 1024.0f, a.References, a.Path.c_str());
+				}
+				ImGui::TreePop();
+			}
+
+			// Vertex counts and memory before/after welding, and
+			// vertex cache efficiency before/after reordering
+			if (ImGui::TreeNode("Meshes")) {
+				for (auto& m : meshes) {
+					const MeshStats& s = m->GetStats();
+					ImGui::Text("%s%s%s: %u -> %u verts, %.1f -> %.1f KB",
+						m->GetName().c_str(),
+						m->GetVertexLayout() == VertexLayout::Packed ? " (packed)" : "",
+						m->IsPooled() ? "" : " (own buffers)",
+						s.SourceVertexCount, s.VertexCount,
+						s.SourceBytes / 1024.0f, s.Bytes / 1024.0f);
+					ImGui::Text("    ACMR %.2f -> %.2f, ATVR %.2f -> %.2f",
+						s.SourceACMR, s.ACMR, s.SourceATVR, s.ATVR);
+					for (unsigned int i = 1; i < m->GetLodCount(); i++) {
+						const MeshLod& lod = m->GetLod(i);
+						ImGui::Text("    LOD %u: %u tris, error %.4f",
+							i, lod.IndexCount / 3, lod.Error);
+					}
+				}
+				ImGui::TreePop();
+			}
 		}
 		ImGui::End();
 
@@ -627,27 +851,41 @@ void Game::Update(float deltaTime, float totalTime)
 			ImGui::Text("Scene Depth:");
 			ImGui::Image(renderer->GetSceneDepthSRV().Get(), size);
 			ImGui::Text("Shadow Map:");
+			ImGui::SliderInt("Cascade", &shadowPreviewCascade, 0, MAX_SHADOW_CASCADES - 1);
+			renderer->SetShadowPreviewCascade(shadowPreviewCascade);
 			ImGui::Image(renderer->GetShadowMapSRV().Get(), size);
 		}
 		ImGui::End();
 	}
 
 
-	// Update the camera
+	// Update the camera - this follows the mouse and keyboard
+	// every frame, rather than waiting on the simulation
 	camera->Update(deltaTime);
 
-	float offset = sinf(totalTime);
-	entities[0].get()->GetTransform()->SetPosition(offset * 7, 0, -3);
+	// Check individual input
+	if (input.KeyDown(VK_ESCAPE)) Quit();
+	if (input.KeyPress(VK_TAB)) GenerateLights();
+}
+
+// --------------------------------------------------------
+// Moves everything in the scene along by one simulation
+// step, which is always the same length (see the constructor)
+// --------------------------------------------------------
+void Game::FixedUpdate(float stepTime, float simulationTime)
+{
+	// Move the helix, and spin the cones around it
+	float offset = sinf(simulationTime);
+	scene->SetPosition(movingNode, offset * 7, 0, -3);
+	scene->Rotate(orbitNode, 0, stepTime, 0);
+	scene->UpdateWorldMatrices();
+	transforms->UpdateWorldMatrices();
 
 	// Update all emitters
 	for (auto& e : emitters)
-		e->Update(deltaTime, totalTime);
-
-	//emitters[0]->GetTransform().SetPosition(5 * sin(totalTime / 5.0f), 0, 0);
+		e->Update(stepTime, simulationTime);
 
-	// Check individual input
-	if (input.KeyDown(VK_ESCAPE)) Quit();
-	if (input.KeyPress(VK_TAB)) GenerateLights();
+	//emitters[0]->GetTransform().SetPosition(5 * sin(simulationTime / 5.0f), 0, 0);
 }
 
 // --------------------------------------------------------
@@ -655,5 +893,9 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
-	renderer->Render(camera, totalTime);
+	// We're somewhere between the last two simulation steps, so
+	// draw things that far between them, at that time
+	float alpha = GetInterpolationAlpha();
+	float drawTime = GetSimulationTime() - (1.0f - alpha) * GetStepTime();
+	renderer->Render(camera, drawTime, alpha);
 }
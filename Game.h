@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DXCore.h"
+#include "AssetRegistry.h"
 #include "Mesh.h"
 #include "GameEntity.h"
 #include "Camera.h"
@@ -10,6 +11,7 @@
 #include "Lights.h"
 #include "Sky.h"
 #include "Renderer.h"
+#include "SceneGraph.h"
 #include "Emitter.h"
 
 #include <DirectXMath.h>
@@ -28,6 +30,7 @@ public:
 	// will be called automatically
 	void Init();
 	void OnResize();
+	void FixedUpdate(float stepTime, float simulationTime);
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
 
@@ -35,11 +38,24 @@ private:
 	// Renderer
 	std::shared_ptr<Renderer> renderer;
 
+	// Every mesh, texture and shader we've loaded
+	std::shared_ptr<AssetRegistry> assets;
+
 	// Our scene
 	std::vector<std::shared_ptr<GameEntity>> entities;
 	std::vector<std::shared_ptr<Emitter>> emitters;
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::shared_ptr<MeshPool> meshPool;
 	std::shared_ptr<Camera> camera;
 
+	// Where every entity's position, rotation and scale live
+	std::shared_ptr<TransformSystem> transforms;
+
+	// Entities that move together, and the nodes we animate
+	std::shared_ptr<SceneGraph> scene;
+	SceneNode movingNode;
+	SceneNode orbitNode;
+
 	// Lights
 	std::vector<Light> lights;
 	int lightCount;
@@ -53,6 +69,7 @@ private:
 	// Text & ui
 	std::shared_ptr<DirectX::SpriteFont> arial;
 	std::shared_ptr<DirectX::SpriteBatch> spriteBatch;
+	int shadowPreviewCascade;	// Which shadow cascade the render targets window shows
 
 	// Texture related resources
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
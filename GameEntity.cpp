@@ -2,23 +2,82 @@
 
 using namespace DirectX;
 
-GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
+GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, std::shared_ptr<TransformSystem> transforms)
 {
 	// Save the data
 	this->mesh = mesh;
 	this->material = material;
+	this->transforms = transforms;
+	this->transform = transforms->Create();
+	this->node = InvalidSceneNode;
+	this->lod = 0;
+}
+
+GameEntity::~GameEntity()
+{
+	transforms->Destroy(transform);
 }
 
 std::shared_ptr<Mesh> GameEntity::GetMesh() { return mesh; }
 std::shared_ptr<Material> GameEntity::GetMaterial() { return material; }
-Transform* GameEntity::GetTransform() { return &transform; }
+TransformRef GameEntity::GetTransform() { return TransformRef(transforms.get(), transform); }
+unsigned int GameEntity::GetLod() { return lod; }
+void GameEntity::SetLod(unsigned int lod) { this->lod = lod; }
+std::shared_ptr<OccluderMesh> GameEntity::GetOccluder() { return occluder; }
+void GameEntity::SetOccluder(std::shared_ptr<OccluderMesh> occluder) { this->occluder = occluder; }
+SceneNode GameEntity::GetSceneNode() { return node; }
+
+void GameEntity::SetSceneNode(std::shared_ptr<SceneGraph> scene, SceneNode node)
+{
+	this->scene = scene;
+	this->node = scene ? node : InvalidSceneNode;
+}
 
+XMFLOAT4X4 GameEntity::GetWorldMatrix(float alpha)
+{
+	return scene ? scene->GetInterpolatedWorldMatrix(node, alpha) : transforms->GetInterpolatedWorldMatrix(transform, alpha);
+}
 
-void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
+XMFLOAT4X4 GameEntity::GetWorldInverseTransposeMatrix(float alpha)
+{
+	return scene ? scene->GetInterpolatedWorldInverseTransposeMatrix(node, alpha) : transforms->GetInterpolatedWorldInverseTransposeMatrix(transform, alpha);
+}
+
+unsigned int GameEntity::GetTransformVersion()
+{
+	return scene ? scene->GetVersion(node) : transforms->GetVersion(transform);
+}
+
+bool GameEntity::IsTransformMoving()
+{
+	return scene ? scene->IsMoving(node) : transforms->IsMoving(transform);
+}
+
+
+void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera, MeshletCullStats* stats, float alpha, bool materialBound)
 {
 	// Tell the material to prepare for a draw
-	material->PrepareMaterial(&transform, camera);
+	XMFLOAT4X4 world = GetWorldMatrix(alpha);
+	XMFLOAT4X4 worldInverseTranspose = GetWorldInverseTransposeMatrix(alpha);
+	if (materialBound)
+		material->SetObjectData(world, worldInverseTranspose, mesh.get());
+	else
+		material->PrepareMaterial(world, worldInverseTranspose, mesh.get());
+
+	// Meshlets only cover the full detail level
+	if (lod == 0 && !mesh->GetMeshlets().empty())
+	{
+		CullMeshlets(
+			mesh->GetMeshlets(),
+			world,
+			camera->GetFrustum(),
+			camera->GetTransform()->GetPosition(),
+			visibleMeshlets,
+			stats);
+		mesh->Draw(context, visibleMeshlets);
+		return;
+	}
 
 	// Draw the mesh
-	mesh->SetBuffersAndDraw(context);
+	mesh->Draw(context, lod);
 }
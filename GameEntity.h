@@ -2,27 +2,79 @@
 
 #include <wrl/client.h>
 #include <DirectXMath.h>
+#include <vector>
 #include "Mesh.h"
+#include "Meshlet.h"
 #include "Material.h"
-#include "Transform.h"
+#include "OcclusionCuller.h"
+#include "SceneGraph.h"
+#include "TransformSystem.h"
 #include "Camera.h"
 #include "SimpleShader.h"
 
 class GameEntity
 {
 public:
-	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	// The entity's transform lives in the given system, and is
+	// given back to it when the entity goes away
+	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, std::shared_ptr<TransformSystem> transforms);
+	~GameEntity();
+	GameEntity(const GameEntity&) = delete;
+	GameEntity& operator=(const GameEntity&) = delete;
 
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Material> GetMaterial();
-	Transform* GetTransform();
+	TransformRef GetTransform();
 
-	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
+	// Puts the entity in a scene graph, after which it's positioned
+	// by the node (relative to its parents) and GetTransform() is
+	// no longer used for drawing
+	void SetSceneNode(std::shared_ptr<SceneGraph> scene, SceneNode node);
+	SceneNode GetSceneNode();
+
+	// From the scene graph if the entity is in one, or its own
+	// transform otherwise.  Alpha blends from the world matrix as
+	// of the simulation step before the last (0) to the last (1).
+	DirectX::XMFLOAT4X4 GetWorldMatrix(float alpha = 1.0f);
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix(float alpha = 1.0f);
+
+	// Changes whenever GetWorldMatrix() could give something new
+	// (see TransformSystem::GetVersion())
+	unsigned int GetTransformVersion();
+
+	// Whether GetWorldMatrix() is changing from one alpha to the
+	// next (see TransformSystem::IsMoving())
+	bool IsTransformMoving();
+
+	// Which of the mesh's LODs to draw
+	unsigned int GetLod();
+	void SetLod(unsigned int lod);
+
+	// Simple geometry inside the mesh that hides whatever's behind
+	// it from the renderer, or null if the entity doesn't
+	std::shared_ptr<OccluderMesh> GetOccluder();
+	void SetOccluder(std::shared_ptr<OccluderMesh> occluder);
+
+	// Meshes with meshlets only draw the ones that could be visible
+	// at full detail, adding to stats (if given) as they go.  The
+	// mesh's buffers have to be bound already (Mesh::SetBuffers()).
+	// Alpha is as for GetWorldMatrix().  If the material's shaders
+	// and resources are already bound (see Material::SetShaders()
+	// and SetResources()), only the per-object data gets set.
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera, MeshletCullStats* stats = nullptr, float alpha = 1.0f, bool materialBound = false);
 
 private:
 
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
-	Transform transform;
+	std::shared_ptr<TransformSystem> transforms;
+	TransformHandle transform;
+	std::shared_ptr<SceneGraph> scene;
+	SceneNode node;
+	unsigned int lod;
+	std::shared_ptr<OccluderMesh> occluder;
+
+	// Reused every frame, to avoid allocating
+	std::vector<IndexRange> visibleMeshlets;
 };
 
@@ -0,0 +1,108 @@
+#include "Hash.h"
+
+#include <cstring>
+
+static const unsigned long long Prime1 = 0x9E3779B185EBCA87ull;
+static const unsigned long long Prime2 = 0xC2B2AE3D27D4EB4Full;
+static const unsigned long long Prime3 = 0x165667B19E3779F9ull;
+static const unsigned long long Prime4 = 0x85EBCA77C2B2AE63ull;
+static const unsigned long long Prime5 = 0x27D4EB2F165667C5ull;
+
+static inline unsigned long long RotateLeft(unsigned long long x, int bits)
+{
+	return (x << bits) | (x >> (64 - bits));
+}
+
+// Unaligned loads, since files can be any length
+static inline unsigned long long Read64(const unsigned char* p)
+{
+	unsigned long long v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned int Read32(const unsigned char* p)
+{
+	unsigned int v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned long long Round(unsigned long long acc, unsigned long long input)
+{
+	acc += input * Prime2;
+	acc = RotateLeft(acc, 31);
+	return acc * Prime1;
+}
+
+static inline unsigned long long MergeRound(unsigned long long acc, unsigned long long lane)
+{
+	acc ^= Round(0, lane);
+	return acc * Prime1 + Prime4;
+}
+
+
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + size;
+	unsigned long long h;
+
+	if (size >= 32)
+	{
+		// Four independent lanes, so the multiplies can overlap
+		unsigned long long v1 = seed + Prime1 + Prime2;
+		unsigned long long v2 = seed + Prime2;
+		unsigned long long v3 = seed;
+		unsigned long long v4 = seed - Prime1;
+
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + Prime5;
+	}
+
+	h += (unsigned long long)size;
+
+	// Leftover bytes
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= Round(0, Read64(p));
+		h = RotateLeft(h, 27) * Prime1 + Prime4;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (unsigned long long)Read32(p) * Prime1;
+		h = RotateLeft(h, 23) * Prime2 + Prime3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		h ^= (*p) * Prime5;
+		h = RotateLeft(h, 11) * Prime1;
+	}
+
+	// Final avalanche
+	h ^= h >> 33;
+	h *= Prime2;
+	h ^= h >> 29;
+	h *= Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Fast, non-cryptographic 64-bit hash of a block of memory
+// (the xxHash64 algorithm).  Used to tell when source assets
+// have changed, so it needs to be quick on whole files rather
+// than resistant to deliberate collisions.
+// --------------------------------------------------------
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long seed = 0);
@@ -0,0 +1,87 @@
+#include "InstanceBatcher.h"
+
+InstanceBatcher::InstanceBatcher()
+	: stats()
+{
+}
+
+
+void InstanceBatcher::Clear()
+{
+	entries.clear();
+	groupBatches.clear();
+	batches.clear();
+	items.clear();
+	instances.clear();
+	stats = {};
+}
+
+
+void InstanceBatcher::Add(uint64_t group, unsigned int item, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose)
+{
+	// The first draw of a group decides where its batch goes
+	auto found = groupBatches.find(group);
+	unsigned int batch;
+	if (found != groupBatches.end())
+	{
+		batch = found->second;
+	}
+	else
+	{
+		batch = (unsigned int)batches.size();
+		batches.push_back({ 0, 0, 0 });
+		groupBatches.insert({ group, batch });
+	}
+	batches[batch].Count++;
+
+	entries.push_back({ batch, item, { world, worldInverseTranspose } });
+}
+
+
+void InstanceBatcher::AddSingle(unsigned int item)
+{
+	unsigned int batch = (unsigned int)batches.size();
+	batches.push_back({ 0, 1, 0 });
+
+	Entry entry = {};
+	entry.Batch = batch;
+	entry.Item = item;
+	entries.push_back(entry);
+}
+
+
+void InstanceBatcher::Build()
+{
+	// Lay the batches out one after another, with instance data
+	// only for the ones drawing more than one item
+	unsigned int itemCount = 0;
+	unsigned int instanceCount = 0;
+	for (InstanceBatch& batch : batches)
+	{
+		batch.FirstItem = itemCount;
+		batch.FirstInstance = instanceCount;
+		itemCount += batch.Count;
+		if (batch.Count > 1)
+		{
+			instanceCount += batch.Count;
+			stats.InstancedDraws++;
+		}
+	}
+
+	// Then drop each draw into the next free spot in its batch
+	items.resize(itemCount);
+	instances.resize(instanceCount);
+	filled.assign(batches.size(), 0);
+	for (const Entry& entry : entries)
+	{
+		const InstanceBatch& batch = batches[entry.Batch];
+		unsigned int slot = filled[entry.Batch]++;
+		items[batch.FirstItem + slot] = entry.Item;
+		if (batch.Count > 1)
+			instances[batch.FirstInstance + slot] = entry.Data;
+	}
+
+	stats.Items = itemCount;
+	stats.Draws = (unsigned int)batches.size();
+	stats.InstanceBytes = instanceCount * (unsigned int)sizeof(InstanceData);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// One instance's worth of the instance buffer, read by the
+// *_PER_INSTANCE inputs of the instanced vertex shaders
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+};
+
+// --------------------------------------------------------
+// A run of draws that can go out as one: the items are
+// GetItems()[FirstItem] onward, and when there's more than
+// one their instance data is GetInstances()[FirstInstance]
+// onward, in the same order
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	unsigned int FirstItem;
+	unsigned int Count;
+	unsigned int FirstInstance;
+};
+
+// What batching did to a frame's draws
+struct InstancingStats
+{
+	unsigned int Items;			// Draws asked for
+	unsigned int Draws;			// Draws left after batching
+	unsigned int InstancedDraws;	// Of those, how many draw more than one item
+	unsigned int InstanceBytes;		// Size of the packed instance data
+};
+
+// --------------------------------------------------------
+// Groups draws that share everything but their matrices (a
+// mesh, material and level of detail, say) so each group can
+// be drawn with a single instanced draw call.
+//
+// Draws are added in the order they'd be drawn, each with a
+// group key made up by the caller.  Build() then puts every
+// group where its first draw was, so sorted draws stay about
+// as sorted, and packs the matrices of each group of two or
+// more together for the instance buffer.  Groups of one are
+// left to draw the usual way and don't take up any space.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher();
+
+	// Forgets every draw, keeping the memory for next frame
+	void Clear();
+
+	// A draw that can be grouped with the others of the same group
+	void Add(uint64_t group, unsigned int item, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose);
+
+	// A draw that can't be instanced, which gets a batch of its own
+	void AddSingle(unsigned int item);
+
+	// Makes the batches and packs the instance data
+	void Build();
+
+	const std::vector<InstanceBatch>& GetBatches() { return batches; }
+	const std::vector<unsigned int>& GetItems() { return items; }
+	const std::vector<InstanceData>& GetInstances() { return instances; }
+	const InstancingStats& GetStats() { return stats; }
+
+private:
+	// A draw as added, with the batch its group ended up in
+	struct Entry
+	{
+		unsigned int Batch;
+		unsigned int Item;
+		InstanceData Data;
+	};
+
+	std::vector<Entry> entries;
+	std::unordered_map<uint64_t, unsigned int> groupBatches;
+
+	std::vector<InstanceBatch> batches;
+	std::vector<unsigned int> items;
+	std::vector<InstanceData> instances;
+	std::vector<unsigned int> filled;	// Per batch, while building
+
+	InstancingStats stats;
+};
@@ -0,0 +1,304 @@
+#include "LightGrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "Parallel.h"
+#include "Simd.h"
+#include "Timer.h"
+
+using namespace DirectX;
+
+// Padding lights sit out here with no range, so they never
+// reach a cluster
+static const float FarAway = 1e30f;
+
+// How much bigger than the cluster each box is, so a point
+// right on the edge between two clusters is in both boxes
+// however the rounding goes
+static const float BoxSlack = 1e-3f;
+
+// Fewer lights than this aren't worth starting threads for
+static const size_t MinLightsForThreads = 64;
+static const size_t SlicesPerThread = 4;
+
+LightGrid::LightGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices)
+	: tilesX(std::max(tilesX, 1u)),
+	tilesY(std::max(tilesY, 1u)),
+	slices(std::max(slices, 1u)),
+	projection(),
+	nearZ(0.0f),
+	farZ(0.0f),
+	sliceScale(0.0f),
+	sliceBias(0.0f),
+	stats()
+{
+	clusters.resize(this->tilesX * this->tilesY * this->slices, { 0, 0 });
+	sliceIndices.resize(this->slices);
+}
+
+
+void LightGrid::SetProjection(const XMFLOAT4X4& projection)
+{
+	if (!boxes.empty() && memcmp(&projection, &this->projection, sizeof(projection)) == 0)
+		return;
+	this->projection = projection;
+
+	// Near and far back out of the depth terms of a
+	// perspective projection (see XMMatrixPerspectiveFovLH)
+	nearZ = -projection._43 / projection._33;
+	farZ = projection._43 / (1.0f - projection._33);
+
+	// Each slice is the same ratio deeper than the last
+	float logRatio = logf(farZ / nearZ);
+	sliceScale = slices / logRatio;
+	sliceBias = -(float)slices * logf(nearZ) / logRatio;
+
+	sliceNear.resize(slices);
+	sliceFar.resize(slices);
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		sliceNear[s] = nearZ * powf(farZ / nearZ, (float)s / slices) * (1.0f - BoxSlack);
+		sliceFar[s] = nearZ * powf(farZ / nearZ, (float)(s + 1) / slices) * (1.0f + BoxSlack);
+	}
+
+	// A tile's view-space x and y grow with depth, so its box
+	// spans the tile's edges at both ends of the slice
+	boxes.resize(clusters.size());
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			// Screen y goes down, view-space y goes up
+			float top = (1.0f - 2.0f * y / tilesY + BoxSlack) / projection._22;
+			float bottom = (1.0f - 2.0f * (y + 1) / tilesY - BoxSlack) / projection._22;
+			for (unsigned int x = 0; x < tilesX; x++)
+			{
+				float left = (2.0f * x / tilesX - 1.0f - BoxSlack) / projection._11;
+				float right = (2.0f * (x + 1) / tilesX - 1.0f + BoxSlack) / projection._11;
+
+				ClusterBox& box = boxes[(s * tilesY + y) * tilesX + x];
+				box.MinX = std::min(left * sliceNear[s], left * sliceFar[s]);
+				box.MaxX = std::max(right * sliceNear[s], right * sliceFar[s]);
+				box.MinY = std::min(bottom * sliceNear[s], bottom * sliceFar[s]);
+				box.MaxY = std::max(top * sliceNear[s], top * sliceFar[s]);
+				box.MinZ = sliceNear[s];
+				box.MaxZ = sliceFar[s];
+			}
+		}
+	}
+}
+
+
+void LightGrid::Build(const XMFLOAT4X4& view, const std::vector<Light>& lights)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Every light as a view-space sphere
+	size_t count = lights.size();
+	size_t padded = (count + LaneCount - 1) / LaneCount * LaneCount;
+	lightX.assign(padded, FarAway);
+	lightY.assign(padded, 0.0f);
+	lightZ.assign(padded, 0.0f);
+	lightRadius.assign(padded, 0.0f);
+
+	XMMATRIX v = XMLoadFloat4x4(&view);
+	for (size_t i = 0; i < count; i++)
+	{
+		const Light& light = lights[i];
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			lightX[i] = 0.0f;
+			lightRadius[i] = INFINITY;
+			continue;
+		}
+
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&light.Position), v));
+		lightX[i] = center.x;
+		lightY[i] = center.y;
+		lightZ[i] = center.z;
+		lightRadius[i] = light.Range;
+	}
+
+	// Slices fill in their own clusters and index lists
+	ParallelFor(slices, count >= MinLightsForThreads ? SlicesPerThread : slices, [&](size_t begin, size_t end)
+	{
+		for (size_t s = begin; s < end; s++)
+			BinSlice((unsigned int)s);
+	});
+
+	// Then the slices' lists go end to end.  Each one is already
+	// in cluster order, so the offsets just count up.
+	lightIndices.clear();
+	unsigned int clustersPerSlice = tilesX * tilesY;
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		for (unsigned int c = s * clustersPerSlice; c < (s + 1) * clustersPerSlice; c++)
+		{
+			clusters[c].Offset += (unsigned int)lightIndices.size();
+		}
+		lightIndices.insert(lightIndices.end(), sliceIndices[s].begin(), sliceIndices[s].end());
+	}
+
+	stats = {};
+
+	stats.Lights = (unsigned int)count;
+	stats.Indices = (unsigned int)lightIndices.size();
+	for (const LightCluster& cluster : clusters)
+	{
+		stats.MaxPerCluster = std::max(stats.MaxPerCluster, cluster.Count);
+		if (cluster.Count == 0)
+			stats.EmptyClusters++;
+	}
+	stats.BuildMs = MillisecondsSince(start);
+}
+
+
+// --------------------------------------------------------
+// Light spheres picked out for part of the grid, one array
+// per component, padded to whole SIMD groups with lights that
+// reach nothing
+// --------------------------------------------------------
+struct SphereList
+{
+	std::vector<unsigned int> Index;
+	std::vector<float> X, Y, Z, Radius;
+
+	void Clear()
+	{
+		Index.clear();
+		X.clear();
+		Y.clear();
+		Z.clear();
+		Radius.clear();
+	}
+
+	void Add(unsigned int index, float x, float y, float z, float radius)
+	{
+		Index.push_back(index);
+		X.push_back(x);
+		Y.push_back(y);
+		Z.push_back(z);
+		Radius.push_back(radius);
+	}
+
+	void Pad()
+	{
+		size_t padded = (Index.size() + LaneCount - 1) / LaneCount * LaneCount;
+		X.resize(padded, FarAway);
+		Y.resize(padded, 0.0f);
+		Z.resize(padded, 0.0f);
+		Radius.resize(padded, 0.0f);
+	}
+};
+
+// --------------------------------------------------------
+// Which of the SIMD group of spheres starting at i touch the
+// box, as a bit per lane.  The distance from a center to the
+// nearest point of the box, along each axis, is how far the
+// center is past either side (or 0 when it's between them).
+// --------------------------------------------------------
+static inline unsigned int TouchBox(const SphereList& spheres, size_t i, const Lanes boxMin[3], const Lanes boxMax[3])
+{
+	Lanes cx = Load(&spheres.X[i]);
+	Lanes cy = Load(&spheres.Y[i]);
+	Lanes cz = Load(&spheres.Z[i]);
+	Lanes r = Load(&spheres.Radius[i]);
+
+	Lanes dx = Add(Max(Sub(boxMin[0], cx), Zero()), Max(Sub(cx, boxMax[0]), Zero()));
+	Lanes dy = Add(Max(Sub(boxMin[1], cy), Zero()), Max(Sub(cy, boxMax[1]), Zero()));
+	Lanes dz = Add(Max(Sub(boxMin[2], cz), Zero()), Max(Sub(cz, boxMax[2]), Zero()));
+	Lanes distanceSquared = Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz));
+	return Mask(LessEqual(distanceSquared, Mul(r, r)));
+}
+
+
+// --------------------------------------------------------
+// Fills in one slice's clusters, with offsets from the start
+// of the slice's own list.  Only touches that slice's data, so
+// slices can be binned at the same time.
+//
+// Lights are narrowed down a step at a time: those reaching
+// the slice's depths, then those touching each row of tiles,
+// then each tile.
+// --------------------------------------------------------
+void LightGrid::BinSlice(unsigned int slice)
+{
+	std::vector<unsigned int>& indices = sliceIndices[slice];
+	indices.clear();
+
+	SphereList inSlice;
+	Lanes zNear = Splat(sliceNear[slice]);
+	Lanes zFar = Splat(sliceFar[slice]);
+	for (size_t i = 0; i < lightX.size(); i += LaneCount)
+	{
+		Lanes cz = Load(&lightZ[i]);
+		Lanes r = Load(&lightRadius[i]);
+		unsigned int hits = Mask(And(Less(Sub(cz, r), zFar), Less(zNear, Add(cz, r))));
+		for (size_t lane = 0; lane < LaneCount; lane++)
+		{
+			if (hits & (1u << lane))
+				inSlice.Add((unsigned int)(i + lane), lightX[i + lane], lightY[i + lane], lightZ[i + lane], lightRadius[i + lane]);
+		}
+	}
+	inSlice.Pad();
+
+	SphereList inRow;
+	for (unsigned int y = 0; y < tilesY; y++)
+	{
+		// A row's box runs from its first tile's left side to its
+		// last tile's right
+		unsigned int first = (slice * tilesY + y) * tilesX;
+		const ClusterBox& left = boxes[first];
+		const ClusterBox& right = boxes[first + tilesX - 1];
+		Lanes rowMin[3] = { Splat(left.MinX), Splat(left.MinY), Splat(left.MinZ) };
+		Lanes rowMax[3] = { Splat(right.MaxX), Splat(left.MaxY), Splat(left.MaxZ) };
+
+		inRow.Clear();
+		for (size_t i = 0; i < inSlice.X.size(); i += LaneCount)
+		{
+			unsigned int hits = TouchBox(inSlice, i, rowMin, rowMax);
+			for (size_t lane = 0; lane < LaneCount; lane++)
+			{
+				if (hits & (1u << lane))
+					inRow.Add(inSlice.Index[i + lane], inSlice.X[i + lane], inSlice.Y[i + lane], inSlice.Z[i + lane], inSlice.Radius[i + lane]);
+			}
+		}
+		inRow.Pad();
+
+		for (unsigned int c = first; c < first + tilesX; c++)
+		{
+			const ClusterBox& box = boxes[c];
+			Lanes boxMin[3] = { Splat(box.MinX), Splat(box.MinY), Splat(box.MinZ) };
+			Lanes boxMax[3] = { Splat(box.MaxX), Splat(box.MaxY), Splat(box.MaxZ) };
+
+			clusters[c] = { (unsigned int)indices.size(), 0 };
+			for (size_t i = 0; i < inRow.X.size(); i += LaneCount)
+			{
+				unsigned int hits = TouchBox(inRow, i, boxMin, boxMax);
+				for (size_t lane = 0; lane < LaneCount; lane++)
+				{
+					if (hits & (1u << lane))
+						indices.push_back(inRow.Index[i + lane]);
+				}
+			}
+			clusters[c].Count = (unsigned int)indices.size() - clusters[c].Offset;
+		}
+	}
+}
+
+
+unsigned int LightGrid::GetClusterIndex(float screenX, float screenY, float viewDepth) const
+{
+	int x = std::min(std::max((int)(screenX * tilesX), 0), (int)tilesX - 1);
+	int y = std::min(std::max((int)(screenY * tilesY), 0), (int)tilesY - 1);
+
+	int slice = 0;
+	if (viewDepth > nearZ)
+		slice = std::min(std::max((int)floorf(logf(viewDepth) * sliceScale + sliceBias), 0), (int)slices - 1);
+
+	return ((unsigned int)slice * tilesY + y) * tilesX + x;
+}
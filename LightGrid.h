@@ -0,0 +1,107 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+// --------------------------------------------------------
+// Where a cluster's lights are in the light index list.
+// Matches the uint2 in PerFrame.hlsli's lightClusters.
+// --------------------------------------------------------
+struct LightCluster
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+// What the last Build() did
+struct LightGridStats
+{
+	unsigned int Lights;
+	unsigned int Indices;			// Total entries across all clusters
+	unsigned int MaxPerCluster;
+	unsigned int EmptyClusters;
+	double BuildMs;
+};
+
+// --------------------------------------------------------
+// Lights binned into clusters for clustered forward shading.
+//
+// The view frustum is cut into a grid of screen tiles, and
+// each column of tiles into depth slices that get thicker
+// further away (each is the same ratio deeper than the last),
+// so a cluster covers about the same amount of screen at any
+// depth.  A pixel only has to light itself with the lights
+// in its own cluster.
+//
+// Build() tests each light's sphere (its range around it;
+// directional lights reach everything) against each cluster's
+// view-space box.  Each slice picks out the lights that reach
+// its depths, then those touching each row of tiles, then each
+// tile, testing a SIMD register's worth of lights at a time,
+// and slices are spread across worker threads.  The boxes are
+// a little bigger than the clusters, so lights are sometimes
+// kept in a cluster they don't touch, but never left out of
+// one they do.
+// --------------------------------------------------------
+class LightGrid
+{
+public:
+	LightGrid(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+
+	// Works out the clusters' boxes from a perspective projection
+	// (only when it's changed since last time)
+	void SetProjection(const DirectX::XMFLOAT4X4& projection);
+
+	// Bins the lights, given the camera's view matrix
+	void Build(const DirectX::XMFLOAT4X4& view, const std::vector<Light>& lights);
+
+	// The cluster a point is in: x and y from 0 to 1 across and
+	// down the screen, and its view-space depth.  Matches the
+	// lookup in PerFrame.hlsli.
+	unsigned int GetClusterIndex(float screenX, float screenY, float viewDepth) const;
+
+	// Light indices for every cluster, one cluster after another
+	// (ordered by slice, then row, then column)
+	const std::vector<LightCluster>& GetClusters() const { return clusters; }
+	const std::vector<unsigned int>& GetLightIndices() const { return lightIndices; }
+
+	unsigned int GetTilesX() const { return tilesX; }
+	unsigned int GetTilesY() const { return tilesY; }
+	unsigned int GetSlices() const { return slices; }
+
+	// slice = log(depth) * scale + bias, for the shader
+	float GetSliceScale() const { return sliceScale; }
+	float GetSliceBias() const { return sliceBias; }
+
+	const LightGridStats& GetStats() const { return stats; }
+
+private:
+	struct ClusterBox
+	{
+		float MinX, MinY, MinZ;
+		float MaxX, MaxY, MaxZ;
+	};
+
+	unsigned int tilesX, tilesY, slices;
+	DirectX::XMFLOAT4X4 projection;
+	float nearZ, farZ;
+	float sliceScale, sliceBias;
+
+	// View-space boxes by cluster index, and each slice's depths
+	std::vector<ClusterBox> boxes;
+	std::vector<float> sliceNear, sliceFar;
+
+	// This frame's lights as view-space spheres, one array per
+	// component, padded to whole SIMD groups
+	std::vector<float> lightX, lightY, lightZ, lightRadius;
+
+	std::vector<LightCluster> clusters;
+	std::vector<unsigned int> lightIndices;
+	std::vector<std::vector<unsigned int>> sliceIndices; // Per slice, while building
+
+	LightGridStats stats;
+
+	void BinSlice(unsigned int slice);
+};
@@ -30,15 +30,15 @@ float3 SampleAndUnpackNormalMap(Texture2D map, SamplerState samp, float2 uv)
 }
 
 // Handle converting tangent-space normal map to world space normal
-float3 NormalMapping(Texture2D map, SamplerState samp, float2 uv, float3 normal, float3 tangent)
+float3 NormalMapping(Texture2D map, SamplerState samp, float2 uv, float3 normal, float4 tangent)
 {
 	// Grab the normal from the map
 	float3 normalFromMap = SampleAndUnpackNormalMap(map, samp, uv);
 
 	// Gather the required vectors for converting the normal
 	float3 N = normal;
-	float3 T = normalize(tangent - N * dot(tangent, N));
-	float3 B = cross(T, N);
+	float3 T = normalize(tangent.xyz - N * dot(tangent.xyz, N));
+	float3 B = cross(T, N) * (tangent.w < 0.0f ? -1.0f : 1.0f); // w flips it for mirrored UVs
 
 	// Create the 3x3 matrix to convert from TANGENT-SPACE normals to WORLD-SPACE normals
 	float3x3 TBN = float3x3(T, B, N);
@@ -2,9 +2,9 @@
 
 #include <DirectXMath.h>
 
-// This define should match your
-// MAX_LIGHTS definition in your shader(s)
-#define MAX_LIGHTS 128
+// The most lights the scene can be given.  The shaders read
+// lights from a structured buffer, so they don't limit this.
+#define MAX_LIGHTS 4096
 
 // Light types
 // Must match definitions in shader
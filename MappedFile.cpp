@@ -0,0 +1,48 @@
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Opens and maps the given file.  Check IsOpen() afterwards,
+// since missing and empty files both result in no data.
+// --------------------------------------------------------
+MappedFile::MappedFile(const char* path)
+	: file(INVALID_HANDLE_VALUE),
+	mapping(0),
+	data(0),
+	size(0)
+{
+	// Open the file itself, hinting that we'll mostly read it front to back
+	file = CreateFileA(
+		path,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	// Empty files can't be mapped, so bail early
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	// Create the mapping and a view of the whole thing
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+		return;
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data)
+		size = (size_t)fileSize.QuadPart;
+}
+
+// --------------------------------------------------------
+// Unmaps the view and releases the OS handles
+// --------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// A read-only, memory-mapped view of an entire file.
+//
+// The OS pages the file in on demand, so there is no
+// up-front copy into our own buffers.  The view stays
+// valid for as long as this object is alive.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* path);
+	~MappedFile();
+
+	// Not copyable, since we own OS handles
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen() { return data != 0; }
+	const char* GetData() { return data; }
+	size_t GetSize() { return size; }
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
@@ -10,6 +10,8 @@ Material::Material(
 	:
 	ps(ps),
 	vs(vs),
+	packedVS(0),
+	instancedVS(0),
 	colorTint(tint),
 	uvScale(uvScale),
 	uvOffset(uvOffset),
@@ -21,6 +23,17 @@ Material::Material(
 // Getters
 std::shared_ptr<SimplePixelShader> Material::GetPixelShader() { return ps; }
 std::shared_ptr<SimpleVertexShader> Material::GetVertexShader() { return vs; }
+
+// Picks the vertex shader that can read the given vertex layout
+std::shared_ptr<SimpleVertexShader> Material::GetVertexShader(VertexLayout layout)
+{
+	if (layout == VertexLayout::Packed && packedVS)
+		return packedVS;
+	return vs;
+}
+
+std::shared_ptr<SimpleVertexShader> Material::GetInstancedVertexShader() { return instancedVS; }
+
 DirectX::XMFLOAT2 Material::GetUVScale() { return uvScale; }
 DirectX::XMFLOAT2 Material::GetUVOffset() { return uvOffset; }
 DirectX::XMFLOAT3 Material::GetColorTint() { return colorTint; }
@@ -59,6 +72,8 @@ Microsoft::WRL::ComPtr<ID3D11SamplerState> Material::GetSampler(std::string name
 // Setters
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> ps) { this->ps = ps; }
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> vs) { this->vs = vs; }
+void Material::SetPackedVertexShader(std::shared_ptr<SimpleVertexShader> vs) { this->packedVS = vs; }
+void Material::SetInstancedVertexShader(std::shared_ptr<SimpleVertexShader> vs) { this->instancedVS = vs; }
 void Material::SetUVScale(DirectX::XMFLOAT2 scale) { uvScale = scale; }
 void Material::SetUVOffset(DirectX::XMFLOAT2 offset) { uvOffset = offset; }
 void Material::SetColorTint(DirectX::XMFLOAT3 tint) { this->colorTint = tint; }
@@ -90,27 +105,57 @@ void Material::RemoveSampler(std::string name)
 }
 
 
-void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera)
+void Material::PrepareMaterial(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose, Mesh* mesh)
 {
-	// Turn on these shaders
-	vs->SetShader();
+	SetShaders(mesh);
+	SetObjectData(world, worldInverseTranspose, mesh);
+	SetResources();
+}
+
+
+void Material::SetShaders(Mesh* mesh)
+{
+	// Turn on these shaders (the vertex shader depends on the mesh's format)
+	GetVertexShader(mesh->GetVertexLayout())->SetShader();
 	ps->SetShader();
+}
+
+
+void Material::SetResources()
+{
+	// Loop and set any other resources
+	for (auto& t : textureSRVs) { ps->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
+	for (auto& s : samplers) { ps->SetSamplerState(s.first.c_str(), s.second.Get()); }
+}
 
-	// Send data to the vertex shader
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
-	vs->SetMatrix4x4("worldInverseTranspose", transform->GetWorldInverseTransposeMatrix());
-	vs->SetMatrix4x4("view", camera->GetView());
-	vs->SetMatrix4x4("projection", camera->GetProjection());
-	vs->CopyAllBufferData();
 
+void Material::SetObjectData(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose, Mesh* mesh)
+{
+	std::shared_ptr<SimpleVertexShader> meshVS = GetVertexShader(mesh->GetVertexLayout());
+
+	// Send data to the vertex shader (the camera and lights are in
+	// the shared per-frame buffer, which the renderer fills)
+	meshVS->SetMatrix4x4("world", world);
+	meshVS->SetMatrix4x4("worldInverseTranspose", worldInverseTranspose);
+
+	// Packed positions are relative to the mesh's bounds
+	if (mesh->GetVertexLayout() == VertexLayout::Packed)
+	{
+		const MeshBounds& bounds = mesh->GetBounds();
+		meshVS->SetFloat3("positionMin", bounds.Min);
+		meshVS->SetFloat3("positionExtent", GetBoundsExtent(bounds));
+	}
+	meshVS->CopyAllBufferData();
+
+	SetMaterialData();
+}
+
+
+void Material::SetMaterialData()
+{
 	// Send data to the pixel shader
 	ps->SetFloat3("colorTint", colorTint);
-	ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
 	ps->SetFloat2("uvScale", uvScale);
 	ps->SetFloat2("uvOffset", uvOffset);
 	ps->CopyAllBufferData();
-
-	// Loop and set any other resources
-	for (auto& t : textureSRVs) { ps->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
-	for (auto& s : samplers) { ps->SetSamplerState(s.first.c_str(), s.second.Get()); }
 }
@@ -8,6 +8,7 @@
 
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "Mesh.h"
 #include "Transform.h"
 
 class Material
@@ -23,6 +24,8 @@ public:
 
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(VertexLayout layout);
+	std::shared_ptr<SimpleVertexShader> GetInstancedVertexShader(); // Null if this material can't be instanced
 	DirectX::XMFLOAT2 GetUVScale();
 	DirectX::XMFLOAT2 GetUVOffset();
 	DirectX::XMFLOAT3 GetColorTint();
@@ -33,6 +36,8 @@ public:
 
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> ps);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> ps);
+	void SetPackedVertexShader(std::shared_ptr<SimpleVertexShader> vs);
+	void SetInstancedVertexShader(std::shared_ptr<SimpleVertexShader> vs);
 	void SetUVScale(DirectX::XMFLOAT2 scale);
 	void SetUVOffset(DirectX::XMFLOAT2 offset);
 	void SetColorTint(DirectX::XMFLOAT3 tint);
@@ -44,13 +49,25 @@ public:
 	void RemoveTextureSRV(std::string name);
 	void RemoveSampler(std::string name);
 
-	void PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera);
+	void PrepareMaterial(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose, Mesh* mesh);
+
+	// The three parts of PrepareMaterial(), for drawing sorted
+	// objects where the shaders or textures are often already bound
+	void SetShaders(Mesh* mesh);
+	void SetResources();
+	void SetObjectData(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose, Mesh* mesh);
+
+	// Just the pixel shader's part of SetObjectData(), for instanced
+	// draws whose world matrices are in the instance buffer
+	void SetMaterialData();
 
 private:
 
 	// Shaders
 	std::shared_ptr<SimplePixelShader> ps;
 	std::shared_ptr<SimpleVertexShader> vs;
+	std::shared_ptr<SimpleVertexShader> packedVS; // Same as vs, but for meshes using VertexLayout::Packed
+	std::shared_ptr<SimpleVertexShader> instancedVS; // Same as vs, but reading world matrices per instance
 
 	// Material properties
 	DirectX::XMFLOAT3 colorTint;
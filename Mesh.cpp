@@ -1,323 +1,347 @@
 #include "Mesh.h"
+#include "Camera.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Tangents.h"
 #include <DirectXMath.h>
+#include <algorithm>
+#include <cstring>
 #include <vector>
-#include <fstream>
 
 using namespace DirectX;
 
+// How many pixels of error a LOD is allowed on screen
+static const float LodPixelError = 1.0f;
+
+// A coarser LOD has to beat the pixel error by this fraction
+// before we switch down to it
+static const float LodHysteresis = 0.25f;
+
 Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+	: name("custom"), stats(), layout(VertexLayout::Full), poolHandle(RangeAllocator::Invalid)
 {
-	CreateBuffers(vertArray, numVerts, indexArray, numIndices, device);
+	// Always calculate the tangents before copying to buffer
+	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	bounds = CalculateBounds(vertArray, numVerts);
+
+	// Small enough for 16-bit indices?
+	if (numVerts < 65536)
+	{
+		std::vector<unsigned short> shortIndices(numIndices);
+		for (int i = 0; i < numIndices; i++)
+			shortIndices[i] = (unsigned short)indexArray[i];
+		CreateBuffers(vertArray, sizeof(Vertex), numVerts, shortIndices.data(), sizeof(unsigned short), numIndices, device);
+	}
+	else
+	{
+		CreateBuffers(vertArray, sizeof(Vertex), numVerts, indexArray, sizeof(unsigned int), numIndices, device);
+	}
+
+	// Nothing was welded or reordered
+	VertexCacheStats cache = AnalyzeVertexCache(indexArray, numIndices, numVerts);
+	stats.SourceVertexCount = stats.VertexCount;
+	stats.SourceBytes = stats.Bytes;
+	stats.ACMR = stats.SourceACMR = cache.ACMR;
+	stats.ATVR = stats.SourceATVR = cache.ATVR;
 }
 
-Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device)
+Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, const MeshOptions& options, std::shared_ptr<MeshPool> pool)
+	: numIndices(0), stats(), bounds(), layout(options.Layout), vertexStride(0), indexFormat(DXGI_FORMAT_R32_UINT),
+	pool(pool), poolHandle(RangeAllocator::Invalid)
 {
-	// File input object
-	std::ifstream obj(objFile);
-
-	// Check for successful open
-	if (!obj.is_open())
+	// Name the mesh after the file, minus the folders
+	name = objFile;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != std::string::npos)
+		name = name.substr(slash + 1);
+
+	// Always hash the source, so an edited .obj is never
+	// hidden behind an out of date cooked file
+	MappedFile source(objFile);
+	if (!source.IsOpen())
 		return;
+	unsigned long long sourceHash = HashBytes(source.GetData(), source.GetSize());
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	// If the cooked mesh is up to date, upload it straight
+	// from the mapped file - no parsing and no copies
+	std::string cookedFile = GetCookedMeshPath(objFile);
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
+		CookedMesh cooked(cookedFile.c_str());
+		if (cooked.IsValid(sourceHash, options))
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
+			const CookedMeshHeader* header = cooked.GetHeader();
+			CreateBuffers(
+				cooked.GetVertexData(), header->VertexStride, header->VertexCount,
+				cooked.GetIndexData(), header->IndexStride, header->IndexCount,
+				device);
+			ApplyCookedHeader(*header);
+
+			meshlets.resize(header->MeshletCount);
+			if (header->MeshletCount > 0)
+				memcpy(&meshlets[0], cooked.GetMeshletData(), sizeof(Meshlet) * header->MeshletCount);
+			return;
 		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			//  If the model is missing any of these, this 
-			//  code will not handle the file correctly!
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-			}
-		}
-	}
-
-	// Close the file and create the actual buffers
-	obj.close();
-
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-
-	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
-
+	} // The mapping has to be closed before we can overwrite the file
 
+	// Otherwise, run the whole pipeline (parse, weld, reorder,
+	// tangents) and save the result for next time
+	CookedMeshData mesh;
+	if (!CookObj(source.GetData(), source.GetSize(), sourceHash, options, mesh))
+		return;
+	WriteCookedMesh(cookedFile.c_str(), mesh);
+
+	const CookedMeshHeader& header = mesh.Header;
+	CreateBuffers(
+		mesh.GetVertexData(), header.VertexStride, header.VertexCount,
+		mesh.GetIndexData(), header.IndexStride, header.IndexCount,
+		device);
+	ApplyCookedHeader(mesh.Header);
+	meshlets = mesh.Meshlets;
 }
 
 
 Mesh::~Mesh(void)
 {
-
+	// Give our space in the pool back
+	if (pool && poolHandle != RangeAllocator::Invalid)
+		pool->Remove(poolHandle);
 }
 
 
-void Mesh::CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+void Mesh::CreateBuffers(
+	const void* vertexData, unsigned int vertexStride, int numVerts,
+	const void* indexData, unsigned int indexStride, int numIndices,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
-	// Always calculate the tangents before copying to buffer
-	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	// Save the formats and indices, which are one LOD until
+	// the cooked header says otherwise
+	this->vertexStride = vertexStride;
+	this->indexFormat = indexStride == sizeof(unsigned short) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	this->numIndices = numIndices;
+	lods.assign(1, { 0, (unsigned int)numIndices, 0.0f });
 
+	// Track what we uploaded
+	stats.VertexCount = numVerts;
+	stats.IndexCount = numIndices;
+	stats.Bytes = (size_t)vertexStride * numVerts + (size_t)indexStride * numIndices;
+
+	// The pool only has a 16-bit index buffer, so bigger
+	// meshes fall back to buffers of their own
+	if (pool && indexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		poolHandle = pool->Add(layout, vertexData, numVerts, (const unsigned short*)indexData, numIndices);
+		return;
+	}
+	pool.reset();
 
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * numVerts; // Number of vertices
+	vbd.ByteWidth = vertexStride * numVerts; // Number of vertices
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
 	vbd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertArray;
+	initialVertexData.pSysMem = vertexData;
 	device->CreateBuffer(&vbd, &initialVertexData, vb.GetAddressOf());
 
 	// Create the index buffer
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * numIndices; // Number of indices
+	ibd.ByteWidth = indexStride * numIndices; // Number of indices
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indexArray;
+	initialIndexData.pSysMem = indexData;
 	device->CreateBuffer(&ibd, &initialIndexData, ib.GetAddressOf());
-
-	// Save the indices
-	this->numIndices = numIndices;
 }
 
 
-// Calculates the tangents of the vertices in a mesh
-// Code originally adapted from: http://www.terathon.com/code/tangent.html
-// Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//  - See listing 7.4 in section 7.5 (page 9 of the PDF)
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+// Copies the stats and bounds worked out while cooking
+void Mesh::ApplyCookedHeader(const CookedMeshHeader& header)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
+	stats.SourceVertexCount = header.SourceVertexCount;
+	stats.SourceBytes = (sizeof(Vertex) + sizeof(unsigned int)) * header.SourceVertexCount;
+	stats.SourceACMR = header.SourceACMR;
+	stats.SourceATVR = header.SourceATVR;
+	stats.ACMR = header.ACMR;
+	stats.ATVR = header.ATVR;
+	bounds = header.Bounds;
+	lods.assign(header.Lods, header.Lods + header.LodCount);
+}
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-		
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx; 
-		v1->Tangent.y += ty; 
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx; 
-		v2->Tangent.y += ty; 
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx; 
-		v3->Tangent.y += ty; 
-		v3->Tangent.z += tz;
-	}
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-
-		// Use Gram-Schmidt orthogonalize
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-		
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
+unsigned int Mesh::SelectLod(const XMFLOAT4X4& world, Camera* camera, float screenHeight, unsigned int currentLod)
+{
+	if (lods.size() <= 1)
+		return 0;
+
+	// Bounding sphere in world space (the largest axis scale
+	// keeps it covering the mesh under non-uniform scaling)
+	XMMATRIX worldMat = XMLoadFloat4x4(&world);
+	float scale = sqrtf(std::max({
+		XMVectorGetX(XMVector3LengthSq(worldMat.r[0])),
+		XMVectorGetX(XMVector3LengthSq(worldMat.r[1])),
+		XMVectorGetX(XMVector3LengthSq(worldMat.r[2])) }));
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&bounds.Center), worldMat);
+	float radius = bounds.Radius * scale;
+
+	// Always full detail from inside the bounds
+	XMFLOAT3 cameraPos = camera->GetTransform()->GetPosition();
+	float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&cameraPos))) - radius;
+	if (distance <= 0.0f)
+		return 0;
+
+	// How many pixels one world unit covers at the front of the
+	// sphere.  _22 of the projection is 1 / tan(fovY / 2), so it
+	// maps one unit at a distance of one to half the screen.
+	float pixelsPerUnit = camera->GetProjection()._22 * screenHeight * 0.5f / distance;
+	auto pixelError = [&](unsigned int lod) { return lods[lod].Error * scale * pixelsPerUnit; };
+
+	// Refine as soon as the current level is visibly wrong, but
+	// only coarsen once the next level is comfortably invisible
+	unsigned int lod = std::min(currentLod, (unsigned int)lods.size() - 1);
+	while (lod > 0 && pixelError(lod) > LodPixelError)
+		lod--;
+	while (lod + 1 < lods.size() && pixelError(lod + 1) < LodPixelError * (1.0f - LodHysteresis))
+		lod++;
+	return lod;
 }
 
 
+bool Mesh::SharesBuffers(Mesh* other)
+{
+	if (other == this)
+		return true;
+	return other && pool && other->pool == pool && other->layout == layout;
+}
 
 
-void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+void Mesh::SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
+	if (pool)
+	{
+		pool->SetBuffers(context, layout);
+		return;
+	}
+
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
+	UINT stride = vertexStride;
 	UINT offset = 0;
 	context->IASetVertexBuffers(0, 1, vb.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(ib.Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(ib.Get(), indexFormat, 0);
+}
+
+
+void Mesh::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int lod)
+{
+	// Nothing to draw if the mesh failed to load
+	if (lods.empty())
+		return;
+
+	// Pooled meshes are looked up every time, since the
+	// pool can move them around
+	MeshPoolRange pooled = {};
+	if (pool)
+		pooled = pool->GetRange(poolHandle);
 
 	// Draw this mesh
-	context->DrawIndexed(this->numIndices, 0, 0);
+	const MeshLod& range = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+	context->DrawIndexed(range.IndexCount, pooled.FirstIndex + range.IndexOffset, pooled.BaseVertex);
+}
+
+
+void Mesh::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<IndexRange>& ranges)
+{
+	if (ranges.empty())
+		return;
+
+	MeshPoolRange pooled = {};
+	if (pool)
+		pooled = pool->GetRange(poolHandle);
+
+	// One draw per range
+	for (const IndexRange& range : ranges)
+		context->DrawIndexed(range.IndexCount, pooled.FirstIndex + range.IndexOffset, pooled.BaseVertex);
+}
+
+
+void Mesh::DrawInstanced(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int instanceCount, unsigned int firstInstance, unsigned int lod)
+{
+	if (lods.empty() || instanceCount == 0)
+		return;
+
+	MeshPoolRange pooled = {};
+	if (pool)
+		pooled = pool->GetRange(poolHandle);
+
+	const MeshLod& range = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+	context->DrawIndexedInstanced(range.IndexCount, instanceCount, pooled.FirstIndex + range.IndexOffset, pooled.BaseVertex, firstInstance);
+}
+
+
+void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int lod)
+{
+	if (lods.empty())
+		return;
+
+	SetBuffers(context);
+	Draw(context, lod);
+}
+
+
+void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<IndexRange>& ranges)
+{
+	if (ranges.empty())
+		return;
+
+	SetBuffers(context);
+	Draw(context, ranges);
+}
+
+
+Microsoft::WRL::ComPtr<ID3D11InputLayout> Mesh::CreateInputLayout(
+	VertexLayout layout,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+{
+	// Matches struct Vertex
+	const D3D11_INPUT_ELEMENT_DESC fullElements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	// Matches struct PackedVertex - the hardware turns the unorm/snorm/half
+	// values into floats, and the shader does the rest of the decoding
+	const D3D11_INPUT_ELEMENT_DESC packedElements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	const D3D11_INPUT_ELEMENT_DESC* elements = fullElements;
+	UINT elementCount = ARRAYSIZE(fullElements);
+	if (layout == VertexLayout::Packed)
+	{
+		elements = packedElements;
+		elementCount = ARRAYSIZE(packedElements);
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	device->CreateInputLayout(
+		elements,
+		elementCount,
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout.GetAddressOf());
+	return inputLayout;
 }
@@ -2,30 +2,113 @@
 
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <DirectXMath.h>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "Bounds.h"
+#include "CookedMesh.h"
+#include "Meshlet.h"
+#include "MeshPool.h"
+#include "PackedVertex.h"
 #include "Vertex.h"
 
+class Camera;
+
+// Vertex and memory counts for a mesh, before and after
+// welding duplicate vertices together, and vertex cache
+// efficiency before and after reordering
+struct MeshStats
+{
+	unsigned int SourceVertexCount;	// One per face corner, before welding
+	unsigned int VertexCount;		// Actually in the vertex buffer
+	unsigned int IndexCount;		// All LODs together
+	size_t SourceBytes;				// Vertex + index memory before welding
+	size_t Bytes;					// Vertex + index memory in the buffers
+	float SourceACMR;				// Cache misses per triangle, in file order
+	float ACMR;						// Cache misses per triangle, as drawn
+	float SourceATVR;				// Cache misses per vertex, in file order
+	float ATVR;						// Cache misses per vertex, as drawn
+};
 
 class Mesh
 {
 public:
 	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	// Meshes with 16-bit indices go in the pool, if given, and
+	// share its buffers rather than getting their own
+	Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, const MeshOptions& options = MeshOptions(), std::shared_ptr<MeshPool> pool = nullptr);
 	~Mesh(void);
 
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() { return vb; }
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() { return ib; }
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() { return pool ? pool->GetVertexBuffer(layout) : vb; }
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() { return pool ? pool->GetIndexBuffer() : ib; }
+	bool IsPooled() { return pool != nullptr; }
+
+	// Whether drawing this mesh right after the other one can
+	// skip SetBuffers()
+	bool SharesBuffers(Mesh* other);
+
 	int GetIndexCount() { return numIndices; }
+	const std::string& GetName() { return name; }
+	const MeshStats& GetStats() { return stats; }
+	const MeshBounds& GetBounds() { return bounds; }
+	VertexLayout GetVertexLayout() { return layout; }
+	unsigned int GetLodCount() { return (unsigned int)lods.size(); }
+	const MeshLod& GetLod(unsigned int lod) { return lods[lod]; }
+	const std::vector<Meshlet>& GetMeshlets() { return meshlets; } // Empty unless cooked with them
+
+	// Picks the coarsest LOD whose error would cover less than a
+	// pixel, given where the mesh is on screen.  Pass in the LOD
+	// picked last frame, so a mesh sitting right on the boundary
+	// between two levels doesn't flicker back and forth.
+	unsigned int SelectLod(const DirectX::XMFLOAT4X4& world, Camera* camera, float screenHeight, unsigned int currentLod);
 
-	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	// Builds the input layout for vertex shaders that read the given
+	// vertex format (reflection can't tell a float from a unorm16)
+	static Microsoft::WRL::ComPtr<ID3D11InputLayout> CreateInputLayout(
+		VertexLayout layout,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
+
+	// Binds the vertex and index buffers to the input assembler.
+	// Draw() assumes they're already bound, so a run of meshes
+	// from the same pool only needs this once.
+	void SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int lod = 0);
+
+	// Draws just these parts of the index buffer, such as the
+	// meshlets that survived CullMeshlets()
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<IndexRange>& ranges);
+
+	// Draws the LOD once for each instance in the bound instance
+	// buffer, starting from firstInstance
+	void DrawInstanced(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int instanceCount, unsigned int firstInstance, unsigned int lod = 0);
+
+	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int lod = 0);
+	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<IndexRange>& ranges);
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vb;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ib;
 	int numIndices;
+	VertexLayout layout;
+	unsigned int vertexStride;
+	DXGI_FORMAT indexFormat;
+	std::shared_ptr<MeshPool> pool;	// Null when using vb and ib
+	unsigned int poolHandle;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+
+	std::string name;
+	MeshStats stats;
+	MeshBounds bounds;
 
-	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void CreateBuffers(
+		const void* vertexData, unsigned int vertexStride, int numVerts,
+		const void* indexData, unsigned int indexStride, int numIndices,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void ApplyCookedHeader(const CookedMeshHeader& header);
 
 };
 
@@ -0,0 +1,624 @@
+#include "MeshOptimizer.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// Marks an unused slot in the weld hash table
+static const unsigned int EmptySlot = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// Raw bits of a float, with -0 folded into +0 so that
+// values that compare equal also hash equal
+// --------------------------------------------------------
+static inline unsigned int FloatBits(float f)
+{
+	if (f == 0.0f) f = 0.0f;
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+// --------------------------------------------------------
+// Hashes the attributes that welding compares
+// --------------------------------------------------------
+static unsigned int HashVertex(const Vertex& v)
+{
+	const float values[] = {
+		v.Position.x, v.Position.y, v.Position.z,
+		v.UV.x, v.UV.y,
+		v.Normal.x, v.Normal.y, v.Normal.z };
+
+	unsigned int h = 2166136261u;
+	for (float f : values)
+	{
+		h ^= FloatBits(f);
+		h *= 0x9E3779B1u;
+		h ^= h >> 15;
+	}
+	return h;
+}
+
+static bool SameVertex(const Vertex& a, const Vertex& b)
+{
+	return
+		a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+		a.UV.x == b.UV.x && a.UV.y == b.UV.y &&
+		a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z;
+}
+
+static bool NearlySameVertex(const Vertex& a, const Vertex& b, float epsilon)
+{
+	return
+		fabsf(a.Position.x - b.Position.x) <= epsilon &&
+		fabsf(a.Position.y - b.Position.y) <= epsilon &&
+		fabsf(a.Position.z - b.Position.z) <= epsilon &&
+		fabsf(a.UV.x - b.UV.x) <= epsilon &&
+		fabsf(a.UV.y - b.UV.y) <= epsilon &&
+		fabsf(a.Normal.x - b.Normal.x) <= epsilon &&
+		fabsf(a.Normal.y - b.Normal.y) <= epsilon &&
+		fabsf(a.Normal.z - b.Normal.z) <= epsilon;
+}
+
+// --------------------------------------------------------
+// Packs a 3D grid cell into a single 64-bit key.  Far away
+// cells can collide, which is fine since candidates are
+// always compared properly afterwards.
+// --------------------------------------------------------
+static unsigned long long CellKey(long long x, long long y, long long z)
+{
+	const unsigned long long mask = 0x1FFFFF; // 21 bits per axis
+	return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+}
+
+// --------------------------------------------------------
+// Exact welding using an open-addressing hash table
+// --------------------------------------------------------
+static void WeldExact(const std::vector<Vertex>& verts, std::vector<Vertex>& unique, std::vector<unsigned int>& remap)
+{
+	// Table is at least twice the vertex count, so probes stay short
+	size_t tableSize = 1;
+	while (tableSize < verts.size() * 2) tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, EmptySlot);
+	size_t mask = tableSize - 1;
+
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		size_t slot = HashVertex(verts[i]) & mask;
+		while (true)
+		{
+			unsigned int existing = table[slot];
+
+			// First time we've seen this vertex
+			if (existing == EmptySlot)
+			{
+				table[slot] = (unsigned int)unique.size();
+				remap[i] = (unsigned int)unique.size();
+				unique.push_back(verts[i]);
+				break;
+			}
+
+			// Already have it
+			if (SameVertex(unique[existing], verts[i]))
+			{
+				remap[i] = existing;
+				break;
+			}
+
+			// Collision, so keep probing
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Epsilon welding using a spatial grid with epsilon-sized
+// cells.  Anything within epsilon of a vertex must be in the
+// same cell or one of its 26 neighbors.
+// --------------------------------------------------------
+static void WeldNearby(const std::vector<Vertex>& verts, std::vector<Vertex>& unique, std::vector<unsigned int>& remap, float epsilon)
+{
+	std::unordered_map<unsigned long long, unsigned int> cellHeads; // Cell -> most recent unique vertex in it
+	std::vector<unsigned int> cellNext;                             // Unique vertex -> next one in the same cell
+	cellHeads.reserve(verts.size());
+	cellNext.reserve(verts.size());
+
+	float invCellSize = 1.0f / epsilon;
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		const Vertex& v = verts[i];
+		long long cx = (long long)floorf(v.Position.x * invCellSize);
+		long long cy = (long long)floorf(v.Position.y * invCellSize);
+		long long cz = (long long)floorf(v.Position.z * invCellSize);
+
+		// Search this cell and its neighbors for a close enough match
+		unsigned int match = EmptySlot;
+		for (int dz = -1; dz <= 1 && match == EmptySlot; dz++)
+			for (int dy = -1; dy <= 1 && match == EmptySlot; dy++)
+				for (int dx = -1; dx <= 1 && match == EmptySlot; dx++)
+				{
+					auto it = cellHeads.find(CellKey(cx + dx, cy + dy, cz + dz));
+					if (it == cellHeads.end())
+						continue;
+
+					for (unsigned int u = it->second; u != EmptySlot; u = cellNext[u])
+					{
+						if (NearlySameVertex(unique[u], v, epsilon))
+						{
+							match = u;
+							break;
+						}
+					}
+				}
+
+		if (match != EmptySlot)
+		{
+			remap[i] = match;
+			continue;
+		}
+
+		// New unique vertex, so add it to the front of its cell's list
+		unsigned int index = (unsigned int)unique.size();
+		unsigned long long key = CellKey(cx, cy, cz);
+		auto head = cellHeads.find(key);
+		cellNext.push_back(head == cellHeads.end() ? EmptySlot : head->second);
+		cellHeads[key] = index;
+
+		remap[i] = index;
+		unique.push_back(v);
+	}
+}
+
+
+unsigned int WeldVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, float epsilon)
+{
+	std::vector<Vertex> unique;
+	std::vector<unsigned int> remap(verts.size());
+	unique.reserve(verts.size());
+
+	if (epsilon > 0.0f)
+		WeldNearby(verts, unique, remap, epsilon);
+	else
+		WeldExact(verts, unique, remap);
+
+	// Point the indices at the shared vertices
+	for (auto& index : indices)
+		index = remap[index];
+
+	verts.swap(unique);
+	return (unsigned int)verts.size();
+}
+
+
+// --------------------------------------------------------
+// A simulated FIFO post-transform cache.  A vertex stays in
+// the cache until "size" more misses have pushed it out, and
+// hits don't refresh it.
+// --------------------------------------------------------
+struct FifoCache
+{
+	std::vector<long long> insertedAt;	// Miss count when each vertex was added
+	long long misses;
+	unsigned int size;
+
+	FifoCache(unsigned int vertexCount, unsigned int size)
+		: insertedAt(vertexCount, -(long long)size - 1), misses(0), size(size) { }
+
+	// Returns 1 if the vertex had to be transformed
+	unsigned int Access(unsigned int v)
+	{
+		if (misses - insertedAt[v] < size)
+			return 0;
+		insertedAt[v] = misses++;
+		return 1;
+	}
+
+	unsigned int AccessTriangle(const unsigned int* tri)
+	{
+		return Access(tri[0]) + Access(tri[1]) + Access(tri[2]);
+	}
+
+	// Empties the cache by pretending enough misses happened
+	void Flush() { misses += size; }
+};
+
+// --------------------------------------------------------
+// Face normal (not normalized, so it's area weighted),
+// oriented to agree with the vertex normals.  This way we
+// don't care which winding the mesh uses.
+// --------------------------------------------------------
+static XMVECTOR FaceNormal(const std::vector<Vertex>& verts, const unsigned int* tri)
+{
+	XMVECTOR p0 = XMLoadFloat3(&verts[tri[0]].Position);
+	XMVECTOR p1 = XMLoadFloat3(&verts[tri[1]].Position);
+	XMVECTOR p2 = XMLoadFloat3(&verts[tri[2]].Position);
+	XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+	XMVECTOR vn =
+		XMLoadFloat3(&verts[tri[0]].Normal) +
+		XMLoadFloat3(&verts[tri[1]].Normal) +
+		XMLoadFloat3(&verts[tri[2]].Normal);
+	return XMVectorGetX(XMVector3Dot(n, vn)) < 0.0f ? -n : n;
+}
+
+// --------------------------------------------------------
+// Rasterizes one triangle into a depth buffer (smaller is
+// closer), returning how many pixels passed the depth test
+// --------------------------------------------------------
+static unsigned int RasterizeTriangle(
+	const float* x, const float* y, const float* z,
+	std::vector<float>& depth, int resolution)
+{
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (fabsf(area) < 1e-12f)
+		return 0;
+	float invArea = 1.0f / area;
+
+	int minX = std::max(0, (int)floorf(std::min({ x[0], x[1], x[2] })));
+	int minY = std::max(0, (int)floorf(std::min({ y[0], y[1], y[2] })));
+	int maxX = std::min(resolution - 1, (int)ceilf(std::max({ x[0], x[1], x[2] })));
+	int maxY = std::min(resolution - 1, (int)ceilf(std::max({ y[0], y[1], y[2] })));
+
+	unsigned int shaded = 0;
+	for (int py = minY; py <= maxY; py++)
+	{
+		float cy = py + 0.5f;
+		for (int px = minX; px <= maxX; px++)
+		{
+			float cx = px + 0.5f;
+
+			// Barycentrics from edge functions, scaled so they're
+			// positive inside the triangle regardless of winding
+			float w0 = ((x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1])) * invArea;
+			float w1 = ((x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2])) * invArea;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			float d = w0 * z[0] + w1 * z[1] + w2 * z[2];
+			float& stored = depth[py * resolution + px];
+			if (d < stored)
+			{
+				stored = d;
+				shaded++;
+			}
+		}
+	}
+	return shaded;
+}
+
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<unsigned char> used(vertexCount, 0);
+	unsigned int usedCount = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		stats.Transformed += cache.Access(indices[i]);
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = 1;
+			usedCount++;
+		}
+	}
+
+	stats.ACMR = (float)stats.Transformed / (indexCount / 3);
+	stats.ATVR = (float)stats.Transformed / usedCount;
+	return stats;
+}
+
+
+OverdrawStats AnalyzeOverdraw(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, unsigned int resolution)
+{
+	OverdrawStats stats = {};
+	if (verts.empty() || indices.size() < 3)
+		return stats;
+
+	// Fit the mesh's bounds to the raster
+	XMFLOAT3 minPos(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 maxPos(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const Vertex& v : verts)
+	{
+		minPos = XMFLOAT3(std::min(minPos.x, v.Position.x), std::min(minPos.y, v.Position.y), std::min(minPos.z, v.Position.z));
+		maxPos = XMFLOAT3(std::max(maxPos.x, v.Position.x), std::max(maxPos.y, v.Position.y), std::max(maxPos.z, v.Position.z));
+	}
+	float extent = std::max({ maxPos.x - minPos.x, maxPos.y - minPos.y, maxPos.z - minPos.z });
+	if (extent <= 0.0f)
+		return stats;
+	float scale = (resolution - 1) / extent;
+
+	// Face normals are the same for every view
+	size_t triCount = indices.size() / 3;
+	std::vector<XMFLOAT3> normals(triCount);
+	for (size_t t = 0; t < triCount; t++)
+		XMStoreFloat3(&normals[t], FaceNormal(verts, &indices[t * 3]));
+
+	std::vector<float> depth(resolution * resolution);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		for (float dir = -1.0f; dir <= 1.0f; dir += 2.0f)
+		{
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+			for (size_t t = 0; t < triCount; t++)
+			{
+				// Looking along "dir" on this axis, so front faces point the other way
+				if ((&normals[t].x)[axis] * dir >= 0.0f)
+					continue;
+
+				float x[3], y[3], z[3];
+				for (int k = 0; k < 3; k++)
+				{
+					const float* p = &verts[indices[t * 3 + k]].Position.x;
+					const float* minP = &minPos.x;
+					x[k] = (p[u] - minP[u]) * scale;
+					y[k] = (p[v] - minP[v]) * scale;
+					z[k] = p[axis] * dir;
+				}
+				stats.PixelsShaded += RasterizeTriangle(x, y, z, depth, (int)resolution);
+			}
+
+			for (float d : depth)
+				stats.PixelsCovered += d != FLT_MAX;
+		}
+	}
+
+	stats.Overdraw = stats.PixelsCovered ? (float)stats.PixelsShaded / stats.PixelsCovered : 0.0f;
+	return stats;
+}
+
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>* clusters, unsigned int cacheSize)
+{
+	if (clusters)
+		clusters->clear();
+
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0 || vertexCount == 0)
+		return;
+
+	// Vertex -> triangle adjacency, stored as one flat array
+	// with a start offset per vertex
+	std::vector<unsigned int> adjOffsets(vertexCount + 1, 0);
+	for (unsigned int index : indices)
+		adjOffsets[index + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjOffsets[v + 1] += adjOffsets[v];
+
+	std::vector<unsigned int> adjTris(indices.size());
+	std::vector<unsigned int> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjTris[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	// Triangles left to emit around each vertex
+	std::vector<unsigned int> live(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		live[v] = adjOffsets[v + 1] - adjOffsets[v];
+
+	std::vector<int> cacheTime(vertexCount, 0);
+	int timestamp = cacheSize + 1;
+	std::vector<unsigned char> emitted(triCount, 0);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	deadEnd.reserve(indices.size());
+	output.reserve(indices.size());
+	unsigned int cursor = 0;
+
+	if (clusters)
+		clusters->push_back(0);
+
+	int fanning = (int)indices[0];
+	while (fanning >= 0)
+	{
+		// Emit every remaining triangle around this vertex
+		candidates.clear();
+		for (unsigned int a = adjOffsets[fanning]; a < adjOffsets[fanning + 1]; a++)
+		{
+			unsigned int t = adjTris[a];
+			if (emitted[t])
+				continue;
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (timestamp - cacheTime[v] > (int)cacheSize)
+					cacheTime[v] = timestamp++;
+			}
+			emitted[t] = 1;
+		}
+
+		// Prefer a vertex from this fan that will still be in the
+		// cache once all of its own triangles have been emitted
+		int next = -1;
+		int bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (timestamp - cacheTime[v] + 2 * (int)live[v] <= (int)cacheSize)
+				priority = timestamp - cacheTime[v];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = (int)v;
+			}
+		}
+
+		// Dead end, so back up to a recent vertex with triangles
+		// left, or failing that, just find the next one in order
+		if (next < 0)
+		{
+			while (!deadEnd.empty() && next < 0)
+			{
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					next = (int)v;
+			}
+
+			while (next < 0 && cursor < vertexCount)
+			{
+				if (live[cursor] > 0)
+					next = (int)cursor;
+				cursor++;
+			}
+
+			if (next >= 0 && clusters)
+				clusters->push_back((unsigned int)(output.size() / 3));
+		}
+
+		fanning = next;
+	}
+
+	indices.swap(output);
+}
+
+
+void OptimizeOverdraw(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, const std::vector<unsigned int>& clusters, float threshold, unsigned int cacheSize)
+{
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0 || clusters.empty())
+		return;
+
+	// Split each hard cluster wherever the running ACMR dips
+	// to within "threshold" of the whole cluster's ACMR
+	std::vector<unsigned int> starts;
+	FifoCache cache((unsigned int)verts.size(), cacheSize);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		unsigned int begin = clusters[c];
+		unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : (unsigned int)triCount;
+
+		cache.Flush();
+		unsigned int misses = 0;
+		for (unsigned int t = begin; t < end; t++)
+			misses += cache.AccessTriangle(&indices[t * 3]);
+		float clusterThreshold = threshold * misses / (end - begin);
+
+		cache.Flush();
+		misses = 0;
+		unsigned int start = begin;
+		starts.push_back(begin);
+		for (unsigned int t = begin; t + 1 < end; t++)
+		{
+			misses += cache.AccessTriangle(&indices[t * 3]);
+			if ((float)misses / (t + 1 - start) <= clusterThreshold)
+			{
+				start = t + 1;
+				starts.push_back(start);
+				misses = 0;
+				cache.Flush();
+			}
+		}
+	}
+
+	// Area-weighted centroid and normal of each cluster, and
+	// the centroid of the whole mesh
+	struct Cluster
+	{
+		unsigned int Begin;
+		unsigned int End;
+		XMFLOAT3 Centroid;
+		XMFLOAT3 Normal;
+		float Sort;
+	};
+	std::vector<Cluster> sorted(starts.size());
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		Cluster& cluster = sorted[c];
+		cluster.Begin = starts[c];
+		cluster.End = c + 1 < starts.size() ? starts[c + 1] : (unsigned int)triCount;
+
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (unsigned int t = cluster.Begin; t < cluster.End; t++)
+		{
+			const unsigned int* tri = &indices[t * 3];
+			XMVECTOR n = FaceNormal(verts, tri);
+			float triArea = XMVectorGetX(XMVector3Length(n)) * 0.5f;
+			XMVECTOR center = (
+				XMLoadFloat3(&verts[tri[0]].Position) +
+				XMLoadFloat3(&verts[tri[1]].Position) +
+				XMLoadFloat3(&verts[tri[2]].Position)) / 3.0f;
+
+			centroid += center * triArea;
+			normal += n;
+			area += triArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+		XMStoreFloat3(&cluster.Centroid, area > 0.0f ? centroid / area : centroid);
+		XMStoreFloat3(&cluster.Normal, normal);
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters on the outside, facing away from the center,
+	// are the most likely to occlude others, so draw them first
+	for (Cluster& cluster : sorted)
+	{
+		XMVECTOR toCluster = XMLoadFloat3(&cluster.Centroid) - meshCentroid;
+		cluster.Sort = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&cluster.Normal)));
+	}
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const Cluster& a, const Cluster& b) { return a.Sort > b.Sort; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (const Cluster& cluster : sorted)
+		output.insert(output.end(), indices.begin() + cluster.Begin * 3, indices.begin() + cluster.End * 3);
+	indices.swap(output);
+}
+
+
+unsigned int OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> remap(verts.size(), EmptySlot);
+	std::vector<Vertex> ordered;
+	ordered.reserve(verts.size());
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == EmptySlot)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(verts[index]);
+		}
+		index = remap[index];
+	}
+
+	verts.swap(ordered);
+	return (unsigned int)verts.size();
+}
+
+
+void OptimizeMesh(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> clusters;
+	OptimizeVertexCache(indices, (unsigned int)verts.size(), &clusters);
+	OptimizeOverdraw(verts, indices, clusters);
+	OptimizeVertexFetch(verts, indices);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Collapses duplicate vertices into a single shared vertex
+// and rewrites the index list to match.  Vertices compare
+// by position, UV and normal (tangents are ignored, since
+// they're calculated after welding).
+//
+// verts   - Vertices to weld; replaced by the unique set, kept
+//           in order of first use
+// indices - Indices into verts; remapped in place
+// epsilon - 0 for exact matches only, otherwise the largest
+//           per-component difference still considered equal
+//
+// Returns the number of unique vertices
+// --------------------------------------------------------
+unsigned int WeldVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, float epsilon = 0.0f);
+
+// --------------------------------------------------------
+// Post-transform vertex cache statistics, from running the
+// index list through a simulated FIFO cache
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float ACMR;					// Vertex shader runs per triangle (0.5 is ideal, 3 is worst)
+	float ATVR;					// Vertex shader runs per unique vertex (1 is ideal)
+	unsigned int Transformed;	// Total vertex shader runs
+};
+
+// --------------------------------------------------------
+// Overdraw statistics, from rasterizing the mesh on the CPU
+// (with depth testing and back face culling) from each of
+// the six axis directions
+// --------------------------------------------------------
+struct OverdrawStats
+{
+	float Overdraw;						// Pixels shaded per pixel covered (1 is ideal)
+	unsigned long long PixelsCovered;
+	unsigned long long PixelsShaded;
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize = 16);
+OverdrawStats AnalyzeOverdraw(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, unsigned int resolution = 256);
+
+// --------------------------------------------------------
+// Reorders triangles for post-transform cache reuse, using
+// Tipsify (Sander, Nehab & Barczak 2007).  Fans around one
+// vertex at a time, picking the next vertex that's still in
+// the cache and has the fewest triangles left.
+//
+// clusters - Optional; filled with the first triangle of each
+//            run that had to restart from a dead end.  These
+//            are the hard boundaries for OptimizeOverdraw().
+// --------------------------------------------------------
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>* clusters = nullptr, unsigned int cacheSize = 16);
+
+// --------------------------------------------------------
+// Splits the cache-optimized clusters further wherever that
+// costs less than "threshold" times their ACMR, then sorts
+// the clusters so the ones facing out from the center of the
+// mesh draw first.  This keeps most of the cache benefit while
+// letting the depth test reject more hidden pixels.
+// --------------------------------------------------------
+void OptimizeOverdraw(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, const std::vector<unsigned int>& clusters, float threshold = 1.05f, unsigned int cacheSize = 16);
+
+// --------------------------------------------------------
+// Renumbers the vertices in the order the index list first
+// uses them, so vertex fetches walk forward through memory.
+// Unused vertices are dropped.  Returns the vertex count.
+// --------------------------------------------------------
+unsigned int OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+// Runs all three passes above, in order
+void OptimizeMesh(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
@@ -0,0 +1,217 @@
+#include "MeshPool.h"
+#include "Vertex.h"
+
+#include <algorithm>
+
+MeshPool::MeshPool(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int vertexCapacity,
+	unsigned int indexCapacity)
+	: device(device), context(context), compactions(0), grows(0)
+{
+	// The buffers themselves aren't made until something goes
+	// in them, so an unused layout costs nothing
+	InitArena(GetArena(VertexLayout::Full), vertexCapacity, sizeof(Vertex), D3D11_BIND_VERTEX_BUFFER);
+	InitArena(GetArena(VertexLayout::Packed), vertexCapacity, sizeof(PackedVertex), D3D11_BIND_VERTEX_BUFFER);
+	InitArena(indices, indexCapacity, sizeof(unsigned short), D3D11_BIND_INDEX_BUFFER);
+}
+
+
+unsigned int MeshPool::Add(
+	VertexLayout layout,
+	const void* vertexData, unsigned int vertexCount,
+	const unsigned short* indexData, unsigned int indexCount)
+{
+	Entry entry;
+	entry.Layout = layout;
+	entry.VertexAllocation = Allocate(GetArena(layout), vertexData, vertexCount);
+	entry.IndexAllocation = Allocate(indices, indexData, indexCount);
+	entry.Used = true;
+
+	// Reuse an old handle if there is one
+	if (!unusedHandles.empty())
+	{
+		unsigned int handle = unusedHandles.back();
+		unusedHandles.pop_back();
+		entries[handle] = entry;
+		return handle;
+	}
+	entries.push_back(entry);
+	return (unsigned int)entries.size() - 1;
+}
+
+
+void MeshPool::Remove(unsigned int handle)
+{
+	Entry& entry = entries[handle];
+	if (!entry.Used)
+		return;
+
+	// The data stays in the buffers until something new
+	// overwrites it or they're rebuilt
+	GetArena(entry.Layout).Allocator.Free(entry.VertexAllocation);
+	indices.Allocator.Free(entry.IndexAllocation);
+	entry.VertexAllocation = RangeAllocator::Invalid;
+	entry.IndexAllocation = RangeAllocator::Invalid;
+	entry.Used = false;
+	unusedHandles.push_back(handle);
+}
+
+
+MeshPoolRange MeshPool::GetRange(unsigned int handle)
+{
+	const Entry& entry = entries[handle];
+	const RangeAllocator& vertexAllocator = GetArena(entry.Layout).Allocator;
+
+	// An empty mesh has nothing allocated, so it gets an empty range
+	MeshPoolRange range = {};
+	if (entry.VertexAllocation != RangeAllocator::Invalid)
+	{
+		range.BaseVertex = vertexAllocator.GetOffset(entry.VertexAllocation);
+		range.VertexCount = vertexAllocator.GetSize(entry.VertexAllocation);
+	}
+	if (entry.IndexAllocation != RangeAllocator::Invalid)
+	{
+		range.FirstIndex = indices.Allocator.GetOffset(entry.IndexAllocation);
+		range.IndexCount = indices.Allocator.GetSize(entry.IndexAllocation);
+	}
+	return range;
+}
+
+
+void MeshPool::SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, VertexLayout layout)
+{
+	// Offsets come from each draw, so the buffers always
+	// start at zero
+	Arena& arena = GetArena(layout);
+	UINT stride = arena.Stride;
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, arena.Buffer.GetAddressOf(), &stride, &offset);
+	context->IASetIndexBuffer(indices.Buffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+}
+
+
+void MeshPool::Defragment()
+{
+	Arena* arenas[] = { &vertices[0], &vertices[1], &indices };
+	for (Arena* arena : arenas)
+	{
+		if (arena->Buffer && arena->Allocator.GetStats().FreeBlocks > 1)
+		{
+			Rebuild(*arena, arena->Allocator.GetCapacity());
+			compactions++;
+		}
+	}
+}
+
+
+MeshPoolStats MeshPool::GetStats()
+{
+	MeshPoolStats stats = {};
+	stats.Meshes = (unsigned int)(entries.size() - unusedHandles.size());
+	stats.Compactions = compactions;
+	stats.Grows = grows;
+
+	const Arena* arenas[] = { &vertices[0], &vertices[1], &indices };
+	for (const Arena* arena : arenas)
+	{
+		if (!arena->Buffer)
+			continue;
+		RangeAllocatorStats s = arena->Allocator.GetStats();
+		stats.UsedBytes += (size_t)s.Used * arena->Stride;
+		stats.CapacityBytes += (size_t)s.Capacity * arena->Stride;
+	}
+	return stats;
+}
+
+
+void MeshPool::InitArena(Arena& arena, unsigned int capacity, unsigned int stride, UINT bindFlags)
+{
+	arena.Allocator = RangeAllocator(capacity);
+	arena.Stride = stride;
+	arena.BindFlags = bindFlags;
+}
+
+
+// Finds room for the data, making more if needed, and
+// uploads it to the GPU.  Nothing is allocated for no data.
+unsigned int MeshPool::Allocate(Arena& arena, const void* data, unsigned int count)
+{
+	if (count == 0)
+		return RangeAllocator::Invalid;
+
+	if (!arena.Buffer)
+		arena.Buffer = CreateBuffer(arena, arena.Allocator.GetCapacity());
+
+	unsigned int id = arena.Allocator.Allocate(count);
+	if (id == RangeAllocator::Invalid)
+	{
+		// Enough room once the gaps are closed up?
+		RangeAllocatorStats s = arena.Allocator.GetStats();
+		if (s.Capacity - s.Used >= count)
+		{
+			Rebuild(arena, s.Capacity);
+			compactions++;
+		}
+		else
+		{
+			Rebuild(arena, std::max(s.Capacity * 2, s.Used + count));
+			grows++;
+		}
+		id = arena.Allocator.Allocate(count);
+	}
+
+	unsigned int offset = arena.Allocator.GetOffset(id);
+	D3D11_BOX box = {};
+	box.left = offset * arena.Stride;
+	box.right = (offset + count) * arena.Stride;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(arena.Buffer.Get(), 0, &box, data, 0, 0);
+	return id;
+}
+
+
+// Copies everything into a new buffer of the given size, with
+// all of the allocations packed together at the front.  D3D11
+// can't copy between overlapping parts of one buffer, so this
+// never compacts in place.
+void MeshPool::Rebuild(Arena& arena, unsigned int capacity)
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = CreateBuffer(arena, capacity);
+
+	arena.Allocator.Grow(capacity);
+	std::vector<RangeMove> moves = arena.Allocator.Compact();
+
+	// Whatever didn't move is all together at the start
+	unsigned int unmoved = moves.empty() ? arena.Allocator.GetStats().Used : moves[0].To;
+	if (unmoved > 0)
+		moves.insert(moves.begin(), { 0, 0, unmoved });
+
+	for (const RangeMove& move : moves)
+	{
+		D3D11_BOX box = {};
+		box.left = move.From * arena.Stride;
+		box.right = (move.From + move.Size) * arena.Stride;
+		box.bottom = 1;
+		box.back = 1;
+		context->CopySubresourceRegion(buffer.Get(), 0, move.To * arena.Stride, 0, 0, arena.Buffer.Get(), 0, &box);
+	}
+	arena.Buffer = buffer;
+}
+
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> MeshPool::CreateBuffer(const Arena& arena, unsigned int capacity)
+{
+	// Default usage, since meshes are copied in and moved
+	// around on the GPU after creation
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = capacity * arena.Stride;
+	desc.BindFlags = arena.BindFlags;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+	return buffer;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+
+#include "PackedVertex.h"
+#include "RangeAllocator.h"
+
+// Where a pooled mesh ended up in the shared buffers
+struct MeshPoolRange
+{
+	unsigned int BaseVertex;	// Added to every index by DrawIndexed()
+	unsigned int FirstIndex;	// Added to every IndexRange's offset
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+};
+
+// Totals across all of the pool's buffers
+struct MeshPoolStats
+{
+	unsigned int Meshes;
+	size_t UsedBytes;
+	size_t CapacityBytes;
+	unsigned int Compactions;	// Rebuilt at the same size to close gaps
+	unsigned int Grows;			// Rebuilt at a bigger size
+};
+
+// --------------------------------------------------------
+// Keeps the vertices and indices of many meshes together in
+// a few big buffers, so drawing one mesh after another only
+// changes the offsets passed to DrawIndexed() rather than the
+// buffers bound to the input assembler.
+//
+// There's one vertex buffer per vertex layout (their strides
+// differ) and one 16-bit index buffer shared by all of them.
+// Indices stay relative to their own mesh and DrawIndexed()'s
+// base vertex finds the right spot, so the vertex buffers can
+// hold far more than 65536 vertices in total.
+//
+// When a mesh doesn't fit, the buffer it needs is rebuilt:
+// at the same size with every mesh packed to the front if the
+// free space is just scattered, or at double the size if there
+// really isn't enough.  Either way the ranges move, so always
+// look them up with GetRange() rather than holding on to them.
+// --------------------------------------------------------
+class MeshPool
+{
+public:
+	// Capacities are in vertices (per layout) and indices
+	MeshPool(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int vertexCapacity = 65536,
+		unsigned int indexCapacity = 262144);
+
+	// Copies a mesh into the pool, returning a handle for it
+	unsigned int Add(
+		VertexLayout layout,
+		const void* vertexData, unsigned int vertexCount,
+		const unsigned short* indexData, unsigned int indexCount);
+	void Remove(unsigned int handle);
+
+	MeshPoolRange GetRange(unsigned int handle);
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer(VertexLayout layout) { return GetArena(layout).Buffer; }
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() { return indices.Buffer; }
+
+	// Binds the buffers for meshes of the given layout
+	void SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, VertexLayout layout);
+
+	// Packs every buffer that has gaps, such as after a level unload
+	void Defragment();
+
+	MeshPoolStats GetStats();
+	RangeAllocatorStats GetVertexStats(VertexLayout layout) { return GetArena(layout).Allocator.GetStats(); }
+	RangeAllocatorStats GetIndexStats() { return indices.Allocator.GetStats(); }
+
+private:
+	// One GPU buffer and the bookkeeping for what's in it
+	struct Arena
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+		RangeAllocator Allocator;
+		unsigned int Stride;
+		UINT BindFlags;
+	};
+
+	struct Entry
+	{
+		VertexLayout Layout;
+		unsigned int VertexAllocation;	// Invalid if there are no vertices
+		unsigned int IndexAllocation;	// Or indices
+		bool Used;						// False for unused handles
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	Arena vertices[2];	// Indexed by VertexLayout
+	Arena indices;
+	std::vector<Entry> entries;
+	std::vector<unsigned int> unusedHandles;
+
+	unsigned int compactions;
+	unsigned int grows;
+
+	Arena& GetArena(VertexLayout layout) { return vertices[(int)layout]; }
+	void InitArena(Arena& arena, unsigned int capacity, unsigned int stride, UINT bindFlags);
+	unsigned int Allocate(Arena& arena, const void* data, unsigned int count);
+	void Rebuild(Arena& arena, unsigned int capacity);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> CreateBuffer(const Arena& arena, unsigned int capacity);
+};
@@ -0,0 +1,546 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+// Open edges are weighted this much more than faces, so
+// borders and seams hold their shape
+static const double EdgeWeight = 10.0;
+
+// How each vertex is allowed to move, decided once from the
+// topology of the original mesh
+enum class VertexKind : unsigned char
+{
+	Manifold,	// Surrounded by triangles - can collapse onto any neighbor
+	Border,		// On an open edge - can only slide along it
+	Seam,		// One of a pair on a UV/normal seam - can only slide along the seam
+	Locked		// Seam ends, corners and anything messier - never moves
+};
+
+// --------------------------------------------------------
+// Symmetric 3x3 matrix A, vector b and constant c, so the
+// weighted sum of squared distances from p to every plane
+// added so far is p.A.p + 2b.p + c
+// --------------------------------------------------------
+struct Quadric
+{
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+	double w; // Total weight, to turn the sum into an average
+};
+
+// --------------------------------------------------------
+// Every corner of every triangle, grouped by vertex, with the
+// two vertices that follow it in winding order
+// --------------------------------------------------------
+struct EdgeAdjacency
+{
+	std::vector<unsigned int> Offsets;	// Vertex -> its first corner (vertexCount + 1 entries)
+	std::vector<unsigned int> Next;		// Corner -> next vertex in the triangle
+	std::vector<unsigned int> Prev;		// Corner -> previous vertex in the triangle
+};
+
+// One possible collapse, moving From onto To
+struct Collapse
+{
+	unsigned int From;
+	unsigned int To;
+	double Error;
+};
+
+static void AddPlane(Quadric& q, double nx, double ny, double nz, double d, double w)
+{
+	q.a00 += w * nx * nx;
+	q.a11 += w * ny * ny;
+	q.a22 += w * nz * nz;
+	q.a01 += w * nx * ny;
+	q.a02 += w * nx * nz;
+	q.a12 += w * ny * nz;
+	q.b0 += w * nx * d;
+	q.b1 += w * ny * d;
+	q.b2 += w * nz * d;
+	q.c += w * d * d;
+	q.w += w;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& r)
+{
+	q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+	q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+	q.w += r.w;
+}
+
+// Weighted sum of squared distances (not yet averaged)
+static double QuadricError(const Quadric& q, const XMFLOAT3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double rx = q.a00 * x + q.a01 * y + q.a02 * z;
+	double ry = q.a01 * x + q.a11 * y + q.a12 * z;
+	double rz = q.a02 * x + q.a12 * y + q.a22 * z;
+	double e = x * rx + y * ry + z * rz + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+
+	// Can dip just below zero from rounding
+	return e > 0.0 ? e : 0.0;
+}
+
+// --------------------------------------------------------
+// Builds the corner lists, optionally with every vertex
+// replaced by the first vertex at its position
+// --------------------------------------------------------
+static void BuildAdjacency(EdgeAdjacency& adj, const std::vector<unsigned int>& indices, size_t vertexCount, const unsigned int* remap)
+{
+	adj.Offsets.assign(vertexCount + 1, 0);
+	adj.Next.resize(indices.size());
+	adj.Prev.resize(indices.size());
+
+	auto map = [remap](unsigned int v) { return remap ? remap[v] : v; };
+
+	// Count the corners per vertex, then turn the counts into offsets
+	for (unsigned int i : indices)
+		adj.Offsets[map(i) + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		adj.Offsets[v + 1] += adj.Offsets[v];
+
+	std::vector<unsigned int> fill(adj.Offsets.begin(), adj.Offsets.end() - 1);
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = map(indices[t + k]);
+			unsigned int corner = fill[v]++;
+			adj.Next[corner] = map(indices[t + (k + 1) % 3]);
+			adj.Prev[corner] = map(indices[t + (k + 2) % 3]);
+		}
+	}
+}
+
+// True if some triangle has the edge a -> b
+static bool HasEdge(const EdgeAdjacency& adj, unsigned int a, unsigned int b)
+{
+	for (unsigned int c = adj.Offsets[a]; c < adj.Offsets[a + 1]; c++)
+		if (adj.Next[c] == b)
+			return true;
+	return false;
+}
+
+// True if an earlier corner of the same vertex has the same
+// outgoing edge (meshes can contain duplicate triangles)
+static bool IsRepeatedEdge(const EdgeAdjacency& adj, unsigned int a, unsigned int corner)
+{
+	for (unsigned int c = adj.Offsets[a]; c < corner; c++)
+		if (adj.Next[c] == adj.Next[corner])
+			return true;
+	return false;
+}
+
+// --------------------------------------------------------
+// Groups vertices that share a position.  remap points each
+// vertex at the first vertex with its position, and wedge
+// links the vertices at each position into a loop.
+// --------------------------------------------------------
+static void BuildPositionRemap(const std::vector<Vertex>& verts, std::vector<unsigned int>& remap, std::vector<unsigned int>& wedge)
+{
+	size_t vertexCount = verts.size();
+
+	// Sorting (rather than hashing) keeps the grouping identical between runs
+	std::vector<unsigned int> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0);
+	auto lessPosition = [&verts](unsigned int a, unsigned int b)
+	{
+		const XMFLOAT3& pa = verts[a].Position;
+		const XMFLOAT3& pb = verts[b].Position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		if (pa.z != pb.z) return pa.z < pb.z;
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), lessPosition);
+
+	remap.resize(vertexCount);
+	wedge.resize(vertexCount);
+	for (size_t start = 0; start < vertexCount; )
+	{
+		const XMFLOAT3& p = verts[order[start]].Position;
+		size_t end = start + 1;
+		while (end < vertexCount &&
+			verts[order[end]].Position.x == p.x &&
+			verts[order[end]].Position.y == p.y &&
+			verts[order[end]].Position.z == p.z)
+			end++;
+
+		for (size_t i = start; i < end; i++)
+		{
+			remap[order[i]] = order[start];
+			wedge[order[i]] = order[i + 1 < end ? i + 1 : start];
+		}
+		start = end;
+	}
+}
+
+// --------------------------------------------------------
+// Decides which way each vertex may move.  An edge is open
+// if no triangle runs along it in the other direction.  Edges
+// that are open between vertices but closed between positions
+// are seams; edges open even between positions are borders.
+// --------------------------------------------------------
+static void ClassifyVertices(
+	std::vector<VertexKind>& kinds,
+	const EdgeAdjacency& adj,
+	const EdgeAdjacency& positionAdj,
+	const std::vector<unsigned int>& remap,
+	const std::vector<unsigned int>& wedge)
+{
+	size_t vertexCount = remap.size();
+	std::vector<unsigned int> openOut(vertexCount, 0), openIn(vertexCount, 0);
+	std::vector<unsigned int> positionOpenOut(vertexCount, 0), positionOpenIn(vertexCount, 0);
+
+	for (unsigned int a = 0; a < vertexCount; a++)
+	{
+		for (unsigned int c = adj.Offsets[a]; c < adj.Offsets[a + 1]; c++)
+		{
+			unsigned int b = adj.Next[c];
+			if (!IsRepeatedEdge(adj, a, c) && !HasEdge(adj, b, a)) { openOut[a]++; openIn[b]++; }
+		}
+		for (unsigned int c = positionAdj.Offsets[a]; c < positionAdj.Offsets[a + 1]; c++)
+		{
+			unsigned int b = positionAdj.Next[c];
+			if (!IsRepeatedEdge(positionAdj, a, c) && !HasEdge(positionAdj, b, a)) { positionOpenOut[a]++; positionOpenIn[b]++; }
+		}
+	}
+
+	kinds.resize(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		unsigned int p = remap[v];
+		unsigned int w = wedge[v];
+		unsigned int wedgeCount = 1;
+		for (unsigned int i = w; i != v; i = wedge[i])
+			wedgeCount++;
+
+		bool closed = positionOpenOut[p] == 0 && positionOpenIn[p] == 0;
+		if (closed && wedgeCount == 1 && openOut[v] == 0 && openIn[v] == 0)
+			kinds[v] = VertexKind::Manifold;
+		else if (closed && wedgeCount == 2 &&
+			openOut[v] == 1 && openIn[v] == 1 &&
+			openOut[w] == 1 && openIn[w] == 1)
+			kinds[v] = VertexKind::Seam;
+		else if (wedgeCount == 1 && positionOpenOut[p] == 1 && positionOpenIn[p] == 1)
+			kinds[v] = VertexKind::Border;
+		else
+			kinds[v] = VertexKind::Locked;
+	}
+}
+
+// --------------------------------------------------------
+// One quadric per position, from the planes of the triangles
+// around it (weighted by area), plus planes perpendicular to
+// any open edges so borders and seams don't wander
+// --------------------------------------------------------
+static void BuildQuadrics(
+	std::vector<Quadric>& quadrics,
+	const std::vector<Vertex>& verts,
+	const std::vector<unsigned int>& indices,
+	const EdgeAdjacency& adj,
+	const std::vector<unsigned int>& remap)
+{
+	quadrics.assign(verts.size(), Quadric());
+
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		XMVECTOR p[3];
+		for (int k = 0; k < 3; k++)
+			p[k] = XMLoadFloat3(&verts[indices[t + k]].Position);
+
+		XMVECTOR cross = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+		float length = XMVectorGetX(XMVector3Length(cross));
+		if (length <= 0.0f)
+			continue;
+
+		// Face plane, weighted by area
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, cross / length);
+		double d = -XMVectorGetX(XMVector3Dot(cross / length, p[0]));
+		double area = 0.5 * length;
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadrics[remap[indices[t + k]]], n.x, n.y, n.z, d, area);
+
+		// Planes along open edges, standing up from the face
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = indices[t + k];
+			unsigned int b = indices[t + (k + 1) % 3];
+			if (HasEdge(adj, b, a))
+				continue;
+
+			XMVECTOR edge = p[(k + 1) % 3] - p[k];
+			XMVECTOR edgeNormal = XMVector3Normalize(XMVector3Cross(edge, cross));
+			XMFLOAT3 en;
+			XMStoreFloat3(&en, edgeNormal);
+			double ed = -XMVectorGetX(XMVector3Dot(edgeNormal, p[k]));
+			double edgeLength = XMVectorGetX(XMVector3Length(edge));
+			double weight = edgeLength * edgeLength * EdgeWeight;
+			AddPlane(quadrics[remap[a]], en.x, en.y, en.z, ed, weight);
+			AddPlane(quadrics[remap[b]], en.x, en.y, en.z, ed, weight);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Can "from" collapse onto its neighbor "to" without tearing
+// a border or seam?  For a seam, also finds the twin collapse
+// on the other side of the seam.
+// --------------------------------------------------------
+static bool CanCollapse(
+	unsigned int from,
+	unsigned int to,
+	const std::vector<VertexKind>& kinds,
+	const EdgeAdjacency& adj,
+	const EdgeAdjacency& positionAdj,
+	const std::vector<unsigned int>& remap,
+	const std::vector<unsigned int>& wedge,
+	unsigned int& twinFrom,
+	unsigned int& twinTo)
+{
+	twinFrom = from;
+	twinTo = to;
+
+	switch (kinds[from])
+	{
+	case VertexKind::Manifold:
+		return true;
+
+	case VertexKind::Border:
+	{
+		// Only along the border itself
+		unsigned int pf = remap[from], pt = remap[to];
+		bool open = HasEdge(positionAdj, pf, pt) != HasEdge(positionAdj, pt, pf);
+		return open && (kinds[to] == VertexKind::Border || kinds[to] == VertexKind::Locked);
+	}
+
+	case VertexKind::Seam:
+	{
+		// Only along the seam, and only if the matching edge
+		// exists on the other side
+		if (kinds[to] != VertexKind::Seam)
+			return false;
+		if (HasEdge(adj, from, to) == HasEdge(adj, to, from))
+			return false;
+
+		twinFrom = wedge[from];
+		twinTo = wedge[to];
+		return HasEdge(adj, twinFrom, twinTo) != HasEdge(adj, twinTo, twinFrom);
+	}
+
+	default:
+		return false;
+	}
+}
+
+// --------------------------------------------------------
+// Would moving "from" onto "to" turn any of the remaining
+// triangles around it inside out?  Other vertices are looked
+// up through the collapses already made this pass.
+// --------------------------------------------------------
+static bool FlipsTriangles(
+	unsigned int from,
+	unsigned int to,
+	const std::vector<Vertex>& verts,
+	const EdgeAdjacency& adj,
+	const std::vector<unsigned int>& remap,
+	const std::vector<unsigned int>& collapseRemap)
+{
+	XMVECTOR pf = XMLoadFloat3(&verts[from].Position);
+	XMVECTOR pt = XMLoadFloat3(&verts[to].Position);
+
+	for (unsigned int c = adj.Offsets[from]; c < adj.Offsets[from + 1]; c++)
+	{
+		unsigned int b = collapseRemap[adj.Next[c]];
+		unsigned int d = collapseRemap[adj.Prev[c]];
+
+		// Triangles on the collapsing edge just disappear
+		if (remap[b] == remap[to] || remap[d] == remap[to])
+			continue;
+
+		XMVECTOR pb = XMLoadFloat3(&verts[b].Position);
+		XMVECTOR pd = XMLoadFloat3(&verts[d].Position);
+		XMVECTOR before = XMVector3Cross(pb - pf, pd - pf);
+		XMVECTOR after = XMVector3Cross(pb - pt, pd - pt);
+		if (XMVectorGetX(XMVector3Dot(before, after)) <= 0.0f)
+			return true;
+	}
+	return false;
+}
+
+
+float SimplifyMesh(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, size_t targetIndexCount, std::vector<unsigned int>& result, float maxError)
+{
+	size_t vertexCount = verts.size();
+	result = indices;
+	if (indices.size() <= targetIndexCount || vertexCount == 0)
+		return 0.0f;
+
+	std::vector<unsigned int> remap, wedge;
+	BuildPositionRemap(verts, remap, wedge);
+
+	// Decide how every vertex can move, and how far each
+	// position is from the original surface, up front
+	EdgeAdjacency adj, positionAdj;
+	BuildAdjacency(adj, result, vertexCount, nullptr);
+	BuildAdjacency(positionAdj, result, vertexCount, remap.data());
+
+	std::vector<VertexKind> kinds;
+	ClassifyVertices(kinds, adj, positionAdj, remap, wedge);
+
+	std::vector<Quadric> quadrics;
+	BuildQuadrics(quadrics, verts, result, adj, remap);
+
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseRemap(vertexCount);
+	std::vector<bool> locked(vertexCount);
+	double errorLimitSquared = (double)maxError * maxError;
+	double resultError = 0.0;
+
+	// Each pass makes a batch of the cheapest collapses that don't
+	// touch each other, then rebuilds the triangle list
+	while (result.size() > targetIndexCount)
+	{
+		BuildAdjacency(adj, result, vertexCount, nullptr);
+		BuildAdjacency(positionAdj, result, vertexCount, remap.data());
+
+		// Gather every allowed collapse, in both directions along
+		// each edge (shared edges are only visited from one side)
+		collapses.clear();
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = result[t + k];
+				unsigned int b = result[t + (k + 1) % 3];
+				if (a > b && HasEdge(adj, b, a))
+					continue;
+
+				unsigned int twinFrom, twinTo;
+				const Quadric& qa = quadrics[remap[a]];
+				const Quadric& qb = quadrics[remap[b]];
+				double weight = std::max(qa.w + qb.w, 1e-20);
+
+				if (CanCollapse(a, b, kinds, adj, positionAdj, remap, wedge, twinFrom, twinTo))
+				{
+					double error = (QuadricError(qa, verts[b].Position) + QuadricError(qb, verts[b].Position)) / weight;
+					collapses.push_back({ a, b, error });
+				}
+				if (CanCollapse(b, a, kinds, adj, positionAdj, remap, wedge, twinFrom, twinTo))
+				{
+					double error = (QuadricError(qa, verts[a].Position) + QuadricError(qb, verts[a].Position)) / weight;
+					collapses.push_back({ b, a, error });
+				}
+			}
+		}
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y)
+		{
+			if (x.Error != y.Error) return x.Error < y.Error;
+			if (x.From != y.From) return x.From < y.From;
+			return x.To < y.To;
+		});
+
+		// Most collapses remove two triangles, so aim for half as many
+		// collapses as triangles we still need to lose, and don't reach
+		// far past the error of the last one we expect to need
+		size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+		size_t collapseGoal = std::max<size_t>(trianglesToRemove / 2, 1);
+		double errorLimit = collapses[std::min(collapseGoal, collapses.size()) - 1].Error * 1.5;
+		errorLimit = std::min(errorLimit, errorLimitSquared);
+
+		std::iota(collapseRemap.begin(), collapseRemap.end(), 0);
+		std::fill(locked.begin(), locked.end(), false);
+		size_t removed = 0;
+		size_t collapsed = 0;
+		for (const Collapse& c : collapses)
+		{
+			if (removed >= trianglesToRemove || c.Error > errorLimitSquared || (collapsed > 0 && c.Error > errorLimit))
+				break;
+
+			// Each position moves at most once per pass, and nothing
+			// moves onto a position that's already moved
+			unsigned int pf = remap[c.From];
+			unsigned int pt = remap[c.To];
+			if (locked[pf] || locked[pt])
+				continue;
+
+			unsigned int twinFrom, twinTo;
+			CanCollapse(c.From, c.To, kinds, adj, positionAdj, remap, wedge, twinFrom, twinTo);
+			if (FlipsTriangles(c.From, c.To, verts, adj, remap, collapseRemap) ||
+				(twinFrom != c.From && FlipsTriangles(twinFrom, twinTo, verts, adj, remap, collapseRemap)))
+				continue;
+
+			collapseRemap[c.From] = c.To;
+			collapseRemap[twinFrom] = twinTo;
+			AddQuadric(quadrics[pt], quadrics[pf]);
+			locked[pf] = locked[pt] = true;
+
+			removed += kinds[c.From] == VertexKind::Border ? 1 : 2;
+			collapsed++;
+			resultError = std::max(resultError, c.Error);
+		}
+		if (collapsed == 0)
+			break;
+
+		// Apply the collapses, dropping triangles that now have
+		// two corners at the same position
+		size_t write = 0;
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			unsigned int a = collapseRemap[result[t]];
+			unsigned int b = collapseRemap[result[t + 1]];
+			unsigned int c = collapseRemap[result[t + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return (float)sqrt(resultError);
+}
+
+
+void GenerateLods(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int maxLods, float maxError, std::vector<MeshLod>& lods)
+{
+	lods.clear();
+	lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+
+	std::vector<unsigned int> original = indices;
+	std::vector<unsigned int> simplified;
+	while (lods.size() < std::min(maxLods, (unsigned int)MAX_MESH_LODS))
+	{
+		const MeshLod& previous = lods.back();
+		size_t target = previous.IndexCount / 6 * 3; // Half the triangles
+		float error = SimplifyMesh(verts, original, target, simplified, maxError);
+
+		// Not worth a level if it barely saves anything
+		if (simplified.empty() || simplified.size() > previous.IndexCount * 0.8f)
+			break;
+
+		OptimizeVertexCache(simplified, (unsigned int)verts.size());
+
+		MeshLod lod;
+		lod.IndexOffset = (unsigned int)indices.size();
+		lod.IndexCount = (unsigned int)simplified.size();
+		lod.Error = std::max(error, previous.Error);
+		lods.push_back(lod);
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+	}
+}
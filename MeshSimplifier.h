@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+
+#include "Vertex.h"
+
+// Most detail levels a mesh can have, including the original
+#define MAX_MESH_LODS 6
+
+// --------------------------------------------------------
+// One level of detail: a range of the mesh's index buffer,
+// drawn with the same vertex buffer as every other level
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+	float Error;				// Geometric error from SimplifyMesh(), in model units
+};
+
+// --------------------------------------------------------
+// Simplifies a mesh with quadric error metric edge collapses
+// (Garland & Heckbert 1997), down to roughly targetIndexCount
+// indices.  Collapses only ever move a vertex onto one of its
+// neighbors, so the result is a new index list into the same
+// vertex buffer rather than a new mesh.
+//
+// UV and normal seams are kept intact: a vertex on a seam can
+// only slide along the seam (taking its twin on the other side
+// with it), vertices on open borders only slide along the
+// border, and corners where seams meet never move.  There's no
+// randomness or threading, so the same input always gives the
+// same result.
+//
+// result   - Filled with the simplified indices; may stop short
+//            of the target if nothing else can safely collapse
+// maxError - Stop before any collapse that would push the
+//            error past this
+//
+// Returns the geometric error: roughly how far (in model units)
+// the simplified surface strays from the original
+// --------------------------------------------------------
+float SimplifyMesh(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, size_t targetIndexCount, std::vector<unsigned int>& result, float maxError = FLT_MAX);
+
+// --------------------------------------------------------
+// Builds a chain of up to maxLods levels of detail, each with
+// about half the triangles of the one before.  Every level is
+// simplified from the original (so errors don't pile up) and
+// reordered for the vertex cache, then appended to indices.
+// lods[0] is always the original mesh.  The chain ends early
+// once a level can't get meaningfully smaller without its
+// error passing maxError.
+// --------------------------------------------------------
+void GenerateLods(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int maxLods, float maxError, std::vector<MeshLod>& lods);
@@ -0,0 +1,272 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Marks a vertex that isn't in the meshlet being built
+static const unsigned int NotInMeshlet = 0xFFFFFFFF;
+
+// A cone that wide can't reject anything useful
+static const float MinConeDot = 0.1f;
+
+// --------------------------------------------------------
+// Fills in the bounding sphere and backface cone of a
+// finished meshlet, following meshoptimizer's
+// computeClusterBounds()
+// --------------------------------------------------------
+static void CalculateMeshletBounds(Meshlet& meshlet, const std::vector<Vertex>& verts, const unsigned int* indices)
+{
+	unsigned int triangleCount = meshlet.IndexCount / 3;
+
+	// Sphere around the center of the box
+	XMVECTOR boxMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boxMax = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < meshlet.IndexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[indices[i]].Position);
+		boxMin = XMVectorMin(boxMin, p);
+		boxMax = XMVectorMax(boxMax, p);
+	}
+	XMVECTOR center = (boxMin + boxMax) * 0.5f;
+
+	float radiusSq = 0.0f;
+	for (unsigned int i = 0; i < meshlet.IndexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[indices[i]].Position);
+		radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(p - center)));
+	}
+	XMStoreFloat3(&meshlet.Center, center);
+	meshlet.Radius = sqrtf(radiusSq);
+
+	// Front faces wind clockwise, which in our left handed space
+	// makes cross(p1 - p0, p2 - p0) point out of the front
+	std::vector<XMVECTOR> normals;
+	normals.reserve(triangleCount);
+	XMVECTOR axis = XMVectorZero();
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+		XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+		float length = XMVectorGetX(XMVector3Length(n));
+		if (length <= 0.0f)
+			continue; // Degenerate triangles are never drawn anyway
+
+		n = n / length;
+		normals.push_back(n);
+		axis += n;
+	}
+
+	// No cone unless every triangle faces roughly the same way
+	meshlet.ConeApex = meshlet.Center;
+	meshlet.ConeAxis = XMFLOAT3(0, 0, 1);
+	meshlet.ConeCutoff = 2.0f;
+	float axisLength = XMVectorGetX(XMVector3Length(axis));
+	if (normals.empty() || axisLength <= 0.0f)
+		return;
+
+	axis = axis / axisLength;
+	float minDot = 1.0f;
+	for (XMVECTOR n : normals)
+		minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(n, axis)));
+	if (minDot <= MinConeDot)
+		return;
+
+	// Move the apex back along the axis until it's behind every
+	// triangle's plane, so the test works for nearby viewers too
+	float maxT = 0.0f;
+	for (unsigned int t = 0, n = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+		if (XMVectorGetX(XMVector3LengthSq(XMVector3Cross(p1 - p0, p2 - p0))) <= 0.0f)
+			continue;
+
+		XMVECTOR normal = normals[n++];
+		float dc = XMVectorGetX(XMVector3Dot(center - p0, normal));
+		float dn = XMVectorGetX(XMVector3Dot(axis, normal));
+		maxT = std::max(maxT, dc / dn);
+	}
+
+	XMStoreFloat3(&meshlet.ConeApex, center - axis * maxT);
+	XMStoreFloat3(&meshlet.ConeAxis, axis);
+	meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+
+void BuildMeshlets(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	size_t vertexCount = verts.size();
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles around each vertex
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (unsigned int i : indices)
+		offsets[i + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> adjacent(indices.size());
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacent[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<bool> used(triangleCount, false);
+	std::vector<unsigned int> vertexMeshlet(vertexCount, NotInMeshlet);
+	std::vector<unsigned int> meshletVerts;
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	size_t seed = 0;
+
+	while (result.size() < indices.size())
+	{
+		// Start from the first triangle nobody has claimed yet
+		while (used[seed])
+			seed++;
+
+		unsigned int id = (unsigned int)meshlets.size();
+		Meshlet meshlet = {};
+		meshlet.IndexOffset = (unsigned int)result.size();
+		meshletVerts.clear();
+		XMVECTOR positionSum = XMVectorZero();
+
+		auto addTriangle = [&](size_t t)
+		{
+			used[t] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				result.push_back(v);
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					meshletVerts.push_back(v);
+					positionSum += XMLoadFloat3(&verts[v].Position);
+				}
+			}
+			meshlet.IndexCount += 3;
+		};
+		addTriangle(seed);
+
+		while (meshlet.IndexCount / 3 < MESHLET_MAX_TRIANGLES)
+		{
+			XMVECTOR centroid = positionSum / (float)meshletVerts.size();
+
+			// Look at every unused triangle touching the meshlet
+			size_t best = triangleCount;
+			unsigned int bestNew = 4;
+			float bestDistance = FLT_MAX;
+			for (size_t i = 0; i < meshletVerts.size() && bestNew > 0; i++)
+			{
+				unsigned int v = meshletVerts[i];
+				for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+				{
+					unsigned int t = adjacent[a];
+					if (used[t])
+						continue;
+
+					unsigned int newVerts = 0;
+					for (int k = 0; k < 3; k++)
+						newVerts += vertexMeshlet[indices[t * 3 + k]] != id;
+					if (meshletVerts.size() + newVerts > MESHLET_MAX_VERTICES || newVerts > bestNew)
+						continue;
+
+					XMVECTOR triCenter =
+						XMLoadFloat3(&verts[indices[t * 3 + 0]].Position) +
+						XMLoadFloat3(&verts[indices[t * 3 + 1]].Position) +
+						XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+					float distance = XMVectorGetX(XMVector3LengthSq(triCenter / 3.0f - centroid));
+					if (newVerts < bestNew || distance < bestDistance || (distance == bestDistance && t < best))
+					{
+						best = t;
+						bestNew = newVerts;
+						bestDistance = distance;
+					}
+				}
+			}
+
+			// Full, or nothing left that's connected
+			if (best == triangleCount)
+				break;
+			addTriangle(best);
+		}
+
+		meshlet.VertexCount = (unsigned int)meshletVerts.size();
+		CalculateMeshletBounds(meshlet, verts, &result[meshlet.IndexOffset]);
+		meshlets.push_back(meshlet);
+	}
+
+	indices.swap(result);
+}
+
+
+void CullMeshlets(
+	const std::vector<Meshlet>& meshlets,
+	const XMFLOAT4X4& world,
+	const Frustum& frustum,
+	const XMFLOAT3& cameraPosition,
+	std::vector<IndexRange>& visible,
+	MeshletCullStats* stats)
+{
+	visible.clear();
+
+	// Spheres go to world space for the frustum (the largest axis
+	// scale keeps them covering their triangles)
+	XMMATRIX worldMat = XMLoadFloat4x4(&world);
+	float scale = sqrtf(std::max({
+		XMVectorGetX(XMVector3LengthSq(worldMat.r[0])),
+		XMVectorGetX(XMVector3LengthSq(worldMat.r[1])),
+		XMVectorGetX(XMVector3LengthSq(worldMat.r[2])) }));
+
+	// The camera comes to object space for the cones instead.  Whether
+	// a triangle faces a point doesn't change under any transform,
+	// so this works with non-uniform scaling too.
+	XMVECTOR localCamera = XMVector3Transform(XMLoadFloat3(&cameraPosition), XMMatrixInverse(0, worldMat));
+
+	unsigned int outsideFrustum = 0;
+	unsigned int backfacing = 0;
+	for (const Meshlet& m : meshlets)
+	{
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&m.Center), worldMat));
+		if (!SphereInFrustum(frustum, center, m.Radius * scale))
+		{
+			outsideFrustum += m.IndexCount / 3;
+			continue;
+		}
+
+		if (m.ConeCutoff <= 1.0f)
+		{
+			XMVECTOR toApex = XMVector3Normalize(XMLoadFloat3(&m.ConeApex) - localCamera);
+			if (XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&m.ConeAxis))) >= m.ConeCutoff)
+			{
+				backfacing += m.IndexCount / 3;
+				continue;
+			}
+		}
+
+		// Merge with the previous range when they touch
+		if (!visible.empty() && visible.back().IndexOffset + visible.back().IndexCount == m.IndexOffset)
+			visible.back().IndexCount += m.IndexCount;
+		else
+			visible.push_back({ m.IndexOffset, m.IndexCount });
+
+		if (stats) stats->MeshletsDrawn++;
+	}
+
+	if (stats)
+	{
+		stats->Meshlets += (unsigned int)meshlets.size();
+		for (const Meshlet& m : meshlets)
+			stats->Triangles += m.IndexCount / 3;
+		stats->TrianglesOutsideFrustum += outsideFrustum;
+		stats->TrianglesBackfacing += backfacing;
+	}
+}
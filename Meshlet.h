@@ -0,0 +1,83 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Frustum.h"
+#include "Vertex.h"
+
+// Limits on the size of one meshlet
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// --------------------------------------------------------
+// A small cluster of neighboring triangles, stored as one
+// contiguous range of the mesh's index buffer so it can be
+// drawn (or skipped) with a single DrawIndexed call
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+	unsigned int VertexCount;		// Unique vertices used, at most MESHLET_MAX_VERTICES
+
+	// Object-space bounding sphere
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+
+	// Backface cone: every triangle faces away from any viewer
+	// who sees ConeApex along a direction within the cone, i.e.
+	// dot(normalize(ConeApex - viewer), ConeAxis) >= ConeCutoff.
+	// A cutoff above 1 means the triangles face too many ways.
+	DirectX::XMFLOAT3 ConeApex;
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// A range of an index buffer to draw
+struct IndexRange
+{
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+};
+
+// Counts from CullMeshlets(), added up over any number of calls
+struct MeshletCullStats
+{
+	unsigned int Meshlets;
+	unsigned int MeshletsDrawn;
+	unsigned int Triangles;
+	unsigned int TrianglesOutsideFrustum;
+	unsigned int TrianglesBackfacing;
+};
+
+// --------------------------------------------------------
+// Splits a mesh into meshlets, reordering the triangles so
+// each one is contiguous.  Each meshlet starts from the first
+// unused triangle (in the existing, cache-friendly order) and
+// grows by the neighboring triangle that adds the fewest new
+// vertices, breaking ties by distance, until it's full.
+//
+// indices - Triangles to split up; reordered in place
+// --------------------------------------------------------
+void BuildMeshlets(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets);
+
+// --------------------------------------------------------
+// Finds the meshlets of an object that could be visible,
+// rejecting the ones outside the frustum or facing entirely
+// away from the camera.  Visible meshlets that sit next to
+// each other in the index buffer are merged into one range.
+//
+// world          - The object's world matrix
+// frustum        - World-space frustum, from CreateFrustum()
+// cameraPosition - World-space camera position
+// visible        - Cleared, then filled with ranges to draw
+// stats          - Optional; added to
+// --------------------------------------------------------
+void CullMeshlets(
+	const std::vector<Meshlet>& meshlets,
+	const DirectX::XMFLOAT4X4& world,
+	const Frustum& frustum,
+	const DirectX::XMFLOAT3& cameraPosition,
+	std::vector<IndexRange>& visible,
+	MeshletCullStats* stats = nullptr);
@@ -0,0 +1,489 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <cstring>
+#include <cmath>
+
+using namespace DirectX;
+
+// Chunks smaller than this aren't worth a thread of their own
+static const size_t MinChunkBytes = 256 * 1024;
+
+// Bits used to mark corner indices that are relative to the
+// start of their chunk (negative OBJ indices) and still need
+// the chunk's base offset added once all chunks are merged
+static const unsigned char RelativePosition = 1;
+static const unsigned char RelativeUV = 2;
+static const unsigned char RelativeNormal = 4;
+
+// --------------------------------------------------------
+// Everything parsed from one line-aligned piece of the file
+// --------------------------------------------------------
+struct ObjChunk
+{
+	const char* Begin;
+	const char* End;
+
+	std::vector<XMFLOAT3> Positions;
+	std::vector<XMFLOAT2> UVs;
+	std::vector<XMFLOAT3> Normals;
+	std::vector<ObjCorner> Corners;
+	std::vector<unsigned char> Relative; // One entry per corner
+};
+
+
+// --------------------------------------------------------
+// Small character helpers.  Deliberately not using the
+// locale-aware <cctype> versions, since they're much slower.
+// --------------------------------------------------------
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static inline void SkipSpaces(const char*& p, const char* end)
+{
+	while (p < end && IsSpace(*p)) p++;
+}
+
+// --------------------------------------------------------
+// Parses a signed integer, advancing p past it.
+// Returns false if there were no digits.
+// --------------------------------------------------------
+static bool ParseInt(const char*& p, const char* end, int& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	if (p >= end || !IsDigit(*p))
+		return false;
+
+	int value = 0;
+	while (p < end && IsDigit(*p))
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+
+	out = negative ? -value : value;
+	return true;
+}
+
+// --------------------------------------------------------
+// Parses a decimal float (with optional exponent), advancing
+// p past it.  Digits are gathered into a 64-bit integer and
+// scaled by an exact power of ten, which is plenty accurate
+// for 32-bit floats and far faster than sscanf/strtof.
+// --------------------------------------------------------
+static bool ParseFloat(const char*& p, const char* end, float& out)
+{
+	// Exactly representable powers of ten
+	static const double powersOf10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+		1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	SkipSpaces(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+
+	// Integer part
+	while (p < end && IsDigit(*p))
+	{
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) significantDigits++;
+		}
+		else
+		{
+			exponent++;
+		}
+		anyDigits = true;
+		p++;
+	}
+
+	// Fractional part
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && IsDigit(*p))
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) significantDigits++;
+				exponent--;
+			}
+			anyDigits = true;
+			p++;
+		}
+	}
+
+	if (!anyDigits)
+		return false;
+
+	// Optional exponent
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* expStart = p;
+		p++;
+		int e = 0;
+		if (ParseInt(p, end, e))
+			exponent += e;
+		else
+			p = expStart; // Not actually an exponent
+	}
+
+	// Scale the digits
+	double value = (double)mantissa;
+	if (exponent > 0)
+		value *= exponent <= 22 ? powersOf10[exponent] : pow(10.0, exponent);
+	else if (exponent < 0)
+		value /= -exponent <= 22 ? powersOf10[-exponent] : pow(10.0, -exponent);
+
+	out = (float)(negative ? -value : value);
+	return true;
+}
+
+// --------------------------------------------------------
+// Converts a raw OBJ index into our 0-based form.
+//
+// Positive indices are absolute (1-based).  Negative indices
+// count back from the most recent element, which we can only
+// express relative to the chunk for now - those get flagged
+// so the merge step can add the chunk's base offset later.
+// --------------------------------------------------------
+static int ResolveIndex(int raw, size_t countInChunk, unsigned char flag, unsigned char& relative)
+{
+	if (raw > 0)
+		return raw - 1;
+
+	if (raw < 0)
+	{
+		relative |= flag;
+		return (int)countInChunk + raw;
+	}
+
+	return -1; // Zero is never valid in OBJ
+}
+
+// --------------------------------------------------------
+// Parses a single "f" line (already past the 'f') and
+// appends its corners to the chunk as a triangle fan
+// --------------------------------------------------------
+static void ParseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<ObjCorner>& faceCorners, std::vector<unsigned char>& faceRelative)
+{
+	faceCorners.clear();
+	faceRelative.clear();
+
+	while (true)
+	{
+		SkipSpaces(p, end);
+		if (p >= end)
+			break;
+
+		// Each corner is one of: v, v/vt, v//vn or v/vt/vn
+		int raw = 0;
+		if (!ParseInt(p, end, raw))
+			break;
+
+		unsigned char relative = 0;
+		ObjCorner corner = {};
+		corner.Position = ResolveIndex(raw, chunk.Positions.size(), RelativePosition, relative);
+		corner.UV = -1;
+		corner.Normal = -1;
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (ParseInt(p, end, raw))
+				corner.UV = ResolveIndex(raw, chunk.UVs.size(), RelativeUV, relative);
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				if (ParseInt(p, end, raw))
+					corner.Normal = ResolveIndex(raw, chunk.Normals.size(), RelativeNormal, relative);
+			}
+		}
+
+		faceCorners.push_back(corner);
+		faceRelative.push_back(relative);
+
+		// Skip anything unexpected up to the next corner
+		while (p < end && !IsSpace(*p)) p++;
+	}
+
+	// Triangulate as a fan around the first corner
+	for (size_t i = 2; i < faceCorners.size(); i++)
+	{
+		chunk.Corners.push_back(faceCorners[0]);
+		chunk.Corners.push_back(faceCorners[i - 1]);
+		chunk.Corners.push_back(faceCorners[i]);
+		chunk.Relative.push_back(faceRelative[0]);
+		chunk.Relative.push_back(faceRelative[i - 1]);
+		chunk.Relative.push_back(faceRelative[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Parses every line in the chunk's range
+// --------------------------------------------------------
+static void ParseChunk(ObjChunk& chunk)
+{
+	// Rough guess at the amount of data, based on ~30 bytes per line
+	size_t lineGuess = (chunk.End - chunk.Begin) / 30;
+	chunk.Positions.reserve(lineGuess / 3);
+	chunk.Corners.reserve(lineGuess);
+	chunk.Relative.reserve(lineGuess);
+
+	// Reused for every face to avoid reallocating
+	std::vector<ObjCorner> faceCorners;
+	std::vector<unsigned char> faceRelative;
+
+	const char* p = chunk.Begin;
+	while (p < chunk.End)
+	{
+		// Find the end of this line (no length limit)
+		const char* lineEnd = (const char*)memchr(p, '\n', chunk.End - p);
+		if (!lineEnd) lineEnd = chunk.End;
+
+		SkipSpaces(p, lineEnd);
+		if (lineEnd - p >= 2)
+		{
+			if (p[0] == 'v' && IsSpace(p[1]))
+			{
+				XMFLOAT3 pos(0, 0, 0);
+				p++;
+				ParseFloat(p, lineEnd, pos.x);
+				ParseFloat(p, lineEnd, pos.y);
+				ParseFloat(p, lineEnd, pos.z);
+				chunk.Positions.push_back(pos);
+			}
+			else if (p[0] == 'v' && p[1] == 't')
+			{
+				XMFLOAT2 uv(0, 0);
+				p += 2;
+				ParseFloat(p, lineEnd, uv.x);
+				ParseFloat(p, lineEnd, uv.y);
+				chunk.UVs.push_back(uv);
+			}
+			else if (p[0] == 'v' && p[1] == 'n')
+			{
+				XMFLOAT3 norm(0, 0, 0);
+				p += 2;
+				ParseFloat(p, lineEnd, norm.x);
+				ParseFloat(p, lineEnd, norm.y);
+				ParseFloat(p, lineEnd, norm.z);
+				chunk.Normals.push_back(norm);
+			}
+			else if (p[0] == 'f' && IsSpace(p[1]))
+			{
+				ParseFace(p + 1, lineEnd, chunk, faceCorners, faceRelative);
+			}
+		}
+
+		p = lineEnd + 1;
+	}
+}
+
+
+bool LoadObj(const char* objFile, ObjData& out)
+{
+	MappedFile file(objFile);
+	if (!file.IsOpen())
+		return false;
+
+	return ParseObj(file.GetData(), file.GetSize(), out);
+}
+
+
+bool ParseObj(const char* data, size_t size, ObjData& out)
+{
+	out = ObjData();
+
+	// Split the file into chunks that each start at the beginning of a line
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(GetWorkerCount(), size / MinChunkBytes));
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* chunkStart = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = end;
+		if (i + 1 < chunkCount)
+		{
+			// Move the split point forward to just past the next newline
+			chunkEnd = std::max(chunkStart, data + size * (i + 1) / chunkCount);
+			const char* newline = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+			chunkEnd = newline ? newline + 1 : end;
+		}
+
+		chunks[i].Begin = chunkStart;
+		chunks[i].End = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// Parse every chunk in parallel
+	ParallelFor(chunkCount, 1, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				ParseChunk(chunks[i]);
+		});
+
+	// Each chunk's data lands after all of the chunks before it
+	std::vector<size_t> posBase(chunkCount), uvBase(chunkCount), normBase(chunkCount), cornerBase(chunkCount);
+	size_t posTotal = 0, uvTotal = 0, normTotal = 0, cornerTotal = 0;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		posBase[i] = posTotal;			posTotal += chunks[i].Positions.size();
+		uvBase[i] = uvTotal;			uvTotal += chunks[i].UVs.size();
+		normBase[i] = normTotal;		normTotal += chunks[i].Normals.size();
+		cornerBase[i] = cornerTotal;	cornerTotal += chunks[i].Corners.size();
+	}
+
+	out.Positions.resize(posTotal);
+	out.UVs.resize(uvTotal);
+	out.Normals.resize(normTotal);
+	out.Corners.resize(cornerTotal);
+
+	// Merge the chunks, fixing up any chunk-relative indices on the way
+	ParallelFor(chunkCount, 1, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				ObjChunk& c = chunks[i];
+				std::copy(c.Positions.begin(), c.Positions.end(), out.Positions.begin() + posBase[i]);
+				std::copy(c.UVs.begin(), c.UVs.end(), out.UVs.begin() + uvBase[i]);
+				std::copy(c.Normals.begin(), c.Normals.end(), out.Normals.begin() + normBase[i]);
+
+				for (size_t j = 0; j < c.Corners.size(); j++)
+				{
+					ObjCorner corner = c.Corners[j];
+					unsigned char relative = c.Relative[j];
+					if (relative & RelativePosition) corner.Position += (int)posBase[i];
+					if (relative & RelativeUV) corner.UV += (int)uvBase[i];
+					if (relative & RelativeNormal) corner.Normal += (int)normBase[i];
+
+					// Optional attributes that point nowhere are treated as missing
+					if (corner.UV < 0 || corner.UV >= (int)uvTotal) corner.UV = -1;
+					if (corner.Normal < 0 || corner.Normal >= (int)normTotal) corner.Normal = -1;
+
+					out.Corners[cornerBase[i] + j] = corner;
+				}
+			}
+		});
+
+	// Drop any triangles with out-of-range positions, so
+	// users of the data never have to check for them
+	size_t kept = 0;
+	for (size_t i = 0; i + 2 < out.Corners.size(); i += 3)
+	{
+		bool valid = true;
+		for (size_t j = 0; j < 3; j++)
+		{
+			int p = out.Corners[i + j].Position;
+			valid = valid && p >= 0 && p < (int)posTotal;
+		}
+
+		if (!valid)
+			continue;
+
+		if (kept != i)
+		{
+			out.Corners[kept + 0] = out.Corners[i + 0];
+			out.Corners[kept + 1] = out.Corners[i + 1];
+			out.Corners[kept + 2] = out.Corners[i + 2];
+		}
+		kept += 3;
+	}
+	out.Corners.resize(kept);
+
+	return !out.Corners.empty();
+}
+
+
+void BuildObjVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	using namespace DirectX;
+
+	verts.clear();
+	indices.clear();
+	verts.reserve(obj.Corners.size());
+	indices.reserve(obj.Corners.size());
+	unsigned int vertCounter = 0;
+
+	// Every 3 corners are one triangle
+	for (size_t c = 0; c < obj.Corners.size(); c += 3)
+	{
+		// - Create the verts by looking up
+		//    corresponding data from the parsed arrays
+		// - The loader has already made the indices 0-based
+		//    and verified that the positions exist
+		Vertex v[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const ObjCorner& corner = obj.Corners[c + i];
+			v[i].Position = obj.Positions[corner.Position];
+			v[i].UV = corner.UV >= 0 ? obj.UVs[corner.UV] : XMFLOAT2(0, 0);
+			v[i].Normal = corner.Normal >= 0 ? obj.Normals[corner.Normal] : XMFLOAT3(0, 0, 0);
+			v[i].Tangent = XMFLOAT4(0, 0, 0, 1);
+		}
+
+		// Any corners without normals get the flat face normal
+		if (obj.Corners[c].Normal < 0 || obj.Corners[c + 1].Normal < 0 || obj.Corners[c + 2].Normal < 0)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&v[0].Position);
+			XMVECTOR p1 = XMLoadFloat3(&v[1].Position);
+			XMVECTOR p2 = XMLoadFloat3(&v[2].Position);
+			XMFLOAT3 faceNormal;
+			XMStoreFloat3(&faceNormal, XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0)));
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (obj.Corners[c + i].Normal < 0)
+					v[i].Normal = faceNormal;
+			}
+		}
+
+		// The model is most likely in a right-handed space,
+		// especially if it came from Maya.  We want to convert
+		// to a left-handed space for DirectX.  This means we 
+		// need to:
+		//  - Invert the Z position
+		//  - Invert the normal's Z
+		//  - Flip the winding order
+		// We also need to flip the UV coordinate since DirectX
+		// defines (0,0) as the top left of the texture, and many
+		// 3D modeling packages use the bottom left as (0,0)
+		for (int i = 0; i < 3; i++)
+		{
+			v[i].UV.y = 1.0f - v[i].UV.y;
+			v[i].Position.z *= -1.0f;
+			v[i].Normal.z *= -1.0f;
+		}
+
+		// Add the verts to the vector (flipping the winding order)
+		verts.push_back(v[0]);
+		verts.push_back(v[2]);
+		verts.push_back(v[1]);
+
+		// Add three more indices
+		indices.push_back(vertCounter); vertCounter += 1;
+		indices.push_back(vertCounter); vertCounter += 1;
+		indices.push_back(vertCounter); vertCounter += 1;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// One corner of a face, pointing into the position/uv/normal
+// arrays of an ObjData.  Indices are 0-based, and -1 means
+// the face didn't specify that attribute.
+// --------------------------------------------------------
+struct ObjCorner
+{
+	int Position;
+	int UV;
+	int Normal;
+};
+
+// --------------------------------------------------------
+// Raw contents of an OBJ file, exactly as they appear in
+// the file (no handedness or UV flipping is applied here).
+// Every 3 corners form one triangle - faces with more than
+// 3 corners have already been split into a triangle fan.
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT2> UVs;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<ObjCorner> Corners;
+};
+
+// Memory-maps and parses the given OBJ file.  Returns false
+// if the file couldn't be opened or contained no faces.
+bool LoadObj(const char* objFile, ObjData& out);
+
+// Parses OBJ text that is already in memory.  Large inputs
+// are split into line-aligned chunks parsed in parallel.
+bool ParseObj(const char* data, size_t size, ObjData& out);
+
+// Turns parsed OBJ data into one vertex per face corner, ready
+// for DirectX: Z and the winding order are flipped into a left-
+// handed space, V is flipped, and corners without normals get
+// the flat face normal.  Indices are simply 0..corners-1.
+void BuildObjVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
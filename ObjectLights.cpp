@@ -0,0 +1,247 @@
+#include "ObjectLights.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Parallel.h"
+#include "Simd.h"
+#include "Timer.h"
+
+using namespace DirectX;
+
+// The shaders' range attenuation (see Attenuate() in
+// Lighting.hlsli), from the squared distance and 1 / range^2
+static inline Lanes Attenuate(Lanes distanceSquared, Lanes invRangeSquared)
+{
+	Lanes att = Max(Sub(Splat(1.0f), Mul(distanceSquared, invRangeSquared)), Zero());
+	return Mul(att, att);
+}
+
+// Averaged over every direction a surface could face, a
+// light's diffuse N dot L comes to a quarter
+static const float DroppedLightScale = 0.25f;
+
+// Fewer groups of objects than this aren't worth a thread
+static const size_t MinGroupsPerThread = 64;
+
+// How bright a color looks, for ranking lights
+static inline float Brightness(const XMFLOAT3& color)
+{
+	return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// 1 / range^2, with 0 for lights that reach everywhere and
+// lights with no range (whose weight is 0 anyway)
+static inline float InvRangeSquared(const Light& light)
+{
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL || !(light.Range > 0.0f))
+		return 0.0f;
+	return 1.0f / (light.Range * light.Range);
+}
+
+ObjectLightSelector::ObjectLightSelector()
+	: count(0), stats()
+{
+}
+
+
+void ObjectLightSelector::Clear()
+{
+	count = 0;
+}
+
+
+unsigned int ObjectLightSelector::AddObject(const XMFLOAT3& center, float radius)
+{
+	// Grow a whole group at a time, so the padding is always there
+	if (count == centerX.size())
+	{
+		size_t size = centerX.size() + LaneCount;
+		centerX.resize(size, 0.0f);
+		centerY.resize(size, 0.0f);
+		centerZ.resize(size, 0.0f);
+		this->radius.resize(size, 0.0f);
+	}
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	this->radius[count] = radius;
+	return count++;
+}
+
+
+float ObjectLightSelector::GetLightWeight(const Light& light, const XMFLOAT3& center, float radius)
+{
+	if (light.Type != LIGHT_TYPE_DIRECTIONAL && !(light.Range > 0.0f))
+		return 0.0f;
+
+	float dx = center.x - light.Position.x;
+	float dy = center.y - light.Position.y;
+	float dz = center.z - light.Position.z;
+	float nearest = std::max(sqrtf(dx * dx + dy * dy + dz * dz) - radius, 0.0f);
+	float att = std::max(1.0f - nearest * nearest * InvRangeSquared(light), 0.0f);
+	return att * att * light.Intensity * Brightness(light.Color);
+}
+
+
+void ObjectLightSelector::Select(const std::vector<Light>& lights)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	size_t lightCount = lights.size();
+	lightX.resize(lightCount);
+	lightY.resize(lightCount);
+	lightZ.resize(lightCount);
+	lightInvRangeSq.resize(lightCount);
+	lightWeight.resize(lightCount);
+	lightR.resize(lightCount);
+	lightG.resize(lightCount);
+	lightB.resize(lightCount);
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		const Light& light = lights[i];
+		bool reaches = light.Type == LIGHT_TYPE_DIRECTIONAL || light.Range > 0.0f;
+		float intensity = reaches ? light.Intensity : 0.0f;
+
+		lightX[i] = light.Position.x;
+		lightY[i] = light.Position.y;
+		lightZ[i] = light.Position.z;
+		lightInvRangeSq[i] = InvRangeSquared(light);
+		lightWeight[i] = intensity * Brightness(light.Color);
+		lightR[i] = intensity * light.Color.x;
+		lightG[i] = intensity * light.Color.y;
+		lightB[i] = intensity * light.Color.z;
+	}
+
+	// Each group of objects only writes its own lists
+	size_t groups = (count + LaneCount - 1) / LaneCount;
+	lists.resize(count);
+	reachingPerGroup.assign(groups, 0);
+	ParallelFor(groups, MinGroupsPerThread, [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; g++)
+			SelectGroup(g * LaneCount);
+	});
+
+	stats = {};
+	stats.Objects = count;
+	stats.Lights = (unsigned int)lightCount;
+	for (unsigned int reaching : reachingPerGroup)
+		stats.Reaching += reaching;
+	for (const ObjectLightList& list : lists)
+		stats.Kept += list.Count;
+	stats.SelectMs = MillisecondsSince(start);
+}
+
+
+// --------------------------------------------------------
+// Picks the lights for the SIMD group of objects starting at
+// first.  Each object keeps its list sorted strongest first,
+// and a light only has to be looked at on its own for objects
+// where it beats the weakest light in a full list.
+// --------------------------------------------------------
+void ObjectLightSelector::SelectGroup(size_t first)
+{
+	Lanes cx = Load(&centerX[first]);
+	Lanes cy = Load(&centerY[first]);
+	Lanes cz = Load(&centerZ[first]);
+	Lanes r = Load(&radius[first]);
+
+	// Each object's list so far, with each kept light's weight and
+	// its attenuation at the center (to take back out of the
+	// dropped light at the end)
+	ObjectLightList found[LaneCount] = {};
+	float keptWeight[LaneCount][MAX_OBJECT_LIGHTS];
+	float keptCenter[LaneCount][MAX_OBJECT_LIGHTS];
+
+	// What a light has to beat to get in, which stays 0 until an
+	// object's list is full
+	float threshold[LaneCount] = {};
+	Lanes limit = Zero();
+
+	Lanes reaching = Zero();
+	Lanes droppedR = Zero(), droppedG = Zero(), droppedB = Zero();
+	for (size_t i = 0; i < lightX.size(); i++)
+	{
+		Lanes dx = Sub(cx, Splat(lightX[i]));
+		Lanes dy = Sub(cy, Splat(lightY[i]));
+		Lanes dz = Sub(cz, Splat(lightZ[i]));
+		Lanes distanceSquared = Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz));
+		Lanes nearest = Max(Sub(Sqrt(distanceSquared), r), Zero());
+
+		Lanes invRangeSquared = Splat(lightInvRangeSq[i]);
+		Lanes weight = Mul(Attenuate(Mul(nearest, nearest), invRangeSquared), Splat(lightWeight[i]));
+		Lanes center = Attenuate(distanceSquared, invRangeSquared);
+
+		// Everything in range counts as dropped for now
+		reaching = Add(reaching, And(Less(Zero(), weight), Splat(1.0f)));
+		droppedR = Add(droppedR, Mul(center, Splat(lightR[i])));
+		droppedG = Add(droppedG, Mul(center, Splat(lightG[i])));
+		droppedB = Add(droppedB, Mul(center, Splat(lightB[i])));
+
+		unsigned int better = Mask(Less(limit, weight));
+		if (better == 0)
+			continue;
+
+		float weights[LaneCount], centers[LaneCount];
+		Store(weights, weight);
+		Store(centers, center);
+		for (size_t lane = 0; lane < LaneCount; lane++)
+		{
+			if (!(better & (1u << lane)))
+				continue;
+
+			// After everything at least as strong, so ties keep the
+			// light that came first
+			ObjectLightList& list = found[lane];
+			unsigned int slot = 0;
+			while (slot < list.Count && keptWeight[lane][slot] >= weights[lane])
+				slot++;
+
+			unsigned int last = std::min(list.Count, (unsigned int)MAX_OBJECT_LIGHTS - 1);
+			for (unsigned int k = last; k > slot; k--)
+			{
+				list.Indices[k] = list.Indices[k - 1];
+				keptWeight[lane][k] = keptWeight[lane][k - 1];
+				keptCenter[lane][k] = keptCenter[lane][k - 1];
+			}
+			list.Indices[slot] = (unsigned int)i;
+			keptWeight[lane][slot] = weights[lane];
+			keptCenter[lane][slot] = centers[lane];
+			list.Count = last + 1;
+
+			if (list.Count == MAX_OBJECT_LIGHTS)
+				threshold[lane] = keptWeight[lane][MAX_OBJECT_LIGHTS - 1];
+		}
+		limit = Load(threshold);
+	}
+
+	// Take the kept lights back out of the dropped light
+	float dropped[3][LaneCount], reached[LaneCount];
+	Store(dropped[0], droppedR);
+	Store(dropped[1], droppedG);
+	Store(dropped[2], droppedB);
+	Store(reached, reaching);
+	unsigned int reachingTotal = 0;
+	for (size_t lane = 0; lane < LaneCount && first + lane < count; lane++)
+	{
+		ObjectLightList& list = found[lane];
+		for (unsigned int k = 0; k < list.Count; k++)
+		{
+			unsigned int light = list.Indices[k];
+			dropped[0][lane] -= keptCenter[lane][k] * lightR[light];
+			dropped[1][lane] -= keptCenter[lane][k] * lightG[light];
+			dropped[2][lane] -= keptCenter[lane][k] * lightB[light];
+		}
+		list.DroppedColor = XMFLOAT3(
+			std::max(dropped[0][lane], 0.0f) * DroppedLightScale,
+			std::max(dropped[1][lane], 0.0f) * DroppedLightScale,
+			std::max(dropped[2][lane], 0.0f) * DroppedLightScale);
+
+		lists[first + lane] = list;
+		reachingTotal += (unsigned int)reached[lane];
+	}
+	reachingPerGroup[first / LaneCount] = reachingTotal;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Lights.h"
+
+// How many lights an object's list holds.  Must match the
+// perObject cbuffer in ObjectLights.hlsli.
+#define MAX_OBJECT_LIGHTS 8
+
+// --------------------------------------------------------
+// The lights picked for one object, laid out like the
+// perObject cbuffer in ObjectLights.hlsli.  DroppedColor is
+// the light that reached the object from lights that didn't
+// make the list, for the shaders to add as a flat ambient.
+// --------------------------------------------------------
+struct ObjectLightList
+{
+	unsigned int		Indices[MAX_OBJECT_LIGHTS];	// Strongest first
+	DirectX::XMFLOAT3	DroppedColor;
+	unsigned int		Count;
+};
+
+// What the last Select() did
+struct ObjectLightStats
+{
+	unsigned int Objects;
+	unsigned int Lights;
+	unsigned int Reaching;	// Light and object pairs in range of each other
+	unsigned int Kept;		// Of those, how many made the lists
+	double SelectMs;
+};
+
+// --------------------------------------------------------
+// Per-object light lists for forward shading, an alternative
+// to the light grid for scenes with only a few lights.
+//
+// Each object's bounding sphere picks the MAX_OBJECT_LIGHTS
+// lights that reach it hardest: each light is weighted by its
+// intensity and brightness, attenuated the way the shaders do
+// to the nearest point of the sphere.  Ties go to the light
+// that comes first.  Lights in range that don't make the list
+// are summed into DroppedColor (attenuated to the center, and
+// averaged over every way a surface could face).
+//
+// Objects are stored one array per component and tested a
+// SIMD register's worth at a time against each light, and
+// groups of objects are spread across worker threads.  Only
+// objects with a light worth keeping leave the SIMD path to
+// update their lists.
+// --------------------------------------------------------
+class ObjectLightSelector
+{
+public:
+	ObjectLightSelector();
+
+	// Forgets every object, keeping the memory for next time
+	void Clear();
+
+	// Adds an object's world-space bounding sphere, returning its
+	// index (objects are numbered from 0 in the order they were
+	// added)
+	unsigned int AddObject(const DirectX::XMFLOAT3& center, float radius);
+
+	// Picks every object's lights
+	void Select(const std::vector<Light>& lights);
+
+	// How much a light reaches an object's sphere, as Select()
+	// ranks them (0 when it's out of range)
+	static float GetLightWeight(const Light& light, const DirectX::XMFLOAT3& center, float radius);
+
+	const ObjectLightList& GetList(unsigned int object) const { return lists[object]; }
+	unsigned int GetCount() const { return count; }
+	const ObjectLightStats& GetStats() const { return stats; }
+
+private:
+	// Spheres by object, padded out to whole SIMD groups
+	std::vector<float> centerX, centerY, centerZ, radius;
+	unsigned int count;
+
+	// This frame's lights, one array per component.  Weight is
+	// intensity times brightness, the color is scaled by the
+	// intensity, and directional lights have an infinite range
+	// (so 0 here).
+	std::vector<float> lightX, lightY, lightZ, lightInvRangeSq, lightWeight;
+	std::vector<float> lightR, lightG, lightB;
+
+	std::vector<ObjectLightList> lists;
+	std::vector<unsigned int> reachingPerGroup;	// While selecting
+	ObjectLightStats stats;
+
+	void SelectGroup(size_t first);
+};
@@ -0,0 +1,47 @@
+// Include guard
+#ifndef _OBJECT_LIGHTS_HLSL
+#define _OBJECT_LIGHTS_HLSL
+
+#include "PerFrame.hlsli"
+
+// The lights picked for this object on the CPU, used in place
+// of the light grid when objectLighting is set.  Must match
+// ObjectLightList in ObjectLights.h.
+cbuffer perObject : register(b1)
+{
+	// Up to 8 light indices, strongest first
+	uint4 objectLights[2];
+
+	// Light from the lights that reach this object but didn't
+	// make the list, added as a flat ambient
+	float3 droppedLightColor;
+
+	uint objectLightCount;
+};
+
+// --------------------------------------------------------
+// The lights to loop over for a pixel: an offset and count
+// into its cluster's lights, or into the object's own list
+// --------------------------------------------------------
+uint2 GetPixelLights(float2 pixel, float3 worldPos)
+{
+	if (objectLighting)
+		return uint2(0, objectLightCount);
+	return GetLightCluster(pixel, worldPos);
+}
+
+// The nth light from GetPixelLights()
+uint GetPixelLight(uint2 pixelLights, uint n)
+{
+	if (objectLighting)
+		return objectLights[n / 4][n % 4];
+	return lightIndices[pixelLights.x + n];
+}
+
+// Light the object's list left out, as ambient
+float3 GetDroppedLight()
+{
+	return objectLighting ? droppedLightColor : float3(0, 0, 0);
+}
+
+#endif
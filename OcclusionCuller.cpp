@@ -0,0 +1,354 @@
+#include "OcclusionCuller.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+using namespace DirectX;
+
+// Pixels along each side of a tile
+static const int TileSize = 8;
+
+// Points this close to the camera (in clip space w) count as
+// crossing the near plane
+static const float MinW = 1e-4f;
+
+// How much nearer than an occluder an object has to be to count
+// as in front of it, which covers the rounding in depths worked
+// out two different ways (and lets occluders pass their own test)
+static const float DepthBias = 1e-6f;
+
+// Threads only get started when there's enough to do, since the
+// usual scene has a handful of occluder triangles
+static const size_t MinTrianglesForThreads = 256;
+static const size_t MinTileRowsPerThread = 4;
+static const size_t MinObjectsPerThread = 256;
+
+// Where each lane's pixel center is, across a register's
+// worth of pixels.  Tiles are a whole number of registers
+// wide either way.
+#if defined(__AVX2__)
+static inline Lanes LaneOffsets() { return _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f); }
+#else
+static inline Lanes LaneOffsets() { return _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f); }
+#endif
+
+// Clamps before converting, since points near the camera plane
+// can land a long way off the screen
+static int ClampToInt(float f, int low, int high)
+{
+	return (int)std::min((float)high, std::max((float)low, f));
+}
+
+
+OccluderMesh CreateBoxOccluder(const MeshBounds& bounds)
+{
+	OccluderMesh box;
+	for (int c = 0; c < 8; c++)
+	{
+		box.Positions.push_back(XMFLOAT3(
+			(c & 1) ? bounds.Max.x : bounds.Min.x,
+			(c & 2) ? bounds.Max.y : bounds.Min.y,
+			(c & 4) ? bounds.Max.z : bounds.Min.z));
+	}
+
+	// Two triangles per face.  Winding doesn't matter, since
+	// both sides of an occluder hide things.
+	const unsigned int faces[6][4] =
+	{
+		{ 0, 2, 6, 4 }, { 1, 3, 7, 5 },	// -X, +X
+		{ 0, 1, 5, 4 }, { 2, 3, 7, 6 },	// -Y, +Y
+		{ 0, 1, 3, 2 }, { 4, 5, 7, 6 },	// -Z, +Z
+	};
+	for (const auto& f : faces)
+	{
+		unsigned int quad[6] = { f[0], f[1], f[2], f[0], f[2], f[3] };
+		box.Indices.insert(box.Indices.end(), quad, quad + 6);
+	}
+	return box;
+}
+
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+	: width(width), height(height), stats()
+{
+	tilesX = (width + TileSize - 1) / TileSize;
+	tilesY = (height + TileSize - 1) / TileSize;
+	bufferWidth = tilesX * TileSize;
+	bufferHeight = tilesY * TileSize;
+
+	depth.assign((size_t)bufferWidth * bufferHeight, 1.0f);
+	tileMaxDepth.assign((size_t)tilesX * tilesY, 1.0f);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+}
+
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+	triangles.clear();
+	stats = {};
+}
+
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& occluder, const XMFLOAT4X4& world)
+{
+	// Every vertex into pixel coordinates, once
+	XMMATRIX toClip = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection));
+	std::vector<XMFLOAT4> screen(occluder.Positions.size());
+	for (size_t i = 0; i < occluder.Positions.size(); i++)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&occluder.Positions[i]), toClip));
+
+		// w is only kept to say whether the point is behind us
+		float invW = clip.w > MinW ? 1.0f / clip.w : 0.0f;
+		screen[i] = XMFLOAT4(
+			(clip.x * invW * 0.5f + 0.5f) * width,
+			(0.5f - clip.y * invW * 0.5f) * height,
+			clip.z * invW,
+			clip.w);
+	}
+
+	for (size_t i = 0; i + 2 < occluder.Indices.size(); i += 3)
+	{
+		const XMFLOAT4* v[3] =
+		{
+			&screen[occluder.Indices[i]],
+			&screen[occluder.Indices[i + 1]],
+			&screen[occluder.Indices[i + 2]]
+		};
+		if (v[0]->w <= MinW || v[1]->w <= MinW || v[2]->w <= MinW)
+			continue;
+
+		// Same orientation for everything, so inside is always
+		// where all three edge functions are positive
+		float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[2]->x - v[0]->x) * (v[1]->y - v[0]->y);
+		if (area == 0.0f)
+			continue;
+		if (area < 0.0f)
+			std::swap(v[1], v[2]);
+
+		ScreenTriangle tri;
+		float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+		for (int c = 0; c < 3; c++)
+		{
+			tri.X[c] = v[c]->x;
+			tri.Y[c] = v[c]->y;
+			tri.Z[c] = v[c]->z;
+			minX = std::min(minX, v[c]->x);
+			maxX = std::max(maxX, v[c]->x);
+			minY = std::min(minY, v[c]->y);
+			maxY = std::max(maxY, v[c]->y);
+		}
+
+		// Pixels whose centers could be inside, clamped to the screen
+		tri.MinX = ClampToInt(floorf(minX - 0.5f), 0, width);
+		tri.MaxX = ClampToInt(ceilf(maxX - 0.5f), -1, width - 1);
+		tri.MinY = ClampToInt(floorf(minY - 0.5f), 0, height);
+		tri.MaxY = ClampToInt(ceilf(maxY - 0.5f), -1, height - 1);
+		if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+			continue;
+
+		triangles.push_back(tri);
+	}
+
+	stats.Occluders++;
+}
+
+
+void OcclusionCuller::RasterizeOccluders()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Each thread gets its own band of tile rows and goes through
+	// every triangle, so no two threads touch the same pixels
+	size_t minRows = triangles.size() < MinTrianglesForThreads ? tilesY : MinTileRowsPerThread;
+	ParallelFor(tilesY, minRows, [&](size_t begin, size_t end)
+	{
+		int rowBegin = (int)begin * TileSize;
+		int rowEnd = (int)end * TileSize;
+		for (const ScreenTriangle& tri : triangles)
+		{
+			if (tri.MaxY >= rowBegin && tri.MinY < rowEnd)
+				RasterizeTriangle(tri, rowBegin, rowEnd);
+		}
+
+		for (size_t tileRow = begin; tileRow < end; tileRow++)
+			UpdateTileDepths((unsigned int)tileRow);
+	});
+
+	stats.Triangles = (unsigned int)triangles.size();
+	stats.RasterMs = MillisecondsSince(start);
+}
+
+
+// --------------------------------------------------------
+// Writes the nearer of the triangle and what's already there
+// into every pixel whose center is inside the triangle, for
+// the rows in [rowBegin, rowEnd)
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& tri, int rowBegin, int rowEnd)
+{
+	// Edge functions, as a*x + b*y + c, positive on the inside
+	float a[3], b[3], c[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int next = (e + 1) % 3;
+		a[e] = tri.Y[e] - tri.Y[next];
+		b[e] = tri.X[next] - tri.X[e];
+		c[e] = -(a[e] * tri.X[e] + b[e] * tri.Y[e]);
+	}
+
+	// Depth over the screen is a plane, so it's the same form
+	float area = (tri.X[1] - tri.X[0]) * (tri.Y[2] - tri.Y[0]) - (tri.X[2] - tri.X[0]) * (tri.Y[1] - tri.Y[0]);
+	float dzdx = ((tri.Z[1] - tri.Z[0]) * (tri.Y[2] - tri.Y[0]) - (tri.Z[2] - tri.Z[0]) * (tri.Y[1] - tri.Y[0])) / area;
+	float dzdy = ((tri.Z[2] - tri.Z[0]) * (tri.X[1] - tri.X[0]) - (tri.Z[1] - tri.Z[0]) * (tri.X[2] - tri.X[0])) / area;
+	float dzc = tri.Z[0] - dzdx * tri.X[0] - dzdy * tri.Y[0];
+
+	Lanes a0 = Splat(a[0]), a1 = Splat(a[1]), a2 = Splat(a[2]);
+	Lanes zx = Splat(dzdx);
+	Lanes zero = Splat(0.0f);
+
+	int firstRow = std::max(tri.MinY, rowBegin);
+	int lastRow = std::min(tri.MaxY, rowEnd - 1);
+	int firstX = tri.MinX - tri.MinX % (int)LaneCount;
+	for (int y = firstRow; y <= lastRow; y++)
+	{
+		float py = y + 0.5f;
+		Lanes rowE0 = Splat(b[0] * py + c[0]);
+		Lanes rowE1 = Splat(b[1] * py + c[1]);
+		Lanes rowE2 = Splat(b[2] * py + c[2]);
+		Lanes rowZ = Splat(dzdy * py + dzc);
+
+		float* row = &depth[(size_t)y * bufferWidth];
+		for (int x = firstX; x <= tri.MaxX; x += (int)LaneCount)
+		{
+			Lanes px = Add(Splat((float)x), LaneOffsets());
+			Lanes inside = And(
+				And(GreaterEqual(Add(Mul(a0, px), rowE0), zero), GreaterEqual(Add(Mul(a1, px), rowE1), zero)),
+				GreaterEqual(Add(Mul(a2, px), rowE2), zero));
+			if (!Any(inside))
+				continue;
+
+			Lanes z = Add(Mul(zx, px), rowZ);
+			Lanes old = Load(row + x);
+			Store(row + x, Select(old, Min(old, z), inside));
+		}
+	}
+}
+
+
+void OcclusionCuller::UpdateTileDepths(unsigned int tileRow)
+{
+	for (unsigned int tx = 0; tx < tilesX; tx++)
+	{
+		Lanes farthest = Splat(0.0f);
+		for (int y = 0; y < TileSize; y++)
+		{
+			const float* row = &depth[((size_t)tileRow * TileSize + y) * bufferWidth + (size_t)tx * TileSize];
+			for (int x = 0; x < TileSize; x += (int)LaneCount)
+				farthest = Max(farthest, Load(row + x));
+		}
+		tileMaxDepth[(size_t)tileRow * tilesX + tx] = HorizontalMax(farthest);
+	}
+}
+
+
+bool OcclusionCuller::IsVisible(const XMFLOAT3& center, const XMFLOAT3& halfExtent) const
+{
+	// Screen rectangle and nearest depth of the box's corners
+	XMMATRIX toClip = XMLoadFloat4x4(&viewProjection);
+	float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (int c = 0; c < 8; c++)
+	{
+		XMFLOAT3 corner(
+			center.x + ((c & 1) ? halfExtent.x : -halfExtent.x),
+			center.y + ((c & 2) ? halfExtent.y : -halfExtent.y),
+			center.z + ((c & 4) ? halfExtent.z : -halfExtent.z));
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), toClip));
+		if (clip.w <= MinW)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y * invW * 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * invW);
+	}
+
+	// Every pixel the box touches at all, not just by its center
+	int x0 = ClampToInt(floorf(minX), 0, width);
+	int x1 = ClampToInt(ceilf(maxX) - 1.0f, -1, width - 1);
+	int y0 = ClampToInt(floorf(minY), 0, height);
+	int y1 = ClampToInt(ceilf(maxY) - 1.0f, -1, height - 1);
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	nearest -= DepthBias;
+	for (int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+	{
+		for (int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+		{
+			// All of the tile is in front of the box
+			if (tileMaxDepth[(size_t)ty * tilesX + tx] < nearest)
+				continue;
+
+			// Otherwise check the pixels the box covers
+			int px0 = std::max(x0, tx * TileSize), px1 = std::min(x1, tx * TileSize + TileSize - 1);
+			int py0 = std::max(y0, ty * TileSize), py1 = std::min(y1, ty * TileSize + TileSize - 1);
+			for (int y = py0; y <= py1; y++)
+			{
+				const float* row = &depth[(size_t)y * bufferWidth];
+				for (int x = px0; x <= px1; x++)
+				{
+					if (row[x] >= nearest)
+						return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+
+unsigned int OcclusionCuller::Cull(const FrustumCuller& bounds, std::vector<unsigned int>& visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<unsigned char> keep(visible.size());
+	ParallelFor(visible.size(), MinObjectsPerThread, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			XMFLOAT3 center, halfExtent;
+			bounds.GetBox(visible[i], center, halfExtent);
+			keep[i] = IsVisible(center, halfExtent);
+		}
+	});
+
+	size_t kept = 0;
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		if (keep[i])
+			visible[kept++] = visible[i];
+	}
+
+	stats.Tested += (unsigned int)visible.size();
+	stats.Occluded += (unsigned int)(visible.size() - kept);
+	stats.TestMs += MillisecondsSince(start);
+	visible.resize(kept);
+	return (unsigned int)kept;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "FrustumCuller.h"
+
+// --------------------------------------------------------
+// Cut down geometry for hiding other objects: just positions
+// and triangles.  It has to stay inside the real mesh, or
+// things it covers that the real mesh doesn't will vanish.
+// --------------------------------------------------------
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<unsigned int> Indices;
+};
+
+// The mesh's bounding box as an occluder, for meshes that fill
+// their box (walls, floors, crates)
+OccluderMesh CreateBoxOccluder(const MeshBounds& bounds);
+
+// What the last frame's occlusion culling did
+struct OcclusionStats
+{
+	unsigned int Occluders;
+	unsigned int Triangles;		// Occluder triangles rasterized
+	unsigned int Tested;		// Objects tested against them
+	unsigned int Occluded;		// Objects found to be hidden
+	double RasterMs;
+	double TestMs;
+};
+
+// --------------------------------------------------------
+// Software occlusion culling on the CPU.
+//
+// Occluders are rasterized into a small depth buffer, split
+// into 8x8 pixel tiles, with several pixels done per SIMD
+// instruction and bands of tile rows spread across worker
+// threads.  Each tile also keeps the farthest depth in it, so
+// testing an object's box usually only has to look at one
+// number per tile rather than every pixel.
+//
+// An object is hidden when the nearest point of its box is
+// behind the occluders at every pixel the box could cover.
+// Occluders cover a pixel when its center is inside them, so
+// the edges of an occluder are only as exact as a pixel of
+// this buffer; otherwise mistakes only ever keep things that
+// could have been culled.  Occluders are tested like anything
+// else, and pass.
+//
+// Per frame: BeginFrame(), AddOccluder() for each occluder,
+// RasterizeOccluders(), then IsVisible() or Cull() as often as
+// needed.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	// Size of the depth buffer in pixels, which doesn't have to
+	// match the screen (only its aspect ratio should)
+	OcclusionCuller(unsigned int width, unsigned int height);
+
+	// Clears the depth buffer and occluders for a new view
+	void BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+	// Queues up the occluder's triangles, moved into place by the
+	// world matrix.  Triangles crossing the near plane are dropped
+	// rather than clipped, which only loses a little occlusion.
+	void AddOccluder(const OccluderMesh& occluder, const DirectX::XMFLOAT4X4& world);
+
+	// Draws every queued triangle into the depth buffer
+	void RasterizeOccluders();
+
+	// Whether any part of the world-space box (given by its center
+	// and half its size along each axis) might not be hidden.
+	// Boxes crossing the near plane or off the screen always are.
+	bool IsVisible(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfExtent) const;
+
+	// Removes the hidden objects from visible (indices into the
+	// frustum culler, whose boxes are tested), keeping the order,
+	// and returns how many are left
+	unsigned int Cull(const FrustumCuller& bounds, std::vector<unsigned int>& visible);
+
+	// Depth of a pixel after RasterizeOccluders(), 1 where there's
+	// no occluder
+	float GetDepth(unsigned int x, unsigned int y) const { return depth[y * bufferWidth + x]; }
+
+	unsigned int GetWidth() const { return width; }
+	unsigned int GetHeight() const { return height; }
+	const OcclusionStats& GetStats() const { return stats; }
+
+private:
+	// A triangle in pixel coordinates, with depth from 0 (near)
+	// to 1 (far), and the pixel rows it touches
+	struct ScreenTriangle
+	{
+		float X[3], Y[3], Z[3];
+		int MinX, MaxX, MinY, MaxY; // Inclusive
+	};
+
+	unsigned int width, height;
+
+	// Rounded up to whole tiles
+	unsigned int bufferWidth, bufferHeight;
+	unsigned int tilesX, tilesY;
+
+	std::vector<float> depth;		// Per pixel, row by row
+	std::vector<float> tileMaxDepth;	// Farthest depth in each tile
+	std::vector<ScreenTriangle> triangles;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	OcclusionStats stats;
+
+	void RasterizeTriangle(const ScreenTriangle& tri, int rowBegin, int rowEnd);
+	void UpdateTileDepths(unsigned int tileRow);
+};
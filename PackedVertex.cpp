@@ -0,0 +1,116 @@
+#include "PackedVertex.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match the input layout in Mesh.cpp");
+
+// --------------------------------------------------------
+// Float <-> normalized integer conversions, matching the
+// way D3D converts UNORM/SNORM formats when fetching
+// --------------------------------------------------------
+static inline unsigned short ToUnorm16(float f)
+{
+	f = std::min(std::max(f, 0.0f), 1.0f);
+	return (unsigned short)(f * 65535.0f + 0.5f);
+}
+
+static inline short ToSnorm16(float f)
+{
+	f = std::min(std::max(f, -1.0f), 1.0f);
+	return (short)roundf(f * 32767.0f);
+}
+
+static inline float FromSnorm16(short s)
+{
+	return std::max(s / 32767.0f, -1.0f);
+}
+
+// Sign that treats 0 as positive, so the octahedron's
+// folds don't collapse onto the axes
+static inline float SignNotZero(float f)
+{
+	return f >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Per-axis scale from the bounds, guarding against flat meshes
+static inline float InverseExtent(float minValue, float maxValue)
+{
+	float extent = maxValue - minValue;
+	return extent > 0.0f ? 1.0f / extent : 0.0f;
+}
+
+
+XMFLOAT2 OctahedralEncode(XMFLOAT3 n)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum <= 0.0f)
+		return XMFLOAT2(0, 0);
+	float x = n.x / sum;
+	float y = n.y / sum;
+
+	// Fold the lower half over the diagonals
+	if (n.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+	return XMFLOAT2(x, y);
+}
+
+
+XMFLOAT3 OctahedralDecode(XMFLOAT2 e)
+{
+	XMFLOAT3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+
+	// Unfold the lower half
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+
+PackedVertex PackVertex(const Vertex& v, const MeshBounds& bounds)
+{
+	PackedVertex p;
+	p.Position[0] = ToUnorm16((v.Position.x - bounds.Min.x) * InverseExtent(bounds.Min.x, bounds.Max.x));
+	p.Position[1] = ToUnorm16((v.Position.y - bounds.Min.y) * InverseExtent(bounds.Min.y, bounds.Max.y));
+	p.Position[2] = ToUnorm16((v.Position.z - bounds.Min.z) * InverseExtent(bounds.Min.z, bounds.Max.z));
+	p.Position[3] = v.Tangent.w < 0.0f ? 0 : 65535;
+
+	XMFLOAT2 normal = OctahedralEncode(v.Normal);
+	p.Normal[0] = ToSnorm16(normal.x);
+	p.Normal[1] = ToSnorm16(normal.y);
+
+	XMFLOAT2 tangent = OctahedralEncode(XMFLOAT3(v.Tangent.x, v.Tangent.y, v.Tangent.z));
+	p.Tangent[0] = ToSnorm16(tangent.x);
+	p.Tangent[1] = ToSnorm16(tangent.y);
+
+	p.UV[0] = XMConvertFloatToHalf(v.UV.x);
+	p.UV[1] = XMConvertFloatToHalf(v.UV.y);
+	return p;
+}
+
+
+Vertex UnpackVertex(const PackedVertex& p, const MeshBounds& bounds)
+{
+	Vertex v;
+	v.Position.x = bounds.Min.x + p.Position[0] / 65535.0f * (bounds.Max.x - bounds.Min.x);
+	v.Position.y = bounds.Min.y + p.Position[1] / 65535.0f * (bounds.Max.y - bounds.Min.y);
+	v.Position.z = bounds.Min.z + p.Position[2] / 65535.0f * (bounds.Max.z - bounds.Min.z);
+	v.Normal = OctahedralDecode(XMFLOAT2(FromSnorm16(p.Normal[0]), FromSnorm16(p.Normal[1])));
+	XMFLOAT3 tangent = OctahedralDecode(XMFLOAT2(FromSnorm16(p.Tangent[0]), FromSnorm16(p.Tangent[1])));
+	v.Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, p.Position[3] == 0 ? -1.0f : 1.0f);
+	v.UV.x = XMConvertHalfToFloat(p.UV[0]);
+	v.UV.y = XMConvertHalfToFloat(p.UV[1]);
+	return v;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "Bounds.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Which vertex format a mesh uploads to the GPU
+// --------------------------------------------------------
+enum class VertexLayout
+{
+	Full,	// Vertex - 48 bytes of floats
+	Packed	// PackedVertex - 20 bytes, decoded in the vertex shader
+};
+
+// --------------------------------------------------------
+// A compact vertex, decoded by VertexShaderPacked.hlsl
+//
+//  - Position: 16-bit unorm, relative to the mesh's bounding
+//    box (so the shader needs the box's min and size).  The w
+//    channel holds the tangent's handedness: 0 is -1, 1 is +1.
+//  - Normal & tangent: octahedral encoding, 16-bit snorm
+//  - UV: half floats
+// --------------------------------------------------------
+struct PackedVertex
+{
+	unsigned short Position[4];
+	short Normal[2];
+	short Tangent[2];
+	DirectX::PackedVector::HALF UV[2];
+};
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2, and back
+DirectX::XMFLOAT2 OctahedralEncode(DirectX::XMFLOAT3 n);
+DirectX::XMFLOAT3 OctahedralDecode(DirectX::XMFLOAT2 e);
+
+// Packs a single vertex.  Positions outside the bounds are clamped.
+PackedVertex PackVertex(const Vertex& v, const MeshBounds& bounds);
+
+// The CPU version of what the packed vertex shader does
+Vertex UnpackVertex(const PackedVertex& p, const MeshBounds& bounds);
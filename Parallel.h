@@ -0,0 +1,62 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// --------------------------------------------------------
+// How many threads are worth using for CPU-side work.
+// Always at least 1, even if the OS won't tell us.
+// --------------------------------------------------------
+inline unsigned int GetWorkerCount()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count == 0 ? 1 : count;
+}
+
+// --------------------------------------------------------
+// Splits the range [0, count) into contiguous pieces and
+// calls job(begin, end) for each piece on its own thread.
+// The calling thread does the first piece itself, and
+// this only returns once every piece is finished.
+//
+// count        - Total number of items
+// minPerThread - Smallest piece worth spinning up a thread for
+// job          - Callable taking (size_t begin, size_t end)
+// --------------------------------------------------------
+template<typename Job>
+void ParallelFor(size_t count, size_t minPerThread, const Job& job)
+{
+	if (count == 0)
+		return;
+
+	// Figure out how many pieces to split the work into
+	size_t pieces = std::min<size_t>(GetWorkerCount(), (count + minPerThread - 1) / std::max<size_t>(minPerThread, 1));
+	pieces = std::max<size_t>(pieces, 1);
+
+	// Small jobs just run here
+	if (pieces == 1)
+	{
+		job((size_t)0, count);
+		return;
+	}
+
+	// Hand out all but the first piece to other threads
+	size_t perPiece = (count + pieces - 1) / pieces;
+	std::vector<std::thread> threads;
+	threads.reserve(pieces - 1);
+	for (size_t p = 1; p < pieces; p++)
+	{
+		size_t begin = p * perPiece;
+		size_t end = std::min(count, begin + perPiece);
+		if (begin >= end)
+			break;
+
+		threads.emplace_back([&job, begin, end]() { job(begin, end); });
+	}
+
+	// Do our own share, then wait for the rest
+	job((size_t)0, std::min(count, perPiece));
+	for (auto& t : threads)
+		t.join();
+}
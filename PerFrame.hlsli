@@ -0,0 +1,70 @@
+// Include guard
+#ifndef _PER_FRAME_HLSL
+#define _PER_FRAME_HLSL
+
+#include "Lighting.hlsli"
+
+// The most shadow cascades there can be.  Must match
+// ShadowCascades.h.
+#define MAX_SHADOW_CASCADES 4
+
+// Data that only changes once per frame, shared by every
+// shader that includes this.  The renderer fills one buffer
+// a frame and binds it to this register itself, so it must
+// match PerFrameData in PerFrameData.h.
+cbuffer perFrame : register(b13)
+{
+	// Camera matrices, and world to each shadow cascade's map
+	matrix view;
+	matrix projection;
+	matrix shadowMatrices[MAX_SHADOW_CASCADES];
+
+	// Needed for specular (reflection) calculation
+	float3 cameraPosition;
+
+	// The amount of lights THIS FRAME
+	int lightCount;
+
+	float2 screenSize;
+
+	// The number of mip levels in the specular IBL map
+	int SpecIBLTotalMipLevels;
+
+	// The light grid's size (tiles across, tiles down, depth
+	// slices) and how view depth maps to a slice
+	float clusterSliceScale;
+	uint3 clusterCounts;
+	float clusterSliceBias;
+
+	// Whether each object's own light list (see ObjectLights.hlsli)
+	// is used instead of the light grid
+	int objectLighting;
+	int shadowCascadeCount;
+	float2 perFramePadding;
+};
+
+// Every light this frame, and the light grid built from them
+// on the CPU (see LightGrid.h): each cluster's offset and
+// count into lightIndices, which index into lights
+StructuredBuffer<Light> lights			: register(t20);
+StructuredBuffer<uint> lightIndices		: register(t21);
+StructuredBuffer<uint2> lightClusters	: register(t22);
+
+// --------------------------------------------------------
+// The offset and count of the lights reaching a pixel, from
+// its position on the screen (SV_POSITION's xy) and in the
+// world.  Matches LightGrid::GetClusterIndex().
+// --------------------------------------------------------
+uint2 GetLightCluster(float2 pixel, float3 worldPos)
+{
+	uint2 tile = min(uint2(pixel / screenSize * clusterCounts.xy), clusterCounts.xy - 1);
+
+	float depth = mul(view, float4(worldPos, 1)).z;
+	uint slice = 0;
+	if (depth > 0)
+		slice = (uint)clamp(floor(log(depth) * clusterSliceScale + clusterSliceBias), 0, clusterCounts.z - 1);
+
+	return lightClusters[(slice * clusterCounts.y + tile.y) * clusterCounts.x + tile.x];
+}
+
+#endif
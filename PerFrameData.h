@@ -0,0 +1,50 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Lights.h"
+#include "ShadowCascades.h"
+
+// The register PerFrame.hlsli puts the shared buffer in
+#define PER_FRAME_SLOT 13
+
+// The first of the three registers PerFrame.hlsli puts the
+// lights, light indices and light clusters in
+#define LIGHT_GRID_SLOT 20
+
+// --------------------------------------------------------
+// The shared per-frame constant buffer, laid out the way the
+// shaders see it (see PerFrame.hlsli).  The lights themselves
+// go in their own buffer alongside the light grid.
+// --------------------------------------------------------
+struct PerFrameData
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectX::XMFLOAT4X4 ShadowMatrices[MAX_SHADOW_CASCADES];	// World to each cascade's map
+
+	DirectX::XMFLOAT3	CameraPosition;
+	int					LightCount;
+
+	DirectX::XMFLOAT2	ScreenSize;
+	int					SpecIBLTotalMipLevels;
+	float				ClusterSliceScale;
+
+	unsigned int		ClusterCounts[3];
+	float				ClusterSliceBias;
+
+	int					ObjectLighting;
+	int					ShadowCascadeCount;
+	float				Padding[2];
+};
+
+static_assert(sizeof(PerFrameData) == 448, "PerFrameData must match the perFrame cbuffer in PerFrame.hlsli");
+static_assert(sizeof(Light) == 64, "Light must match the Light struct in Lighting.hlsli");
+
+// Constant buffer data sent to the GPU in a frame
+struct ConstantBufferUploads
+{
+	unsigned int PerFrameBytes;	// The shared per-frame buffer
+	unsigned int ShaderBytes;	// Every shader's own buffers (per object, per material, ...)
+	unsigned int LightGridBytes;	// The lights and light grid
+};
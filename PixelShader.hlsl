@@ -1,8 +1,5 @@
 
-#include "Lighting.hlsli"
-
-// How many lights could we handle?
-#define MAX_LIGHTS 128
+#include "ObjectLights.hlsli"
 
 // Data that can change per material
 cbuffer perMaterial : register(b0)
@@ -15,19 +12,6 @@ cbuffer perMaterial : register(b0)
 	float2 uvOffset;
 };
 
-// Data that only changes once per frame
-cbuffer perFrame : register(b1)
-{
-	// An array of light data
-	Light lights[MAX_LIGHTS];
-
-	// The amount of lights THIS FRAME
-	int lightCount;
-
-	// Needed for specular (reflection) calculation
-	float3 cameraPosition;
-};
-
 
 // Defines the input to this pixel shader
 // - Should match the output of our corresponding vertex shader
@@ -36,7 +20,7 @@ struct VertexToPixel
 	float4 screenPosition	: SV_POSITION;
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;
 	float3 worldPos			: POSITION; // The world position of this PIXEL
 };
 
@@ -59,7 +43,7 @@ PS_Output main(VertexToPixel input)
 {
 	// Always re-normalize interpolated direction vectors
 	input.normal = normalize(input.normal);
-	input.tangent = normalize(input.tangent);
+	input.tangent.xyz = normalize(input.tangent.xyz);
 
 	// Apply the uv adjustments
 	input.uv = input.uv * uvScale + uvOffset;
@@ -78,9 +62,13 @@ PS_Output main(VertexToPixel input)
 	// Total color for this pixel
 	float3 totalColor = float3(0,0,0);
 
-	// Loop through all lights this frame
-	for(int i = 0; i < lightCount; i++)
+	// Loop through the lights reaching this pixel's cluster (or
+	// picked for this object)
+	uint2 pixelLights = GetPixelLights(input.screenPosition.xy, input.worldPos);
+	for(uint c = 0; c < pixelLights.y; c++)
 	{
+		uint i = GetPixelLight(pixelLights, c);
+
 		// Which kind of light?
 		switch (lights[i].Type)
 		{
@@ -98,6 +86,9 @@ PS_Output main(VertexToPixel input)
 		}
 	}
 
+	// Lights that didn't make the object's list, as plain diffuse
+	totalColor += GetDroppedLight() * surfaceColor.rgb;
+
 	// Gamma correction
 	PS_Output output;
 	output.color = float4(pow(totalColor, 1.0f / 2.2f), 1); // Gamma correction
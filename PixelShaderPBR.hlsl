@@ -1,8 +1,5 @@
 
-#include "Lighting.hlsli"
-
-// How many lights could we handle?
-#define MAX_LIGHTS 128
+#include "ObjectLights.hlsli"
 
 // Data that can change per material
 cbuffer perMaterial : register(b0)
@@ -15,21 +12,6 @@ cbuffer perMaterial : register(b0)
 	float2 uvOffset;
 };
 
-// Data that only changes once per frame
-cbuffer perFrame : register(b1)
-{
-	// An array of light data
-	Light lights[MAX_LIGHTS];
-
-	// The amount of lights THIS FRAME
-	int lightCount;
-
-	// Needed for specular (reflection) calculation
-	float3 cameraPosition;
-
-	int SpecIBLTotalMipLevels;
-};
-
 
 // Defines the input to this pixel shader
 // - Should match the output of our corresponding vertex shader
@@ -38,9 +20,8 @@ struct VertexToPixel
 	float4 screenPosition	: SV_POSITION;
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;
 	float3 worldPos			: POSITION; // The world position of this PIXEL
-	float4 posForShadow		: SHADOWPOS;
 };
 
 
@@ -55,8 +36,8 @@ Texture2D BrdfLookUpMap      : register(t4);
 TextureCube IrradianceIBLMap : register(t5);
 TextureCube SpecularIBLMap   : register(t6);
 
-// Shadow map
-Texture2D ShadowMap			 : register(t7);
+// Shadow map, a slice per cascade
+Texture2DArray ShadowMap	 : register(t7);
 
 // Samplers
 SamplerState BasicSampler : register(s0);
@@ -75,7 +56,7 @@ PS_Output main(VertexToPixel input)
 {
 	// Always re-normalize interpolated direction vectors
 	input.normal = normalize(input.normal);
-	input.tangent = normalize(input.tangent);
+	input.tangent.xyz = normalize(input.tangent.xyz);
 
 	// Apply the uv adjustments
 	input.uv = input.uv * uvScale + uvOffset;
@@ -97,23 +78,39 @@ PS_Output main(VertexToPixel input)
 	// SHADOW MAPPING --------------------------------
 	// Note: This is only for a SINGLE light!  If you want multiple lights to cast shadows,
 	// you need to do all of this multiple times IN THIS SHADER.
-	float2 shadowUV = input.posForShadow.xy / input.posForShadow.w * 0.5f + 0.5f;
-	shadowUV.y = 1.0f - shadowUV.y;
-
-	// Calculate this pixel's depth from the light
-	float depthFromLight = input.posForShadow.z / input.posForShadow.w;
-
-	// Sample the shadow map using a comparison sampler, which
-	// will compare the depth from the light and the value in the shadow map
-	// Note: This is applied below, after we calc our DIRECTIONAL LIGHT
-	float shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, shadowUV, depthFromLight);
+	// Use the first (most detailed) cascade whose map covers this
+	// pixel.  Cascades aren't all redrawn every frame, so this
+	// goes by where each map actually is rather than by depth.
+	// Past the last cascade there's no shadow.
+	float shadowAmount = 1.0f;
+	for (int c = 0; c < shadowCascadeCount; c++)
+	{
+		float4 posForShadow = mul(shadowMatrices[c], float4(input.worldPos, 1.0f));
+		float2 shadowUV = posForShadow.xy / posForShadow.w * 0.5f + 0.5f;
+		shadowUV.y = 1.0f - shadowUV.y;
+
+		// Calculate this pixel's depth from the light
+		float depthFromLight = posForShadow.z / posForShadow.w;
+		if (any(shadowUV != saturate(shadowUV)) || depthFromLight > 1.0f)
+			continue;
+
+		// Sample the shadow map using a comparison sampler, which
+		// will compare the depth from the light and the value in the shadow map
+		// Note: This is applied below, after we calc our DIRECTIONAL LIGHT
+		shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, float3(shadowUV, c), depthFromLight);
+		break;
+	}
 
 	// Total color for this pixel
 	float3 totalColor = float3(0,0,0);
 
-	// Loop through all lights this frame
-	for(int i = 0; i < lightCount; i++)
+	// Loop through the lights reaching this pixel's cluster (or
+	// picked for this object)
+	uint2 pixelLights = GetPixelLights(input.screenPosition.xy, input.worldPos);
+	for(uint c = 0; c < pixelLights.y; c++)
 	{
+		uint i = GetPixelLight(pixelLights, c);
+
 		// Which kind of light?
 		switch (lights[i].Type)
 		{
@@ -133,6 +130,10 @@ PS_Output main(VertexToPixel input)
 		}
 	}
 
+	// Lights that didn't make the object's list, as plain diffuse
+	// (metals don't diffuse)
+	totalColor += GetDroppedLight() * surfaceColor.rgb * (1 - metal);
+
 	// Calculate requisite reflection vectors
 	float3 viewToCam = normalize(cameraPosition - input.worldPos);
 	float3 viewRefl = normalize(reflect(-viewToCam, input.normal));
@@ -0,0 +1,191 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(unsigned int capacity)
+	: capacity(0), used(0)
+{
+	Grow(capacity);
+}
+
+
+unsigned int RangeAllocator::Allocate(unsigned int size)
+{
+	if (size == 0)
+		return Invalid;
+
+	// Smallest free block that fits, so big blocks stay big
+	size_t best = freeBlocks.size();
+	for (size_t i = 0; i < freeBlocks.size(); i++)
+	{
+		if (freeBlocks[i].Size >= size && (best == freeBlocks.size() || freeBlocks[i].Size < freeBlocks[best].Size))
+		{
+			best = i;
+			if (freeBlocks[i].Size == size)
+				break; // Can't do better than exact
+		}
+	}
+	if (best == freeBlocks.size())
+		return Invalid;
+
+	// Take it from the front of the block
+	Block allocation = { freeBlocks[best].Offset, size };
+	freeBlocks[best].Offset += size;
+	freeBlocks[best].Size -= size;
+	if (freeBlocks[best].Size == 0)
+		freeBlocks.erase(freeBlocks.begin() + best);
+	used += size;
+
+	// Reuse an old id if there is one
+	unsigned int id;
+	if (!unusedIds.empty())
+	{
+		id = unusedIds.back();
+		unusedIds.pop_back();
+		allocations[id] = allocation;
+	}
+	else
+	{
+		id = (unsigned int)allocations.size();
+		allocations.push_back(allocation);
+	}
+	return id;
+}
+
+
+void RangeAllocator::Free(unsigned int id)
+{
+	if (id >= allocations.size() || allocations[id].Offset == Invalid)
+		return;
+
+	AddFreeBlock(allocations[id].Offset, allocations[id].Size);
+	used -= allocations[id].Size;
+	allocations[id] = { Invalid, 0 };
+	unusedIds.push_back(id);
+}
+
+
+void RangeAllocator::Grow(unsigned int newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	AddFreeBlock(capacity, newCapacity - capacity);
+	capacity = newCapacity;
+}
+
+
+std::vector<RangeMove> RangeAllocator::Compact()
+{
+	// Live allocations in the order they sit in the buffer
+	std::vector<unsigned int> order;
+	for (unsigned int id = 0; id < allocations.size(); id++)
+	{
+		if (allocations[id].Offset != Invalid)
+			order.push_back(id);
+	}
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return allocations[a].Offset < allocations[b].Offset; });
+
+	// Pack them down
+	std::vector<RangeMove> moves;
+	unsigned int offset = 0;
+	for (unsigned int id : order)
+	{
+		Block& a = allocations[id];
+		if (a.Offset != offset)
+		{
+			moves.push_back({ a.Offset, offset, a.Size });
+			a.Offset = offset;
+		}
+		offset += a.Size;
+	}
+
+	freeBlocks.clear();
+	if (offset < capacity)
+		freeBlocks.push_back({ offset, capacity - offset });
+	return moves;
+}
+
+
+RangeAllocatorStats RangeAllocator::GetStats() const
+{
+	RangeAllocatorStats stats = {};
+	stats.Capacity = capacity;
+	stats.Used = used;
+	stats.Allocations = (unsigned int)(allocations.size() - unusedIds.size());
+	stats.FreeBlocks = (unsigned int)freeBlocks.size();
+	for (const Block& b : freeBlocks)
+		stats.LargestFreeBlock = std::max(stats.LargestFreeBlock, b.Size);
+
+	unsigned int free = capacity - used;
+	stats.Fragmentation = free > 0 ? 1.0f - (float)stats.LargestFreeBlock / free : 0.0f;
+	return stats;
+}
+
+
+bool RangeAllocator::Validate() const
+{
+	// Every block, free or not, sorted by offset
+	std::vector<Block> blocks = freeBlocks;
+	unsigned int freeTotal = 0;
+	for (size_t i = 0; i < freeBlocks.size(); i++)
+	{
+		if (freeBlocks[i].Size == 0)
+			return false;
+		if (i > 0 && freeBlocks[i - 1].Offset + freeBlocks[i - 1].Size >= freeBlocks[i].Offset)
+			return false; // Out of order, overlapping or should have been merged
+		freeTotal += freeBlocks[i].Size;
+	}
+
+	unsigned int usedTotal = 0;
+	for (const Block& a : allocations)
+	{
+		if (a.Offset == Invalid)
+			continue;
+		blocks.push_back(a);
+		usedTotal += a.Size;
+	}
+	if (usedTotal != used || usedTotal + freeTotal != capacity)
+		return false;
+
+	// Together they should tile the whole buffer
+	std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.Offset < b.Offset; });
+	unsigned int offset = 0;
+	for (const Block& b : blocks)
+	{
+		if (b.Offset != offset)
+			return false;
+		offset += b.Size;
+	}
+	return offset == capacity;
+}
+
+
+// Puts a range back on the free list, merging it with the
+// blocks on either side if they touch
+void RangeAllocator::AddFreeBlock(unsigned int offset, unsigned int size)
+{
+	auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset,
+		[](const Block& b, unsigned int o) { return b.Offset < o; });
+
+	bool joinsPrevious = next != freeBlocks.begin() && (next - 1)->Offset + (next - 1)->Size == offset;
+	bool joinsNext = next != freeBlocks.end() && offset + size == next->Offset;
+	if (joinsPrevious && joinsNext)
+	{
+		(next - 1)->Size += size + next->Size;
+		freeBlocks.erase(next);
+	}
+	else if (joinsPrevious)
+	{
+		(next - 1)->Size += size;
+	}
+	else if (joinsNext)
+	{
+		next->Offset = offset;
+		next->Size += size;
+	}
+	else
+	{
+		freeBlocks.insert(next, { offset, size });
+	}
+}
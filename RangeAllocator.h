@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// Where a live allocation moved to during Compact()
+// --------------------------------------------------------
+struct RangeMove
+{
+	unsigned int From;
+	unsigned int To;
+	unsigned int Size;
+};
+
+// --------------------------------------------------------
+// How full and how fragmented a RangeAllocator is.  All of
+// the sizes are in whatever units the allocator hands out.
+// --------------------------------------------------------
+struct RangeAllocatorStats
+{
+	unsigned int Capacity;
+	unsigned int Used;
+	unsigned int Allocations;
+	unsigned int FreeBlocks;
+	unsigned int LargestFreeBlock;
+
+	// 0 when all the free space is in one block, approaching 1
+	// as it gets split into many small ones:
+	// 1 - largest free block / total free space
+	float Fragmentation;
+};
+
+// --------------------------------------------------------
+// Hands out ranges of a fixed size buffer that lives
+// somewhere else (such as on the GPU).  This only does the
+// bookkeeping - nothing is ever read or written.
+//
+// Allocations are identified by an id rather than their
+// offset, since Compact() can move them around.  Free space
+// is a list of blocks sorted by offset, merged with their
+// neighbors as soon as they touch, and new allocations take
+// the smallest block they fit in (best fit).
+//
+// When nothing fits, it's up to the owner what to do:
+// Compact() if there's enough free space in total, or Grow()
+// otherwise.
+// --------------------------------------------------------
+class RangeAllocator
+{
+public:
+	// Returned by Allocate() when nothing fits
+	static const unsigned int Invalid = 0xFFFFFFFF;
+
+	RangeAllocator(unsigned int capacity = 0);
+
+	// Returns the new allocation's id, or Invalid if there's no
+	// single free block big enough (or size is 0)
+	unsigned int Allocate(unsigned int size);
+	void Free(unsigned int id);
+
+	unsigned int GetOffset(unsigned int id) const { return allocations[id].Offset; }
+	unsigned int GetSize(unsigned int id) const { return allocations[id].Size; }
+	unsigned int GetCapacity() const { return capacity; }
+
+	// Adds free space on the end.  The owner copies its buffer
+	// into a bigger one; nothing already allocated moves.
+	void Grow(unsigned int newCapacity);
+
+	// Slides every allocation down to the start of the buffer,
+	// in order, leaving one free block at the end.  Returns the
+	// allocations that moved, in increasing offset order (so
+	// they can be copied in place, front to back).  Everything
+	// that didn't move sits before the first one that did.
+	std::vector<RangeMove> Compact();
+
+	RangeAllocatorStats GetStats() const;
+
+	// Checks the free list and allocations against each other:
+	// sorted, merged, not overlapping, and adding up to the
+	// capacity.  Only meant for testing.
+	bool Validate() const;
+
+private:
+	struct Block
+	{
+		unsigned int Offset;
+		unsigned int Size;
+	};
+
+	unsigned int capacity;
+	unsigned int used;
+	std::vector<Block> freeBlocks;		// Sorted by offset, never touching
+	std::vector<Block> allocations;		// By id; Offset is Invalid for unused ids
+	std::vector<unsigned int> unusedIds;
+
+	void AddFreeBlock(unsigned int offset, unsigned int size);
+};
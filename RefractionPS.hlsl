@@ -1,28 +1,7 @@
-#include "Lighting.hlsli"
-
-// How many lights could we handle?
-#define MAX_LIGHTS 128
-
-// Data that only changes once per frame
-cbuffer perFrame : register(b0)
-{
-	// An array of light data
-	Light lights[MAX_LIGHTS];
-
-	// The amount of lights THIS FRAME
-	int lightCount;
-
-	// Needed for specular (reflection) calculation
-	float3 cameraPosition;
-
-	// The number of mip levels in the specular IBL map
-	int SpecIBLTotalMipLevels;
-
-	float2 screenSize;
-};
+#include "PerFrame.hlsli"
 
 // Data that can change per material
-cbuffer perMaterial : register(b1)
+cbuffer perMaterial : register(b0)
 {
 	// Surface color
 	float4 colorTint;
@@ -36,7 +15,7 @@ struct VertexToPixel
 	float4 screenPosition	: SV_POSITION;
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;
 	float3 worldPos			: POSITION; // The world position of this PIXEL
 };
 
@@ -61,7 +40,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 {
 	// Always re-normalize interpolated direction vectors
 	input.normal = normalize(input.normal);
-	input.tangent = normalize(input.tangent);
+	input.tangent.xyz = normalize(input.tangent.xyz);
 	input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
 
 	// The actual screen UV and refraction offset UV
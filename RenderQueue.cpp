@@ -0,0 +1,210 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// Where each field goes in the 64-bit key, from the top.
+// Opaque:      pass | ps | vs | material | buffers | mesh | depth
+// Refractive:  pass | far-to-near depth | ps | vs | material | buffers | mesh
+// --------------------------------------------------------
+static const int PassBits = 2;
+static const int ShaderBits = 8;
+static const int MaterialBits = 12;
+static const int BuffersBits = 8;
+static const int MeshBits = 10;
+static const int DepthBits = 16;
+
+static const int StateBits = ShaderBits * 2 + MaterialBits + BuffersBits + MeshBits;
+static const int PassShift = 64 - PassBits;
+
+static inline uint64_t Field(unsigned int value, int bits)
+{
+	return value & ((1ull << bits) - 1);
+}
+
+// --------------------------------------------------------
+// The top 16 bits of a positive float.  Floats compare the
+// same way as their bits do, so this keeps the order (at
+// about 1% precision) with buckets that get wider further
+// from the camera.
+// --------------------------------------------------------
+static inline uint64_t DepthBucket(float depth)
+{
+	if (!(depth > 0.0f))
+		return 0;
+
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits >> (32 - DepthBits);
+}
+
+uint64_t EncodeRenderKey(const RenderKey& key)
+{
+	uint64_t state =
+		Field(key.PixelShader, ShaderBits) << (StateBits - ShaderBits) |
+		Field(key.VertexShader, ShaderBits) << (StateBits - ShaderBits * 2) |
+		Field(key.Material, MaterialBits) << (BuffersBits + MeshBits) |
+		Field(key.Buffers, BuffersBits) << MeshBits |
+		Field(key.Mesh, MeshBits);
+
+	uint64_t pass = (uint64_t)key.Pass << PassShift;
+	uint64_t depth = DepthBucket(key.Depth);
+	if (key.Pass == RenderPass::Refractive)
+	{
+		uint64_t farToNear = ((1ull << DepthBits) - 1) - depth;
+		return pass | farToNear << StateBits | state;
+	}
+	return pass | state << DepthBits | depth;
+}
+
+RenderPass GetRenderPass(uint64_t key)
+{
+	return (RenderPass)(key >> PassShift);
+}
+
+// The state part of a key, wherever the pass put it
+static inline uint64_t GetState(uint64_t key)
+{
+	uint64_t mask = (1ull << StateBits) - 1;
+	return GetRenderPass(key) == RenderPass::Refractive ? key & mask : (key >> DepthBits) & mask;
+}
+
+
+// --------------------------------------------------------
+// Stable counting sort of the packets into out by the bits of
+// their keys from shift up, which have the given number of
+// values.  Returns false without touching out if every key has
+// the same value there, since nothing would move.
+// --------------------------------------------------------
+static bool SortByBits(const std::vector<RenderPacket>& in, std::vector<RenderPacket>& out, int shift, size_t values)
+{
+	size_t counts[256] = {};
+	for (const RenderPacket& p : in)
+		counts[(p.Key >> shift) & (values - 1)]++;
+	if (in.empty() || counts[(in[0].Key >> shift) & (values - 1)] == in.size())
+		return false;
+
+	size_t offset = 0;
+	for (size_t v = 0; v < values; v++)
+	{
+		size_t count = counts[v];
+		counts[v] = offset;
+		offset += count;
+	}
+	for (const RenderPacket& p : in)
+		out[counts[(p.Key >> shift) & (values - 1)]++] = p;
+	return true;
+}
+
+
+RenderQueue::RenderQueue()
+	: unsortedChanges(), sortedChanges()
+{
+}
+
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+
+void RenderQueue::Add(uint64_t key, unsigned int item)
+{
+	packets.push_back({ key, item });
+}
+
+
+void RenderQueue::Sort()
+{
+	// The order things were added, but split into passes, since
+	// each pass is drawn on its own either way
+	scratch.resize(packets.size());
+	unsortedChanges = CountStateChanges(SortByBits(packets, scratch, PassShift, 1 << PassBits) ? scratch : packets);
+
+	// Least significant byte first, each pass a stable counting
+	// sort, so the last pass leaves everything in order
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		if (SortByBits(packets, scratch, shift, 256))
+			packets.swap(scratch);
+	}
+
+	sortedChanges = CountStateChanges(packets);
+}
+
+
+RenderStateChanges RenderQueue::CountStateChanges(const std::vector<RenderPacket>& packets)
+{
+	const int vsShift = BuffersBits + MeshBits + MaterialBits;
+	const int psShift = vsShift + ShaderBits;
+
+	RenderStateChanges changes = {};
+	uint64_t last = 0;
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		// Everything gets bound again at the start of each pass
+		uint64_t state = GetState(packets[i].Key);
+		bool newPass = i == 0 || GetRenderPass(packets[i].Key) != GetRenderPass(packets[i - 1].Key);
+		uint64_t changed = newPass ? ~0ull : state ^ last;
+		if ((changed >> psShift) & ((1ull << ShaderBits) - 1))
+			changes.Shaders++;
+		if ((changed >> vsShift) & ((1ull << ShaderBits) - 1))
+			changes.Shaders++;
+		if ((changed >> (BuffersBits + MeshBits)) & ((1ull << MaterialBits) - 1))
+			changes.Materials++;
+		if ((changed >> MeshBits) & ((1ull << BuffersBits) - 1))
+			changes.Buffers++;
+		changes.Draws++;
+		last = state;
+	}
+	return changes;
+}
+
+
+SortIdTable::SortIdTable()
+	: nextId(0)
+{
+}
+
+
+unsigned int SortIdTable::Get(const void* object)
+{
+	auto it = ids.find(object);
+	if (it != ids.end())
+	{
+		it->second.Used = true;
+		return it->second.Id;
+	}
+
+	unsigned int id;
+	if (freeIds.empty())
+	{
+		id = nextId++;
+	}
+	else
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	ids.insert({ object, { id, true } });
+	return id;
+}
+
+
+void SortIdTable::EndFrame()
+{
+	for (auto it = ids.begin(); it != ids.end();)
+	{
+		if (it->second.Used)
+		{
+			it->second.Used = false;
+			++it;
+		}
+		else
+		{
+			freeIds.push_back(it->second.Id);
+			it = ids.erase(it);
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Which part of the frame a draw belongs to, in drawing order
+enum class RenderPass
+{
+	Opaque = 0,
+	Refractive = 1
+};
+
+// --------------------------------------------------------
+// Everything a draw is sorted by.  The ids just have to be
+// the same for the same shader (or material, or buffers) and
+// small; only the low bits of each one are kept.
+// --------------------------------------------------------
+struct RenderKey
+{
+	RenderPass Pass;
+	unsigned int PixelShader;
+	unsigned int VertexShader;
+	unsigned int Material;
+	unsigned int Buffers;		// Meshes sharing buffers share this
+	unsigned int Mesh;
+	float Depth;				// Distance from the camera
+};
+
+// --------------------------------------------------------
+// Packs a key into 64 bits, so that sorting the numbers
+// sorts the draws.  Opaque draws are grouped by state (pixel
+// shader, vertex shader, material, buffers, mesh) and then
+// front to back within that.  Refractive draws are back to
+// front first, since each one can see the ones behind it.
+// --------------------------------------------------------
+uint64_t EncodeRenderKey(const RenderKey& key);
+
+// Get the pass back out of an encoded key
+RenderPass GetRenderPass(uint64_t key);
+
+// One draw: its sort key, and what to draw (an index into
+// whatever the caller is drawing from)
+struct RenderPacket
+{
+	uint64_t Key;
+	unsigned int Item;
+};
+
+// How many times state would change drawing a queue in order
+struct RenderStateChanges
+{
+	unsigned int Draws;
+	unsigned int Shaders;		// Pixel or vertex shader switches
+	unsigned int Materials;		// Texture and sampler rebinds
+	unsigned int Buffers;		// Vertex and index buffer rebinds
+};
+
+// --------------------------------------------------------
+// This frame's draws, sorted by key with a radix sort (a
+// byte at a time, skipping bytes every key agrees on, which
+// with a handful of shaders and materials is most of them).
+//
+// Counts the state changes the draws would need both in the
+// order they were added and once sorted, so the difference
+// sorting makes can be shown.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Empties the queue, keeping the memory for next frame
+	void Clear();
+	void Add(uint64_t key, unsigned int item);
+
+	// Sorts by key, keeping the order of equal keys
+	void Sort();
+
+	const std::vector<RenderPacket>& GetPackets() { return packets; }
+
+	// State changes drawing in the order things were added, and in
+	// sorted order, as of the last Sort()
+	const RenderStateChanges& GetUnsortedChanges() { return unsortedChanges; }
+	const RenderStateChanges& GetSortedChanges() { return sortedChanges; }
+
+	// Counts the state changes needed to draw the packets in order
+	static RenderStateChanges CountStateChanges(const std::vector<RenderPacket>& packets);
+
+private:
+	std::vector<RenderPacket> packets;
+	std::vector<RenderPacket> scratch;
+
+	RenderStateChanges unsortedChanges;
+	RenderStateChanges sortedChanges;
+};
+
+// --------------------------------------------------------
+// Hands out the small ids one field of a key holds, one table
+// per field so each gets all of its bits.  An id not asked for
+// in a whole frame is dropped and handed out again, since its
+// object may be gone for good (like a mesh pool's old buffers
+// after it grows).  So ids only outgrow their field, and start
+// sharing bits, when one frame has that many distinct things.
+// --------------------------------------------------------
+class SortIdTable
+{
+public:
+	SortIdTable();
+
+	// The same id every time this frame, and every frame after
+	// for as long as the object keeps being asked for
+	unsigned int Get(const void* object);
+
+	// Drops the ids that weren't asked for since the last call
+	void EndFrame();
+
+	unsigned int GetCount() const { return (unsigned int)ids.size(); }
+
+private:
+	struct Entry
+	{
+		unsigned int Id;
+		bool Used;
+	};
+
+	std::unordered_map<const void*, Entry> ids;
+	std::vector<unsigned int> freeIds;
+	unsigned int nextId;
+};
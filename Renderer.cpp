@@ -11,6 +11,10 @@
 // https://github.com/vixorien/ggp-advanced-demos/blob/main/Refraction/Renderer.cpp
 //
 
+// Width of the occlusion culling depth buffer.  Its height
+// follows the window's aspect ratio.
+static const unsigned int OcclusionBufferWidth = 320;
+
 Renderer::Renderer(
 	Microsoft::WRL::ComPtr<ID3D11Device> device,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
@@ -31,6 +35,9 @@ Renderer::Renderer(
 	std::shared_ptr<SimpleVertexShader> fullScreenVS,
 	std::shared_ptr<SimplePixelShader> texturePS,
 	std::shared_ptr<SimpleVertexShader> shadowVS,
+	std::shared_ptr<SimpleVertexShader> shadowVSPacked,
+	std::shared_ptr<SimpleVertexShader> shadowVSInstanced,
+	std::shared_ptr<SimplePixelShader> shadowCacheCopyPS,
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> basicSampler)
   : entities(entities),
 	emitters(emitters),
@@ -52,7 +59,32 @@ Renderer::Renderer(
 	this->fullScreenVS = fullScreenVS;
 	this->texturePS = texturePS;
 	this->shadowVS = shadowVS;
+	this->shadowVSPacked = shadowVSPacked;
+	this->shadowVSInstanced = shadowVSInstanced;
+	this->shadowCacheCopyPS = shadowCacheCopyPS;
 	this->basicSampler = basicSampler;
+	this->meshletCullStats = {};
+	this->interpolation = 1.0f;
+	this->perFrameData = {};
+	this->constantBufferUploads = {};
+	this->instanceCapacity = 0;
+	this->lightBuffer = {};
+	this->lightIndexBuffer = {};
+	this->lightClusterBuffer = {};
+	this->objectLighting = false;
+	this->shadowCaching = true;
+	this->shadowCasterStats = {};
+	this->shadowPreviewCascade = 0;
+
+	// One per-frame buffer for everything, bound once per frame in
+	// place of each shader's own copy
+	D3D11_BUFFER_DESC perFrameDesc = {};
+	perFrameDesc.Usage = D3D11_USAGE_DYNAMIC;
+	perFrameDesc.ByteWidth = sizeof(PerFrameData);
+	perFrameDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	perFrameDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	device->CreateBuffer(&perFrameDesc, 0, perFrameBuffer.GetAddressOf());
+	ISimpleShader::SharedBufferSlot = PER_FRAME_SLOT;
 
 	PostResize(windowWidth, windowHeight, backBufferRTV, depthBufferDSV);
 
@@ -76,7 +108,7 @@ Renderer::Renderer(
 	device->CreateBlendState(&additiveBlendDesc, particleBlendAdditive.GetAddressOf());
 	
 	// Create shadow map resources
-	CreateShadowMapResources(1024, 10.0f);
+	CreateShadowMapResources(1024);
 }
 
 Renderer::~Renderer()
@@ -100,6 +132,9 @@ void Renderer::PostResize(
 	this->backBufferRTV = backBufferRTV;
 	this->depthBufferDSV = depthBufferDSV;
 
+	unsigned int occlusionHeight = OcclusionBufferWidth * windowHeight / max(windowWidth, 1u);
+	occlusionCuller = std::make_shared<OcclusionCuller>(OcclusionBufferWidth, max(occlusionHeight, 1u));
+
 	sceneColorRTV.Reset();
 	sceneColorSRV.Reset();
 	sceneNormalsRTV.Reset();
@@ -112,8 +147,10 @@ void Renderer::PostResize(
 	CreateRenderTarget(windowWidth, windowHeight, sceneDepthRTV, sceneDepthSRV, DXGI_FORMAT_R32_FLOAT);
 }
 
-void Renderer::Render(std::shared_ptr<Camera> camera, float totalTime)
+void Renderer::Render(std::shared_ptr<Camera> camera, float totalTime, float interpolation)
 {
+	this->interpolation = interpolation;
+
 	// Background color for clearing
 	const float color[4] = { 0, 0, 0, 1 };
 
@@ -128,51 +165,120 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float totalTime)
 		1.0f,
 		0);
 
+	// Start counting culled meshlets and uploads for the frame
+	meshletCullStats = {};
+	ISimpleShader::BytesUploaded = 0;
+	constantBufferUploads = {};
+
+	// Pick each entity's level of detail for this frame, which
+	// the shadow map uses too (so off screen entities still
+	// need one), and gather their bounds for culling
+	entityCuller.Clear();
+	for (auto& ge : entities)
+	{
+		DirectX::XMFLOAT4X4 world = ge->GetWorldMatrix(interpolation);
+		unsigned int lod = ge->GetMesh()->SelectLod(
+			world,
+			camera.get(),
+			(float)windowHeight,
+			ge->GetLod());
+		ge->SetLod(lod);
+		entityCuller.AddBounds(ge->GetMesh()->GetBounds(), world);
+	}
+
+	// Only what's in front of the camera gets drawn
+	entityCuller.Cull(camera->GetFrustum(), visibleEntities);
+
+	// Then only what isn't hidden behind the occluders on screen
+	occlusionCuller->BeginFrame(camera->GetView(), camera->GetProjection());
+	for (unsigned int i : visibleEntities)
+	{
+		if (entities[i]->GetOccluder())
+			occlusionCuller->AddOccluder(*entities[i]->GetOccluder(), entities[i]->GetWorldMatrix(interpolation));
+	}
+	if (occlusionCuller->GetStats().Occluders > 0)
+	{
+		occlusionCuller->RasterizeOccluders();
+		occlusionCuller->Cull(entityCuller, visibleEntities);
+	}
+
 	// Render our shadow map
-	RenderShadowMap();
+	RenderShadowMap(camera);
+
+	// Everything from here on reads the camera and lights from
+	// the shared buffer, and finds the lights reaching each pixel
+	// in the light grid (or its entity's own list)
+	UpdateLightGrid(camera);
+	if (objectLighting)
+		SelectObjectLights();
+	UpdatePerFrameData(camera);
 
 	// declare stores for useful data
 	const int numTargets = 4;
 	ID3D11RenderTargetView* targets[numTargets] = {};
-	std::vector<std::shared_ptr<GameEntity>> refractiveEntites;
+
+	// Sort what's left so draws sharing shaders, materials and
+	// buffers end up next to each other
+	QueueVisibleEntities(camera);
+	const std::vector<RenderPacket>& packets = renderQueue.GetPackets();
+	size_t packet = 0;
+
+	// Then group the opaque ones sharing a mesh, material and
+	// level of detail, so each group is a single instanced draw
+	BatchOpaqueEntities(packets, packet);
+	UploadInstances(instanceBatcher.GetInstances());
 
 	// Draw all normal entities
 	targets[0] = sceneColorRTV.Get();
 	targets[1] = sceneNormalsRTV.Get();
 	targets[2] = sceneDepthRTV.Get();
 	context->OMSetRenderTargets(3, targets, depthBufferDSV.Get());
-	for (auto& ge : entities)
+	BoundState bound = {};
+	const std::vector<unsigned int>& batchItems = instanceBatcher.GetItems();
+	for (const InstanceBatch& batch : instanceBatcher.GetBatches())
 	{
-		if (ge->GetMaterial()->GetRefractive()) {
-			refractiveEntites.push_back(ge);
-			continue;
-		}
+		const std::shared_ptr<GameEntity>& ge = entities[batchItems[batch.FirstItem]];
+		std::shared_ptr<Material> material = ge->GetMaterial();
+		bool instanced = batch.Count > 1;
+		std::shared_ptr<SimpleVertexShader> vs = instanced ?
+			material->GetInstancedVertexShader() :
+			material->GetVertexShader(ge->GetMesh()->GetVertexLayout());
+		std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+
+		// Set the "per frame" resources, once for each shader that's used
+		if (vs.get() != bound.VertexShader)
+			vs->SetShader();
+		if (ps.get() != bound.PixelShader)
+		{
+			ps->SetShader();
+			ps->SetShaderResourceView("BrdfLookUpMap", sky->GetLookUpTable());
+			ps->SetShaderResourceView("IrradianceIBLMap", sky->GetIrradianceMap());
+			ps->SetShaderResourceView("SpecularIBLMap", sky->GetSpecularMap());
 
-		std::shared_ptr<SimpleVertexShader> vs = ge->GetMaterial()->GetVertexShader();
-		vs->SetMatrix4x4("shadowView", shadowViewMatrix);
-		vs->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-
-		// Set the "per frame" data
-		// Note that this should literally be set once PER FRAME, before
-		// the draw loop, but we're currently setting it per entity since 
-		// we are just using whichever shader the current entity has.  
-		// Inefficient!!!
-		std::shared_ptr<SimplePixelShader> ps = ge->GetMaterial()->GetPixelShader();
-		ps->SetData("lights", (void*)(&lights[0]), sizeof(Light) * lights.size());
-		ps->SetInt("lightCount", lights.size());
-		ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-		ps->SetInt("SpecIBLTotalMipLevels", sky->GetIBLMipLevels());
-		ps->CopyBufferData("perFrame");
-
-		ps->SetShaderResourceView("BrdfLookUpMap", sky->GetLookUpTable());
-		ps->SetShaderResourceView("IrradianceIBLMap", sky->GetIrradianceMap());
-		ps->SetShaderResourceView("SpecularIBLMap", sky->GetSpecularMap());
-
-		ps->SetShaderResourceView("ShadowMap", shadowSRV);
-		ps->SetSamplerState("ShadowSampler", shadowSampler);
+			ps->SetShaderResourceView("ShadowMap", shadowSRV);
+			ps->SetSamplerState("ShadowSampler", shadowSampler);
+		}
+		BindMaterialAndBuffers(ge, bound);
+		bound.VertexShader = vs.get();
 
-		// Draw the entity
-		ge->Draw(context, camera);
+		// Draw the entity, or every entity in the batch at once
+		if (instanced)
+		{
+			material->SetMaterialData();
+			ge->GetMesh()->DrawInstanced(context, batch.Count, batch.FirstInstance, ge->GetLod());
+		}
+		else
+		{
+			// The entity's lights go up with the material's data
+			if (objectLighting)
+			{
+				const ObjectLightList& list = objectLightSelector.GetList(entityLightLists[batchItems[batch.FirstItem]]);
+				ps->SetData("objectLights", list.Indices, sizeof(list.Indices));
+				ps->SetFloat3("droppedLightColor", list.DroppedColor);
+				ps->SetInt("objectLightCount", (int)list.Count);
+			}
+			ge->Draw(context, camera, &meshletCullStats, interpolation, true);
+		}
 	}
 	
 	// Draw the sky
@@ -188,27 +294,31 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float totalTime)
 		context->Draw(3, 0);
 	}
 
-	// Draw all refractive entites
+	// Draw all refractive entites, back to front
 	targets[0] = backBufferRTV.Get();
 	context->OMSetRenderTargets(1, targets, depthBufferDSV.Get());
-	for (auto& ge : refractiveEntites) {
-		ge->GetMaterial()->SetColorTint(DirectX::XMFLOAT3(1, 0.3, 0.3));
-
-		std::shared_ptr<SimplePixelShader> ps = ge->GetMaterial()->GetPixelShader();
-		ps->SetData("lights", (void*)(&lights[0]), sizeof(Light) * lights.size());
-		ps->SetInt("lightCount", lights.size());
-		ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-		ps->SetInt("SpecIBLTotalMipLevels", sky->GetIBLMipLevels());
-		ps->SetFloat2("screenSize", DirectX::XMFLOAT2(windowWidth, windowHeight));
-		ps->CopyBufferData("perFrame");
-		
-		//ps->SetShaderResourceView("BrdfLookUpMap", sky->GetLookUpTable());
-		//ps->SetShaderResourceView("IrradianceIBLMap", sky->GetIrradianceMap());
-		ps->SetShaderResourceView("SpecularIBLMap", sky->GetSpecularMap());
-		ps->SetShaderResourceView("ScreenPixels", sceneColorSRV);
+	bound = {}; // The sky and the copy bound their own
+	for (; packet < packets.size(); packet++)
+	{
+		const std::shared_ptr<GameEntity>& ge = entities[packets[packet].Item];
+		std::shared_ptr<Material> material = ge->GetMaterial();
+		material->SetColorTint(DirectX::XMFLOAT3(1, 0.3, 0.3));
+
+		std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader(ge->GetMesh()->GetVertexLayout());
+		std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+		if (vs.get() != bound.VertexShader || ps.get() != bound.PixelShader)
+			material->SetShaders(ge->GetMesh().get());
+		if (ps.get() != bound.PixelShader)
+		{
+			//ps->SetShaderResourceView("BrdfLookUpMap", sky->GetLookUpTable());
+			//ps->SetShaderResourceView("IrradianceIBLMap", sky->GetIrradianceMap());
+			ps->SetShaderResourceView("SpecularIBLMap", sky->GetSpecularMap());
+			ps->SetShaderResourceView("ScreenPixels", sceneColorSRV);
+		}
+		BindMaterialAndBuffers(ge, bound);
 
 		// Draw the entity
-		ge->Draw(context, camera);
+		ge->Draw(context, camera, &meshletCullStats, interpolation, true);
 	}
 
 	// Draw the light sources
@@ -235,6 +345,10 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float totalTime)
 		context->OMSetDepthStencilState(0, 0);
 	}
 
+	// Everything the shaders copied this frame, before the UI
+	// (which doesn't use them) draws
+	constantBufferUploads.ShaderBytes = (unsigned int)ISimpleShader::BytesUploaded;
+
 	// Draw some UI
 	DrawUI();
 
@@ -255,6 +369,13 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float totalTime)
 	// when we begin the MRTs of the next frame
 	ID3D11ShaderResourceView* nullSRVs[16] = {};
 	context->PSSetShaderResources(0, 16, nullSRVs);
+
+	// Anything not drawn this frame gives its sort ids back
+	pixelShaderIds.EndFrame();
+	vertexShaderIds.EndFrame();
+	materialIds.EndFrame();
+	bufferIds.EndFrame();
+	meshIds.EndFrame();
 }
 
 Microsoft::WRL::ComPtr<ID3D11RenderTargetView> Renderer::GetSceneColorRTV()
@@ -293,10 +414,7 @@ void Renderer::DrawPointLights(std::shared_ptr<Camera> camera)
 	lightVS->SetShader();
 	lightPS->SetShader();
 
-	// Set up vertex shader
-	lightVS->SetMatrix4x4("view", camera->GetView());
-	lightVS->SetMatrix4x4("projection", camera->GetProjection());
-
+	// The camera comes from the shared per-frame buffer
 	for (int i = 0; i < lights.size(); i++)
 	{
 		Light light = lights[i];
@@ -317,7 +435,7 @@ void Renderer::DrawPointLights(std::shared_ptr<Camera> camera)
 		DirectX::XMFLOAT4X4 world;
 		DirectX::XMFLOAT4X4 worldInvTrans;
 		DirectX::XMStoreFloat4x4(&world, worldMat);
-		DirectX::XMStoreFloat4x4(&worldInvTrans, XMMatrixInverse(0, XMMatrixTranspose(worldMat)));
+		DirectX::XMStoreFloat4x4(&worldInvTrans, InverseTransposeFromTRS(worldMat, DirectX::XMFLOAT3(scale, scale, scale)));
 
 		// Set up the world matrix for this light
 		lightVS->SetMatrix4x4("world", world);
@@ -401,7 +519,7 @@ void Renderer::CreateRenderTarget(
 		srv.GetAddressOf()); // ComPtr<ID3D11ShaderResourceView>
 }
 
-void Renderer::CreateShadowMapResources(unsigned int shadowMapSize, float projectionSize)
+void Renderer::CreateShadowMapResources(unsigned int shadowMapSize)
 {
 	// Create the initial shadow map
 	ResizeShadowMap(shadowMapSize);
@@ -429,51 +547,42 @@ void Renderer::CreateShadowMapResources(unsigned int shadowMapSize, float projec
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
 	device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
 
-	// Create the "camera" matrices for the shadow map rendering
-
-	// View matrix will be re-created each frame in the event the light rotates
+	// Copying the static casters' cache into a cascade overwrites
+	// whatever depth was there
+	D3D11_DEPTH_STENCIL_DESC copyDepthDesc = {};
+	copyDepthDesc.DepthEnable = true;
+	copyDepthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	copyDepthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	device->CreateDepthStencilState(&copyDepthDesc, shadowCacheCopyDepthState.GetAddressOf());
 
-	// Projection
-	UpdateShadowProjection(projectionSize);
+	// The cascades' matrices are fit to the camera each frame
 }
 
 
-void Renderer::UpdateShadowProjection(float projectionSize)
-{
-	shadowProjectionSize = projectionSize;
-
-	DirectX::XMMATRIX shProj = DirectX::XMMatrixOrthographicLH(shadowProjectionSize, shadowProjectionSize, 0.1f, 100.0f);
-	XMStoreFloat4x4(&shadowProjectionMatrix, shProj);
-}
-
-
-void Renderer::UpdateShadowView(const Light* light)
-{
-	DirectX::XMFLOAT3 lightPos(light->Direction.x * -20, light->Direction.y * -20, light->Direction.z * -20);
-
-	DirectX::XMMATRIX shView = DirectX::XMMatrixLookToLH(
-		DirectX::XMLoadFloat3(&lightPos),
-		DirectX::XMLoadFloat3(&light->Direction),
-		DirectX::XMVectorSet(0, 1, 0, 0));
-	DirectX::XMStoreFloat4x4(&shadowViewMatrix, shView);
-}
-
-
-
 void Renderer::ResizeShadowMap(unsigned int shadowMapSize)
 {
 	// Reset com ptrs
 	shadowSRV.Reset();
-	shadowDSV.Reset();
+	shadowTexture.Reset();
+	staticShadowTexture.Reset();
+	staticShadowSRV.Reset();
+	shadowPreviewSRV.Reset();
+	shadowPreviewTexture.Reset();
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		shadowDSVs[i].Reset();
+		staticShadowDSVs[i].Reset();
+	}
 
 	// Save resolution
 	shadowMapResolution = shadowMapSize;
 
-	// Create the actual texture that will be the shadow map
+	// Create the actual texture that will be the shadow map, with
+	// a slice for each cascade
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
 	shadowDesc.Width = shadowMapResolution;
 	shadowDesc.Height = shadowMapResolution;
-	shadowDesc.ArraySize = 1;
+	shadowDesc.ArraySize = MAX_SHADOW_CASCADES;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
 	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
@@ -482,41 +591,398 @@ void Renderer::ResizeShadowMap(unsigned int shadowMapSize)
 	shadowDesc.SampleDesc.Count = 1;
 	shadowDesc.SampleDesc.Quality = 0;
 	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
 	device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
 
-	// Create the depth/stencil
+	// The same again for the static casters' cache, but the size
+	// of the cascades' cached regions, which are bigger
+	D3D11_TEXTURE2D_DESC staticDesc = shadowDesc;
+	staticDesc.Width = ShadowCascades::GetCacheResolution(shadowMapResolution);
+	staticDesc.Height = staticDesc.Width;
+	device->CreateTexture2D(&staticDesc, 0, staticShadowTexture.GetAddressOf());
+
+	// Create a depth/stencil view of each slice
 	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
 	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSV.GetAddressOf());
+	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+	shadowDSDesc.Texture2DArray.MipSlice = 0;
+	shadowDSDesc.Texture2DArray.ArraySize = 1;
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		shadowDSDesc.Texture2DArray.FirstArraySlice = i;
+		device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSVs[i].GetAddressOf());
+		device->CreateDepthStencilView(staticShadowTexture.Get(), &shadowDSDesc, staticShadowDSVs[i].GetAddressOf());
+		shadowCaches[i].Invalidate();
+	}
 
-	// Create the SRV for the shadow map
+	// Create the SRV for the shadow map, covering every slice
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = MAX_SHADOW_CASCADES;
 	device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV.GetAddressOf());
+	device->CreateShaderResourceView(staticShadowTexture.Get(), &srvDesc, staticShadowSRV.GetAddressOf());
+
+	// And a plain texture one slice gets copied to for showing
+	// (still a depth buffer, since depth only copies to depth)
+	D3D11_TEXTURE2D_DESC previewDesc = shadowDesc;
+	previewDesc.ArraySize = 1;
+	device->CreateTexture2D(&previewDesc, 0, shadowPreviewTexture.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC previewSRVDesc = {};
+	previewSRVDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	previewSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	previewSRVDesc.Texture2D.MipLevels = 1;
+	previewSRVDesc.Texture2D.MostDetailedMip = 0;
+	device->CreateShaderResourceView(shadowPreviewTexture.Get(), &previewSRVDesc, shadowPreviewSRV.GetAddressOf());
 }
 
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Renderer::GetShadowMapSRV() { return shadowSRV; }
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Renderer::GetShadowMapSRV() { return shadowPreviewSRV; }
+void Renderer::SetShadowPreviewCascade(unsigned int cascade) { shadowPreviewCascade = min(cascade, MAX_SHADOW_CASCADES - 1u); }
 unsigned int Renderer::GetShadowMapResolution() { return shadowMapResolution; }
-float Renderer::GetShadowProjectionSize() { return shadowProjectionSize; }
+ShadowCascades& Renderer::GetShadowCascades() { return shadowCascades; }
+const MeshletCullStats& Renderer::GetMeshletCullStats() { return meshletCullStats; }
+unsigned int Renderer::GetVisibleEntityCount() { return (unsigned int)visibleEntities.size(); }
+const OcclusionStats& Renderer::GetOcclusionStats() { return occlusionCuller->GetStats(); }
+const RenderStateChanges& Renderer::GetUnsortedStateChanges() { return renderQueue.GetUnsortedChanges(); }
+const RenderStateChanges& Renderer::GetSortedStateChanges() { return renderQueue.GetSortedChanges(); }
+const ConstantBufferUploads& Renderer::GetConstantBufferUploads() { return constantBufferUploads; }
+const ShadowCasterStats& Renderer::GetShadowCasterStats() { return shadowCasterStats; }
+bool Renderer::GetShadowCaching() { return shadowCaching; }
+const ShadowCacheStats& Renderer::GetShadowCacheStats(unsigned int cascade) { return shadowCaches[cascade].GetStats(); }
+
+void Renderer::SetShadowCaching(bool enabled)
+{
+	shadowCaching = enabled;
+	for (ShadowCache& cache : shadowCaches)
+		cache.Invalidate();
+}
+const InstancingStats& Renderer::GetInstancingStats() { return instanceBatcher.GetStats(); }
+const InstancingStats& Renderer::GetShadowInstancingStats() { return shadowBatcher.GetStats(); }
+const LightGridStats& Renderer::GetLightGridStats() { return lightGrid.GetStats(); }
+void Renderer::SetObjectLighting(bool enabled) { objectLighting = enabled; }
+bool Renderer::GetObjectLighting() { return objectLighting; }
+const ObjectLightStats& Renderer::GetObjectLightStats() { return objectLightSelector.GetStats(); }
+
+
+// --------------------------------------------------------
+// Bins this frame's lights into the camera's clusters and
+// uploads the lights, the index list and the cluster table
+// for the pixel shaders.  The grid's size and slice mapping
+// go in the per-frame buffer.  Entities with their own light
+// lists only need the lights.
+// --------------------------------------------------------
+void Renderer::UpdateLightGrid(std::shared_ptr<Camera> camera)
+{
+	lightGrid.SetProjection(camera->GetProjection());
+	if (!objectLighting)
+		lightGrid.Build(camera->GetView(), lights);
+
+	perFrameData.ClusterSliceScale = lightGrid.GetSliceScale();
+	perFrameData.ClusterSliceBias = lightGrid.GetSliceBias();
+	perFrameData.ClusterCounts[0] = lightGrid.GetTilesX();
+	perFrameData.ClusterCounts[1] = lightGrid.GetTilesY();
+	perFrameData.ClusterCounts[2] = lightGrid.GetSlices();
+
+	const std::vector<unsigned int>& indices = lightGrid.GetLightIndices();
+	const std::vector<LightCluster>& clusters = lightGrid.GetClusters();
+	constantBufferUploads.LightGridBytes = UploadStructuredBuffer(lightBuffer, lights.data(), (unsigned int)lights.size(), sizeof(Light));
+	if (!objectLighting)
+	{
+		constantBufferUploads.LightGridBytes +=
+			UploadStructuredBuffer(lightIndexBuffer, indices.data(), (unsigned int)indices.size(), sizeof(unsigned int)) +
+			UploadStructuredBuffer(lightClusterBuffer, clusters.data(), (unsigned int)clusters.size(), sizeof(LightCluster));
+	}
+
+	ID3D11ShaderResourceView* srvs[3] = { lightBuffer.SRV.Get(), lightIndexBuffer.SRV.Get(), lightClusterBuffer.SRV.Get() };
+	context->PSSetShaderResources(LIGHT_GRID_SLOT, 3, srvs);
+}
+
+
+// --------------------------------------------------------
+// Picks the lights for each visible entity from its bounding
+// sphere, for shading with per-object light lists
+// --------------------------------------------------------
+void Renderer::SelectObjectLights()
+{
+	objectLightSelector.Clear();
+	entityLightLists.resize(entities.size());
+	for (unsigned int i : visibleEntities)
+	{
+		DirectX::XMFLOAT3 center;
+		float radius;
+		entityCuller.GetSphere(i, center, radius);
+		entityLightLists[i] = objectLightSelector.AddObject(center, radius);
+	}
+	objectLightSelector.Select(lights);
+}
+
+
+// --------------------------------------------------------
+// Copies count elements into the buffer, recreating it (and
+// its view) bigger first if they don't fit.  Returns the
+// bytes uploaded.
+// --------------------------------------------------------
+unsigned int Renderer::UploadStructuredBuffer(DynamicStructuredBuffer& buffer, const void* data, unsigned int count, unsigned int stride)
+{
+	if (!buffer.Buffer || count > buffer.Capacity)
+	{
+		buffer.Capacity = max(max(count, buffer.Capacity * 2), 1u);
+		buffer.Buffer.Reset();
+		buffer.SRV.Reset();
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = stride * buffer.Capacity;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		if (FAILED(device->CreateBuffer(&desc, 0, buffer.Buffer.GetAddressOf())))
+			return 0;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = buffer.Capacity;
+		device->CreateShaderResourceView(buffer.Buffer.Get(), &srvDesc, buffer.SRV.GetAddressOf());
+	}
+
+	if (count == 0)
+		return 0;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return 0;
+	memcpy(mapped.pData, data, stride * count);
+	context->Unmap(buffer.Buffer.Get(), 0);
+	return stride * count;
+}
+
+
+// --------------------------------------------------------
+// Fills the shared per-frame buffer with the camera, shadow
+// and light grid data and binds it for both stages
+// --------------------------------------------------------
+void Renderer::UpdatePerFrameData(std::shared_ptr<Camera> camera)
+{
+	perFrameData.View = camera->GetView();
+	perFrameData.Projection = camera->GetProjection();
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		perFrameData.ShadowMatrices[i] = shadowCascades.GetCascade(i).ViewProjection;
+	perFrameData.ShadowCascadeCount = (int)shadowCascades.GetCascadeCount();
+	perFrameData.CameraPosition = camera->GetTransform()->GetPosition();
+	perFrameData.LightCount = (int)lights.size();
+	perFrameData.ScreenSize = DirectX::XMFLOAT2((float)windowWidth, (float)windowHeight);
+	perFrameData.SpecIBLTotalMipLevels = sky->GetIBLMipLevels();
+	perFrameData.ObjectLighting = objectLighting ? 1 : 0;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(context->Map(perFrameBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, &perFrameData, sizeof(PerFrameData));
+		context->Unmap(perFrameBuffer.Get(), 0);
+		constantBufferUploads.PerFrameBytes += sizeof(PerFrameData);
+	}
+
+	context->VSSetConstantBuffers(PER_FRAME_SLOT, 1, perFrameBuffer.GetAddressOf());
+	context->PSSetConstantBuffers(PER_FRAME_SLOT, 1, perFrameBuffer.GetAddressOf());
+}
+
+
+// --------------------------------------------------------
+// Makes a packet for each visible entity, keyed by its pass,
+// shaders, material, buffers and distance, and sorts them
+// --------------------------------------------------------
+void Renderer::QueueVisibleEntities(std::shared_ptr<Camera> camera)
+{
+	DirectX::XMFLOAT3 eye = camera->GetTransform()->GetPosition();
+
+	renderQueue.Clear();
+	for (unsigned int i : visibleEntities)
+	{
+		const std::shared_ptr<GameEntity>& ge = entities[i];
+		std::shared_ptr<Material> material = ge->GetMaterial();
+		Mesh* mesh = ge->GetMesh().get();
+
+		DirectX::XMFLOAT4X4 world = ge->GetWorldMatrix(interpolation);
+		DirectX::XMVECTOR offset = DirectX::XMVectorSet(world._41 - eye.x, world._42 - eye.y, world._43 - eye.z, 0);
+
+		RenderKey key;
+		key.Pass = material->GetRefractive() ? RenderPass::Refractive : RenderPass::Opaque;
+		key.PixelShader = pixelShaderIds.Get(material->GetPixelShader().get());
+		key.VertexShader = vertexShaderIds.Get(material->GetVertexShader(mesh->GetVertexLayout()).get());
+		key.Material = materialIds.Get(material.get());
+		key.Buffers = bufferIds.Get(mesh->GetVertexBuffer().Get());
+		key.Mesh = meshIds.Get(mesh);
+		key.Depth = DirectX::XMVectorGetX(DirectX::XMVector3Length(offset));
+		renderQueue.Add(EncodeRenderKey(key), i);
+	}
+	renderQueue.Sort();
+}
+
+
+// --------------------------------------------------------
+// Binds the entity's textures and buffers, unless the last
+// draw already did
+// --------------------------------------------------------
+void Renderer::BindMaterialAndBuffers(const std::shared_ptr<GameEntity>& ge, BoundState& bound)
+{
+	Material* material = ge->GetMaterial().get();
+	Mesh* mesh = ge->GetMesh().get();
+	bound.VertexShader = material->GetVertexShader(mesh->GetVertexLayout()).get();
+	bound.PixelShader = material->GetPixelShader().get();
+
+	if (material != bound.Textures)
+	{
+		material->SetResources();
+		bound.Textures = material;
+	}
+
+	// Pooled meshes share buffers, so only bind when they change
+	if (!mesh->SharesBuffers(bound.Buffers))
+	{
+		mesh->SetBuffers(context);
+		bound.Buffers = mesh;
+	}
+}
+
+
+// --------------------------------------------------------
+// Batches the opaque packets (from packet on, which is left
+// at the first refractive one) by mesh, material and level of
+// detail.  Only full-format meshes whose material has an
+// instanced vertex shader can be instanced; packed meshes
+// need their bounds in a cbuffer, so they draw one at a time.
+// Instanced draws skip meshlet culling, which is per entity.
+// With per-object lights, every entity draws on its own.
+// --------------------------------------------------------
+void Renderer::BatchOpaqueEntities(const std::vector<RenderPacket>& packets, size_t& packet)
+{
+	instanceBatcher.Clear();
+	for (; packet < packets.size() && GetRenderPass(packets[packet].Key) == RenderPass::Opaque; packet++)
+	{
+		unsigned int item = packets[packet].Item;
+		const std::shared_ptr<GameEntity>& ge = entities[item];
+		Material* material = ge->GetMaterial().get();
+		Mesh* mesh = ge->GetMesh().get();
+		if (objectLighting || !material->GetInstancedVertexShader() || mesh->GetVertexLayout() != VertexLayout::Full)
+		{
+			instanceBatcher.AddSingle(item);
+			continue;
+		}
+
+		uint64_t group = (uint64_t)materialIds.Get(material) << 32 | (uint64_t)meshIds.Get(mesh) << 8 | ge->GetLod();
+		instanceBatcher.Add(group, item, ge->GetWorldMatrix(interpolation), ge->GetWorldInverseTransposeMatrix(interpolation));
+	}
+	instanceBatcher.Build();
+}
+
+
+// --------------------------------------------------------
+// Batches the shadow casters for the shadow map, where only
+// the mesh and level of detail matter
+// --------------------------------------------------------
+void Renderer::BatchShadowCasters(const std::vector<unsigned int>& casters)
+{
+	shadowBatcher.Clear();
+	for (unsigned int i : casters)
+	{
+		const std::shared_ptr<GameEntity>& ge = entities[i];
+		Mesh* mesh = ge->GetMesh().get();
+		if (!shadowVSInstanced || mesh->GetVertexLayout() != VertexLayout::Full)
+		{
+			shadowBatcher.AddSingle(i);
+			continue;
+		}
+
+		uint64_t group = (uint64_t)meshIds.Get(mesh) << 8 | ge->GetLod();
+		shadowBatcher.Add(group, i, ge->GetWorldMatrix(interpolation), ge->GetWorldInverseTransposeMatrix(interpolation));
+	}
+	shadowBatcher.Build();
+}
+
+
+// --------------------------------------------------------
+// Copies the instance data into the instance buffer, growing
+// it if needed, and binds it to the second vertex buffer slot
+// (the per-instance inputs' slot) for the draws to come
+// --------------------------------------------------------
+void Renderer::UploadInstances(const std::vector<InstanceData>& instances)
+{
+	if (instances.empty())
+		return;
+
+	if (instances.size() > instanceCapacity)
+	{
+		instanceCapacity = max((unsigned int)instances.size(), instanceCapacity * 2);
+		instanceBuffer.Reset();
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = sizeof(InstanceData) * instanceCapacity;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		device->CreateBuffer(&desc, 0, instanceBuffer.GetAddressOf());
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, instances.data(), sizeof(InstanceData) * instances.size());
+	context->Unmap(instanceBuffer.Get(), 0);
+
+	UINT stride = sizeof(InstanceData);
+	UINT offset = 0;
+	context->IASetVertexBuffers(1, 1, instanceBuffer.GetAddressOf(), &stride, &offset);
+}
 
 void Renderer::SetShadowMapResolution(unsigned int resolution) { ResizeShadowMap(resolution); }
-void Renderer::SetShadowProjectionSize(float projectionSize) { UpdateShadowProjection(projectionSize); }
 
 
-void Renderer::RenderShadowMap()
+// --------------------------------------------------------
+// Finds the entities inside a cascade's volume that are in
+// front of (nearer the light than) a visible entity.  The
+// visible entities are the receivers, so this has to come
+// after frustum and occlusion culling.
+// --------------------------------------------------------
+void Renderer::CullShadowCasters(const DirectX::XMFLOAT4X4& shadowProjection)
 {
-	// Update the shadow view matrix to match the first directional light
-	UpdateShadowView(&lights[0]);
+	shadowCasterCuller.BeginFrame(shadowCascades.GetView(), shadowProjection);
+	for (unsigned int i : visibleEntities)
+	{
+		DirectX::XMFLOAT3 center, halfExtent;
+		entityCuller.GetBox(i, center, halfExtent);
+		shadowCasterCuller.AddReceiver(center, halfExtent);
+	}
+	shadowCasterCuller.Cull(entityCuller, shadowCasters, &shadowVolumeEntities);
+
+	const ShadowCasterStats& stats = shadowCasterCuller.GetStats();
+	shadowCasterStats.Receivers += stats.Receivers;
+	shadowCasterStats.Tested += stats.Tested;
+	shadowCasterStats.Casters += stats.Casters;
+	shadowCasterStats.Outside += stats.Outside;
+	shadowCasterStats.Unseen += stats.Unseen;
+	shadowCasterStats.CullMs += stats.CullMs;
+}
+
+
+// --------------------------------------------------------
+// Fits the first directional light's shadow cascades to the
+// camera and draws the ones due an update this frame, each
+// into its own slice of the shadow map
+// --------------------------------------------------------
+void Renderer::RenderShadowMap(std::shared_ptr<Camera> camera)
+{
+	unsigned int updated = shadowCascades.Update(
+		camera->GetView(),
+		camera->GetProjection(),
+		lights[0].Direction,
+		shadowMapResolution);
 
-	// Initial pipeline setup - No RTV necessary - Clear shadow map
-	context->OMSetRenderTargets(0, 0, shadowDSV.Get());
-	context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 	context->RSSetState(shadowRasterizer.Get());
 
 	// Need to create a viewport that matches the shadow map resolution
@@ -528,29 +994,201 @@ void Renderer::RenderShadowMap()
 	viewport.MinDepth = 0.0f;
 	viewport.MaxDepth = 1.0f;
 	context->RSSetViewports(1, &viewport);
-
-	// Turn on our shadow map Vertex Shader
-	// and turn OFF the pixel shader entirely
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowProjectionMatrix);
-	shadowVS->CopyBufferData("perFrame");
 	context->PSSetShader(0, 0, 0); // No PS
 
-	// Loop and draw all entities
-	for (auto& e : entities)
+	shadowCasterStats = {};
+	for (unsigned int i = 0; i < shadowCascades.GetCascadeCount(); i++)
 	{
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyBufferData("perObject");
-
-		// Draw the mesh
-		e->GetMesh()->SetBuffersAndDraw(context);
+		if (updated & (1u << i))
+			RenderShadowCascade(i);
 	}
 
+	// Copy out the cascade being shown
+	context->OMSetRenderTargets(0, 0, 0);
+	context->CopySubresourceRegion(
+		shadowPreviewTexture.Get(), 0, 0, 0, 0,
+		shadowTexture.Get(), D3D11CalcSubresource(0, shadowPreviewCascade, 1), 0);
+
 	// After rendering the shadow map, go back to the screen
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
 	viewport.Width = (float)this->windowWidth;
 	viewport.Height = (float)this->windowHeight;
 	context->RSSetViewports(1, &viewport);
 	context->RSSetState(0);
+}
+
+
+// --------------------------------------------------------
+// Draws one cascade's slice of the shadow map, with the
+// shadow rasterizer state and viewport already set
+// --------------------------------------------------------
+void Renderer::RenderShadowCascade(unsigned int cascade)
+{
+	const ShadowCascade& c = shadowCascades.GetCascade(cascade);
+	const DirectX::XMFLOAT4X4& shadowView = shadowCascades.GetView();
+
+	// Only entities whose shadows could land on something on
+	// screen need drawing.  With caching, the light's volume is
+	// the whole cached region, since the cache is drawn for all
+	// of it.
+	CullShadowCasters(shadowCaching ? c.CacheProjection : c.Projection);
+
+	ID3D11DepthStencilView* dsv = shadowDSVs[cascade].Get();
+	if (!shadowCaching)
+	{
+		// No RTV necessary - Clear this cascade's slice
+		SetShadowMatrices(shadowView, c.Projection);
+		context->OMSetRenderTargets(0, 0, dsv);
+		context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
+		DrawShadowCasters(shadowCasters);
+		return;
+	}
+
+	// Split off the casters that haven't been moving, which only
+	// need drawing when they (or the cached region) change.  The
+	// cache holds everything in the region's volume, not just
+	// what's on screen, so turning the camera doesn't change it,
+	// and the region only moves once the camera has gone a good
+	// way, so neither does walking about.
+	ShadowCache& cache = shadowCaches[cascade];
+	staticShadowCasters.clear();
+	dynamicShadowCasters.clear();
+	cache.BeginFrame(shadowView, c.CacheProjection);
+	for (unsigned int i : shadowVolumeEntities)
+		cache.AddCaster(i, entities[i]->GetTransformVersion(), entities[i]->IsTransformMoving());
+	bool redrawStatic = cache.EndFrame();
+	for (unsigned int i : shadowCasters)
+	{
+		if (!cache.IsStatic(i))
+			dynamicShadowCasters.push_back(i);
+	}
+
+	// Bring the static casters' depth up to date if needed, over
+	// the whole region
+	if (redrawStatic)
+	{
+		for (unsigned int i : shadowVolumeEntities)
+		{
+			if (cache.IsStatic(i))
+				staticShadowCasters.push_back(i);
+		}
+
+		D3D11_VIEWPORT viewport = {};
+		viewport.Width = (float)ShadowCascades::GetCacheResolution(shadowMapResolution);
+		viewport.Height = viewport.Width;
+		viewport.MaxDepth = 1.0f;
+		context->RSSetViewports(1, &viewport);
+
+		SetShadowMatrices(shadowView, c.CacheProjection);
+		context->OMSetRenderTargets(0, 0, staticShadowDSVs[cascade].Get());
+		context->ClearDepthStencilView(staticShadowDSVs[cascade].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		DrawShadowCasters(staticShadowCasters);
+
+		viewport.Width = (float)shadowMapResolution;
+		viewport.Height = viewport.Width;
+		context->RSSetViewports(1, &viewport);
+	}
+
+	// Start the slice from the cascade's part of the region.  Depth
+	// buffers can only be copied whole, so this is a fullscreen
+	// triangle writing the cached depth, ignoring what's there.
+	context->OMSetRenderTargets(0, 0, dsv);
+	context->OMSetDepthStencilState(shadowCacheCopyDepthState.Get(), 0);
+	fullScreenVS->SetShader();
+	shadowCacheCopyPS->SetShader();
+	int cacheOffset[2] = { (int)c.CacheX, (int)c.CacheY };
+	shadowCacheCopyPS->SetData("cacheOffset", cacheOffset, sizeof(cacheOffset));
+	shadowCacheCopyPS->SetInt("cascade", (int)cascade);
+	shadowCacheCopyPS->CopyAllBufferData();
+	shadowCacheCopyPS->SetShaderResourceView("StaticShadowMap", staticShadowSRV.Get());
+	context->Draw(3, 0);
+
+	// Then the moving casters on top, with no pixel shader again,
+	// and the cache unbound so it can be drawn into next time
+	ID3D11ShaderResourceView* nullSRV = 0;
+	context->PSSetShaderResources(0, 1, &nullSRV);
+	context->PSSetShader(0, 0, 0);
+	context->OMSetDepthStencilState(0, 0);
+	SetShadowMatrices(shadowView, c.Projection);
+	DrawShadowCasters(dynamicShadowCasters);
+}
+
+
+// --------------------------------------------------------
+// Sets the view and projection of every shadow vertex shader
+// --------------------------------------------------------
+void Renderer::SetShadowMatrices(const DirectX::XMFLOAT4X4& shadowView, const DirectX::XMFLOAT4X4& shadowProjection)
+{
+	// One per vertex layout, plus the instanced one
+	shadowVSPacked->SetMatrix4x4("view", shadowView);
+	shadowVSPacked->SetMatrix4x4("projection", shadowProjection);
+	shadowVSPacked->CopyBufferData("perFrame");
+	if (shadowVSInstanced)
+	{
+		shadowVSInstanced->SetMatrix4x4("view", shadowView);
+		shadowVSInstanced->SetMatrix4x4("projection", shadowProjection);
+		shadowVSInstanced->CopyBufferData("perFrame");
+	}
+	shadowVS->SetMatrix4x4("view", shadowView);
+	shadowVS->SetMatrix4x4("projection", shadowProjection);
+	shadowVS->CopyBufferData("perFrame");
+}
+
+
+// --------------------------------------------------------
+// Draws the given entities into whatever depth buffer is
+// bound, with the shadow vertex shaders already set up
+// --------------------------------------------------------
+void Renderer::DrawShadowCasters(const std::vector<unsigned int>& casters)
+{
+	if (casters.empty())
+		return;
+
+	// Entities sharing a mesh and LOD are drawn together
+	BatchShadowCasters(casters);
+	UploadInstances(shadowBatcher.GetInstances());
+
+	// Loop and draw the casters
+	std::shared_ptr<SimpleVertexShader> currentVS = shadowVS;
+	shadowVS->SetShader();
+	Mesh* boundMesh = nullptr;
+	const std::vector<unsigned int>& batchItems = shadowBatcher.GetItems();
+	for (const InstanceBatch& batch : shadowBatcher.GetBatches())
+	{
+		// Swap shaders only when the vertex layout changes
+		const std::shared_ptr<GameEntity>& e = entities[batchItems[batch.FirstItem]];
+		std::shared_ptr<Mesh> mesh = e->GetMesh();
+		bool instanced = batch.Count > 1;
+		std::shared_ptr<SimpleVertexShader> vs =
+			instanced ? shadowVSInstanced :
+			mesh->GetVertexLayout() == VertexLayout::Packed ? shadowVSPacked : shadowVS;
+		if (vs != currentVS)
+		{
+			vs->SetShader();
+			currentVS = vs;
+		}
+
+		// Bind buffers only when they change
+		if (!mesh->SharesBuffers(boundMesh))
+		{
+			mesh->SetBuffers(context);
+			boundMesh = mesh.get();
+		}
+
+		// A batch's world matrices are already in the instance buffer
+		if (instanced)
+		{
+			mesh->DrawInstanced(context, batch.Count, batch.FirstInstance, e->GetLod());
+			continue;
+		}
+
+		vs->SetMatrix4x4("world", e->GetWorldMatrix(interpolation));
+		if (mesh->GetVertexLayout() == VertexLayout::Packed)
+		{
+			vs->SetFloat3("positionMin", mesh->GetBounds().Min);
+			vs->SetFloat3("positionExtent", GetBoundsExtent(mesh->GetBounds()));
+		}
+		vs->CopyBufferData("perObject");
+		mesh->Draw(context, e->GetLod());
+	}
 }
\ No newline at end of file
@@ -3,7 +3,17 @@
 #include "Sky.h"
 #include "GameEntity.h"
 #include "Emitter.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "LightGrid.h"
 #include "Lights.h"
+#include "ObjectLights.h"
+#include "OcclusionCuller.h"
+#include "PerFrameData.h"
+#include "RenderQueue.h"
+#include "ShadowCache.h"
+#include "ShadowCasterCuller.h"
+#include "ShadowCascades.h"
 
 #include <memory>
 #include <d3d11.h>
@@ -39,6 +49,9 @@ public:
 		std::shared_ptr<SimpleVertexShader> fullScreenVS,
 		std::shared_ptr<SimplePixelShader> texturePS,
 		std::shared_ptr<SimpleVertexShader> shadowVS,
+		std::shared_ptr<SimpleVertexShader> shadowVSPacked,
+		std::shared_ptr<SimpleVertexShader> shadowVSInstanced,
+		std::shared_ptr<SimplePixelShader> shadowCacheCopyPS,
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> basicSampler);
 
 	~Renderer();
@@ -50,7 +63,9 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV,
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV);
 
-	void Render(std::shared_ptr<Camera> camera, float totalTime);
+	// Interpolation is how far between the last two simulation
+	// steps to draw moving entities (see GameEntity::GetWorldMatrix())
+	void Render(std::shared_ptr<Camera> camera, float totalTime, float interpolation = 1.0f);
 
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> GetSceneColorRTV();
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSceneColorSRV();
@@ -61,13 +76,89 @@ public:
 
 	void ResizeShadowMap(unsigned int shadowMapSize);
 
+	// One cascade of the shadow map, copied out each frame so it
+	// can be shown (the shadow map itself is a texture array)
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetShadowMapSRV();
+	void SetShadowPreviewCascade(unsigned int cascade);
 	unsigned int GetShadowMapResolution();
-	float GetShadowProjectionSize();
 
 	void SetShadowMapResolution(unsigned int resolution);
-	void SetShadowProjectionSize(float projectionSize);
+
+	// How the first directional light's shadow is split into
+	// cascades, for changing their count, splits and update rates
+	ShadowCascades& GetShadowCascades();
+
+	// Meshlet culling results from the last frame
+	const MeshletCullStats& GetMeshletCullStats();
+
+	// Entities that survived frustum and occlusion culling last frame
+	unsigned int GetVisibleEntityCount();
+	const OcclusionStats& GetOcclusionStats();
+
+	// State changes drawing last frame's entities in the order
+	// they're in, and sorted by the render queue
+	const RenderStateChanges& GetUnsortedStateChanges();
+	const RenderStateChanges& GetSortedStateChanges();
+
+	// Constant buffer data uploaded last frame
+	const ConstantBufferUploads& GetConstantBufferUploads();
+
+	// Entities last frame's shadow map drew, and why the rest
+	// were skipped, added up over the cascades drawn
+	const ShadowCasterStats& GetShadowCasterStats();
+
+	// Whether static casters are drawn into a cached shadow map
+	// that's only redrawn when they (or the light) change, with
+	// the dynamic ones drawn over a copy of it each frame.  Each
+	// cascade has its own cache.
+	void SetShadowCaching(bool enabled);
+	bool GetShadowCaching();
+	const ShadowCacheStats& GetShadowCacheStats(unsigned int cascade);
+
+	// What instancing did to last frame's opaque and shadow draws
+	const InstancingStats& GetInstancingStats();
+	const InstancingStats& GetShadowInstancingStats();
+
+	// How last frame's lights were binned into clusters
+	const LightGridStats& GetLightGridStats();
+
+	// Whether opaque entities are lit by their own short lists of
+	// lights instead of the light grid (they can't be instanced
+	// then, since each draw has its own list)
+	void SetObjectLighting(bool enabled);
+	bool GetObjectLighting();
+	const ObjectLightStats& GetObjectLightStats();
 private:
+	// What's bound from the last draw, so the next one can skip
+	// whatever it shares
+	struct BoundState
+	{
+		SimpleVertexShader* VertexShader;
+		SimplePixelShader* PixelShader;
+		Material* Textures;	// Whose textures and samplers
+		Mesh* Buffers;		// Whose vertex and index buffers
+	};
+
+	// A structured buffer the CPU rewrites every frame, and the
+	// view the shaders read it through (sized in elements, grown
+	// as needed)
+	struct DynamicStructuredBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		unsigned int Capacity;
+	};
+
+	void QueueVisibleEntities(std::shared_ptr<Camera> camera);
+	void BindMaterialAndBuffers(const std::shared_ptr<GameEntity>& ge, BoundState& bound);
+	void UpdateLightGrid(std::shared_ptr<Camera> camera);
+	void SelectObjectLights();
+	void UpdatePerFrameData(std::shared_ptr<Camera> camera);
+	unsigned int UploadStructuredBuffer(DynamicStructuredBuffer& buffer, const void* data, unsigned int count, unsigned int stride);
+	void BatchOpaqueEntities(const std::vector<RenderPacket>& packets, size_t& packet);
+	void BatchShadowCasters(const std::vector<unsigned int>& casters);
+	void UploadInstances(const std::vector<InstanceData>& instances);
+
 	void DrawPointLights(std::shared_ptr<Camera> camera);
 	void DrawUI();
 
@@ -93,6 +184,55 @@ private:
 	const std::vector<std::shared_ptr<Emitter>>& emitters;
 	const std::vector<Light>& lights;
 
+	MeshletCullStats meshletCullStats;
+
+	// Entity bounds for this frame, and the indices of the
+	// entities that are at least partly on screen
+	FrustumCuller entityCuller;
+	std::vector<unsigned int> visibleEntities;
+
+	// Depth buffer for occluders, sized to match the window's shape
+	std::shared_ptr<OcclusionCuller> occlusionCuller;
+
+	// This frame's draws in order, and the small numbers standing
+	// in for each shader, material and mesh in their sort keys
+	// (and in the instance batchers' groups)
+	RenderQueue renderQueue;
+	SortIdTable pixelShaderIds;
+	SortIdTable vertexShaderIds;
+	SortIdTable materialIds;
+	SortIdTable bufferIds;
+	SortIdTable meshIds;
+
+	// How far between simulation steps this frame is drawn
+	float interpolation;
+
+	// The shared per-frame constant buffer every shader including
+	// PerFrame.hlsli reads, and this frame's contents for it
+	Microsoft::WRL::ComPtr<ID3D11Buffer> perFrameBuffer;
+	PerFrameData perFrameData;
+	ConstantBufferUploads constantBufferUploads;
+
+	// Draws grouped for instancing, and the vertex buffer their
+	// matrices go in (sized in instances, grown as needed)
+	InstanceBatcher instanceBatcher;
+	InstanceBatcher shadowBatcher;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	unsigned int instanceCapacity;
+
+	// This frame's lights binned into clusters, and the buffers
+	// the pixel shaders find them in
+	LightGrid lightGrid;
+	DynamicStructuredBuffer lightBuffer;
+	DynamicStructuredBuffer lightIndexBuffer;
+	DynamicStructuredBuffer lightClusterBuffer;
+
+	// Each visible entity's own lights, when they're used instead
+	// of the grid, and where each entity's list is in the selector
+	bool objectLighting;
+	ObjectLightSelector objectLightSelector;
+	std::vector<unsigned int> entityLightLists;
+
 	std::shared_ptr<Mesh> lightMesh;
 	std::shared_ptr<SimpleVertexShader> lightVS;
 	std::shared_ptr<SimplePixelShader> lightPS;
@@ -104,19 +244,45 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> sceneColorRTV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sceneColorSRV;
 
-	// Shadow resources
+	// Shadow resources: a texture array with a slice (and depth
+	// view) per cascade, and a copy of one slice to show
 	int shadowMapResolution;
-	float shadowProjectionSize;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSVs[MAX_SHADOW_CASCADES];
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
-	DirectX::XMFLOAT4X4 shadowViewMatrix;
-	DirectX::XMFLOAT4X4 shadowProjectionMatrix;
-	void CreateShadowMapResources(unsigned int shadowMapSize, float projectionSize);
-	void UpdateShadowProjection(float projectionSize);
-	void UpdateShadowView(const Light* light);
-	void RenderShadowMap();
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowPreviewTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowPreviewSRV;
+	unsigned int shadowPreviewCascade;
+	ShadowCascades shadowCascades;
+	void CreateShadowMapResources(unsigned int shadowMapSize);
+	void CullShadowCasters(const DirectX::XMFLOAT4X4& shadowProjection);
+	void RenderShadowMap(std::shared_ptr<Camera> camera);
+	void RenderShadowCascade(unsigned int cascade);
+	void SetShadowMatrices(const DirectX::XMFLOAT4X4& shadowView, const DirectX::XMFLOAT4X4& shadowProjection);
+	void DrawShadowCasters(const std::vector<unsigned int>& casters);
+
+	// Which entities could cast a shadow onto one on screen, and
+	// which are anywhere in the light's volume, for the cascade
+	// being drawn
+	ShadowCasterCuller shadowCasterCuller;
+	ShadowCasterStats shadowCasterStats;
+	std::vector<unsigned int> shadowCasters;
+	std::vector<unsigned int> shadowVolumeEntities;
+
+	// Depth of just the static casters over each cascade's cached
+	// region, copied into the cascade (by shadowCacheCopyPS) when
+	// it's drawn, and the casters split between it and the shadow
+	// map
+	bool shadowCaching;
+	ShadowCache shadowCaches[MAX_SHADOW_CASCADES];
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staticShadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> staticShadowDSVs[MAX_SHADOW_CASCADES];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> staticShadowSRV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> shadowCacheCopyDepthState;
+	std::vector<unsigned int> staticShadowCasters;
+	std::vector<unsigned int> dynamicShadowCasters;
 
 	// Extra render targets just for the fun of it (displayed in ImGui)
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> sceneNormalsRTV;
@@ -128,6 +294,9 @@ private:
 	std::shared_ptr<SimpleVertexShader> fullScreenVS;
 	std::shared_ptr<SimplePixelShader> texturePS;
 	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> shadowVSPacked;
+	std::shared_ptr<SimpleVertexShader> shadowVSInstanced;
+	std::shared_ptr<SimplePixelShader> shadowCacheCopyPS;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> basicSampler;
 
 	// Particle states
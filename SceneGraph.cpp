@@ -0,0 +1,386 @@
+#include "SceneGraph.h"
+#include "Transform.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+
+// Values of the moved flags
+static const unsigned char AtRest = 0;
+static const unsigned char Moved = 1;
+static const unsigned char Created = 2;
+
+// Rearranges the array so element i comes from old slot order[i]
+template<typename T>
+static void Permute(std::vector<T>& data, const std::vector<unsigned int>& order)
+{
+	std::vector<T> sorted(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		sorted[i] = data[order[i]];
+	data.swap(sorted);
+}
+
+
+SceneGraph::SceneGraph()
+	: orderDirty(false), lastUpdateCount(0), updateNumber(0)
+{
+}
+
+
+SceneNode SceneGraph::CreateNode(SceneNode parent)
+{
+	unsigned int slot = (unsigned int)handles.size();
+	unsigned int parentSlot = parent == InvalidSceneNode ? InvalidSceneNode : GetSlot(parent);
+	unsigned int depth = parentSlot == InvalidSceneNode ? 0 : depths[parentSlot] + 1;
+
+	// Reuse an old handle if there is one
+	SceneNode node;
+	if (!unusedHandles.empty())
+	{
+		node = unusedHandles.back();
+		unusedHandles.pop_back();
+		slots[node] = slot;
+	}
+	else
+	{
+		node = (SceneNode)slots.size();
+		slots.push_back(slot);
+	}
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	parents.push_back(parentSlot);
+	depths.push_back(depth);
+	handles.push_back(node);
+	positions.push_back(XMFLOAT3(0, 0, 0));
+	pitchYawRolls.push_back(XMFLOAT3(0, 0, 0));
+	scales.push_back(XMFLOAT3(1, 1, 1));
+	worldMatrices.push_back(identity);
+	worldInverseTransposeMatrices.push_back(identity);
+	previousWorldMatrices.push_back(identity);
+	previousWorldInverseTransposeMatrices.push_back(identity);
+	moved.push_back(Created);
+	dirty.push_back(1); // Picks up its parent's matrix on the next update
+	versions.push_back(0);
+
+	// The end of the array is still after the parent, but might
+	// not be in depth order any more
+	if (slot > 0 && depth < depths[slot - 1])
+		orderDirty = true;
+	return node;
+}
+
+
+void SceneGraph::DestroyNode(SceneNode node)
+{
+	if (!IsValid(node))
+		return;
+
+	// Children come after their parents, so one pass down the
+	// array finds the whole subtree
+	if (orderDirty)
+		SortByDepth();
+
+	unsigned int root = GetSlot(node);
+	std::vector<unsigned char> remove(handles.size(), 0);
+	remove[root] = 1;
+	for (size_t i = root + 1; i < handles.size(); i++)
+		remove[i] = parents[i] != InvalidSceneNode && remove[parents[i]];
+
+	RemoveSlots(remove);
+}
+
+
+bool SceneGraph::SetParent(SceneNode node, SceneNode parent)
+{
+	unsigned int slot = GetSlot(node);
+	unsigned int parentSlot = parent == InvalidSceneNode ? InvalidSceneNode : GetSlot(parent);
+
+	// Can't be our own ancestor
+	for (unsigned int s = parentSlot; s != InvalidSceneNode; s = parents[s])
+	{
+		if (s == slot)
+			return false;
+	}
+
+	parents[slot] = parentSlot;
+	dirty[slot] = 1;
+
+	// Depths of the whole subtree change, so they get
+	// worked out again when the slots are sorted
+	orderDirty = true;
+	return true;
+}
+
+
+SceneNode SceneGraph::GetParent(SceneNode node)
+{
+	unsigned int parentSlot = parents[GetSlot(node)];
+	return parentSlot == InvalidSceneNode ? InvalidSceneNode : handles[parentSlot];
+}
+
+
+bool SceneGraph::IsValid(SceneNode node)
+{
+	return node < slots.size() && slots[node] != InvalidSceneNode;
+}
+
+
+void SceneGraph::MoveAbsolute(SceneNode node, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(node);
+	positions[slot].x += x;
+	positions[slot].y += y;
+	positions[slot].z += z;
+	dirty[slot] = 1;
+}
+
+void SceneGraph::Rotate(SceneNode node, float p, float y, float r)
+{
+	unsigned int slot = GetSlot(node);
+	pitchYawRolls[slot].x += p;
+	pitchYawRolls[slot].y += y;
+	pitchYawRolls[slot].z += r;
+	dirty[slot] = 1;
+}
+
+void SceneGraph::SetPosition(SceneNode node, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(node);
+	positions[slot] = XMFLOAT3(x, y, z);
+	dirty[slot] = 1;
+}
+
+void SceneGraph::SetRotation(SceneNode node, float p, float y, float r)
+{
+	unsigned int slot = GetSlot(node);
+	pitchYawRolls[slot] = XMFLOAT3(p, y, r);
+	dirty[slot] = 1;
+}
+
+void SceneGraph::SetScale(SceneNode node, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(node);
+	scales[slot] = XMFLOAT3(x, y, z);
+	dirty[slot] = 1;
+}
+
+XMFLOAT3 SceneGraph::GetPosition(SceneNode node) { return positions[GetSlot(node)]; }
+XMFLOAT3 SceneGraph::GetPitchYawRoll(SceneNode node) { return pitchYawRolls[GetSlot(node)]; }
+XMFLOAT3 SceneGraph::GetScale(SceneNode node) { return scales[GetSlot(node)]; }
+const XMFLOAT4X4& SceneGraph::GetWorldMatrix(SceneNode node) { return worldMatrices[GetSlot(node)]; }
+const XMFLOAT4X4& SceneGraph::GetWorldInverseTransposeMatrix(SceneNode node) { return worldInverseTransposeMatrices[GetSlot(node)]; }
+
+XMFLOAT4X4 SceneGraph::GetInterpolatedWorldMatrix(SceneNode node, float alpha)
+{
+	unsigned int slot = GetSlot(node);
+	if (moved[slot] != Moved)
+		return worldMatrices[slot];
+	return InterpolateWorldMatrix(previousWorldMatrices[slot], worldMatrices[slot], alpha);
+}
+
+// Blended the same way as the world matrix, so the two stay
+// in step
+XMFLOAT4X4 SceneGraph::GetInterpolatedWorldInverseTransposeMatrix(SceneNode node, float alpha)
+{
+	unsigned int slot = GetSlot(node);
+	if (moved[slot] != Moved)
+		return worldInverseTransposeMatrices[slot];
+	return InterpolateWorldMatrix(previousWorldInverseTransposeMatrices[slot], worldInverseTransposeMatrices[slot], alpha);
+}
+
+bool SceneGraph::IsMoving(SceneNode node)
+{
+	return moved[GetSlot(node)] == Moved;
+}
+
+
+unsigned int SceneGraph::UpdateWorldMatrices()
+{
+	if (orderDirty)
+		SortByDepth();
+
+	// Parents are always done before their children, so a dirty
+	// parent has already passed its flag down by the time we
+	// get to each child
+	unsigned int updated = 0;
+	unsigned int version = ++updateNumber;
+	size_t count = handles.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int parent = parents[i];
+		if (parent != InvalidSceneNode)
+			dirty[i] |= dirty[parent];
+		if (!dirty[i])
+		{
+			// Stopped since the last update, so it isn't between
+			// two places any more
+			if (moved[i] == Moved)
+			{
+				previousWorldMatrices[i] = worldMatrices[i];
+				previousWorldInverseTransposeMatrices[i] = worldInverseTransposeMatrices[i];
+				versions[i] = version;
+			}
+			moved[i] = AtRest;
+			continue;
+		}
+
+		// Same order as Transform: scale, then rotate, then
+		// translate, then whatever the parent does
+		XMMATRIX local =
+			XMMatrixScalingFromVector(XMLoadFloat3(&scales[i])) *
+			XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRolls[i])) *
+			XMMatrixTranslationFromVector(XMLoadFloat3(&positions[i]));
+		XMMATRIX world = local;
+		XMMATRIX worldInverseTranspose = InverseTransposeFromTRS(local, scales[i]);
+
+		// The inverse transpose of a product is the product of the
+		// inverse transposes, in the same order
+		if (parent != InvalidSceneNode)
+		{
+			world = world * XMLoadFloat4x4(&worldMatrices[parent]);
+			worldInverseTranspose = worldInverseTranspose * XMLoadFloat4x4(&worldInverseTransposeMatrices[parent]);
+		}
+
+		previousWorldMatrices[i] = worldMatrices[i];
+		previousWorldInverseTransposeMatrices[i] = worldInverseTransposeMatrices[i];
+		XMStoreFloat4x4(&worldMatrices[i], world);
+		XMStoreFloat4x4(&worldInverseTransposeMatrices[i], worldInverseTranspose);
+
+		// New nodes start where they are, rather than sliding in
+		// from the origin
+		if (moved[i] == Created)
+		{
+			previousWorldMatrices[i] = worldMatrices[i];
+			previousWorldInverseTransposeMatrices[i] = worldInverseTransposeMatrices[i];
+		}
+		moved[i] = moved[i] == Created ? AtRest : Moved;
+		versions[i] = version;
+		updated++;
+	}
+
+	// Everything's up to date now
+	if (count > 0)
+		memset(&dirty[0], 0, count);
+	lastUpdateCount = updated;
+	return updated;
+}
+
+
+// Works out every node's depth again and sorts the slots by
+// it, keeping nodes of the same depth in their current order
+void SceneGraph::SortByDepth()
+{
+	const unsigned int unknown = InvalidSceneNode;
+	size_t count = handles.size();
+
+	// Climb until we hit a node we already know, then fill in
+	// the depths on the way back down
+	std::vector<unsigned int> chain;
+	depths.assign(count, unknown);
+	unsigned int maxDepth = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int s = (unsigned int)i;
+		while (s != InvalidSceneNode && depths[s] == unknown)
+		{
+			chain.push_back(s);
+			s = parents[s];
+		}
+
+		unsigned int depth = s == InvalidSceneNode ? 0 : depths[s] + 1;
+		while (!chain.empty())
+		{
+			depths[chain.back()] = depth++;
+			chain.pop_back();
+		}
+		maxDepth = std::max(maxDepth, depths[i]);
+	}
+
+	// Counting sort by depth
+	std::vector<unsigned int> starts(maxDepth + 2, 0);
+	for (size_t i = 0; i < count; i++)
+		starts[depths[i] + 1]++;
+	for (size_t d = 1; d < starts.size(); d++)
+		starts[d] += starts[d - 1];
+
+	std::vector<unsigned int> order(count);
+	for (size_t i = 0; i < count; i++)
+		order[starts[depths[i]]++] = (unsigned int)i;
+
+	// Parents point at slots, so they need the new numbering
+	std::vector<unsigned int> newSlot(count);
+	for (size_t i = 0; i < count; i++)
+		newSlot[order[i]] = (unsigned int)i;
+	for (unsigned int& parent : parents)
+	{
+		if (parent != InvalidSceneNode)
+			parent = newSlot[parent];
+	}
+
+	Permute(parents, order);
+	Permute(depths, order);
+	Permute(handles, order);
+	Permute(positions, order);
+	Permute(pitchYawRolls, order);
+	Permute(scales, order);
+	Permute(worldMatrices, order);
+	Permute(worldInverseTransposeMatrices, order);
+	Permute(previousWorldMatrices, order);
+	Permute(previousWorldInverseTransposeMatrices, order);
+	Permute(moved, order);
+	Permute(dirty, order);
+	Permute(versions, order);
+
+	for (size_t i = 0; i < count; i++)
+		slots[handles[i]] = (unsigned int)i;
+	orderDirty = false;
+}
+
+
+// Drops the flagged slots, sliding the rest down in order.
+// Children have to be flagged along with their parents.
+void SceneGraph::RemoveSlots(const std::vector<unsigned char>& remove)
+{
+	std::vector<unsigned int> order;
+	for (size_t i = 0; i < remove.size(); i++)
+	{
+		if (remove[i])
+		{
+			slots[handles[i]] = InvalidSceneNode;
+			unusedHandles.push_back(handles[i]);
+		}
+		else
+		{
+			order.push_back((unsigned int)i);
+		}
+	}
+
+	std::vector<unsigned int> newSlot(remove.size(), InvalidSceneNode);
+	for (size_t i = 0; i < order.size(); i++)
+		newSlot[order[i]] = (unsigned int)i;
+	for (unsigned int& parent : parents)
+	{
+		if (parent != InvalidSceneNode)
+			parent = newSlot[parent];
+	}
+
+	Permute(parents, order);
+	Permute(depths, order);
+	Permute(handles, order);
+	Permute(positions, order);
+	Permute(pitchYawRolls, order);
+	Permute(scales, order);
+	Permute(worldMatrices, order);
+	Permute(worldInverseTransposeMatrices, order);
+	Permute(previousWorldMatrices, order);
+	Permute(previousWorldInverseTransposeMatrices, order);
+	Permute(moved, order);
+	Permute(dirty, order);
+	Permute(versions, order);
+
+	for (size_t i = 0; i < order.size(); i++)
+		slots[handles[i]] = (unsigned int)i;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Identifies a node.  Stays the same for the node's whole life,
+// even as the graph moves its data around.
+typedef unsigned int SceneNode;
+static const SceneNode InvalidSceneNode = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// A hierarchy of transforms, where each node's position,
+// rotation and scale are relative to its parent.
+//
+// Rather than each node working out its own world matrix
+// when asked, everything lives in flat arrays sorted by depth
+// (so parents always come before their children) and
+// UpdateWorldMatrices() does them all in one pass from front
+// to back.  Changing a node marks it dirty, and that pass
+// carries the flag down to the whole subtree on its way past,
+// so untouched parts of the graph cost almost nothing.
+//
+// The Get*Matrix() functions return the result of the last
+// update, so call it once per frame (or simulation step) after
+// moving things.  The matrices from the update before are kept
+// too, for GetInterpolatedWorldMatrix().
+// --------------------------------------------------------
+class SceneGraph
+{
+public:
+	SceneGraph();
+
+	// Makes a node with an identity transform, as a root or as a
+	// child of the given parent
+	SceneNode CreateNode(SceneNode parent = InvalidSceneNode);
+
+	// Destroys the node and everything below it
+	void DestroyNode(SceneNode node);
+
+	// Moves the node (and its subtree) under a new parent, or makes
+	// it a root.  Its local transform is kept, so it'll move in the
+	// world.  Fails if the parent is the node or one of its children.
+	bool SetParent(SceneNode node, SceneNode parent);
+	SceneNode GetParent(SceneNode node);
+	bool IsValid(SceneNode node);
+
+	void MoveAbsolute(SceneNode node, float x, float y, float z);
+	void Rotate(SceneNode node, float p, float y, float r);
+	void SetPosition(SceneNode node, float x, float y, float z);
+	void SetRotation(SceneNode node, float p, float y, float r);
+	void SetScale(SceneNode node, float x, float y, float z);
+
+	DirectX::XMFLOAT3 GetPosition(SceneNode node);
+	DirectX::XMFLOAT3 GetPitchYawRoll(SceneNode node);
+	DirectX::XMFLOAT3 GetScale(SceneNode node);
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(SceneNode node);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(SceneNode node);
+
+	// Between the last two updates: 0 for the one before, 1 for
+	// the latest
+	DirectX::XMFLOAT4X4 GetInterpolatedWorldMatrix(SceneNode node, float alpha);
+	DirectX::XMFLOAT4X4 GetInterpolatedWorldInverseTransposeMatrix(SceneNode node, float alpha);
+
+	// Changes whenever an update changes what the interpolated
+	// world matrix could be, as for TransformSystem::GetVersion()
+	unsigned int GetVersion(SceneNode node) { return versions[GetSlot(node)]; }
+
+	// Whether the node moved in the last update, as for
+	// TransformSystem::IsMoving()
+	bool IsMoving(SceneNode node);
+
+	// Recomputes the world matrices of every dirty node and its
+	// descendants, returning how many were recomputed
+	unsigned int UpdateWorldMatrices();
+
+	unsigned int GetNodeCount() { return (unsigned int)handles.size(); }
+	unsigned int GetLastUpdateCount() { return lastUpdateCount; }
+
+private:
+	// Node data, by slot.  Slots are sorted by depth, except
+	// between a change to the hierarchy and the next update.
+	std::vector<unsigned int> parents;		// Parent's slot, or InvalidSceneNode for roots
+	std::vector<unsigned int> depths;		// 0 for roots
+	std::vector<SceneNode> handles;			// Which node is in each slot
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> pitchYawRolls;
+	std::vector<DirectX::XMFLOAT3> scales;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+	std::vector<DirectX::XMFLOAT4X4> previousWorldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> previousWorldInverseTransposeMatrices;
+	std::vector<unsigned char> moved;		// Changed in the last update, or was just made
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned int> versions;
+
+	// Slot of each node, or InvalidSceneNode for unused handles
+	std::vector<unsigned int> slots;
+	std::vector<SceneNode> unusedHandles;
+
+	// Set when the slots are out of depth order
+	bool orderDirty;
+	unsigned int lastUpdateCount;
+	unsigned int updateNumber;		// Counts updates, for versions
+
+	unsigned int GetSlot(SceneNode node) { return slots[node]; }
+	void SortByDepth();
+	void RemoveSlots(const std::vector<unsigned char>& remove);
+};
@@ -0,0 +1,110 @@
+#include "ShadowCache.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+ShadowCache::ShadowCache(unsigned int framesToSettle)
+	: framesToSettle(framesToSettle),
+	frame(0),
+	shadowView(),
+	shadowProjection(),
+	valid(false),
+	lightChanged(false),
+	castersChanged(false),
+	stats()
+{
+}
+
+
+void ShadowCache::Invalidate()
+{
+	valid = false;
+}
+
+
+void ShadowCache::BeginFrame(const XMFLOAT4X4& shadowView, const XMFLOAT4X4& shadowProjection)
+{
+	frame++;
+	stats.Frames++;
+	stats.StaticCasters = 0;
+	stats.DynamicCasters = 0;
+
+	// Any change at all to the matrices moves every shadow
+	lightChanged = !valid ||
+		memcmp(&shadowView, &this->shadowView, sizeof(XMFLOAT4X4)) != 0 ||
+		memcmp(&shadowProjection, &this->shadowProjection, sizeof(XMFLOAT4X4)) != 0;
+	castersChanged = false;
+
+	this->shadowView = shadowView;
+	this->shadowProjection = shadowProjection;
+}
+
+
+void ShadowCache::AddCaster(unsigned int id, unsigned int version, bool moving)
+{
+	if (id >= casters.size())
+		casters.resize(id + 1, Caster());
+
+	Caster& c = casters[id];
+	if (c.LastFrame != frame - 1 || c.LastFrame == 0)
+	{
+		// New to the volume (or new altogether), so it goes in the
+		// cache until it shows it moves, unless it's moving already
+		c.Static = !moving;
+		c.QuietFrames = 0;
+		if (c.Static)
+			castersChanged = true;
+	}
+	else if (c.Version != version || moving)
+	{
+		if (c.Static)
+			castersChanged = true;
+		c.Static = false;
+		c.QuietFrames = 0;
+	}
+	else if (!c.Static && ++c.QuietFrames >= framesToSettle)
+	{
+		c.Static = true;
+		castersChanged = true;
+	}
+
+	c.Version = version;
+	c.LastFrame = frame;
+	if (c.Static)
+		stats.StaticCasters++;
+	else
+		stats.DynamicCasters++;
+}
+
+
+bool ShadowCache::EndFrame()
+{
+	// A static caster that wasn't added this frame has left the
+	// volume (or gone), taking its shadow out of the cache
+	for (Caster& c : casters)
+	{
+		if (c.Static && c.LastFrame == frame - 1 && c.LastFrame != 0)
+		{
+			c.Static = false;
+			castersChanged = true;
+		}
+	}
+
+	bool redraw = lightChanged || castersChanged;
+	if (lightChanged)
+		stats.LightChanges++;
+	else if (castersChanged)
+		stats.CasterChanges++;
+	if (redraw)
+		stats.StaticRenders++;
+
+	valid = true;
+	return redraw;
+}
+
+
+bool ShadowCache::IsStatic(unsigned int id) const
+{
+	return id < casters.size() && casters[id].LastFrame == frame && casters[id].Static;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// How the static shadow cache has done since it was made
+struct ShadowCacheStats
+{
+	unsigned int Frames;
+	unsigned int StaticRenders;		// Frames the static casters were redrawn
+	unsigned int LightChanges;		// Redraws for a new light, projection or map
+	unsigned int CasterChanges;		// Redraws for a static caster moving, coming or going
+	unsigned int StaticCasters;		// As of the last frame
+	unsigned int DynamicCasters;
+};
+
+// --------------------------------------------------------
+// Decides when a directional light's shadow map needs its
+// static casters drawn again.
+//
+// Casters are split in two.  Static ones are drawn into a
+// cached depth map, which is only redrawn when the light's
+// view or projection changes, or a static caster moves, enters
+// or leaves the light's volume.  Every frame the cache is
+// copied into the real shadow map and the dynamic casters are
+// drawn on top.
+//
+// Each caster is identified by an id (an entity index), the
+// version of its transform, which changes whenever it moves,
+// and whether it's moving now.  Versions only change on
+// simulation steps, but a moving caster is drawn somewhere new
+// every frame in between, so it can't be cached whatever its
+// version.  Anything new that isn't moving is assumed to be
+// static.  A static caster that moves becomes dynamic (costing
+// one redraw), and one that then stays put for a while becomes
+// static again (costing another), so a thing that moves now
+// and then doesn't keep flushing the cache.
+//
+// Per frame: BeginFrame(), AddCaster() for everything in the
+// light's volume, then EndFrame() to find out whether to
+// redraw, and IsStatic() to split the casters.
+// --------------------------------------------------------
+class ShadowCache
+{
+public:
+	// How many frames a dynamic caster has to stay still before
+	// it goes back into the cache
+	ShadowCache(unsigned int framesToSettle = 120);
+
+	// Forces a redraw next frame, such as when the shadow map
+	// has been made again
+	void Invalidate();
+
+	void BeginFrame(const DirectX::XMFLOAT4X4& shadowView, const DirectX::XMFLOAT4X4& shadowProjection);
+	// Moving is whether the caster's drawn matrix is changing
+	// between versions (see TransformSystem::IsMoving())
+	void AddCaster(unsigned int id, unsigned int version, bool moving);
+
+	// Whether the static casters need drawing into the cache
+	// again this frame
+	bool EndFrame();
+
+	// Whether a caster added this frame belongs in the cache
+	bool IsStatic(unsigned int id) const;
+
+	const ShadowCacheStats& GetStats() const { return stats; }
+
+private:
+	struct Caster
+	{
+		unsigned int Version;
+		unsigned int LastFrame;		// Last frame it was added, 0 if never
+		unsigned int QuietFrames;	// Frames since its version changed
+		bool Static;
+	};
+
+	unsigned int framesToSettle;
+	unsigned int frame;
+	DirectX::XMFLOAT4X4 shadowView;
+	DirectX::XMFLOAT4X4 shadowProjection;
+
+	// Set during a frame when the cached depth is out of date
+	bool valid;
+	bool lightChanged;
+	bool castersChanged;
+
+	// By id
+	std::vector<Caster> casters;
+
+	ShadowCacheStats stats;
+};
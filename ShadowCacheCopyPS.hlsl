@@ -0,0 +1,29 @@
+// Where this cascade's map starts in its cached region, and
+// which slice of the cache holds it
+cbuffer externalData : register(b0)
+{
+	int2 cacheOffset;
+	int cascade;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv           : TEXCOORD0;
+};
+
+// The static casters' depth, each slice a cascade's cached
+// region (a border of texels bigger than the cascade's map)
+Texture2DArray StaticShadowMap : register(t0);
+
+// --------------------------------------------------------
+// Copies the part of the cached region under a cascade's map
+// into it, texel for texel.  Depth buffers can only be copied
+// whole, so this draws a fullscreen triangle over the cascade's
+// slice instead, writing each texel's depth as it goes.
+// --------------------------------------------------------
+float main(VertexToPixel input) : SV_DEPTH
+{
+	int2 texel = int2(input.position.xy) + cacheOffset;
+	return StaticShadowMap.Load(int4(texel, cascade, 0)).r;
+}
@@ -0,0 +1,228 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace DirectX;
+
+ShadowCascades::ShadowCascades(unsigned int cascadeCount, float splitBlend)
+	: cascadeCount(1),
+	splitBlend(0),
+	shadowDistance(0),
+	casterDistance(20.0f),
+	valid(false),
+	frame(0),
+	lightDirection(0, 0, 0),
+	cameraProjection(),
+	resolution(0),
+	view(),
+	cascades(),
+	regions()
+{
+	SetCascadeCount(cascadeCount);
+	SetSplitBlend(splitBlend);
+
+	// Far cascades cover more of the world with each texel, so
+	// they change less on screen from one frame to the next
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		updateIntervals[i] = i < 2 ? 1 : 1u << (i - 1);
+}
+
+
+void ShadowCascades::SetCascadeCount(unsigned int count)
+{
+	cascadeCount = std::min(std::max(count, 1u), (unsigned int)MAX_SHADOW_CASCADES);
+	valid = false;
+}
+
+void ShadowCascades::SetSplitBlend(float blend)
+{
+	splitBlend = std::min(std::max(blend, 0.0f), 1.0f);
+	valid = false;
+}
+
+void ShadowCascades::SetShadowDistance(float distance)
+{
+	shadowDistance = std::max(distance, 0.0f);
+	valid = false;
+}
+
+void ShadowCascades::SetCasterDistance(float distance)
+{
+	casterDistance = std::max(distance, 0.0f);
+	valid = false;
+}
+
+void ShadowCascades::SetUpdateInterval(unsigned int cascade, unsigned int frames)
+{
+	if (cascade < MAX_SHADOW_CASCADES)
+		updateIntervals[cascade] = std::max(frames, 1u);
+}
+
+void ShadowCascades::Invalidate()
+{
+	valid = false;
+}
+
+
+void ShadowCascades::ComputeSplits(float nearZ, float farZ, unsigned int count, float blend, float* splits)
+{
+	// Each split is somewhere between where it'd be spaced
+	// evenly and where it'd be the same ratio past the last
+	for (unsigned int i = 0; i <= count; i++)
+	{
+		float t = (float)i / count;
+		float uniform = nearZ + (farZ - nearZ) * t;
+		float logarithmic = nearZ * powf(farZ / nearZ, t);
+		splits[i] = uniform + (logarithmic - uniform) * blend;
+	}
+
+	// Exactly the ends, whatever the rounding did
+	splits[0] = nearZ;
+	splits[count] = farZ;
+}
+
+
+unsigned int ShadowCascades::GetCacheResolution(unsigned int resolution)
+{
+	return resolution + GetCacheBorder(resolution) * 2;
+}
+
+unsigned int ShadowCascades::GetCacheBorder(unsigned int resolution)
+{
+	// A quarter of the map each way, so the camera can move that
+	// far across a cascade before its region has to move
+	return resolution / 4;
+}
+
+
+unsigned int ShadowCascades::Update(const XMFLOAT4X4& cameraView, const XMFLOAT4X4& cameraProjection,
+	const XMFLOAT3& lightDirection, unsigned int resolution)
+{
+	frame++;
+
+	// Anything that changes every cascade's shape throws them all out
+	bool all = !valid ||
+		memcmp(&lightDirection, &this->lightDirection, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&cameraProjection, &this->cameraProjection, sizeof(XMFLOAT4X4)) != 0 ||
+		resolution != this->resolution;
+	if (all)
+	{
+		this->lightDirection = lightDirection;
+		this->cameraProjection = cameraProjection;
+		this->resolution = std::max(resolution, 1u);
+
+		// The light looks along its direction from the origin, with
+		// any up that isn't parallel to it.  The cascades are all
+		// boxes in this space, so it never moves with the camera.
+		XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+		XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), direction, up));
+	}
+
+	// The camera's clip planes, from its perspective projection
+	const XMFLOAT4X4& p = cameraProjection;
+	float nearZ = -p._43 / p._33;
+	float farZ = p._43 / (1.0f - p._33);
+	if (shadowDistance > nearZ)
+		farZ = std::min(farZ, shadowDistance);
+
+	float splits[MAX_SHADOW_CASCADES + 1];
+	ComputeSplits(nearZ, farZ, cascadeCount, splitBlend, splits);
+
+	unsigned int updated = 0;
+	for (unsigned int i = 0; i < cascadeCount; i++)
+	{
+		ShadowCascade& cascade = cascades[i];
+		if (!all && cascade.LastUpdate != 0 && frame - cascade.LastUpdate < updateIntervals[i])
+			continue;
+
+		Fit(i, cameraView, splits[i], splits[i + 1]);
+		cascade.LastUpdate = frame;
+		cascade.Updates++;
+		updated |= 1u << i;
+	}
+
+	valid = true;
+	return updated;
+}
+
+
+// --------------------------------------------------------
+// Fits a cascade's projection around the camera's frustum
+// between two view depths, moving its cached region along if
+// the cascade has left it
+// --------------------------------------------------------
+void ShadowCascades::Fit(unsigned int index, const XMFLOAT4X4& cameraView, float nearDepth, float farDepth)
+{
+	ShadowCascade& cascade = cascades[index];
+
+	// A point at view depth z on the edge of the frustum is
+	// z * sqrt(k) from the view axis
+	float k = 1.0f / (cameraProjection._11 * cameraProjection._11) + 1.0f / (cameraProjection._22 * cameraProjection._22);
+
+	// The smallest sphere around the slice is centered on the view
+	// axis where the near and far corners are the same distance
+	// away, unless that's past the far end (for wide slices)
+	float centerDepth = (farDepth + nearDepth) * (1.0f + k) * 0.5f;
+	centerDepth = std::min(centerDepth, farDepth);
+	float radius = sqrtf((farDepth - centerDepth) * (farDepth - centerDepth) + farDepth * farDepth * k);
+
+	// Into the world, then into the light's view
+	XMMATRIX cameraWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameraView));
+	XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0, 0, centerDepth, 1), cameraWorld);
+	XMFLOAT3 lightCenter;
+	XMStoreFloat3(&lightCenter, XMVector3TransformCoord(center, XMLoadFloat4x4(&view)));
+
+	// Snap the center to whole texels.  The map is a whole number
+	// of texels across, so its edges land on texels too, and it's
+	// a texel wider than the sphere on each side, so snapping
+	// never leaves part of the sphere off the edge.
+	float texel = radius * 2.0f / (std::max(resolution, 3u) - 2);
+	float halfWidth = texel * resolution * 0.5f;
+	int x = (int)floorf(lightCenter.x / texel);
+	int y = (int)floorf(lightCenter.y / texel);
+
+	// The region only moves once the cascade would poke out of
+	// it (sideways, or in depth), or when its texels change size
+	int border = (int)GetCacheBorder(resolution);
+	float borderWidth = border * texel;
+	CacheRegion& region = regions[index];
+	if (!region.Valid || region.TexelSize != texel ||
+		abs(x - region.X) > border || abs(y - region.Y) > border ||
+		fabsf(lightCenter.z - region.Z) > borderWidth)
+	{
+		region.X = x;
+		region.Y = y;
+		region.Z = lightCenter.z;
+		region.TexelSize = texel;
+		region.Valid = true;
+		cascade.CacheMoves++;
+	}
+
+	// Both use the region's depth range, stretched by the border
+	// so the cascade's sphere stays inside it as the cascade moves
+	float nearZ = region.Z - radius - casterDistance - borderWidth;
+	float farZ = region.Z + radius + borderWidth;
+
+	XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+		x * texel - halfWidth, x * texel + halfWidth,
+		y * texel - halfWidth, y * texel + halfWidth,
+		nearZ, farZ);
+	XMStoreFloat4x4(&cascade.Projection, projection);
+	XMStoreFloat4x4(&cascade.ViewProjection, XMLoadFloat4x4(&view) * projection);
+	cascade.NearDepth = nearDepth;
+	cascade.FarDepth = farDepth;
+	cascade.TexelSize = texel;
+
+	// Texture rows go down while the light's y goes up
+	float regionHalfWidth = halfWidth + borderWidth;
+	XMStoreFloat4x4(&cascade.CacheProjection, XMMatrixOrthographicOffCenterLH(
+		region.X * texel - regionHalfWidth, region.X * texel + regionHalfWidth,
+		region.Y * texel - regionHalfWidth, region.Y * texel + regionHalfWidth,
+		nearZ, farZ));
+	cascade.CacheX = (unsigned int)(x - region.X + border);
+	cascade.CacheY = (unsigned int)(region.Y - y + border);
+}
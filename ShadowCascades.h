@@ -0,0 +1,144 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// The most cascades a directional light's shadow can be split
+// into.  Must match PerFrame.hlsli.
+#define MAX_SHADOW_CASCADES 4
+
+// One cascade's part of the shadow, as of its last update
+struct ShadowCascade
+{
+	DirectX::XMFLOAT4X4 Projection;		// Orthographic, in the light's view space
+	DirectX::XMFLOAT4X4 ViewProjection;	// World to the cascade's shadow map
+	float NearDepth;					// Camera view depths it was fit to
+	float FarDepth;
+	float TexelSize;					// World units per shadow map texel
+	unsigned int LastUpdate;			// Frame it was last fit, 0 if never
+	unsigned int Updates;				// Times it's been fit
+	unsigned int CacheMoves;			// Times its cached region has moved
+
+	// The cached region around it, and the texel of the region
+	// its map starts at
+	DirectX::XMFLOAT4X4 CacheProjection;
+	unsigned int CacheX;
+	unsigned int CacheY;
+};
+
+// --------------------------------------------------------
+// Splits a directional light's shadow into cascades, each
+// covering a slice of the camera's view depth with its own
+// shadow map, so shadows close to the camera get most of the
+// texels and ones far away still get some.
+//
+// Slices use the practical split scheme: a blend of evenly
+// spaced splits (which waste texels up close) and
+// logarithmic ones (which bunch up too much near the camera).
+//
+// Each cascade is fit to the bounding sphere of its slice of
+// the camera's frustum.  The sphere is the same size however
+// the camera turns, so the projection only ever moves, and it
+// moves in whole texels in the light's view space, so shadow
+// edges don't shimmer as the camera moves.  The sphere's depth
+// is stretched back toward the light so casters between it
+// and the light are still caught.
+//
+// Static casters are cached (see ShadowCache) over a bigger
+// region than each cascade: a border of texels wider on every
+// side, on the same texel grid and with the same depth range,
+// so a cascade's map is the region with the border cut off.
+// The region stays put while its cascade moves around inside
+// it, and only re-centers once the cascade would leave, so the
+// cache is redrawn every so often as the camera moves rather
+// than every time the camera crosses a texel.
+//
+// Cascades can be updated less often than every frame, with
+// far ones (which change least on screen) usually the slowest.
+// Until its next update a cascade keeps the matrices its map
+// was drawn with, and the shaders pick the first cascade whose
+// map covers a pixel, so a stale cascade is still used right.
+// --------------------------------------------------------
+class ShadowCascades
+{
+public:
+	ShadowCascades(unsigned int cascadeCount = MAX_SHADOW_CASCADES, float splitBlend = 0.75f);
+
+	// From 1 to MAX_SHADOW_CASCADES
+	void SetCascadeCount(unsigned int count);
+	unsigned int GetCascadeCount() const { return cascadeCount; }
+
+	// 0 for evenly spaced splits, 1 for logarithmic ones, or in
+	// between to blend them
+	void SetSplitBlend(float blend);
+	float GetSplitBlend() const { return splitBlend; }
+
+	// How far from the camera shadows reach, or 0 to reach the
+	// camera's far clip plane
+	void SetShadowDistance(float distance);
+	float GetShadowDistance() const { return shadowDistance; }
+
+	// How far past a cascade's sphere, toward the light, casters
+	// are still drawn
+	void SetCasterDistance(float distance);
+	float GetCasterDistance() const { return casterDistance; }
+
+	// Frames between a cascade's updates (1 for every frame)
+	void SetUpdateInterval(unsigned int cascade, unsigned int frames);
+	unsigned int GetUpdateInterval(unsigned int cascade) const { return updateIntervals[cascade]; }
+
+	// Makes every cascade update on the next Update()
+	void Invalidate();
+
+	// Fits each cascade that's due this frame to the camera, for a
+	// light shining in the given direction onto shadow maps of the
+	// given resolution.  A new light direction, camera projection
+	// or resolution updates every cascade.  Returns which cascades
+	// were updated, one bit each.
+	unsigned int Update(const DirectX::XMFLOAT4X4& cameraView, const DirectX::XMFLOAT4X4& cameraProjection,
+		const DirectX::XMFLOAT3& lightDirection, unsigned int resolution);
+
+	// The light's view matrix, shared by every cascade
+	const DirectX::XMFLOAT4X4& GetView() const { return view; }
+	const ShadowCascade& GetCascade(unsigned int cascade) const { return cascades[cascade]; }
+
+	// Fills splits with count + 1 view depths from nearZ to farZ,
+	// the boundaries between count cascades
+	static void ComputeSplits(float nearZ, float farZ, unsigned int count, float blend, float* splits);
+
+	// Width and height of a cached region, for shadow maps of the
+	// given resolution, and how many texels of it are border on
+	// each side
+	static unsigned int GetCacheResolution(unsigned int resolution);
+	static unsigned int GetCacheBorder(unsigned int resolution);
+
+private:
+	// Where each cascade's cached region is centered, in texels
+	// of the light's view (and in its depth)
+	struct CacheRegion
+	{
+		int X;
+		int Y;
+		float Z;
+		float TexelSize;
+		bool Valid;
+	};
+
+	unsigned int cascadeCount;
+	float splitBlend;
+	float shadowDistance;
+	float casterDistance;
+	unsigned int updateIntervals[MAX_SHADOW_CASCADES];
+
+	// What the cascades were last fit for
+	bool valid;
+	unsigned int frame;
+	DirectX::XMFLOAT3 lightDirection;
+	DirectX::XMFLOAT4X4 cameraProjection;
+	unsigned int resolution;
+
+	DirectX::XMFLOAT4X4 view;
+	ShadowCascade cascades[MAX_SHADOW_CASCADES];
+	CacheRegion regions[MAX_SHADOW_CASCADES];
+
+	void Fit(unsigned int cascade, const DirectX::XMFLOAT4X4& cameraView, float nearDepth, float farDepth);
+};
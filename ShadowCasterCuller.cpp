@@ -0,0 +1,161 @@
+#include "ShadowCasterCuller.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+ShadowCasterCuller::ShadowCasterCuller(unsigned int gridSize)
+	: gridSize(std::max(gridSize, 1u)),
+	shadowView(),
+	volume(),
+	stats()
+{
+	receiverDepth.resize(this->gridSize * this->gridSize, -INFINITY);
+}
+
+
+void ShadowCasterCuller::BeginFrame(const XMFLOAT4X4& shadowView, const XMFLOAT4X4& shadowProjection)
+{
+	this->shadowView = shadowView;
+
+	// An orthographic projection scales and offsets each axis, so
+	// the volume is wherever that lands from -1 to 1 (0 to 1 for
+	// depth).  See XMMatrixOrthographicOffCenterLH.
+	const XMFLOAT4X4& p = shadowProjection;
+	volume.MinX = (-1.0f - p._41) / p._11;
+	volume.MaxX = (1.0f - p._41) / p._11;
+	volume.MinY = (-1.0f - p._42) / p._22;
+	volume.MaxY = (1.0f - p._42) / p._22;
+	volume.MinZ = -p._43 / p._33;
+	volume.MaxZ = (1.0f - p._43) / p._33;
+
+	std::fill(receiverDepth.begin(), receiverDepth.end(), -INFINITY);
+	stats = {};
+}
+
+
+// --------------------------------------------------------
+// The light-space box around a world-space box: each axis
+// reaches as far as all three world axes do along it
+// --------------------------------------------------------
+ShadowCasterCuller::LightBox ShadowCasterCuller::ToLightSpace(const XMFLOAT3& center, const XMFLOAT3& halfExtent) const
+{
+	XMFLOAT3 c;
+	XMStoreFloat3(&c, XMVector3TransformCoord(XMLoadFloat3(&center), XMLoadFloat4x4(&shadowView)));
+
+	const XMFLOAT4X4& v = shadowView;
+	XMFLOAT3 half(
+		fabsf(v._11) * halfExtent.x + fabsf(v._21) * halfExtent.y + fabsf(v._31) * halfExtent.z,
+		fabsf(v._12) * halfExtent.x + fabsf(v._22) * halfExtent.y + fabsf(v._32) * halfExtent.z,
+		fabsf(v._13) * halfExtent.x + fabsf(v._23) * halfExtent.y + fabsf(v._33) * halfExtent.z);
+
+	return { c.x - half.x, c.y - half.y, c.z - half.z, c.x + half.x, c.y + half.y, c.z + half.z };
+}
+
+
+bool ShadowCasterCuller::OverlapsVolume(const LightBox& box) const
+{
+	return
+		box.MinX <= volume.MaxX && box.MaxX >= volume.MinX &&
+		box.MinY <= volume.MaxY && box.MaxY >= volume.MinY &&
+		box.MinZ <= volume.MaxZ && box.MaxZ >= volume.MinZ;
+}
+
+
+// The range of grid cells a box covers, clamped to the grid
+void ShadowCasterCuller::GetCells(const LightBox& box, int& minX, int& minY, int& maxX, int& maxY) const
+{
+	float scaleX = gridSize / (volume.MaxX - volume.MinX);
+	float scaleY = gridSize / (volume.MaxY - volume.MinY);
+	int last = (int)gridSize - 1;
+	minX = std::min(std::max((int)floorf((box.MinX - volume.MinX) * scaleX), 0), last);
+	maxX = std::min(std::max((int)floorf((box.MaxX - volume.MinX) * scaleX), 0), last);
+	minY = std::min(std::max((int)floorf((box.MinY - volume.MinY) * scaleY), 0), last);
+	maxY = std::min(std::max((int)floorf((box.MaxY - volume.MinY) * scaleY), 0), last);
+}
+
+
+void ShadowCasterCuller::AddReceiver(const XMFLOAT3& center, const XMFLOAT3& halfExtent)
+{
+	// Receivers outside the light's volume can't be in its shadow
+	LightBox box = ToLightSpace(center, halfExtent);
+	if (!OverlapsVolume(box))
+		return;
+
+	int minX, minY, maxX, maxY;
+	GetCells(box, minX, minY, maxX, maxY);
+	for (int y = minY; y <= maxY; y++)
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			float& depth = receiverDepth[y * gridSize + x];
+			depth = std::max(depth, box.MaxZ);
+		}
+	}
+	stats.Receivers++;
+}
+
+
+// Whether any receiver reaches past the near side of the box
+// in a cell the box covers
+bool ShadowCasterCuller::HasReceiverBehind(const LightBox& box) const
+{
+	int minX, minY, maxX, maxY;
+	GetCells(box, minX, minY, maxX, maxY);
+	for (int y = minY; y <= maxY; y++)
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			if (box.MinZ <= receiverDepth[y * gridSize + x])
+				return true;
+		}
+	}
+	return false;
+}
+
+
+bool ShadowCasterCuller::CouldShadow(const XMFLOAT3& center, const XMFLOAT3& halfExtent) const
+{
+	LightBox box = ToLightSpace(center, halfExtent);
+	return OverlapsVolume(box) && HasReceiverBehind(box);
+}
+
+
+unsigned int ShadowCasterCuller::Cull(const FrustumCuller& bounds, std::vector<unsigned int>& casters, std::vector<unsigned int>* inVolume)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	casters.clear();
+	if (inVolume)
+		inVolume->clear();
+	stats.Tested = 0;
+	stats.Outside = 0;
+	stats.Unseen = 0;
+	for (unsigned int i = 0; i < bounds.GetCount(); i++)
+	{
+		XMFLOAT3 center, halfExtent;
+		bounds.GetBox(i, center, halfExtent);
+		LightBox box = ToLightSpace(center, halfExtent);
+		stats.Tested++;
+
+		if (!OverlapsVolume(box))
+		{
+			stats.Outside++;
+			continue;
+		}
+
+		if (inVolume)
+			inVolume->push_back(i);
+		if (!HasReceiverBehind(box))
+			stats.Unseen++;
+		else
+			casters.push_back(i);
+	}
+
+	stats.Casters = (unsigned int)casters.size();
+	stats.CullMs = MillisecondsSince(start);
+	return stats.Casters;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+// What the last frame's shadow caster culling did
+struct ShadowCasterStats
+{
+	unsigned int Receivers;		// Visible objects that can be shadowed
+	unsigned int Tested;		// Possible casters
+	unsigned int Casters;		// Of those, how many need drawing
+	unsigned int Outside;		// Outside the light's volume
+	unsigned int Unseen;		// Inside it, but with no receiver behind them
+	double CullMs;
+};
+
+// --------------------------------------------------------
+// Picks which objects need drawing into a directional light's
+// shadow map.
+//
+// Everything happens in the light's view space, where light
+// travels along +z and the orthographic projection is a box.
+// A caster has to overlap that box, and has to be in front of
+// some visible receiver (nearer the light than the receiver's
+// far side, with their boxes overlapping across the map), or
+// its shadow couldn't be seen.
+//
+// Receivers are kept as a coarse grid over the shadow map,
+// each cell holding the farthest receiver depth over it, so a
+// caster only looks at the cells it covers rather than every
+// receiver.  Cells are conservative, so casters are sometimes
+// kept without anything behind them, but never dropped when
+// there is.
+//
+// Per frame: BeginFrame(), AddReceiver() for each visible
+// object, then Cull() or CouldShadow().
+// --------------------------------------------------------
+class ShadowCasterCuller
+{
+public:
+	// Cells across (and down) the receiver grid
+	ShadowCasterCuller(unsigned int gridSize = 32);
+
+	// Sets up the light's volume and empties the receiver grid
+	void BeginFrame(const DirectX::XMFLOAT4X4& shadowView, const DirectX::XMFLOAT4X4& shadowProjection);
+
+	// Adds a visible object by its world-space box (center and
+	// half its size along each axis)
+	void AddReceiver(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfExtent);
+
+	// Whether an object with the given world-space box could cast
+	// a shadow onto any receiver
+	bool CouldShadow(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfExtent) const;
+
+	// Fills casters with the index of every object in bounds (all
+	// of them, not just the visible ones) that could cast a shadow
+	// onto a receiver, in order, and returns how many there were.
+	// If given, inVolume gets every object inside the light's
+	// volume, whether or not anything is behind it.
+	unsigned int Cull(const FrustumCuller& bounds, std::vector<unsigned int>& casters, std::vector<unsigned int>* inVolume = nullptr);
+
+	const ShadowCasterStats& GetStats() const { return stats; }
+
+private:
+	// An axis-aligned box in the light's view space
+	struct LightBox
+	{
+		float MinX, MinY, MinZ;
+		float MaxX, MaxY, MaxZ;
+	};
+
+	unsigned int gridSize;
+	DirectX::XMFLOAT4X4 shadowView;
+	LightBox volume;
+
+	// Farthest receiver depth over each cell, row by row, or
+	// -infinity where there's no receiver
+	std::vector<float> receiverDepth;
+
+	ShadowCasterStats stats;
+
+	LightBox ToLightSpace(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfExtent) const;
+	bool OverlapsVolume(const LightBox& box) const;
+	bool HasReceiverBehind(const LightBox& box) const;
+	void GetCells(const LightBox& box, int& minX, int& minY, int& maxX, int& maxY) const;
+};
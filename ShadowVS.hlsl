@@ -15,7 +15,7 @@ struct VertexShaderInput
 	float3 localPosition	: POSITION;
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;
 };
 
 // VStoPS struct for shadow map creation
@@ -0,0 +1,41 @@
+// Constant Buffer for external (C++) data
+cbuffer perFrame : register(b0)
+{
+	matrix view;
+	matrix projection;
+}
+
+// Only the world matrix is read from each InstanceData, the
+// rest of it is skipped over by the instance buffer's stride
+struct VertexShaderInput
+{
+	float3 localPosition	: POSITION;
+	float2 uv				: TEXCOORD;
+	float3 normal			: NORMAL;
+	float4 tangent			: TANGENT;
+
+	float4 world0			: WORLD_PER_INSTANCE0;
+	float4 world1			: WORLD_PER_INSTANCE1;
+	float4 world2			: WORLD_PER_INSTANCE2;
+	float4 world3			: WORLD_PER_INSTANCE3;
+};
+
+// VStoPS struct for shadow map creation
+struct VertexToPixel_Shadow
+{
+	float4 screenPosition	: SV_POSITION;
+};
+
+VertexToPixel_Shadow main(VertexShaderInput input)
+{
+	// Set up output
+	VertexToPixel_Shadow output;
+
+	// The instance's rows multiply with the vector first (see
+	// VertexShaderInstanced.hlsl), the cbuffer matrices after
+	matrix world = matrix(input.world0, input.world1, input.world2, input.world3);
+	float4 worldPos = mul(float4(input.localPosition, 1.0f), world);
+	output.screenPosition = mul(projection, mul(view, worldPos));
+
+	return output;
+}
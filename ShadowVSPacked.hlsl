@@ -0,0 +1,37 @@
+#include "VertexPacking.hlsli"
+
+// Constant Buffer for external (C++) data
+cbuffer perFrame : register(b0)
+{
+	matrix view;
+	matrix projection;
+}
+
+cbuffer perObject : register(b1)
+{
+	matrix world;
+	float3 positionMin;		// Mesh bounds, for decoding positions
+	float3 positionExtent;
+};
+
+// VStoPS struct for shadow map creation
+struct VertexToPixel_Shadow
+{
+	float4 screenPosition	: SV_POSITION;
+};
+
+// --------------------------------------------------------
+// Same as ShadowVS.hlsl, but reading PackedVertex data
+// --------------------------------------------------------
+VertexToPixel_Shadow main(PackedVertexInput input)
+{
+	// Set up output
+	VertexToPixel_Shadow output;
+
+	// Calculate output position
+	float3 localPosition = DecodePosition(input.position, positionMin, positionExtent);
+	matrix wvp = mul(projection, mul(view, world));
+	output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+
+	return output;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstddef>
+
+// --------------------------------------------------------
+// SIMD helpers.  With AVX2 each register holds 8 floats,
+// otherwise SSE's 4, and the CPU-side kernels (culling, light
+// binning, transforms) are written against these so the same
+// code builds for both.  Release builds target AVX2 (/arch:AVX2
+// in the project); Debug builds are left on SSE on purpose, so
+// they still run on any x64 CPU and keep the 4 wide path
+// building and tested.  Comparisons give a mask
+// with every bit of a lane set where they're true, for And(),
+// Or(), Select(), Mask() and Any().
+// --------------------------------------------------------
+#if defined(__AVX2__)
+
+typedef __m256 Lanes;
+static const size_t LaneCount = 8;
+
+inline Lanes Load(const float* in) { return _mm256_loadu_ps(in); }
+inline void Store(float* out, Lanes a) { _mm256_storeu_ps(out, a); }
+inline Lanes Splat(float f) { return _mm256_set1_ps(f); }
+inline Lanes Zero() { return _mm256_setzero_ps(); }
+
+inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+inline Lanes Min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+inline Lanes Max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+inline Lanes Sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+inline Lanes Abs(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+inline Lanes Round(Lanes a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+inline Lanes Less(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline Lanes LessEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline Lanes Greater(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline Lanes GreaterEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+
+inline Lanes And(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+inline Lanes Or(Lanes a, Lanes b) { return _mm256_or_ps(a, b); }
+inline Lanes Select(Lanes a, Lanes b, Lanes mask) { return _mm256_blendv_ps(a, b, mask); }
+inline unsigned int Mask(Lanes a) { return (unsigned int)_mm256_movemask_ps(a); }
+inline bool Any(Lanes mask) { return _mm256_movemask_ps(mask) != 0; }
+
+// Largest of all the lanes
+inline float HorizontalMax(Lanes a)
+{
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+	return _mm_cvtss_f32(m);
+}
+
+#else
+
+typedef __m128 Lanes;
+static const size_t LaneCount = 4;
+
+inline Lanes Load(const float* in) { return _mm_loadu_ps(in); }
+inline void Store(float* out, Lanes a) { _mm_storeu_ps(out, a); }
+inline Lanes Splat(float f) { return _mm_set1_ps(f); }
+inline Lanes Zero() { return _mm_setzero_ps(); }
+
+inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes Min(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+inline Lanes Max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+inline Lanes Abs(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline Lanes Round(Lanes a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+
+inline Lanes Less(Lanes a, Lanes b) { return _mm_cmplt_ps(a, b); }
+inline Lanes LessEqual(Lanes a, Lanes b) { return _mm_cmple_ps(a, b); }
+inline Lanes Greater(Lanes a, Lanes b) { return _mm_cmpgt_ps(a, b); }
+inline Lanes GreaterEqual(Lanes a, Lanes b) { return _mm_cmpge_ps(a, b); }
+
+inline Lanes And(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+inline Lanes Or(Lanes a, Lanes b) { return _mm_or_ps(a, b); }
+inline Lanes Select(Lanes a, Lanes b, Lanes mask) { return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b)); }
+inline unsigned int Mask(Lanes a) { return (unsigned int)_mm_movemask_ps(a); }
+inline bool Any(Lanes mask) { return _mm_movemask_ps(mask) != 0; }
+
+inline float HorizontalMax(Lanes a)
+{
+	__m128 m = _mm_max_ps(a, _mm_movehl_ps(a, a));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+	return _mm_cvtss_f32(m);
+}
+
+#endif
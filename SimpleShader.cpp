@@ -4,6 +4,10 @@
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// No shared constant buffer until the application asks for one
+int ISimpleShader::SharedBufferSlot = -1;
+unsigned long long ISimpleShader::BytesUploaded = 0;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -278,6 +282,17 @@ SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
 	return result->second;
 }
 
+// --------------------------------------------------------
+// Whether the buffer at the given index is bound to the
+// shared slot, and so is filled and bound elsewhere
+// --------------------------------------------------------
+bool ISimpleShader::IsSharedBuffer(unsigned int index)
+{
+	return
+		constantBuffers[index].Type == D3D11_CT_CBUFFER &&
+		(int)constantBuffers[index].BindIndex == SharedBufferSlot;
+}
+
 // --------------------------------------------------------
 // Prints the specified message to the console with the 
 // given color and Visual Studio's output window
@@ -348,10 +363,15 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		// The shared buffer isn't ours to fill
+		if (IsSharedBuffer(i))
+			continue;
+
 		// Copy the entire local data buffer
 		deviceContext->UpdateSubresource(
 			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
 			constantBuffers[i].LocalDataBuffer, 0, 0);
+		BytesUploaded += constantBuffers[i].Size;
 	}
 }
 
@@ -383,6 +403,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	deviceContext->UpdateSubresource(
 		cb->ConstantBuffer.Get(), 0, 0, 
 		cb->LocalDataBuffer, 0, 0);
+	BytesUploaded += cb->Size;
 }
 
 // --------------------------------------------------------
@@ -405,6 +426,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	deviceContext->UpdateSubresource(
 		cb->ConstantBuffer.Get(), 0, 0, 
 		cb->LocalDataBuffer, 0, 0);
+	BytesUploaded += cb->Size;
 }
 
 
@@ -875,8 +897,9 @@ void SimpleVertexShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers,
+		// and the shared one the application binds itself
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || IsSharedBuffer(i))
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1017,8 +1040,9 @@ void SimplePixelShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers,
+		// and the shared one the application binds itself
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || IsSharedBuffer(i))
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1161,8 +1185,9 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers,
+		// and the shared one the application binds itself
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || IsSharedBuffer(i))
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1304,8 +1329,9 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers,
+		// and the shared one the application binds itself
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || IsSharedBuffer(i))
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1578,8 +1604,9 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers,
+		// and the shared one the application binds itself
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || IsSharedBuffer(i))
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1788,8 +1815,9 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers,
+		// and the shared one the application binds itself
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || IsSharedBuffer(i))
 			continue;
 
 		// This is a real constant buffer, so set it
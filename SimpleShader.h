@@ -122,6 +122,15 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Constant buffers bound to this register are shared by every
+	// shader and filled and bound by the application, so shaders
+	// never bind or copy their own copy of it (-1 for none)
+	static int SharedBufferSlot;
+
+	// Bytes copied into constant buffers by every shader so far,
+	// for measuring upload traffic (reset it whenever you like)
+	static unsigned long long BytesUploaded;
+
 protected:
 	
 	bool shaderValid;
@@ -153,6 +162,7 @@ protected:
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	bool IsSharedBuffer(unsigned int index);
 
 	// Error logging
 	void Log(std::string message, WORD color);
@@ -14,7 +14,7 @@ struct VertexShaderInput
 	float3 position		: POSITION;     // XYZ position
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -0,0 +1,266 @@
+#include "Tangents.h"
+#include "Parallel.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// Triangles with less UV area than this (doubled, in UV units)
+// have no direction to give, so they're skipped
+static const float MinUVArea = 1e-20f;
+
+// A tangent this close to the normal (as a fraction of its
+// squared length) is mostly rounding error once it's
+// orthogonalized, so the vertex gets the fallback instead
+static const float MinTangentFraction = 1e-6f;
+
+// Pieces smaller than these aren't worth their own thread
+static const size_t MinTrianglesPerThread = 16384;
+static const size_t MinVerticesPerThread = 16384;
+
+// Triangles are looked at by threads in blocks this big, each
+// remembering which vertices it touches
+static const size_t TrianglesPerBlock = 256;
+
+// --------------------------------------------------------
+// Any unit vector perpendicular to the normal, for vertices
+// whose triangles don't give a usable direction
+// --------------------------------------------------------
+static XMVECTOR FallbackTangent(FXMVECTOR normal)
+{
+	// Cross with whichever axis is furthest from the normal
+	XMFLOAT3 n;
+	XMStoreFloat3(&n, normal);
+	XMVECTOR axis = fabsf(n.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+
+	XMVECTOR tangent = XMVector3Cross(normal, axis);
+	float lengthSq = XMVectorGetX(XMVector3LengthSq(tangent));
+	return lengthSq > 0.0f ? tangent / sqrtf(lengthSq) : XMVectorSet(1, 0, 0, 0);
+}
+
+// --------------------------------------------------------
+// Turns the summed tangent and bitangent of a vertex into
+// its final tangent: Gram-Schmidt orthogonalized against the
+// normal, with the bitangent's handedness in w
+// --------------------------------------------------------
+static XMFLOAT4 FinishTangent(const XMFLOAT3& normal, FXMVECTOR tangentSum, FXMVECTOR bitangentSum)
+{
+	XMVECTOR n = XMLoadFloat3(&normal);
+	XMVECTOR t = tangentSum - n * XMVector3Dot(n, tangentSum);
+
+	// Written so NaNs fail the test too
+	float lengthSq = XMVectorGetX(XMVector3LengthSq(t));
+	float sumLengthSq = XMVectorGetX(XMVector3LengthSq(tangentSum));
+	if (lengthSq > sumLengthSq * MinTangentFraction && lengthSq > 0.0f && std::isfinite(lengthSq))
+		t = t / sqrtf(lengthSq);
+	else
+		t = FallbackTangent(n);
+
+	// Mirrored UVs flip the bitangent relative to cross(n, t)
+	float sign = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, t), bitangentSum)) < 0.0f ? -1.0f : 1.0f;
+
+	XMFLOAT4 result;
+	XMStoreFloat4(&result, XMVectorSetW(t, sign));
+	return result;
+}
+
+
+// Smallest and largest vertex index used by a block of triangles
+struct VertexRange
+{
+	unsigned int Min;
+	unsigned int Max;
+};
+
+// --------------------------------------------------------
+// Tangent and bitangent of one triangle, or false if it has
+// no UV area.  Same math as the reference version.
+// --------------------------------------------------------
+static bool TriangleTangents(const Vertex* verts, const unsigned int* triangle, XMFLOAT3& tangent, XMFLOAT3& bitangent)
+{
+	const Vertex& v1 = verts[triangle[0]];
+	const Vertex& v2 = verts[triangle[1]];
+	const Vertex& v3 = verts[triangle[2]];
+
+	// Vectors relative to the first corner
+	float x1 = v2.Position.x - v1.Position.x;
+	float y1 = v2.Position.y - v1.Position.y;
+	float z1 = v2.Position.z - v1.Position.z;
+	float x2 = v3.Position.x - v1.Position.x;
+	float y2 = v3.Position.y - v1.Position.y;
+	float z2 = v3.Position.z - v1.Position.z;
+
+	float s1 = v2.UV.x - v1.UV.x;
+	float t1 = v2.UV.y - v1.UV.y;
+	float s2 = v3.UV.x - v1.UV.x;
+	float t2 = v3.UV.y - v1.UV.y;
+
+	// NaNs fail the test as well
+	float area = s1 * t2 - s2 * t1;
+	if (!(fabsf(area) >= MinUVArea))
+		return false;
+
+	float r = 1.0f / area;
+	tangent = XMFLOAT3((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+	bitangent = XMFLOAT3((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+	return true;
+}
+
+
+void CalculateTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	size_t vertexCount = numVerts > 0 ? (size_t)numVerts : 0;
+	size_t triangleCount = numIndices > 0 ? (size_t)numIndices / 3 : 0;
+	if (vertexCount == 0)
+		return;
+
+	// With only one thread's worth of vertices, splitting them up
+	// is all overhead
+	if (vertexCount < MinVerticesPerThread * 2 || GetWorkerCount() == 1)
+	{
+		CalculateTangentsReference(verts, numVerts, indices, numIndices);
+		return;
+	}
+
+	// The range of vertices each block of triangles touches
+	size_t blockCount = (triangleCount + TrianglesPerBlock - 1) / TrianglesPerBlock;
+	std::vector<VertexRange> blockVertices(blockCount);
+	ParallelFor(blockCount, MinTrianglesPerThread / TrianglesPerBlock, [&](size_t begin, size_t end)
+	{
+		for (size_t b = begin; b < end; b++)
+		{
+			VertexRange range = { 0xFFFFFFFF, 0 };
+			size_t last = std::min((b + 1) * TrianglesPerBlock, triangleCount);
+			for (size_t i = b * TrianglesPerBlock * 3; i < last * 3; i++)
+			{
+				range.Min = std::min(range.Min, indices[i]);
+				range.Max = std::max(range.Max, indices[i]);
+			}
+			blockVertices[b] = range;
+		}
+	});
+
+	// Each thread owns a range of vertices, and works through just the
+	// blocks that touch it, adding their triangles to the vertices it
+	// owns in triangle order (like the reference version).  The index
+	// buffer is usually ordered for the vertex cache and fetch by now,
+	// so most blocks only land in one thread's range; the rest get
+	// calculated twice.
+	ParallelFor(vertexCount, MinVerticesPerThread, [&](size_t begin, size_t end)
+	{
+		std::vector<XMFLOAT3> tangents(end - begin, XMFLOAT3(0, 0, 0));
+		std::vector<XMFLOAT3> bitangents(end - begin, XMFLOAT3(0, 0, 0));
+		for (size_t b = 0; b < blockCount; b++)
+		{
+			if (blockVertices[b].Max < begin || blockVertices[b].Min >= end)
+				continue;
+
+			// Skip the per-vertex checks when the whole block is ours
+			bool inside = blockVertices[b].Min >= begin && blockVertices[b].Max < end;
+			size_t last = std::min((b + 1) * TrianglesPerBlock, triangleCount);
+			for (size_t t = b * TrianglesPerBlock; t < last; t++)
+			{
+				XMFLOAT3 tx, bx;
+				if (!TriangleTangents(verts, &indices[t * 3], tx, bx))
+					continue;
+
+				for (int c = 0; c < 3; c++)
+				{
+					size_t v = indices[t * 3 + c];
+					if (!inside && (v < begin || v >= end))
+						continue;
+
+					XMFLOAT3& tangent = tangents[v - begin];
+					tangent.x += tx.x;
+					tangent.y += tx.y;
+					tangent.z += tx.z;
+
+					XMFLOAT3& bitangent = bitangents[v - begin];
+					bitangent.x += bx.x;
+					bitangent.y += bx.y;
+					bitangent.z += bx.z;
+				}
+			}
+		}
+
+		for (size_t v = begin; v < end; v++)
+			verts[v].Tangent = FinishTangent(verts[v].Normal, XMLoadFloat3(&tangents[v - begin]), XMLoadFloat3(&bitangents[v - begin]));
+	});
+}
+
+
+// Calculates the tangents of the vertices in a mesh
+// Code originally adapted from: http://www.terathon.com/code/tangent.html
+// Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//  - See listing 7.4 in section 7.5 (page 9 of the PDF)
+void CalculateTangentsReference(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	// Sums for each vertex
+	std::vector<XMFLOAT3> tangents(numVerts, XMFLOAT3(0, 0, 0));
+	std::vector<XMFLOAT3> bitangents(numVerts, XMFLOAT3(0, 0, 0));
+
+	// Calculate tangents one whole triangle at a time
+	for (int i = 0; i + 2 < numIndices;)
+	{
+		// Grab indices and vertices of first triangle
+		unsigned int i1 = indices[i++];
+		unsigned int i2 = indices[i++];
+		unsigned int i3 = indices[i++];
+		Vertex* v1 = &verts[i1];
+		Vertex* v2 = &verts[i2];
+		Vertex* v3 = &verts[i3];
+
+		// Calculate vectors relative to triangle positions
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		// Skip triangles with no UV area instead of dividing by zero
+		float area = s1 * t2 - s2 * t1;
+		if (!(fabsf(area) >= MinUVArea))
+			continue;
+
+		// Create vectors for tangent calculation
+		float r = 1.0f / area;
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		float bx = (s1 * x2 - s2 * x1) * r;
+		float by = (s1 * y2 - s2 * y1) * r;
+		float bz = (s1 * z2 - s2 * z1) * r;
+
+		// Adjust tangents of each vert of the triangle
+		for (unsigned int v : { i1, i2, i3 })
+		{
+			tangents[v].x += tx;
+			tangents[v].y += ty;
+			tangents[v].z += tz;
+
+			bitangents[v].x += bx;
+			bitangents[v].y += by;
+			bitangents[v].z += bz;
+		}
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].Tangent = FinishTangent(verts[i].Normal, XMLoadFloat3(&tangents[i]), XMLoadFloat3(&bitangents[i]));
+	}
+}
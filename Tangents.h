@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Calculates a tangent per vertex from the UV layout of the
+// triangles around it, orthogonalized against the normal.
+// Tangent.w gets the bitangent's sign (-1 where the UVs are
+// mirrored), so shaders can rebuild the bitangent as
+// cross(tangent, normal) * w.
+//
+// Triangles with no UV area don't add to any tangent, and
+// vertices left without a usable direction get an arbitrary
+// tangent perpendicular to their normal.
+//
+// Each worker thread owns a range of vertices and only adds up
+// the triangles that touch them, so no two threads ever write
+// to the same vertex, and the sums come out exactly like the
+// reference version's.  The triangles themselves are done one
+// at a time: fetching their corners and adding to the sums
+// costs far more than the math in between, so doing that math
+// four or eight at a time gained nothing.
+// --------------------------------------------------------
+void CalculateTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+
+// --------------------------------------------------------
+// The same calculation as a plain single-threaded loop over
+// the triangles, kept for checking CalculateTangents() against
+// --------------------------------------------------------
+void CalculateTangentsReference(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <chrono>
+
+// --------------------------------------------------------
+// Milliseconds from start until now, for the timings the
+// CPU-side systems keep in their stats
+// --------------------------------------------------------
+inline double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -1,7 +1,59 @@
 #include "Transform.h"
 
+#include <cmath>
+
 using namespace DirectX;
 
+// One over the square of a scale, or 0 if the axis is flattened
+// (which has no inverse, so normals on it end up zero)
+static float InverseSquare(float s)
+{
+	return s == 0.0f ? 0.0f : 1.0f / (s * s);
+}
+
+XMMATRIX InverseTransposeFromTRS(FXMMATRIX world, const XMFLOAT3& scale)
+{
+	XMMATRIX n = world;
+	if (scale.x == scale.y && scale.y == scale.z)
+	{
+		// Uniform scale only shrinks or grows the whole thing
+		if (scale.x != 1.0f)
+		{
+			float k = InverseSquare(scale.x);
+			n.r[0] = XMVectorScale(n.r[0], k);
+			n.r[1] = XMVectorScale(n.r[1], k);
+			n.r[2] = XMVectorScale(n.r[2], k);
+		}
+	}
+	else
+	{
+		n.r[0] = XMVectorScale(n.r[0], InverseSquare(scale.x));
+		n.r[1] = XMVectorScale(n.r[1], InverseSquare(scale.y));
+		n.r[2] = XMVectorScale(n.r[2], InverseSquare(scale.z));
+	}
+
+	// The inverse's translation is -t * (rotation * scale)^-1, and
+	// the transpose puts it down the last column
+	XMVECTOR t = world.r[3];
+	n.r[0] = XMVectorSetW(n.r[0], -XMVectorGetX(XMVector3Dot(t, n.r[0])));
+	n.r[1] = XMVectorSetW(n.r[1], -XMVectorGetX(XMVector3Dot(t, n.r[1])));
+	n.r[2] = XMVectorSetW(n.r[2], -XMVectorGetX(XMVector3Dot(t, n.r[2])));
+	n.r[3] = XMVectorSet(0, 0, 0, 1);
+	return n;
+}
+
+XMFLOAT4X4 InterpolateWorldMatrix(const XMFLOAT4X4& previous, const XMFLOAT4X4& current, float alpha)
+{
+	XMMATRIX a = XMLoadFloat4x4(&previous);
+	XMMATRIX b = XMLoadFloat4x4(&current);
+	for (int r = 0; r < 4; r++)
+		a.r[r] = XMVectorLerp(a.r[r], b.r[r], alpha);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, a);
+	return result;
+}
+
 
 Transform::Transform()
 {
@@ -10,11 +62,17 @@ Transform::Transform()
 	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
 
 	position = XMFLOAT3(0, 0, 0);
+	rotation = XMFLOAT4(0, 0, 0, 1);
 	pitchYawRoll = XMFLOAT3(0, 0, 0);
 	scale = XMFLOAT3(1, 1, 1);
 
+	right = XMFLOAT3(1, 0, 0);
+	up = XMFLOAT3(0, 1, 0);
+	forward = XMFLOAT3(0, 0, 1);
+
 	// No need to recalc yet
 	matricesDirty = false;
+	axesDirty = false;
 }
 
 void Transform::MoveAbsolute(float x, float y, float z)
@@ -27,25 +85,25 @@ void Transform::MoveAbsolute(float x, float y, float z)
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	// Create a direction vector from the params
-	// and a rotation quaternion
-	XMVECTOR movement = XMVectorSet(x, y, z, 0);
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-
-	// Rotate the movement by the quaternion
-	XMVECTOR dir = XMVector3Rotate(movement, rotQuat);
-
-	// Add and store, and invalidate the matrices
-	XMStoreFloat3(&position, XMLoadFloat3(&position) + dir);
+	// The rotated axes are already around, so moving along
+	// them is just a weighted sum
+	UpdateAxes();
+	position.x += x * right.x + y * up.x + z * forward.x;
+	position.y += x * right.y + y * up.y + z * forward.y;
+	position.z += x * right.z + y * up.z + z * forward.z;
 	matricesDirty = true;
 }
 
 void Transform::Rotate(float p, float y, float r)
 {
-	pitchYawRoll.x += p;
-	pitchYawRoll.y += y;
-	pitchYawRoll.z += r;
-	matricesDirty = true;
+	SetRotation(pitchYawRoll.x + p, pitchYawRoll.y + y, pitchYawRoll.z + r);
+}
+
+void Transform::Rotate(const XMFLOAT4& quaternion)
+{
+	XMFLOAT4 combined;
+	XMStoreFloat4(&combined, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMLoadFloat4(&quaternion)));
+	SetRotation(combined);
 }
 
 void Transform::Scale(float x, float y, float z)
@@ -69,7 +127,36 @@ void Transform::SetRotation(float p, float y, float r)
 	pitchYawRoll.x = p;
 	pitchYawRoll.y = y;
 	pitchYawRoll.z = r;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(p, y, r));
+	matricesDirty = true;
+	axesDirty = true;
+}
+
+void Transform::SetRotation(const XMFLOAT4& quaternion)
+{
+	XMStoreFloat4(&rotation, XMQuaternionNormalize(XMLoadFloat4(&quaternion)));
+
+	// Work the angles back out of the rotation matrix, which is
+	// roll * pitch * yaw:
+	//   row 0 = ( cr*cy + sr*sp*sy,  sr*cp,  sr*sp*cy - cr*sy )
+	//   row 1 = ( cr*sp*sy - sr*cy,  cr*cp,  sr*sy + cr*sp*cy )
+	//   row 2 = ( cp*sy,             -sp,    cp*cy            )
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)));
+	float yaw = atan2f(m._31, m._33);
+	pitchYawRoll.x = atan2f(-m._32, sqrtf(m._31 * m._31 + m._33 * m._33));
+	pitchYawRoll.y = yaw;
+
+	// Roll comes from undoing that yaw (leaving roll * pitch, whose
+	// first column is cr, -sr, 0) rather than from the middle
+	// column.  Looking nearly straight up or down, cp is tiny and
+	// yaw and roll turn the same way, so this way roll makes up
+	// whatever the yaw got wrong.
+	float sy = sinf(yaw);
+	float cy = cosf(yaw);
+	pitchYawRoll.z = atan2f(m._23 * sy - m._21 * cy, m._11 * cy - m._13 * sy);
 	matricesDirty = true;
+	axesDirty = true;
 }
 
 void Transform::SetScale(float x, float y, float z)
@@ -84,6 +171,8 @@ DirectX::XMFLOAT3 Transform::GetPosition() { return position; }
 
 DirectX::XMFLOAT3 Transform::GetPitchYawRoll() { return pitchYawRoll; }
 
+DirectX::XMFLOAT4 Transform::GetRotation() { return rotation; }
+
 DirectX::XMFLOAT3 Transform::GetScale() { return scale; }
 
 
@@ -96,7 +185,25 @@ DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
 	UpdateMatrices();
-	return worldMatrix;
+	return worldInverseTransposeMatrix;
+}
+
+DirectX::XMFLOAT3 Transform::GetRight()
+{
+	UpdateAxes();
+	return right;
+}
+
+DirectX::XMFLOAT3 Transform::GetUp()
+{
+	UpdateAxes();
+	return up;
+}
+
+DirectX::XMFLOAT3 Transform::GetForward()
+{
+	UpdateAxes();
+	return forward;
 }
 
 void Transform::UpdateMatrices()
@@ -106,7 +213,7 @@ void Transform::UpdateMatrices()
 	{
 		// Create the three transformation pieces
 		XMMATRIX trans = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
-		XMMATRIX rot = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+		XMMATRIX rot = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
 		XMMATRIX sc = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
 
 		// Combine and store the world
@@ -114,9 +221,22 @@ void Transform::UpdateMatrices()
 		XMStoreFloat4x4(&worldMatrix, wm);
 
 		// Invert and transpose, too
-		XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(wm)));
+		XMStoreFloat4x4(&worldInverseTransposeMatrix, InverseTransposeFromTRS(wm, scale));
 
 		// All set
 		matricesDirty = false;
 	}
 }
+
+void Transform::UpdateAxes()
+{
+	if (axesDirty)
+	{
+		// The rotation's rows are where the axes end up
+		XMMATRIX rot = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
+		XMStoreFloat3(&right, rot.r[0]);
+		XMStoreFloat3(&up, rot.r[1]);
+		XMStoreFloat3(&forward, rot.r[2]);
+		axesDirty = false;
+	}
+}
@@ -2,6 +2,30 @@
 
 #include <DirectXMath.h>
 
+// --------------------------------------------------------
+// Inverse transpose of a world matrix made from scale *
+// rotation * translation, given the scale it was made with.
+//
+// The rows of that matrix are the rotation's rows times each
+// axis' scale, so the inverse transpose's rows are the same
+// ones divided by the scale instead - the world's rows divided
+// by the scale squared.  That's a handful of multiplies rather
+// than a general 4x4 inverse, and with a uniform scale of 1
+// the 3x3 part is the world's own.  The translation of the
+// inverse ends up down the last column, as it would from
+// XMMatrixInverse(XMMatrixTranspose(world)).
+// --------------------------------------------------------
+DirectX::XMMATRIX InverseTransposeFromTRS(DirectX::FXMMATRIX world, const DirectX::XMFLOAT3& scale);
+
+// --------------------------------------------------------
+// Blends between two world matrices an object had on
+// consecutive simulation steps, element by element.  A step
+// is short enough that the rotation barely changes, so this
+// stays close to a proper rotation and is much cheaper than
+// splitting both apart and slerping.
+// --------------------------------------------------------
+DirectX::XMFLOAT4X4 InterpolateWorldMatrix(const DirectX::XMFLOAT4X4& previous, const DirectX::XMFLOAT4X4& current, float alpha);
+
 class Transform
 {
 public:
@@ -16,15 +40,31 @@ public:
 	void SetRotation(float p, float y, float r);
 	void SetScale(float x, float y, float z);
 
+	// The rotation is kept as a quaternion, and the pitch/yaw/roll
+	// functions above convert to and from it.  These work on it
+	// directly (normalizing anything passed in).  Rotate() applies
+	// the extra rotation after the current one.
+	void SetRotation(const DirectX::XMFLOAT4& quaternion);
+	void Rotate(const DirectX::XMFLOAT4& quaternion);
+
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
+	DirectX::XMFLOAT4 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 
+	// World space directions of the local X, Y and Z axes
+	DirectX::XMFLOAT3 GetRight();
+	DirectX::XMFLOAT3 GetUp();
+	DirectX::XMFLOAT3 GetForward();
+
 private:
-	// Raw transformation data
+	// Raw transformation data.  The quaternion is what's used for
+	// everything; the angles are only there so that rotating by
+	// pitch/yaw/roll adds to the same angles it always did.
 	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT4 rotation;
 	DirectX::XMFLOAT3 pitchYawRoll;
 	DirectX::XMFLOAT3 scale;
 
@@ -33,7 +73,14 @@ private:
 	DirectX::XMFLOAT4X4 worldMatrix;
 	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
 
-	// Helper to update both matrices if necessary
+	// The rotated axes, which only change with the rotation (so
+	// moving doesn't have to rebuild them)
+	bool axesDirty;
+	DirectX::XMFLOAT3 right;
+	DirectX::XMFLOAT3 up;
+	DirectX::XMFLOAT3 forward;
+
+	// Helpers to update the matrices or axes if necessary
 	void UpdateMatrices();
+	void UpdateAxes();
 };
-
@@ -0,0 +1,434 @@
+#include "TransformSystem.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include "Transform.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+using namespace DirectX;
+
+// Values of the moved flags
+static const unsigned char AtRest = 0;
+static const unsigned char Moved = 1;
+static const unsigned char Created = 2;
+
+// Pieces smaller than this aren't worth their own thread.  Each
+// matrix is only a few nanoseconds of work, so it takes a lot
+// of them to pay for starting one.
+static const size_t MinTransformsPerThread = 16384;
+
+// Four of the lanes, starting at 4 * half
+#if defined(__AVX2__)
+static inline __m128 Quarter(Lanes a, size_t half) { return half == 0 ? _mm256_castps256_ps128(a) : _mm256_extractf128_ps(a, 1); }
+#else
+static inline __m128 Quarter(Lanes a, size_t) { return a; }
+#endif
+
+// --------------------------------------------------------
+// Sine and cosine of every lane, the same way as
+// XMScalarSinCos(): wrap to [-pi, pi], fold into
+// [-pi/2, pi/2] and use its polynomials from there
+// --------------------------------------------------------
+static inline void SinCos(Lanes angle, Lanes& sin, Lanes& cos)
+{
+	Lanes x = Sub(angle, Mul(Round(Mul(angle, Splat(XM_1DIV2PI))), Splat(XM_2PI)));
+
+	// sin(pi - x) = sin(x) and cos(pi - x) = -cos(x)
+	Lanes pi = Or(Splat(XM_PI), And(x, Splat(-0.0f)));
+	Lanes fold = Greater(Abs(x), Splat(XM_PIDIV2));
+	x = Select(x, Sub(pi, x), fold);
+	Lanes cosSign = Select(Splat(1.0f), Splat(-1.0f), fold);
+
+	Lanes x2 = Mul(x, x);
+	Lanes s = Splat(-2.3889859e-08f);
+	s = Add(Mul(s, x2), Splat(2.7525562e-06f));
+	s = Add(Mul(s, x2), Splat(-0.00019840874f));
+	s = Add(Mul(s, x2), Splat(0.0083333310f));
+	s = Add(Mul(s, x2), Splat(-0.16666667f));
+	sin = Mul(Add(Mul(s, x2), Splat(1.0f)), x);
+
+	Lanes c = Splat(-2.6051615e-07f);
+	c = Add(Mul(c, x2), Splat(2.4760495e-05f));
+	c = Add(Mul(c, x2), Splat(-0.0013888378f));
+	c = Add(Mul(c, x2), Splat(0.041666638f));
+	c = Add(Mul(c, x2), Splat(-0.5f));
+	cos = Mul(Add(Mul(c, x2), Splat(1.0f)), cosSign);
+}
+
+// --------------------------------------------------------
+// Writes one row of LaneCount matrices, given a register
+// for each column.  Four lanes at a time get transposed so
+// each matrix's row is a single store.
+// --------------------------------------------------------
+static inline void StoreRow(XMFLOAT4X4* out, int row, Lanes x, Lanes y, Lanes z, Lanes w)
+{
+	for (size_t half = 0; half < LaneCount / 4; half++)
+	{
+		__m128 r0 = Quarter(x, half);
+		__m128 r1 = Quarter(y, half);
+		__m128 r2 = Quarter(z, half);
+		__m128 r3 = Quarter(w, half);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		XMFLOAT4X4* m = out + half * 4;
+		_mm_storeu_ps(&m[0].m[row][0], r0);
+		_mm_storeu_ps(&m[1].m[row][0], r1);
+		_mm_storeu_ps(&m[2].m[row][0], r2);
+		_mm_storeu_ps(&m[3].m[row][0], r3);
+	}
+}
+
+
+TransformSystem::TransformSystem()
+	: lastUpdateCount(0), updateNumber(0)
+{
+}
+
+
+TransformHandle TransformSystem::Create()
+{
+	unsigned int slot = (unsigned int)handles.size();
+
+	// Reuse an old handle if there is one
+	TransformHandle handle;
+	if (!unusedHandles.empty())
+	{
+		handle = unusedHandles.back();
+		unusedHandles.pop_back();
+		slots[handle] = slot;
+	}
+	else
+	{
+		handle = (TransformHandle)slots.size();
+		slots.push_back(slot);
+	}
+
+	handles.push_back(handle);
+	Resize(handles.size());
+
+	// Padding is already an identity transform, so the new slot
+	// just needs its matrix built on the next update
+	dirty[slot] = 1;
+	moved[slot] = Created;
+	versions[slot] = 0;
+	return handle;
+}
+
+
+void TransformSystem::Destroy(TransformHandle handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	// Move the last transform into the hole
+	unsigned int slot = GetSlot(handle);
+	unsigned int last = (unsigned int)handles.size() - 1;
+	if (slot != last)
+	{
+		positionX[slot] = positionX[last];
+		positionY[slot] = positionY[last];
+		positionZ[slot] = positionZ[last];
+		pitch[slot] = pitch[last];
+		yaw[slot] = yaw[last];
+		roll[slot] = roll[last];
+		scaleX[slot] = scaleX[last];
+		scaleY[slot] = scaleY[last];
+		scaleZ[slot] = scaleZ[last];
+		dirty[slot] = dirty[last];
+		worldMatrices[slot] = worldMatrices[last];
+		previousWorldMatrices[slot] = previousWorldMatrices[last];
+		moved[slot] = moved[last];
+		versions[slot] = versions[last];
+		worldInverseTransposeMatrices[slot] = worldInverseTransposeMatrices[last];
+		inverseTransposeDirty[slot] = inverseTransposeDirty[last];
+		handles[slot] = handles[last];
+		slots[handles[slot]] = slot;
+	}
+
+	slots[handle] = InvalidTransform;
+	unusedHandles.push_back(handle);
+	handles.pop_back();
+
+	// The old last slot goes back to being padding
+	positionX[last] = positionY[last] = positionZ[last] = 0;
+	pitch[last] = yaw[last] = roll[last] = 0;
+	scaleX[last] = scaleY[last] = scaleZ[last] = 1;
+	dirty[last] = 0;
+	XMStoreFloat4x4(&worldMatrices[last], XMMatrixIdentity());
+	XMStoreFloat4x4(&previousWorldMatrices[last], XMMatrixIdentity());
+	moved[last] = AtRest;
+	versions[last] = 0;
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[last], XMMatrixIdentity());
+	inverseTransposeDirty[last] = 0;
+	Resize(handles.size());
+}
+
+
+bool TransformSystem::IsValid(TransformHandle handle)
+{
+	return handle < slots.size() && slots[handle] != InvalidTransform;
+}
+
+
+void TransformSystem::MoveAbsolute(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(handle);
+	positionX[slot] += x;
+	positionY[slot] += y;
+	positionZ[slot] += z;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::MoveRelative(TransformHandle handle, float x, float y, float z)
+{
+	// Same as Transform: rotate the movement into world space
+	unsigned int slot = GetSlot(handle);
+	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYaw(pitch[slot], yaw[slot], roll[slot]);
+	XMFLOAT3 dir;
+	XMStoreFloat3(&dir, XMVector3Rotate(XMVectorSet(x, y, z, 0), rotQuat));
+	MoveAbsolute(handle, dir.x, dir.y, dir.z);
+}
+
+void TransformSystem::Rotate(TransformHandle handle, float p, float y, float r)
+{
+	unsigned int slot = GetSlot(handle);
+	pitch[slot] += p;
+	yaw[slot] += y;
+	roll[slot] += r;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::Scale(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(handle);
+	scaleX[slot] *= x;
+	scaleY[slot] *= y;
+	scaleZ[slot] *= z;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::SetPosition(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(handle);
+	positionX[slot] = x;
+	positionY[slot] = y;
+	positionZ[slot] = z;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::SetRotation(TransformHandle handle, float p, float y, float r)
+{
+	unsigned int slot = GetSlot(handle);
+	pitch[slot] = p;
+	yaw[slot] = y;
+	roll[slot] = r;
+	dirty[slot] = 1;
+}
+
+void TransformSystem::SetScale(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int slot = GetSlot(handle);
+	scaleX[slot] = x;
+	scaleY[slot] = y;
+	scaleZ[slot] = z;
+	dirty[slot] = 1;
+}
+
+XMFLOAT3 TransformSystem::GetPosition(TransformHandle handle)
+{
+	unsigned int slot = GetSlot(handle);
+	return XMFLOAT3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+XMFLOAT3 TransformSystem::GetPitchYawRoll(TransformHandle handle)
+{
+	unsigned int slot = GetSlot(handle);
+	return XMFLOAT3(pitch[slot], yaw[slot], roll[slot]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(TransformHandle handle)
+{
+	unsigned int slot = GetSlot(handle);
+	return XMFLOAT3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(TransformHandle handle)
+{
+	return worldMatrices[GetSlot(handle)];
+}
+
+XMFLOAT4X4 TransformSystem::GetInterpolatedWorldMatrix(TransformHandle handle, float alpha)
+{
+	unsigned int slot = GetSlot(handle);
+	if (moved[slot] != Moved)
+		return worldMatrices[slot];
+	return InterpolateWorldMatrix(previousWorldMatrices[slot], worldMatrices[slot], alpha);
+}
+
+// Only the current scale is kept, so the blended matrix's
+// scale is read back off it instead: each of its first three
+// rows is a rotation row times that axis' scale
+XMFLOAT4X4 TransformSystem::GetInterpolatedWorldInverseTransposeMatrix(TransformHandle handle, float alpha)
+{
+	unsigned int slot = GetSlot(handle);
+	if (moved[slot] != Moved)
+		return GetWorldInverseTransposeMatrix(handle);
+
+	XMFLOAT4X4 blended = InterpolateWorldMatrix(previousWorldMatrices[slot], worldMatrices[slot], alpha);
+	XMMATRIX world = XMLoadFloat4x4(&blended);
+	XMFLOAT3 scale(
+		XMVectorGetX(XMVector3Length(world.r[0])),
+		XMVectorGetX(XMVector3Length(world.r[1])),
+		XMVectorGetX(XMVector3Length(world.r[2])));
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, InverseTransposeFromTRS(world, scale));
+	return result;
+}
+
+bool TransformSystem::IsMoving(TransformHandle handle)
+{
+	return moved[GetSlot(handle)] == Moved;
+}
+
+const XMFLOAT4X4& TransformSystem::GetWorldInverseTransposeMatrix(TransformHandle handle)
+{
+	unsigned int slot = GetSlot(handle);
+	if (inverseTransposeDirty[slot])
+	{
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrices[slot]);
+		XMFLOAT3 scale(scaleX[slot], scaleY[slot], scaleZ[slot]);
+		XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], InverseTransposeFromTRS(world, scale));
+		inverseTransposeDirty[slot] = 0;
+	}
+	return worldInverseTransposeMatrices[slot];
+}
+
+
+unsigned int TransformSystem::UpdateWorldMatrices()
+{
+	size_t groupCount = (handles.size() + LaneCount - 1) / LaneCount;
+	std::atomic<unsigned int> updated(0);
+	unsigned int version = ++updateNumber;
+
+	ParallelFor(groupCount, MinTransformsPerThread / LaneCount, [&](size_t begin, size_t end)
+	{
+		unsigned int pieceUpdated = 0;
+		for (size_t g = begin; g < end; g++)
+		{
+			size_t first = g * LaneCount;
+
+			// Skip whole groups that haven't changed, other than
+			// catching up the previous matrices of any that stopped
+			unsigned int changed = 0;
+			for (size_t k = 0; k < LaneCount; k++)
+				changed += dirty[first + k];
+			if (changed == 0)
+			{
+				for (size_t k = 0; k < LaneCount; k++)
+				{
+					if (moved[first + k] == Moved)
+					{
+						previousWorldMatrices[first + k] = worldMatrices[first + k];
+						versions[first + k] = version;
+					}
+					moved[first + k] = AtRest;
+				}
+				continue;
+			}
+
+			// Remember where they were before overwriting them
+			memcpy(&previousWorldMatrices[first], &worldMatrices[first], sizeof(XMFLOAT4X4) * LaneCount);
+
+			Lanes sp, cp, sy, cy, sr, cr;
+			SinCos(Load(&pitch[first]), sp, cp);
+			SinCos(Load(&yaw[first]), sy, cy);
+			SinCos(Load(&roll[first]), sr, cr);
+
+			// Rows of XMMatrixRotationRollPitchYaw(), each scaled by
+			// its axis, then the translation - the same as
+			// scale * rotation * translation
+			Lanes scX = Load(&scaleX[first]);
+			Lanes scY = Load(&scaleY[first]);
+			Lanes scZ = Load(&scaleZ[first]);
+			Lanes srsp = Mul(sr, sp);
+			Lanes crsp = Mul(cr, sp);
+			Lanes zero = Splat(0.0f);
+
+			XMFLOAT4X4* out = &worldMatrices[first];
+			StoreRow(out, 0,
+				Mul(Add(Mul(cr, cy), Mul(srsp, sy)), scX),
+				Mul(Mul(sr, cp), scX),
+				Mul(Sub(Mul(srsp, cy), Mul(cr, sy)), scX),
+				zero);
+			StoreRow(out, 1,
+				Mul(Sub(Mul(crsp, sy), Mul(sr, cy)), scY),
+				Mul(Mul(cr, cp), scY),
+				Mul(Add(Mul(sr, sy), Mul(crsp, cy)), scY),
+				zero);
+			StoreRow(out, 2,
+				Mul(Mul(cp, sy), scZ),
+				Mul(Sub(zero, sp), scZ),
+				Mul(Mul(cp, cy), scZ),
+				zero);
+			StoreRow(out, 3,
+				Load(&positionX[first]),
+				Load(&positionY[first]),
+				Load(&positionZ[first]),
+				Splat(1.0f));
+
+			for (size_t k = 0; k < LaneCount; k++)
+			{
+				// New transforms start where they are, rather than
+				// sliding in from the origin
+				bool created = moved[first + k] == Created;
+				if (created)
+					previousWorldMatrices[first + k] = worldMatrices[first + k];
+				if (dirty[first + k] || moved[first + k] == Moved)
+					versions[first + k] = version;
+				moved[first + k] = dirty[first + k] && !created ? Moved : AtRest;
+
+				inverseTransposeDirty[first + k] |= dirty[first + k];
+				dirty[first + k] = 0;
+			}
+			pieceUpdated += changed;
+		}
+		updated += pieceUpdated;
+	});
+
+	lastUpdateCount = updated;
+	return lastUpdateCount;
+}
+
+
+// Grows or shrinks the arrays to hold this many transforms,
+// rounded up to whole groups, with identity transforms in
+// any new space
+void TransformSystem::Resize(size_t count)
+{
+	size_t padded = (count + LaneCount - 1) / LaneCount * LaneCount;
+	if (padded == positionX.size())
+		return;
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	positionX.resize(padded, 0);
+	positionY.resize(padded, 0);
+	positionZ.resize(padded, 0);
+	pitch.resize(padded, 0);
+	yaw.resize(padded, 0);
+	roll.resize(padded, 0);
+	scaleX.resize(padded, 1);
+	scaleY.resize(padded, 1);
+	scaleZ.resize(padded, 1);
+	dirty.resize(padded, 0);
+	worldMatrices.resize(padded, identity);
+	previousWorldMatrices.resize(padded, identity);
+	moved.resize(padded, AtRest);
+	versions.resize(padded, 0);
+	worldInverseTransposeMatrices.resize(padded, identity);
+	inverseTransposeDirty.resize(padded, 0);
+}
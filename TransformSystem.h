@@ -0,0 +1,148 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+// Identifies a transform.  Stays the same for its whole life,
+// even as the system moves its data around.
+typedef unsigned int TransformHandle;
+static const TransformHandle InvalidTransform = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// Position, rotation and scale for lots of objects, stored
+// as one array per component (structure of arrays) instead
+// of one Transform per object.
+//
+// That layout lets UpdateWorldMatrices() build the world
+// matrices of a whole SIMD register's worth of objects at
+// once (8 with AVX2, 4 otherwise), with the sines and cosines
+// of the rotations done in the same registers, and spread
+// big batches across worker threads.  Groups with nothing
+// dirty in them are skipped.
+//
+// GetWorldMatrix() returns the result of the last update, so
+// call it once per frame (or simulation step) after moving
+// things.  Each update also keeps the matrices from the one
+// before, so rendering between two steps can blend them with
+// GetInterpolatedWorldMatrix().  The inverse transpose is
+// only needed for some objects, so it's worked out from the
+// world matrix the first time it's asked for.
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	TransformSystem();
+
+	// Makes a transform at the origin with no rotation and a
+	// scale of 1
+	TransformHandle Create();
+	void Destroy(TransformHandle handle);
+	bool IsValid(TransformHandle handle);
+
+	void MoveAbsolute(TransformHandle handle, float x, float y, float z);
+	void MoveRelative(TransformHandle handle, float x, float y, float z);
+	void Rotate(TransformHandle handle, float p, float y, float r);
+	void Scale(TransformHandle handle, float x, float y, float z);
+
+	void SetPosition(TransformHandle handle, float x, float y, float z);
+	void SetRotation(TransformHandle handle, float p, float y, float r);
+	void SetScale(TransformHandle handle, float x, float y, float z);
+
+	DirectX::XMFLOAT3 GetPosition(TransformHandle handle);
+	DirectX::XMFLOAT3 GetPitchYawRoll(TransformHandle handle);
+	DirectX::XMFLOAT3 GetScale(TransformHandle handle);
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(TransformHandle handle);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(TransformHandle handle);
+
+	// Between the last two updates: 0 for the one before, 1 for
+	// the latest
+	DirectX::XMFLOAT4X4 GetInterpolatedWorldMatrix(TransformHandle handle, float alpha);
+	DirectX::XMFLOAT4X4 GetInterpolatedWorldInverseTransposeMatrix(TransformHandle handle, float alpha);
+
+	// Changes whenever an update changes what the interpolated
+	// world matrix could be (when the transform moves, and again
+	// on the update after it stops), so anything built from it
+	// can tell when it's out of date.  Versions only ever go up,
+	// and are 0 until the transform's first update.
+	unsigned int GetVersion(TransformHandle handle) { return versions[GetSlot(handle)]; }
+
+	// Whether the transform moved in the last update, so its
+	// interpolated world matrix changes with alpha (and will keep
+	// changing between updates without its version changing)
+	bool IsMoving(TransformHandle handle);
+
+	// Recomputes the world matrix of every transform that changed
+	// since the last update, returning how many were recomputed
+	unsigned int UpdateWorldMatrices();
+
+	unsigned int GetCount() { return (unsigned int)handles.size(); }
+	unsigned int GetLastUpdateCount() { return lastUpdateCount; }
+
+private:
+	// Component arrays, by slot.  Live transforms fill the front
+	// and each array is padded out to a whole number of SIMD
+	// groups with identity transforms, so the kernel never has to
+	// deal with a partial group.
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> pitch, yaw, roll;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<unsigned char> dirty;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+
+	// Matrices as of the update before, and whether each transform
+	// moved in the last update (so those two differ), or was made
+	// just before it (so there's nothing to come from)
+	std::vector<DirectX::XMFLOAT4X4> previousWorldMatrices;
+	std::vector<unsigned char> moved;
+	std::vector<unsigned int> versions;
+
+	// Inverse transposes, filled in on demand
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+	std::vector<unsigned char> inverseTransposeDirty;
+
+	// Which transform is in each slot
+	std::vector<TransformHandle> handles;
+
+	// Slot of each handle, or InvalidTransform for unused handles
+	std::vector<unsigned int> slots;
+	std::vector<TransformHandle> unusedHandles;
+
+	unsigned int lastUpdateCount;
+	unsigned int updateNumber;		// Counts updates, for versions
+
+	unsigned int GetSlot(TransformHandle handle) { return slots[handle]; }
+	void Resize(size_t count);
+};
+
+// --------------------------------------------------------
+// A handle plus the system it belongs to, with the same
+// functions as Transform so code that moves one object
+// around reads the same as before
+// --------------------------------------------------------
+class TransformRef
+{
+public:
+	TransformRef(TransformSystem* system, TransformHandle handle) : system(system), handle(handle) {}
+
+	void MoveAbsolute(float x, float y, float z) { system->MoveAbsolute(handle, x, y, z); }
+	void MoveRelative(float x, float y, float z) { system->MoveRelative(handle, x, y, z); }
+	void Rotate(float p, float y, float r) { system->Rotate(handle, p, y, r); }
+	void Scale(float x, float y, float z) { system->Scale(handle, x, y, z); }
+
+	void SetPosition(float x, float y, float z) { system->SetPosition(handle, x, y, z); }
+	void SetRotation(float p, float y, float r) { system->SetRotation(handle, p, y, r); }
+	void SetScale(float x, float y, float z) { system->SetScale(handle, x, y, z); }
+
+	DirectX::XMFLOAT3 GetPosition() { return system->GetPosition(handle); }
+	DirectX::XMFLOAT3 GetPitchYawRoll() { return system->GetPitchYawRoll(handle); }
+	DirectX::XMFLOAT3 GetScale() { return system->GetScale(handle); }
+	DirectX::XMFLOAT4X4 GetWorldMatrix() { return system->GetWorldMatrix(handle); }
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix() { return system->GetWorldInverseTransposeMatrix(handle); }
+
+	TransformHandle GetHandle() { return handle; }
+
+private:
+	TransformSystem* system;
+	TransformHandle handle;
+};
@@ -12,5 +12,5 @@ struct Vertex
 	DirectX::XMFLOAT3 Position;	    // The position of the vertex
 	DirectX::XMFLOAT2 UV;			// Texture mapping
 	DirectX::XMFLOAT3 Normal;		// Lighting
-	DirectX::XMFLOAT3 Tangent;		// Normal mapping
+	DirectX::XMFLOAT4 Tangent;		// Normal mapping (w: bitangent sign, -1 for mirrored UVs)
 };
\ No newline at end of file
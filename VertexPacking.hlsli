@@ -0,0 +1,33 @@
+// Include guard
+#ifndef _VERTEX_PACKING_HLSL
+#define _VERTEX_PACKING_HLSL
+
+// Decoding for PackedVertex (see PackedVertex.h).  The input
+// assembler has already turned the unorm/snorm/half values into
+// floats, so all that's left is undoing our own encodings.
+
+// Struct representing a single packed vertex worth of data
+struct PackedVertexInput
+{
+	float4 position		: POSITION;		// xyz: [0,1] within the bounds, w: tangent handedness as 0/1
+	float2 normal		: NORMAL;		// Octahedral
+	float2 tangent		: TANGENT;		// Octahedral
+	float2 uv			: TEXCOORD;
+};
+
+// Positions are stored relative to the mesh's bounding box
+float3 DecodePosition(float4 packedPosition, float3 boundsMin, float3 boundsExtent)
+{
+	return boundsMin + packedPosition.xyz * boundsExtent;
+}
+
+// Maps a point on the unfolded octahedron back to a unit vector
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+#endif
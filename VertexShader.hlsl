@@ -1,13 +1,10 @@
+#include "PerFrame.hlsli"
 
-// Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
+// Data that changes for each object
+cbuffer perObject : register(b0)
 {
 	matrix world;
 	matrix worldInverseTranspose;
-	matrix view;
-	matrix projection;
-	matrix shadowView;
-	matrix shadowProjection;
 };
 
 // Struct representing a single vertex worth of data
@@ -16,7 +13,7 @@ struct VertexShaderInput
 	float3 position		: POSITION;
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
+	float4 tangent		: TANGENT;		// w: bitangent sign
 };
 
 // Out of the vertex shader (and eventually input to the PS)
@@ -25,9 +22,8 @@ struct VertexToPixel
 	float4 screenPosition	: SV_POSITION;
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;
 	float3 worldPos			: POSITION; // The world position of this vertex
-	float4 posForShadow		: SHADOWPOS;
 };
 
 // --------------------------------------------------------
@@ -43,17 +39,13 @@ VertexToPixel main(VertexShaderInput input)
 	output.screenPosition = mul(worldViewProj, float4(input.position, 1.0f));
 
 
-	// Calculate where this vertex is from the light's point of view
-	matrix shadowWVP = mul(shadowProjection, mul(shadowView, world));
-	output.posForShadow = mul(shadowWVP, float4(input.position, 1.0f));
-
 	// Calculate the world position of this vertex (to be used
 	// in the pixel shader when we do point/spot lights)
 	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
 
 	// Make sure the other vectors are in WORLD space, not "local" space
 	output.normal = normalize(mul((float3x3)worldInverseTranspose, input.normal));
-	output.tangent = normalize(mul((float3x3)world, input.tangent)); // Tangent doesn't need inverse transpose!
+	output.tangent = float4(normalize(mul((float3x3)world, input.tangent.xyz)), input.tangent.w); // Tangent doesn't need inverse transpose!
 
 	// Pass the UV through
 	output.uv = input.uv;
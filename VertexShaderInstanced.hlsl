@@ -0,0 +1,63 @@
+#include "PerFrame.hlsli"
+
+// Struct representing a single vertex worth of data, plus
+// the matrices of the instance it belongs to (one row per
+// input, straight from InstanceData)
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float2 uv			: TEXCOORD;
+	float3 normal		: NORMAL;
+	float4 tangent		: TANGENT;		// w: bitangent sign
+
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+	float4 worldIT0		: WORLDIT_PER_INSTANCE0;
+	float4 worldIT1		: WORLDIT_PER_INSTANCE1;
+	float4 worldIT2		: WORLDIT_PER_INSTANCE2;
+	float4 worldIT3		: WORLDIT_PER_INSTANCE3;
+};
+
+// Out of the vertex shader (and eventually input to the PS)
+struct VertexToPixel
+{
+	float4 screenPosition	: SV_POSITION;
+	float2 uv				: TEXCOORD;
+	float3 normal			: NORMAL;
+	float4 tangent			: TANGENT;
+	float3 worldPos			: POSITION; // The world position of this vertex
+};
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl, but with the world matrices
+// coming from the instance buffer rather than a cbuffer
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	// Set up output
+	VertexToPixel output;
+
+	// The rows arrive as stored on the C++ side, so unlike the
+	// cbuffer matrices these multiply with the vector first
+	matrix world = matrix(input.world0, input.world1, input.world2, input.world3);
+	matrix worldInverseTranspose = matrix(input.worldIT0, input.worldIT1, input.worldIT2, input.worldIT3);
+
+	// Calculate the world position of this vertex (to be used
+	// in the pixel shader when we do point/spot lights)
+	float4 worldPos = mul(float4(input.position, 1.0f), world);
+	output.worldPos = worldPos.xyz;
+
+	// Calculate output position
+	output.screenPosition = mul(projection, mul(view, worldPos));
+
+	// Make sure the other vectors are in WORLD space, not "local" space
+	output.normal = normalize(mul(input.normal, (float3x3)worldInverseTranspose));
+	output.tangent = float4(normalize(mul(input.tangent.xyz, (float3x3)world)), input.tangent.w); // Tangent doesn't need inverse transpose!
+
+	// Pass the UV through
+	output.uv = input.uv;
+
+	return output;
+}
@@ -0,0 +1,52 @@
+#include "VertexPacking.hlsli"
+#include "PerFrame.hlsli"
+
+// Data that changes for each object
+cbuffer perObject : register(b0)
+{
+	matrix world;
+	matrix worldInverseTranspose;
+	float3 positionMin;		// Mesh bounds, for decoding positions
+	float3 positionExtent;
+};
+
+// Out of the vertex shader (and eventually input to the PS)
+struct VertexToPixel
+{
+	float4 screenPosition	: SV_POSITION;
+	float2 uv				: TEXCOORD;
+	float3 normal			: NORMAL;
+	float4 tangent			: TANGENT;
+	float3 worldPos			: POSITION; // The world position of this vertex
+};
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl, but reading PackedVertex data
+// --------------------------------------------------------
+VertexToPixel main(PackedVertexInput input)
+{
+	// Set up output
+	VertexToPixel output;
+
+	// Unpack the vertex
+	float3 position = DecodePosition(input.position, positionMin, positionExtent);
+	float3 normal = DecodeOctahedral(input.normal);
+	float4 tangent = float4(DecodeOctahedral(input.tangent), input.position.w * 2.0f - 1.0f);
+
+	// Calculate output position
+	matrix worldViewProj = mul(projection, mul(view, world));
+	output.screenPosition = mul(worldViewProj, float4(position, 1.0f));
+
+	// Calculate the world position of this vertex (to be used
+	// in the pixel shader when we do point/spot lights)
+	output.worldPos = mul(world, float4(position, 1.0f)).xyz;
+
+	// Make sure the other vectors are in WORLD space, not "local" space
+	output.normal = normalize(mul((float3x3)worldInverseTranspose, normal));
+	output.tangent = float4(normalize(mul((float3x3)world, tangent.xyz)), tangent.w); // Tangent doesn't need inverse transpose!
+
+	// Pass the UV through
+	output.uv = input.uv;
+
+	return output;
+}